@@ -0,0 +1,177 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "fakeaptroot.h"
+
+#include <QtTest>
+
+#include <thread>
+
+#define __CURRENTLY_UNIT_TESTING__ 1
+
+#include <backend.h>
+#include <package.h>
+
+namespace QApt {
+
+class BackendTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testPayloadWithoutStateQuery();
+    void testUndoWithoutStateQuery();
+    void testRecordFields();
+    void testCommitPlan();
+
+private:
+    // A package that is not installed in the fake root
+    Package *notInstalledPackage() const;
+
+    QTemporaryDir m_root;
+    FakeAptRoot::Counts m_counts;
+    Backend *m_backend;
+};
+
+void BackendTest::initTestCase()
+{
+    // Keep the backend\'s caches out of the user\'s cache directory
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(m_root.isValid());
+
+    m_counts.packages = 100;
+    m_counts.historyEntries = 0;
+    m_counts.changelogs = 0;
+    m_counts.debs = 0;
+
+    FakeAptRoot root(m_root.path());
+    QVERIFY2(root.write(m_counts), qPrintable(root.errorString()));
+    root.configure();
+}
+
+void BackendTest::init()
+{
+    // Each test gets a fresh backend that nothing has queried yet
+    m_backend = new Backend(this);
+    QVERIFY(m_backend->init());
+}
+
+void BackendTest::cleanup()
+{
+    delete m_backend;
+    m_backend = nullptr;
+}
+
+Package *BackendTest::notInstalledPackage() const
+{
+    // Every third package is installed, see FakeAptRoot::Counts
+    return m_backend->package(FakeAptRoot::packageName(m_counts.installedEvery + 1));
+}
+
+void BackendTest::testPayloadWithoutStateQuery()
+{
+    Package *pkg = notInstalledPackage();
+    QVERIFY(pkg);
+
+    pkg->setInstall();
+
+    const QVariantMap payload = m_backend->changedPackageList();
+    const QString key = QString::fromStdString(pkg->packageIterator().FullName());
+    QVERIFY(payload.contains(key));
+    QCOMPARE(payload.value(key).toInt(), int(Package::ToInstall));
+}
+
+void BackendTest::testUndoWithoutStateQuery()
+{
+    Package *pkg = notInstalledPackage();
+    QVERIFY(pkg);
+
+    pkg->setInstall();
+    m_backend->saveCacheState();
+
+    pkg->setKeep();
+    QVERIFY(!(pkg->state() & Package::ToInstall));
+
+    m_backend->undo();
+    QVERIFY(pkg->state() & Package::ToInstall);
+}
+
+void BackendTest::testRecordFields()
+{
+    const PackageList packages = m_backend->packages(QStringList()
+        << FakeAptRoot::packageName(0) << FakeAptRoot::packageName(1)).packages;
+    QCOMPARE(packages.size(), 2);
+
+    const QList<QStringList> fields = m_backend->recordFields(packages, QStringList()
+        << QStringLiteral("Maintainer") << QStringLiteral("Section") << QStringLiteral("Nonexistent"));
+    QCOMPARE(fields.size(), 2);
+    for (const QStringList &values : fields) {
+        QCOMPARE(values.size(), 3);
+        QCOMPARE(values.at(0), QStringLiteral("QApt Benchmark <benchmark@example.org>"));
+        QCOMPARE(values.at(1), QStringLiteral("misc"));
+        QVERIFY(values.at(2).isEmpty());
+    }
+}
+
+void BackendTest::testCommitPlan()
+{
+    Package *pkg = notInstalledPackage();
+    QVERIFY(pkg);
+
+    QVERIFY(!m_backend->commitPlan().valid || m_backend->commitPlan().steps.isEmpty());
+
+    pkg->setInstall();
+
+    // Off the backend's thread, as allowed under the cache lock
+    CommitPlan plan;
+    std::thread planner([this, &plan]() {
+        QReadLocker locker(m_backend->cacheLock());
+        plan = m_backend->commitPlan();
+    });
+    planner.join();
+
+    QVERIFY(plan.valid);
+    QVERIFY(plan.installSize > 0);
+
+    int unpacked = -1;
+    int configured = -1;
+    for (int i = 0; i < plan.steps.size(); ++i) {
+        if (plan.steps.at(i).package != pkg)
+            continue;
+        if (plan.steps.at(i).action == CommitStep::Unpack)
+            unpacked = i;
+        else if (plan.steps.at(i).action == CommitStep::Configure)
+            configured = i;
+    }
+    QVERIFY(unpacked != -1);
+    QVERIFY(configured > unpacked);
+
+    // Memoized until the marking changes
+    QCOMPARE(m_backend->commitPlan().steps.size(), plan.steps.size());
+}
+
+}
+
+QTEST_MAIN(QApt::BackendTest);
+
+#include "backendtest.moc"
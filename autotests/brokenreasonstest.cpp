@@ -0,0 +1,135 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "fakeaptroot.h"
+
+#include <QtTest>
+
+#include <apt-pkg/depcache.h>
+
+#include <backend.h>
+#include <cache.h>
+#include <dependencyinfo.h>
+#include <package.h>
+
+namespace QApt {
+
+class BrokenReasonsTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testNothingBroken();
+    void testSharedCauses();
+
+private:
+    QTemporaryDir m_root;
+    Backend *m_backend;
+};
+
+void BrokenReasonsTest::initTestCase()
+{
+    // Keep the backend's caches out of the user's cache directory
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(m_root.isValid());
+
+    FakeAptRoot::Counts counts;
+    counts.packages = 20;
+    counts.historyEntries = 0;
+    counts.changelogs = 0;
+    counts.debs = 0;
+
+    FakeAptRoot root(m_root.path());
+    QVERIFY2(root.write(counts), qPrintable(root.errorString()));
+    root.configure();
+}
+
+void BrokenReasonsTest::init()
+{
+    // Each test starts from the unmarked cache
+    m_backend = new Backend(this);
+    QVERIFY(m_backend->init());
+}
+
+void BrokenReasonsTest::cleanup()
+{
+    delete m_backend;
+    m_backend = nullptr;
+}
+
+void BrokenReasonsTest::testNothingBroken()
+{
+    const BrokenDiagnosis diagnosis = m_backend->brokenReasons();
+    QVERIFY(diagnosis.packages.isEmpty());
+    QVERIFY(diagnosis.causes.isEmpty());
+    QVERIFY(diagnosis.rootCauses().isEmpty());
+}
+
+void BrokenReasonsTest::testSharedCauses()
+{
+    // pkg4 needs pkg3 (>= 1.0-0), which stays at 0.9-1, and both pkg4
+    // and pkg5 need pkg2 | pkg1, neither of which is installed. Marked
+    // without installing dependencies, so that nothing resolves it
+    Package *pkg4 = m_backend->package(FakeAptRoot::packageName(4));
+    Package *pkg5 = m_backend->package(FakeAptRoot::packageName(5));
+    QVERIFY(pkg4 && pkg5);
+
+    pkgDepCache *depCache = m_backend->cache()->depCache();
+    depCache->MarkInstall(pkg4->packageIterator(), false);
+    depCache->MarkInstall(pkg5->packageIterator(), false);
+    QCOMPARE(int(depCache->BrokenCount()), 2);
+
+    const BrokenDiagnosis diagnosis = m_backend->brokenReasons();
+    QCOMPARE(diagnosis.packages.size(), 2);
+    QCOMPARE(diagnosis.packageCauses.size(), 2);
+    QCOMPARE(diagnosis.causePackages.size(), diagnosis.causes.size());
+
+    const int index4 = diagnosis.packages.indexOf(pkg4);
+    const int index5 = diagnosis.packages.indexOf(pkg5);
+    QVERIFY(index4 != -1 && index5 != -1);
+
+    // The cause both share is listed once
+    QCOMPARE(diagnosis.causes.size(), 2);
+    const QVector<int> causes4 = diagnosis.packageCauses.at(index4);
+    const QVector<int> causes5 = diagnosis.packageCauses.at(index5);
+    QCOMPARE(causes4.size(), 2);
+    QCOMPARE(causes5.size(), 1);
+    QVERIFY(causes4.contains(causes5.first()));
+
+    const MarkingErrorInfo shared = diagnosis.causes.at(causes5.first());
+    QCOMPARE(shared.errorType(), QApt::DepNotInstallable);
+    QCOMPARE(shared.errorInfo().packageName(), FakeAptRoot::packageName(2));
+
+    const int own = causes4.at(causes4.at(0) == causes5.first() ? 1 : 0);
+    QCOMPARE(diagnosis.causes.at(own).errorType(), QApt::WrongCandidateVersion);
+    QCOMPARE(diagnosis.causes.at(own).errorInfo().packageName(), FakeAptRoot::packageName(3));
+
+    // Neither pkg2 nor pkg3 is broken itself
+    QCOMPARE(diagnosis.rootCauses().size(), 2);
+}
+
+}
+
+QTEST_MAIN(QApt::BrokenReasonsTest);
+
+#include "brokenreasonstest.moc"
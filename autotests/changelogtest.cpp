@@ -0,0 +1,135 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include <QtTest>
+
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/init.h>
+#include <apt-pkg/pkgsystem.h>
+
+#include <changelog.h>
+
+namespace QApt {
+
+// A changelog of @p source with @p entries entries, 1.0-<entries> first
+static QString changelogText(const QString &source, int entries)
+{
+    QString data;
+    for (int i = entries; i > 0; --i) {
+        data += source + QStringLiteral(" (1.0-%1) unstable; urgency=medium\n\n"
+                                        "  * Change number %1 of the package.\n"
+                                        "  * Another line describing the change.\n\n"
+                                        " -- QApt Tests <tests@example.org>  Wed, 01 Jan 2014 12:00:00 +0000\n\n").arg(i);
+    }
+
+    return data;
+}
+
+class ChangelogTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+
+    void testEntries();
+    void testNewEntriesSince();
+    void testNewEntriesSinceStopsEarly();
+    void testEmpty();
+
+private:
+    QString m_sourcePackage;
+    QString m_data;
+};
+
+void ChangelogTest::initTestCase()
+{
+    // Versions are compared by the apt system
+    QVERIFY(pkgInitConfig(*_config));
+    QVERIFY(pkgInitSystem(*_config, _system));
+
+    m_sourcePackage = QStringLiteral("pkg0");
+    m_data = changelogText(m_sourcePackage, 20);
+}
+
+void ChangelogTest::testEntries()
+{
+    const Changelog changelog(m_data, m_sourcePackage);
+    QCOMPARE(changelog.text(), m_data);
+
+    const ChangelogEntryList entries = changelog.entries();
+    QCOMPARE(entries.size(), 20);
+
+    // Newest first, as written
+    QCOMPARE(entries.first().version(), QStringLiteral("1.0-20"));
+    QCOMPARE(entries.last().version(), QStringLiteral("1.0-1"));
+    QVERIFY(entries.first().entryText().startsWith(m_sourcePackage + QStringLiteral(" (1.0-20)")));
+    QVERIFY(!entries.first().entryText().contains(QStringLiteral("(1.0-19)")));
+    QVERIFY(entries.first().description().contains(QStringLiteral("Change number 20 ")));
+    QVERIFY(entries.first().issueDateTime().isValid());
+
+    // Asking again hands out the same entries
+    QCOMPARE(changelog.entries().size(), 20);
+    QCOMPARE(changelog.entries().at(7).version(), QStringLiteral("1.0-13"));
+}
+
+void ChangelogTest::testNewEntriesSince()
+{
+    const Changelog changelog(m_data, m_sourcePackage);
+
+    const ChangelogEntryList newEntries = changelog.newEntriesSince(QStringLiteral("1.0-15"));
+    QCOMPARE(newEntries.size(), 5);
+    QCOMPARE(newEntries.first().version(), QStringLiteral("1.0-20"));
+    QCOMPARE(newEntries.last().version(), QStringLiteral("1.0-16"));
+
+    QVERIFY(changelog.newEntriesSince(QStringLiteral("1.0-20")).isEmpty());
+    QCOMPARE(changelog.newEntriesSince(QStringLiteral("0.9-1")).size(), 20);
+
+    // Entries parsed on the way are kept for entries()
+    QCOMPARE(changelog.entries().size(), 20);
+}
+
+void ChangelogTest::testNewEntriesSinceStopsEarly()
+{
+    // Changelogs are ordered newest first, so an out of order entry past
+    // the first older one is never looked at
+    const QString data = m_data + m_sourcePackage +
+                         QStringLiteral(" (9.9-1) unstable; urgency=medium\n\n"
+                                        "  * Out of order.\n\n"
+                                        " -- QApt Tests <tests@example.org>  Wed, 01 Jan 2014 12:00:00 +0000\n");
+    const Changelog changelog(data, m_sourcePackage);
+
+    QCOMPARE(changelog.newEntriesSince(QStringLiteral("1.0-18")).size(), 2);
+    QCOMPARE(changelog.entries().size(), 21);
+    QCOMPARE(changelog.entries().last().version(), QStringLiteral("9.9-1"));
+}
+
+void ChangelogTest::testEmpty()
+{
+    const Changelog changelog(QString(), m_sourcePackage);
+
+    QVERIFY(changelog.entries().isEmpty());
+    QVERIFY(changelog.newEntriesSince(QStringLiteral("1.0-1")).isEmpty());
+}
+
+}
+
+QTEST_MAIN(QApt::ChangelogTest);
+
+#include "changelogtest.moc"
@@ -0,0 +1,125 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include <QtTest>
+
+#include <descriptionformatter.h>
+
+namespace QApt {
+
+class DescriptionFormatterTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testFormat_data();
+    void testFormat();
+
+    void benchmarkRegExp();
+    void benchmarkFormatter();
+
+private:
+    static QString regExpFormat(const QString &rawDescription);
+    static QString sampleDescription();
+};
+
+// The QRegExp based implementation that formatLongDescription() replaced,
+// kept for comparison.
+QString DescriptionFormatterTest::regExpFormat(const QString &rawDescription)
+{
+    QString parsedDescription;
+    QStringList sections = rawDescription.split(QLatin1String("\n ."));
+
+    for (int i = 0; i < sections.count(); ++i) {
+        sections[i].replace(QRegExp(QLatin1String("\n( |\t)+(-|\\*)")),
+                            QLatin1Literal("\n\r ") % QString::fromUtf8("\xE2\x80\xA2"));
+        sections[i].remove(QLatin1Char('\n'));
+        sections[i].replace(QLatin1Char('\r'), QLatin1Char('\n'));
+        sections[i].replace(QRegExp(QLatin1String("\\ \\ +")), QChar::fromLatin1(' '));
+        if (sections[i].startsWith(QChar::Space)) {
+            sections[i].remove(0, 1);
+        }
+        if (sections[i].startsWith(QLatin1String("\n ") % QString::fromUtf8("\xE2\x80\xA2 ")) || !i) {
+            parsedDescription += sections[i];
+        }  else {
+            parsedDescription += QLatin1Literal("\n\n") % sections[i];
+        }
+    }
+
+    return parsedDescription;
+}
+
+QString DescriptionFormatterTest::sampleDescription()
+{
+    return QStringLiteral(" TeX Live is a comprehensive distribution of TeX, with binaries\n"
+                          " for most flavours of Unix.\n"
+                          " .\n"
+                          " This package provides:\n"
+                          "  - the TeX engines,   pdfTeX and XeTeX\n"
+                          "  * the LaTeX format\n"
+                          "\t- tools like bibtex\n"
+                          " .\n"
+                          " Homepage:  https://tug.org/texlive/");
+}
+
+void DescriptionFormatterTest::testFormat_data()
+{
+    QTest::addColumn<QString>("raw");
+
+    QTest::newRow("empty") << QString();
+    QTest::newRow("single line") << QStringLiteral(" A single line.");
+    QTest::newRow("joined lines") << QStringLiteral(" First line\n second line\n third  line");
+    QTest::newRow("paragraphs") << QStringLiteral(" One.\n .\n Two.\n .\n Three.");
+    QTest::newRow("trailing separator") << QStringLiteral(" One.\n .");
+    QTest::newRow("list") << QStringLiteral(" Features:\n  - one\n  - two\n * three");
+    QTest::newRow("list paragraph") << QStringLiteral(" Intro.\n .\n  - first\n  - second");
+    QTest::newRow("carriage return") << QStringLiteral(" Windows\r line");
+    QTest::newRow("sample") << sampleDescription();
+}
+
+void DescriptionFormatterTest::testFormat()
+{
+    QFETCH(QString, raw);
+
+    QCOMPARE(formatLongDescription(raw), regExpFormat(raw));
+}
+
+void DescriptionFormatterTest::benchmarkRegExp()
+{
+    const QString raw = sampleDescription();
+
+    QBENCHMARK {
+        regExpFormat(raw);
+    }
+}
+
+void DescriptionFormatterTest::benchmarkFormatter()
+{
+    const QString raw = sampleDescription();
+
+    QBENCHMARK {
+        formatLongDescription(raw);
+    }
+}
+
+}
+
+QTEST_MAIN(QApt::DescriptionFormatterTest)
+
+#include "descriptionformattertest.moc"
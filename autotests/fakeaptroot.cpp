@@ -0,0 +1,318 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "fakeaptroot.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/strutl.h>
+
+namespace {
+
+// Packages have up to six versions, 1.0-0 ... 1.0-6
+QByteArray versionOf(int index)
+{
+    return "1.0-" + QByteArray::number(index % 7);
+}
+
+QByteArray octal(qint64 value, int width)
+{
+    // Zero padded, leaving room for the terminating NUL
+    return QByteArray::number(value, 8).rightJustified(width - 1, '0');
+}
+
+QByteArray tarArchive(const QList<QPair<QByteArray, QByteArray> > &files)
+{
+    QByteArray tar;
+
+    for (const auto &file : files) {
+        QByteArray header(512, '\0');
+        header.replace(0, file.first.size(), file.first);
+        header.replace(100, 7, octal(0644, 8));
+        header.replace(108, 7, octal(0, 8));
+        header.replace(116, 7, octal(0, 8));
+        header.replace(124, 11, octal(file.second.size(), 12));
+        header.replace(136, 11, octal(1388577600, 12));
+        header.replace(148, 8, QByteArray(8, ' '));
+        header[156] = '0';
+        header.replace(257, 8, QByteArray("ustar\0" "00", 8));
+
+        uint checksum = 0;
+        for (char c : header)
+            checksum += uchar(c);
+        header.replace(148, 7, octal(checksum, 8));
+
+        tar += header;
+        tar += file.second;
+        tar += QByteArray((512 - file.second.size() % 512) % 512, '\0');
+    }
+
+    // Two empty blocks end the archive
+    tar += QByteArray(1024, '\0');
+    return tar;
+}
+
+QByteArray arMember(const QByteArray &name, const QByteArray &data)
+{
+    QByteArray member = name.leftJustified(16, ' ')
+                        + QByteArray("1388577600").leftJustified(12, ' ')
+                        + QByteArray("0").leftJustified(6, ' ')
+                        + QByteArray("0").leftJustified(6, ' ')
+                        + QByteArray("100644").leftJustified(8, ' ')
+                        + QByteArray::number(data.size()).leftJustified(10, ' ')
+                        + "`\n" + data;
+    if (data.size() % 2)
+        member += '\n';
+    return member;
+}
+
+}
+
+FakeAptRoot::FakeAptRoot(const QString &path)
+    : m_path(QDir(path).absolutePath())
+{
+}
+
+QString FakeAptRoot::path() const
+{
+    return m_path;
+}
+
+QString FakeAptRoot::errorString() const
+{
+    return m_errorString;
+}
+
+QString FakeAptRoot::packageName(int index)
+{
+    return QStringLiteral("pkg%1").arg(index);
+}
+
+QByteArray FakeAptRoot::changelog(int index, int entries)
+{
+    const QByteArray name = packageName(index).toLatin1();
+    QByteArray data;
+
+    for (int i = entries; i > 0; --i) {
+        data += name + " (1.0-" + QByteArray::number(i) + ") unstable; urgency=medium\n\n"
+                "  * Change number " + QByteArray::number(i) + " of the synthetic package.\n"
+                "  * Another line describing the change.\n\n"
+                " -- QApt Benchmark <benchmark@example.org>  Wed, 01 Jan 2014 12:00:00 +0000\n\n";
+    }
+
+    return data;
+}
+
+QByteArray FakeAptRoot::debFile(int index)
+{
+    const QByteArray name = packageName(index).toLatin1();
+    const QByteArray control = "Package: " + name + "\n"
+                               "Version: " + versionOf(index) + "\n"
+                               "Architecture: amd64\n"
+                               "Maintainer: QApt Benchmark <benchmark@example.org>\n"
+                               "Installed-Size: 1\n"
+                               "Depends: libc6 (>= 2.17)\n"
+                               "Section: misc\n"
+                               "Priority: optional\n"
+                               "Description: synthetic package number " + QByteArray::number(index) + "\n"
+                               " A sample archive for the DebFile benchmarks.\n";
+
+    QList<QPair<QByteArray, QByteArray> > controlFiles;
+    controlFiles << qMakePair(QByteArray("./control"), control);
+
+    QList<QPair<QByteArray, QByteArray> > dataFiles;
+    dataFiles << qMakePair("./usr/share/doc/" + name + "/copyright",
+                           QByteArray("Public domain test data.\n"));
+
+    return "!<arch>\n"
+           + arMember("debian-binary", "2.0\n")
+           + arMember("control.tar", tarArchive(controlFiles))
+           + arMember("data.tar", tarArchive(dataFiles));
+}
+
+bool FakeAptRoot::writeFile(const QString &relativePath, const QByteArray &data)
+{
+    const QString fullPath = m_path + QLatin1Char('/') + relativePath;
+    QDir().mkpath(QFileInfo(fullPath).absolutePath());
+
+    QFile file(fullPath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        m_errorString = fullPath + QStringLiteral(": ") + file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+QList<QPair<QByteArray, QByteArray> > FakeAptRoot::options() const
+{
+    const QByteArray root = QFile::encodeName(m_path);
+    QList<QPair<QByteArray, QByteArray> > options;
+
+    options << qMakePair(QByteArray("Dir"), root + '/')
+            << qMakePair(QByteArray("Dir::Etc::main"), root + "/etc/apt/apt.conf")
+            << qMakePair(QByteArray("Dir::Etc::parts"), root + "/etc/apt/apt.conf.d")
+            << qMakePair(QByteArray("Dir::Etc::sourcelist"), root + "/etc/apt/sources.list")
+            << qMakePair(QByteArray("Dir::Etc::sourceparts"), root + "/etc/apt/sources.list.d")
+            << qMakePair(QByteArray("Dir::Etc::preferences"), root + "/etc/apt/preferences")
+            << qMakePair(QByteArray("Dir::Etc::preferencesparts"), root + "/etc/apt/preferences.d")
+            << qMakePair(QByteArray("Dir::State::lists"), root + "/var/lib/apt/lists/")
+            << qMakePair(QByteArray("Dir::State::status"), root + "/var/lib/dpkg/status")
+            << qMakePair(QByteArray("Dir::Cache"), root + "/var/cache/apt/")
+            << qMakePair(QByteArray("Dir::Log::History"), root + "/var/log/apt/history.log")
+            << qMakePair(QByteArray("APT::Architecture"), QByteArray("amd64"))
+            << qMakePair(QByteArray("APT::Architectures::"), QByteArray("amd64"));
+
+    return options;
+}
+
+void FakeAptRoot::configure() const
+{
+    for (const auto &option : options())
+        _config->Set(option.first.constData(), option.second.constData());
+}
+
+bool FakeAptRoot::write(const Counts &counts)
+{
+    const QString archive = QStringLiteral("file:") + m_path + QStringLiteral("/archive");
+    const QString listsName = QString::fromStdString(URItoFileName(
+        (archive + QStringLiteral("/dists/stable/main/binary-amd64/Packages")).toStdString()));
+
+    QByteArray packages;
+    QByteArray status;
+    packages.reserve(counts.packages * 600);
+    status.reserve(counts.packages * 100);
+
+    for (int i = 0; i < counts.packages; ++i) {
+        const QByteArray name = packageName(i).toLatin1();
+        QByteArray depends = "libc6 (>= 2.17)";
+        if (i > 0)
+            depends += ", pkg" + QByteArray::number(i - 1) + " (>= 1.0-0)";
+        if (i > 1)
+            depends += ", pkg" + QByteArray::number(i / 2) + " | pkg" + QByteArray::number(i / 3);
+
+        packages += "Package: " + name + "\n"
+                    "Architecture: amd64\n"
+                    "Version: " + versionOf(i) + "\n"
+                    "Priority: optional\n"
+                    "Section: misc\n"
+                    "Maintainer: QApt Benchmark <benchmark@example.org>\n"
+                    "Installed-Size: " + QByteArray::number(100 + i % 1000) + "\n"
+                    "Depends: " + depends + "\n"
+                    "Filename: pool/main/p/" + name + "/" + name + "_" + versionOf(i) + "_amd64.deb\n"
+                    "Size: " + QByteArray::number(1000 + i) + "\n"
+                    "Description: synthetic package number " + QByteArray::number(i) + "\n"
+                    " This package only exists to fill the benchmark cache. It has a\n"
+                    " long description spanning several lines and paragraphs.\n"
+                    " .\n"
+                    " Features:\n"
+                    "  - being package " + name + "\n"
+                    "  - depending on its neighbours\n\n";
+
+        // Installed in an older version, so that there are upgrades, too
+        if (counts.installedEvery > 0 && i % counts.installedEvery == 0) {
+            status += "Package: " + name + "\n"
+                      "Status: install ok installed\n"
+                      "Architecture: amd64\n"
+                      "Version: 0.9-1\n"
+                      "Maintainer: QApt Benchmark <benchmark@example.org>\n"
+                      "Description: synthetic package number " + QByteArray::number(i) + "\n\n";
+        }
+    }
+    status += "Package: libc6\n"
+              "Status: install ok installed\n"
+              "Architecture: amd64\n"
+              "Version: 2.31-1\n"
+              "Description: fake C library\n\n";
+
+    if (!writeFile(QStringLiteral("var/lib/apt/lists/") + listsName, packages) ||
+        !writeFile(QStringLiteral("var/lib/dpkg/status"), status) ||
+        !writeFile(QStringLiteral("etc/apt/sources.list"),
+                   "deb [trusted=yes] " + archive.toUtf8() + " stable main\n")) {
+        return false;
+    }
+
+    QByteArray conf;
+    for (const auto &option : options())
+        conf += option.first + " \"" + option.second + "\";\n";
+    if (!writeFile(QStringLiteral("etc/apt/apt.conf"), conf))
+        return false;
+
+    // Disabled mirrors, so they add to the sources but not to the cache
+    for (int i = 0; i < counts.sourceFiles; ++i) {
+        const QByteArray mirror = "http://mirror" + QByteArray::number(i) + ".example.org/debian";
+        const bool deb822 = i % 2;
+        const QString fileName = QStringLiteral("etc/apt/sources.list.d/mirror%1.%2")
+                                 .arg(i).arg(deb822 ? QStringLiteral("sources") : QStringLiteral("list"));
+        const QByteArray data = deb822
+            ? "Types: deb deb-src\nURIs: " + mirror + "\nSuites: stable\n"
+              "Components: main contrib\nEnabled: no\n"
+            : "# deb " + mirror + " stable main contrib\n"
+              "# deb-src " + mirror + " stable main contrib\n";
+        if (!writeFile(fileName, data))
+            return false;
+    }
+
+    // The oldest entries go to the highest rotation
+    const int logs = qMax(0, counts.historyRotations) + 1;
+    const int perLog = (counts.historyEntries + logs - 1) / logs;
+    for (int log = 0; log < logs; ++log) {
+        QByteArray history;
+        const int first = (logs - 1 - log) * perLog;
+        const int last = qMin(counts.historyEntries, first + perLog);
+
+        for (int i = first; i < last; ++i) {
+            const QByteArray date = QDateTime(QDate(2014, 1, 1).addDays(i / 24), QTime(i % 24, 0))
+                                    .toString(QStringLiteral("yyyy-MM-dd  hh:mm:ss")).toLatin1();
+            const QByteArray name = packageName(i % qMax(1, counts.packages)).toLatin1();
+            history += "\nStart-Date: " + date + "\n"
+                       "Commandline: apt-get install " + name + "\n"
+                       "Install: " + name + ":amd64 (1.0-1), libc6:amd64 (2.31-1, automatic)\n"
+                       "Upgrade: " + name + "-data:amd64 (0.9-1, 1.0-1)\n"
+                       "End-Date: " + date + "\n";
+        }
+
+        const QString fileName = log ? QStringLiteral("var/log/apt/history.log.%1").arg(log)
+                                     : QStringLiteral("var/log/apt/history.log");
+        if (!writeFile(fileName, history))
+            return false;
+    }
+
+    for (int i = 0; i < qMin(counts.changelogs, counts.packages); ++i) {
+        if (!writeFile(QStringLiteral("usr/share/doc/%1/changelog.Debian").arg(packageName(i)),
+                       changelog(i, counts.changelogEntries))) {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < qMin(counts.debs, counts.packages); ++i) {
+        const QString name = packageName(i);
+        if (!writeFile(QStringLiteral("debs/%1_%2_amd64.deb").arg(name, QString::fromLatin1(versionOf(i))),
+                       debFile(i))) {
+            return false;
+        }
+    }
+
+    return true;
+}
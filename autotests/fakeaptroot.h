@@ -0,0 +1,81 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef FAKEAPTROOT_H
+#define FAKEAPTROOT_H
+
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+#include <QString>
+
+/**
+ * Writes a self-contained, synthetic apt root for tests and benchmarks.
+ *
+ * The root holds a Packages list for a file: archive, a dpkg status file,
+ * rotated history logs, changelogs below usr/share/doc, sources.list.d
+ * entries in both formats and sample .deb files. All of it is generated
+ * from the package index, so the same counts always give the same root.
+ *
+ * configure() points the global apt configuration at the root. The root
+ * also gets an etc/apt/apt.conf setting the same Dir:: options, so other
+ * programs can use it through the APT_CONFIG environment variable.
+ */
+class FakeAptRoot
+{
+public:
+    struct Counts
+    {
+        int packages = 10000;
+        int installedEvery = 3;      ///< Every n-th package is installed
+        int historyEntries = 1000;
+        int historyRotations = 2;    ///< history.log.1 ... history.log.n
+        int changelogs = 100;
+        int changelogEntries = 50;   ///< Entries per changelog
+        int sourceFiles = 10;
+        int debs = 10;
+    };
+
+    explicit FakeAptRoot(const QString &path);
+
+    /// Writes the root, returns false and sets errorString() on failure
+    bool write(const Counts &counts);
+
+    /// Sets the Dir:: options of the global apt configuration to the root
+    void configure() const;
+
+    QString path() const;
+    QString errorString() const;
+
+    /// The name of package number @p index
+    static QString packageName(int index);
+    /// The changelog text written for package number @p index
+    static QByteArray changelog(int index, int entries);
+
+private:
+    bool writeFile(const QString &relativePath, const QByteArray &data);
+    QList<QPair<QByteArray, QByteArray> > options() const;
+    static QByteArray debFile(int index);
+
+    QString m_path;
+    QString m_errorString;
+};
+
+#endif
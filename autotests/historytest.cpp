@@ -0,0 +1,214 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include <QtTest>
+
+#include <apt-pkg/configuration.h>
+
+#include <history.h>
+
+namespace QApt {
+
+class HistoryTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+
+    void testItems();
+    void testReloadAppended();
+    void testReloadRunningTransaction();
+    void testReloadAfterRotation();
+
+private:
+    // Writes @p data to the history log with the given rotation
+    bool writeLog(int rotation, const QByteArray &data);
+    // Appends @p data to the current history log
+    bool appendToLog(const QByteArray &data);
+    // A stanza for package @p name, started at @p start
+    static QByteArray stanza(const QString &name, const QDateTime &start, bool finished = true);
+
+    QTemporaryDir m_root;
+    QString m_logPath;
+    // After the newest entry written by initTestCase()
+    QDateTime m_nextDate;
+};
+
+void HistoryTest::initTestCase()
+{
+    QVERIFY(m_root.isValid());
+
+    m_logPath = m_root.path() + QStringLiteral("/history.log");
+    _config->Set("Dir::Log::History", QFile::encodeName(m_logPath).constData());
+
+    // Ten entries in each of history.log.2, history.log.1 and history.log,
+    // oldest first
+    QDateTime date(QDate(2014, 1, 1), QTime(0, 0));
+    for (int rotation = 2; rotation >= 0; --rotation) {
+        QByteArray log;
+        for (int i = 0; i < 10; ++i) {
+            log += stanza(QStringLiteral("pkg%1").arg(i), date);
+            date = date.addSecs(3600);
+        }
+        QVERIFY(writeLog(rotation, log));
+    }
+
+    m_nextDate = QDateTime(QDate(2015, 1, 1), QTime(12, 0));
+}
+
+bool HistoryTest::writeLog(int rotation, const QByteArray &data)
+{
+    QFile log(rotation ? m_logPath + QLatin1Char('.') + QString::number(rotation) : m_logPath);
+    if (!log.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    return log.write(data) == data.size();
+}
+
+bool HistoryTest::appendToLog(const QByteArray &data)
+{
+    QFile log(m_logPath);
+    if (!log.open(QIODevice::WriteOnly | QIODevice::Append))
+        return false;
+
+    return log.write(data) == data.size();
+}
+
+QByteArray HistoryTest::stanza(const QString &name, const QDateTime &start, bool finished)
+{
+    const QByteArray date = start.toString(QStringLiteral("yyyy-MM-dd  hh:mm:ss")).toLatin1();
+    QByteArray text = "\nStart-Date: " + date + "\n"
+                      "Commandline: apt-get install " + name.toLatin1() + "\n"
+                      "Install: " + name.toLatin1() + ":amd64 (1.0-1)\n";
+    if (finished)
+        text += "End-Date: " + date + "\n";
+
+    return text;
+}
+
+void HistoryTest::testItems()
+{
+    History history(nullptr);
+    const HistoryItemList all = history.historyItems();
+    QCOMPARE(all.size(), 30);
+
+    // Newest first, across the rotated logs
+    const HistoryItemList page = history.items(0, 15);
+    QCOMPARE(page.size(), 15);
+    for (int i = 1; i < page.size(); ++i)
+        QVERIFY(page.at(i - 1).startDate() > page.at(i).startDate());
+
+    QCOMPARE(history.items(25, 10).size(), 5);
+}
+
+void HistoryTest::testReloadAppended()
+{
+    History history(nullptr);
+    const int before = history.historyItems().size();
+
+    HistoryItemList added;
+    int emitted = 0;
+    connect(&history, &History::itemsAdded, [&added, &emitted](const HistoryItemList &items) {
+        added = items;
+        ++emitted;
+    });
+
+    const QDateTime first = m_nextDate;
+    const QDateTime second = m_nextDate.addSecs(3600);
+    m_nextDate = m_nextDate.addDays(1);
+    QVERIFY(appendToLog(stanza(QStringLiteral("appended-a"), first) +
+                        stanza(QStringLiteral("appended-b"), second)));
+
+    history.reload();
+    QCOMPARE(emitted, 1);
+    QCOMPARE(added.size(), 2);
+    QCOMPARE(added.at(0).startDate(), second);
+    QCOMPARE(added.at(1).startDate(), first);
+    QCOMPARE(added.at(0).installedPackages().size(), 1);
+    QVERIFY(added.at(0).installedPackages().first().startsWith(QLatin1String("appended-b")));
+
+    QCOMPARE(history.historyItems().size(), before + 2);
+    QCOMPARE(history.items(0, 1).first().startDate(), second);
+
+    // Nothing new
+    history.reload();
+    QCOMPARE(emitted, 1);
+}
+
+void HistoryTest::testReloadRunningTransaction()
+{
+    History history(nullptr);
+    const int before = history.historyItems().size();
+
+    int emitted = 0;
+    connect(&history, &History::itemsAdded, [&emitted](const HistoryItemList &) {
+        ++emitted;
+    });
+
+    // No End-Date yet, so it's left for a later reload
+    const QDateTime start = m_nextDate;
+    m_nextDate = m_nextDate.addDays(1);
+    QVERIFY(appendToLog(stanza(QStringLiteral("running"), start, false)));
+
+    history.reload();
+    QCOMPARE(emitted, 0);
+    QCOMPARE(history.historyItems().size(), before);
+
+    const QByteArray date = start.toString(QStringLiteral("yyyy-MM-dd  hh:mm:ss")).toLatin1();
+    QVERIFY(appendToLog("End-Date: " + date + "\n"));
+
+    history.reload();
+    QCOMPARE(emitted, 1);
+    QCOMPARE(history.historyItems().size(), before + 1);
+    QVERIFY(history.items(0, 1).first().installedPackages().first().startsWith(QLatin1String("running")));
+}
+
+void HistoryTest::testReloadAfterRotation()
+{
+    History history(nullptr);
+    const int before = history.historyItems().size();
+
+    int emitted = 0;
+    connect(&history, &History::itemsAdded, [&emitted](const HistoryItemList &) {
+        ++emitted;
+    });
+
+    // A new history.log with a single entry, as logrotate leaves it
+    const QDateTime start = m_nextDate;
+    m_nextDate = m_nextDate.addDays(1);
+    for (int rotation = 2; rotation >= 1; --rotation) {
+        QVERIFY(QFile::rename(m_logPath + QLatin1Char('.') + QString::number(rotation),
+                              m_logPath + QLatin1Char('.') + QString::number(rotation + 1)));
+    }
+    QVERIFY(QFile::rename(m_logPath, m_logPath + QStringLiteral(".1")));
+    QVERIFY(appendToLog(stanza(QStringLiteral("rotated"), start)));
+
+    // A full rescan, which reports nothing as added
+    history.reload();
+    QCOMPARE(emitted, 0);
+    QCOMPARE(history.historyItems().size(), before + 1);
+    QCOMPARE(history.items(0, 1).first().startDate(), start);
+}
+
+}
+
+QTEST_MAIN(QApt::HistoryTest);
+
+#include "historytest.moc"
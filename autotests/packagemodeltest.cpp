@@ -0,0 +1,197 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "fakeaptroot.h"
+
+#include <QtTest>
+
+#include <backend.h>
+#include <package.h>
+#include <packagemodel.h>
+
+namespace QApt {
+
+class PackageModelTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testFetchOnDemand();
+    void testData();
+    void testRecordRoles();
+    void testNameFilter();
+    void testSortByVersion();
+    void testPackageChanged();
+
+private:
+    QTemporaryDir m_root;
+    Backend *m_backend;
+};
+
+void PackageModelTest::initTestCase()
+{
+    // Keep the backend\'s caches out of the user\'s cache directory
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(m_root.isValid());
+
+    // More packages than one fetchMore() hands out
+    FakeAptRoot::Counts counts;
+    counts.packages = 1000;
+    counts.historyEntries = 0;
+    counts.changelogs = 0;
+    counts.debs = 0;
+
+    FakeAptRoot root(m_root.path());
+    QVERIFY2(root.write(counts), qPrintable(root.errorString()));
+    root.configure();
+
+    m_backend = new Backend(this);
+    QVERIFY(m_backend->init());
+}
+
+void PackageModelTest::cleanupTestCase()
+{
+    delete m_backend;
+}
+
+void PackageModelTest::testFetchOnDemand()
+{
+    PackageModel model(m_backend);
+    const int total = m_backend->availablePackages().size();
+
+    QVERIFY(model.rowCount() > 0);
+    QVERIFY(model.rowCount() < total);
+    QVERIFY(model.canFetchMore(QModelIndex()));
+    QVERIFY(!model.packageAt(model.rowCount()));
+
+    QSignalSpy inserted(&model, SIGNAL(rowsInserted(QModelIndex,int,int)));
+    const int before = model.rowCount();
+    model.fetchMore(QModelIndex());
+    QCOMPARE(inserted.count(), 1);
+    QCOMPARE(inserted.first().at(1).toInt(), before);
+    QVERIFY(model.rowCount() > before);
+
+    while (model.canFetchMore(QModelIndex()))
+        model.fetchMore(QModelIndex());
+    QCOMPARE(model.rowCount(), total);
+    QCOMPARE(model.rowCount(model.index(0)), 0);
+}
+
+void PackageModelTest::testData()
+{
+    Package *pkg = m_backend->package(FakeAptRoot::packageName(5));
+    QVERIFY(pkg);
+
+    PackageModel model(m_backend);
+    model.setPackages(PackageList() << pkg);
+    QCOMPARE(model.rowCount(), 1);
+    const QModelIndex index = model.index(0);
+
+    QCOMPARE(index.data().toString(), QString(pkg->name()));
+    QCOMPARE(index.data(PackageModel::NameRole).toString(), QString(pkg->name()));
+    QCOMPARE(index.data(PackageModel::PackageRole).value<Package *>(), pkg);
+    QCOMPARE(index.data(PackageModel::AvailableVersionRole).toString(), pkg->availableVersion());
+    QCOMPARE(index.data(PackageModel::StateRole).toInt(), pkg->state());
+    QCOMPARE(index.data(PackageModel::SectionRole).toString(), QStringLiteral("misc"));
+    QVERIFY(!model.index(1).data().isValid());
+}
+
+void PackageModelTest::testRecordRoles()
+{
+    PackageList packages;
+    for (int i = 0; i < 100; ++i)
+        packages << m_backend->package(FakeAptRoot::packageName(i));
+
+    // Spans more than one block of records
+    PackageModel model(m_backend);
+    model.setPackages(packages);
+    QCOMPARE(model.rowCount(), packages.size());
+
+    for (int row : { 0, 70, 99 }) {
+        const QModelIndex index = model.index(row);
+        QCOMPARE(index.data(PackageModel::MaintainerRole).toString(),
+                 QStringLiteral("QApt Benchmark <benchmark@example.org>"));
+        QCOMPARE(index.data(PackageModel::SourcePackageRole).toString(), FakeAptRoot::packageName(row));
+    }
+}
+
+void PackageModelTest::testNameFilter()
+{
+    PackageModel model(m_backend);
+    QSignalSpy arranged(&model, SIGNAL(arranged()));
+
+    model.setNameFilter(FakeAptRoot::packageName(999));
+    QVERIFY(arranged.count() || arranged.wait());
+
+    QCOMPARE(model.rowCount(), 1);
+    QCOMPARE(model.index(0).data().toString(), FakeAptRoot::packageName(999));
+    QVERIFY(!model.canFetchMore(QModelIndex()));
+}
+
+void PackageModelTest::testSortByVersion()
+{
+    PackageModel model(m_backend);
+    QSignalSpy arranged(&model, SIGNAL(arranged()));
+
+    model.setSortRole(PackageModel::AvailableVersionRole);
+    model.sort(0, Qt::DescendingOrder);
+    QVERIFY(arranged.count() || arranged.wait());
+
+    for (int row = 1; row < model.rowCount(); ++row) {
+        QVERIFY(Package::compareVersion(model.packageAt(row - 1)->availableVersion(),
+                                        model.packageAt(row)->availableVersion()) >= 0);
+    }
+}
+
+void PackageModelTest::testPackageChanged()
+{
+    // Not installed, see FakeAptRoot::Counts::installedEvery
+    Package *pkg = m_backend->package(FakeAptRoot::packageName(1));
+    Package *other = m_backend->package(FakeAptRoot::packageName(2));
+    QVERIFY(pkg && other);
+
+    PackageModel model(m_backend);
+    model.setPackages(PackageList() << other << pkg);
+    QSignalSpy changed(&model, SIGNAL(dataChanged(QModelIndex,QModelIndex,QVector<int>)));
+    QSignalSpy reset(&model, SIGNAL(modelReset()));
+
+    const CacheState state = m_backend->currentCacheState();
+
+    pkg->setInstall();
+    QVERIFY(changed.count() > 0);
+    QCOMPARE(reset.count(), 0);
+
+    bool rowUpdated = false;
+    for (const QList<QVariant> &args : changed) {
+        if (args.at(0).value<QModelIndex>().row() == 1)
+            rowUpdated = true;
+    }
+    QVERIFY(rowUpdated);
+
+    m_backend->restoreCacheState(state);
+}
+
+}
+
+QTEST_MAIN(QApt::PackageModelTest);
+
+#include "packagemodeltest.moc"
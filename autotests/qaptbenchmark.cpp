@@ -0,0 +1,281 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "fakeaptroot.h"
+
+#include <QtTest>
+
+#include <backend.h>
+#include <changelog.h>
+#include <debfile.h>
+#include <dependencyinfo.h>
+#include <history.h>
+#include <package.h>
+#include <packagemodel.h>
+#include <sourceentry.h>
+
+/*
+ * Benchmarks for the hot paths of libqapt.
+ *
+ * All benchmarks run against a FakeAptRoot written to a temporary
+ * directory, so the host system is never touched. The size of the root is
+ * read from the QAPT_BENCHMARK_PACKAGES environment variable and defaults
+ * to 10000 packages, mirror scale runs use e.g. 200000.
+ */
+
+namespace QApt {
+
+class QAptBenchmark : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void benchmarkReloadCache();
+    void benchmarkSearch();
+    void benchmarkPackageCount();
+    void benchmarkStateChanges();
+    void benchmarkMarkPackagesBatch();
+    void benchmarkLongDescription();
+    void benchmarkControlField();
+    void benchmarkSortByVersion();
+    void benchmarkPackageModelSort();
+    void benchmarkParseDepends();
+    void benchmarkSourceEntry();
+    void benchmarkHistory();
+    void benchmarkChangelogEntries();
+    void benchmarkDebFileScan();
+
+private:
+    QTemporaryDir m_root;
+    FakeAptRoot::Counts m_counts;
+    Backend *m_backend;
+};
+
+void QAptBenchmark::initTestCase()
+{
+    // Keep the backend\'s caches out of the user\'s cache directory
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(m_root.isValid());
+
+    if (qEnvironmentVariableIsSet("QAPT_BENCHMARK_PACKAGES"))
+        m_counts.packages = qgetenv("QAPT_BENCHMARK_PACKAGES").toInt();
+    QVERIFY(m_counts.packages > 0);
+    m_counts.historyEntries = m_counts.packages / 10;
+
+    FakeAptRoot root(m_root.path());
+    QVERIFY2(root.write(m_counts), qPrintable(root.errorString()));
+
+    // Set before Backend::init(), pkgInitConfig() only fills in defaults
+    root.configure();
+
+    m_backend = new Backend(this);
+    QVERIFY(m_backend->init());
+    QVERIFY(m_backend->packageCount() > m_counts.packages);
+}
+
+void QAptBenchmark::cleanupTestCase()
+{
+    delete m_backend;
+}
+
+void QAptBenchmark::benchmarkReloadCache()
+{
+    QBENCHMARK_ONCE {
+        QVERIFY(m_backend->reloadCache());
+    }
+}
+
+void QAptBenchmark::benchmarkSearch()
+{
+    // The index is not part of the synthetic root
+    if (m_backend->xapianIndexNeedsUpdate())
+        QSKIP("No up to date apt-xapian-index for the synthetic root");
+
+    PackageList results;
+    QBENCHMARK {
+        results = m_backend->search(QStringLiteral("synthetic"));
+    }
+    QVERIFY(!results.isEmpty());
+}
+
+void QAptBenchmark::benchmarkPackageCount()
+{
+    int count = 0;
+    QBENCHMARK {
+        count = m_backend->packageCount(Package::Installed | Package::Upgradeable);
+    }
+    QVERIFY(count > 0);
+}
+
+void QAptBenchmark::benchmarkStateChanges()
+{
+    const CacheState oldState = m_backend->currentCacheState();
+
+    m_backend->setCompressEvents(true);
+    for (int i = 1; i < m_counts.packages; i += 100) {
+        if (Package *pkg = m_backend->package(FakeAptRoot::packageName(i)))
+            pkg->setInstall();
+    }
+    m_backend->setCompressEvents(false);
+
+    QHash<Package::State, PackageList> changes;
+    QBENCHMARK {
+        changes = m_backend->stateChanges(oldState, QSet<const Package *>());
+    }
+    QVERIFY(!changes.isEmpty());
+
+    m_backend->restoreCacheState(oldState);
+}
+
+void QAptBenchmark::benchmarkMarkPackagesBatch()
+{
+    const CacheState oldState = m_backend->currentCacheState();
+
+    PackageList packages;
+    for (int i = 1; i < m_counts.packages; i += 100) {
+        if (Package *pkg = m_backend->package(FakeAptRoot::packageName(i)))
+            packages.append(pkg);
+    }
+
+    QHash<Package::State, PackageList> changes;
+    QBENCHMARK {
+        m_backend->restoreCacheState(oldState);
+        changes = m_backend->markPackagesBatch(packages, Package::ToInstall);
+    }
+    QVERIFY(!changes.isEmpty());
+
+    m_backend->restoreCacheState(oldState);
+}
+
+void QAptBenchmark::benchmarkLongDescription()
+{
+    const PackageList packages = m_backend->availablePackages();
+    QBENCHMARK {
+        for (const Package *pkg : packages)
+            pkg->longDescription();
+    }
+}
+
+void QAptBenchmark::benchmarkControlField()
+{
+    const PackageList packages = m_backend->availablePackages();
+    QBENCHMARK {
+        for (const Package *pkg : packages)
+            pkg->controlField(QLatin1String("Filename"));
+    }
+}
+
+void QAptBenchmark::benchmarkSortByVersion()
+{
+    const PackageList packages = m_backend->availablePackages();
+    PackageList sorted;
+    QBENCHMARK {
+        sorted = packages;
+        Package::sortByVersion(sorted);
+    }
+    QCOMPARE(sorted.size(), packages.size());
+    QVERIFY(Package::compareVersion(sorted.first()->availableVersionView(),
+                                    sorted.last()->availableVersionView()) <= 0);
+}
+
+void QAptBenchmark::benchmarkPackageModelSort()
+{
+    PackageModel model(m_backend);
+    model.setSortRole(PackageModel::AvailableVersionRole);
+    QSignalSpy spy(&model, SIGNAL(arranged()));
+
+    Qt::SortOrder order = Qt::AscendingOrder;
+    QBENCHMARK {
+        order = (order == Qt::AscendingOrder) ? Qt::DescendingOrder : Qt::AscendingOrder;
+        model.sort(0, order);
+        QVERIFY(spy.wait());
+    }
+    QVERIFY(model.rowCount() > 0);
+    QVERIFY(model.canFetchMore(QModelIndex()));
+}
+
+void QAptBenchmark::benchmarkParseDepends()
+{
+    const QString field = QStringLiteral("libc6 (>= 2.17), libqt5core5a (>= 5.8.0) | libqt5core5, "
+                                         "libstdc++6:any (>= 5.2), foo [amd64] <!nocheck>, bar (<< 2:1.0~rc1)");
+    QBENCHMARK {
+        for (int i = 0; i < 1000; ++i)
+            DependencyInfo::parseDepends(field, Depends);
+    }
+}
+
+void QAptBenchmark::benchmarkSourceEntry()
+{
+    QStringList lines;
+    for (int i = 0; i < 1000; ++i) {
+        lines << QStringLiteral("deb [arch=amd64,i386 trusted=yes] http://mirror%1.example.org/debian "
+                                "stable main contrib non-free").arg(i);
+        lines << QStringLiteral("# deb-src http://mirror%1.example.org/debian stable main").arg(i);
+    }
+
+    QBENCHMARK {
+        for (const QString &line : lines)
+            SourceEntry entry(line);
+    }
+}
+
+void QAptBenchmark::benchmarkHistory()
+{
+    HistoryItemList items;
+    QBENCHMARK_ONCE {
+        History history(nullptr);
+        items = history.historyItems();
+    }
+    QCOMPARE(items.size(), m_counts.historyEntries);
+}
+
+void QAptBenchmark::benchmarkChangelogEntries()
+{
+    const QString data = QString::fromLatin1(FakeAptRoot::changelog(0, 500));
+
+    ChangelogEntryList entries;
+    QBENCHMARK {
+        Changelog changelog(data, QStringLiteral("pkg0"));
+        entries = changelog.entries();
+    }
+    QCOMPARE(entries.size(), 500);
+}
+
+void QAptBenchmark::benchmarkDebFileScan()
+{
+    int scanned = 0;
+    QBENCHMARK {
+        scanned = 0;
+        DebFile::scanDirectory(m_root.path() + QStringLiteral("/debs"),
+                               [&scanned](const DebFile &debFile) {
+            if (debFile.isValid())
+                ++scanned;
+        });
+    }
+    QCOMPARE(scanned, m_counts.debs);
+}
+
+}
+
+QTEST_MAIN(QApt::QAptBenchmark);
+
+#include "qaptbenchmark.moc"
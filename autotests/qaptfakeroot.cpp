@@ -0,0 +1,81 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "fakeaptroot.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+
+// Writes a synthetic apt root, e.g. for profiling libqapt users with
+// APT_CONFIG=<directory>/etc/apt/apt.conf
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    FakeAptRoot::Counts counts;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Writes a synthetic apt root"));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("directory"), QStringLiteral("Where to write the root"));
+
+    struct CountOption {
+        QCommandLineOption option;
+        int *value;
+    };
+    const QList<CountOption> options {
+        { { QStringLiteral("packages"), QStringLiteral("Number of packages"), QStringLiteral("n") }, &counts.packages },
+        { { QStringLiteral("installed-every"), QStringLiteral("Install every n-th package, 0 for none"), QStringLiteral("n") }, &counts.installedEvery },
+        { { QStringLiteral("history"), QStringLiteral("Number of history entries"), QStringLiteral("n") }, &counts.historyEntries },
+        { { QStringLiteral("history-rotations"), QStringLiteral("Number of rotated history logs"), QStringLiteral("n") }, &counts.historyRotations },
+        { { QStringLiteral("changelogs"), QStringLiteral("Number of changelogs"), QStringLiteral("n") }, &counts.changelogs },
+        { { QStringLiteral("changelog-entries"), QStringLiteral("Entries per changelog"), QStringLiteral("n") }, &counts.changelogEntries },
+        { { QStringLiteral("source-files"), QStringLiteral("Number of sources.list.d files"), QStringLiteral("n") }, &counts.sourceFiles },
+        { { QStringLiteral("debs"), QStringLiteral("Number of sample .deb files"), QStringLiteral("n") }, &counts.debs }
+    };
+    for (const CountOption &option : options)
+        parser.addOption(option.option);
+
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+
+    for (const CountOption &option : options) {
+        if (!parser.isSet(option.option))
+            continue;
+
+        bool ok;
+        *option.value = parser.value(option.option).toInt(&ok);
+        if (!ok || *option.value < 0) {
+            qCritical() << "Invalid value for" << option.option.names().first();
+            return 1;
+        }
+    }
+
+    FakeAptRoot root(parser.positionalArguments().first());
+    if (!root.write(counts)) {
+        qCritical() << "Could not write the root:" << root.errorString();
+        return 1;
+    }
+
+    return 0;
+}
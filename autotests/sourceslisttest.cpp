@@ -136,6 +136,7 @@ void SourcesListTest::initTestCase()
     );
     
     
+    deb822File = QString(cwd+"/data/test3.sources");
     outputFile = QString(cwd+"/data/write_test.list");
     dummyFile = QString(cwd+"/data/dummy_file.list");
 }
@@ -520,6 +521,69 @@ void SourcesListTest::testLoadSourcesManyFiles()
     );
 }
 
+void SourcesListTest::testLoadDeb822Sources()
+{
+    QApt::SourcesList subject (0, QStringList(deb822File));
+
+    QApt::SourceEntryList entries = subject.entries();
+    qDebug() << "I have " << entries.count() << " entries.";
+    for ( const QApt::SourceEntry &one : entries ) {
+        qDebug() << "Entry " << one.toString();
+    }
+
+    // The first stanza expands into every type, URI and suite combination
+    QVERIFY2(
+        entries.count() == 5,
+        qPrintable(
+            "I was expecting 5 entries from test3.sources, but I got "
+            + QString::number(entries.count())
+        )
+    );
+
+    verifySourceEntry(
+        "Stanza #0, entry #0",
+        entries[0],
+        "deb",
+        "http://apttest3/ubuntu",
+        "saucy",
+        "main!universe",
+        "",
+        true,
+        true
+    );
+    verifySourceEntry(
+        "Stanza #0, entry #3",
+        entries[3],
+        "deb-src",
+        "http://apttest3/ubuntu",
+        "saucy-updates",
+        "main!universe",
+        "",
+        true,
+        true
+    );
+    QVERIFY2(
+        entries[0].options().value("Signed-By") == "/usr/share/keyrings/apttest3.gpg",
+        qPrintable(
+            "I was expecting the Signed-By option to be kept, but got \""
+            + entries[0].options().value("Signed-By")
+            + "\""
+        )
+    );
+
+    verifySourceEntry(
+        "Stanza #1",
+        entries[4],
+        "deb",
+        "http://apttest3/extra",
+        "saucy",
+        "main",
+        "amd64!i386",
+        false,
+        true
+    );
+}
+
 void SourcesListTest::testAddSource()
 {
     QStringList outfilesListJustOne (dummyFile);
@@ -42,6 +42,7 @@ private slots:
     void testConstructor();
     void testLoadSourcesOneFile();
     void testLoadSourcesManyFiles();
+    void testLoadDeb822Sources();
     void testAddSource();
     void testRemoveSource();
     void testSaveSources();
@@ -50,6 +51,7 @@ private:
     QStringList sampleSourcesHasOneFile;
     QStringList sampleSourcesHasTwoFiles;
     QStringList sampleSourcesHasDuplicateFiles;
+    QString deb822File;
     QString outputFile;
     QString dummyFile;
     
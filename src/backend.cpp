@@ -21,11 +21,23 @@
 #include "backend.h"
 
 // Qt includes
+#include <QBitArray>
 #include <QByteArray>
-#include <QTemporaryFile>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStringBuilder>
+#include <QThread>
+#include <QTimer>
+#include <QUrl>
 #include <QDBusConnection>
 
 // Apt includes
+#include <apt-pkg/acquire-item.h>
 #include <apt-pkg/algorithms.h>
 #include <apt-pkg/aptconfiguration.h>
 #include <apt-pkg/depcache.h>
@@ -33,11 +45,16 @@
 #include <apt-pkg/fileutl.h>
 #include <apt-pkg/gpgv.h>
 #include <apt-pkg/init.h>
+#include <apt-pkg/packagemanager.h>
 #include <apt-pkg/policy.h>
+#include <apt-pkg/progress.h>
 #include <apt-pkg/sourcelist.h>
 #include <apt-pkg/strutl.h>
 #include <apt-pkg/tagfile.h>
 
+#include <algorithm>
+#include <cstring>
+
 // Xapian includes
 #undef slots
 #include <xapian.h>
@@ -47,10 +64,18 @@
 #include "config.h" // krazy:exclude=includes
 #include "dbusinterfaces_p.h"
 #include "debfile.h"
+#include "fileownerindex.h"
+#include "packagearena.h"
+#include "packagetextindex.h"
+#include "tracing.h"
 #include "transaction.h"
+#include "updatephase.h"
+#include "xapiansearch.h"
 
 namespace QApt {
 
+class CacheReloadThread;
+
 class BackendPrivate
 {
 public:
@@ -60,14 +85,37 @@ public:
         , maxStackSize(20)
         , xapianDatabase(nullptr)
         , xapianIndexExists(false)
+        , xapianUpdating(false)
+        , searchThread(nullptr)
         , config(nullptr)
         , actionGroup(nullptr)
         , frontendCaps(QApt::NoCaps)
+        , reloadThread(nullptr)
+        , statesDirty(true)
+        , markingGeneration(1)
+        , downloadSize(0)
+        , downloadSizeGeneration(0)
+        , commitPlanGeneration(0)
+        , downloadSizeRequested(false)
+        , fileOwnerIndex(nullptr)
+        , closureGeneration(0)
+        , cacheLock(QReadWriteLock::Recursive)
+        , memoMutex(QMutex::Recursive)
     {
     }
     ~BackendPrivate()
     {
-        qDeleteAll(packages);
+        if (reloadThread) {
+            reloadThread->wait();
+            delete reloadThread->cache;
+            delete reloadThread->records;
+            delete reloadThread;
+        }
+        arena.clear();
+        delete searchThread;
+        xapianSearch.setDatabase(nullptr);
+        delete fileOwnerIndex;
+        clearThreadRecords();
         delete cache;
         delete records;
         delete config;
@@ -75,16 +123,66 @@ public:
         delete actionGroup;
     }
     // Caches
-    // The canonical list of all unique, non-virutal package objects
-    PackageList packages;
+    // The canonical list of all unique, non-virutal package objects. Slots
+    // stay null until the package is first asked for, see packageAt()
+    mutable PackageList packages;
+    // Memory backing all package objects in the list above
+    mutable PackageArena arena;
     // A list of each package object's ID number
     QVector<int> packagesIndex;
+    // The package ID number belonging to each slot of the package list
+    QVector<int> packageIds;
     // Set of group names extracted from our packages
     QSet<Group> groups;
     // Cache of origin/human-readable name pairings
     QHash<QString, QString> originMap;
     // Relation of an origin and its hostname
     QHash<QString, QString> siteMap;
+    // The reverse lookups of the two maps above
+    QHash<QString, QString> labelMap;
+    QMultiHash<QString, QString> hostOrigins;
+    // The slots of the packages whose candidate comes from each origin
+    QHash<QString, QVector<int> > originPackages;
+
+    // The lookup tables above, as built for a freshly opened cache
+    struct PackageTables {
+        PackageTables() : installedCount(0), isMultiArch(false) {}
+
+        QVector<int> packagesIndex;
+        QVector<int> packageIds;
+        QSet<Group> groups;
+        QHash<QString, QString> originMap;
+        QHash<QString, QString> siteMap;
+        QHash<QString, QVector<int> > originPackages;
+        int installedCount;
+        bool isMultiArch;
+    };
+
+    // On-disk snapshot of the groups, origin and site tables, to skip
+    // resolving every candidate version on a warm start. It is keyed on
+    // the stamps of snapshotFiles()
+    QString snapshotPath() const;
+    QStringList snapshotFiles() const;
+    QByteArray snapshotKey() const;
+    // A file named after @p name in the user's cache, for this apt root
+    QString cacheFilePath(const QString &name) const;
+
+    // Incremental reloads. When nothing but the dpkg status has changed
+    // since the last reload, existing package objects can be kept
+    QStringList sourcesFiles() const;
+    QByteArray sourcesKey() const;
+    QByteArray loadedSourcesKey;
+    bool loadSnapshot(const QByteArray &key, PackageTables &tables) const;
+    void saveSnapshot(const QByteArray &key, const PackageTables &tables) const;
+
+    // Builds the package tables for an opened cache. Does not touch any
+    // state of the backend itself, nor the configuration, which is read
+    // into @p snapshotFiles and @p isMultiArch beforehand. So it may run
+    // outside of the main thread
+    void buildTables(pkgDepCache *depCache, const QStringList &snapshotFiles,
+                     bool isMultiArch, PackageTables &tables) const;
+    // Replaces the current tables with the given ones (which are emptied)
+    void applyTables(PackageTables &tables, bool keepPackages = false);
 
     // Date when the distribution's release was issued. See Backend::releaseDate()
     QDateTime releaseDate;
@@ -98,15 +196,24 @@ public:
     Cache *cache;
     pkgRecords *records;
 
-    // Undo/redo stuff
+    // Undo/redo stuff. Each entry only holds the packages whose state
+    // differs from baseStates, see Backend::currentStateDelta()
     int maxStackSize;
-    QList<CacheState> undoStack;
-    QList<CacheState> redoStack;
+    QList<QHash<int, int> > undoStack;
+    QList<QHash<int, int> > redoStack;
 
     // Xapian
     time_t xapianTimeStamp;
     Xapian::Database *xapianDatabase;
     bool xapianIndexExists;
+    // When the stub pointing to the current index directory was written
+    QDateTime xapianStubTime;
+    bool xapianUpdating;
+    mutable XapianSearch xapianSearch;
+    // Fallback for when there is no Xapian index, built on first use
+    mutable PackageTextIndex textIndex;
+    XapianSearchThread *searchThread;
+    QString asyncSearchString;
 
     // DBus
     WorkerInterface *worker;
@@ -115,162 +222,331 @@ public:
     Config *config;
     bool isMultiArch;
     QString nativeArch;
+    // Tells the apt roots apart in the names of cacheFilePath()
+    QString rootKey;
 
     // Event compression
     bool compressEvents;
     pkgDepCache::ActionGroup *actionGroup;
 
     // Other
-    bool writeSelectionFile(const QString &file, const QString &path) const;
+    // Streams one line per package that has any of @p states to @p device
+    bool writePackageLines(QIODevice *device, int states, const char *suffix) const;
     QString customProxy;
     QString initErrorMessage;
     QApt::FrontendCaps frontendCaps;
+    // Wraps the reply of a worker call creating a transaction. Unless
+    // @p async, this blocks until the worker replied
+    Transaction *createTransaction(const QDBusPendingCall &call, bool async) const;
+
+    // Background cache reload, see Backend::reloadCacheAsync()
+    CacheReloadThread *reloadThread;
+
+    // Dense package state tracking, see Backend::syncStates()
+    // The full Package::state() of each slot
+    mutable QVector<int> states;
+    // The depCache marking state each slot had when last synced
+    mutable QVector<quint64> stateSignatures;
+    // For each state flag, which slots have it set
+    mutable QVector<QBitArray> stateBits;
+    // Slots whose QApt-side flags were changed through a Package
+    mutable QSet<int> touchedSlots;
+    // The states of all slots right after the cache was loaded, taken by
+    // completeCacheReload(), and the slots whose state has changed at some
+    // point since then
+    mutable QVector<int> baseStates;
+    mutable QSet<int> changedSlots;
+    mutable bool statesDirty;
+    QBitArray packagesWithStates(int states) const;
+    // Bumped whenever the marking of any package may have changed
+    quint64 markingGeneration;
+
+    // Memoized downloadSize(), valid for the marking generation it was taken at
+    mutable qint64 downloadSize;
+    mutable quint64 downloadSizeGeneration;
+    // Memoized commitPlan(), likewise
+    mutable CommitPlan commitPlan;
+    mutable quint64 commitPlanGeneration;
+    bool downloadSizeRequested;
+
+    // Reverse index of installed files, see Backend::packageForFile()
+    mutable FileOwnerIndex *fileOwnerIndex;
+
+    // The packages named by the pin preferences, for the preference files
+    // as of pinsKey, and resolved to IDs for the cache as of pinnedIdsKey.
+    // See Backend::loadPackagePins()
+    QByteArray pinsKey;
+    QList<QByteArray> pinnedNames;
+    QByteArray pinnedIdsKey;
+    QVector<int> pinnedIds;
+
+    // Memoized dependency closures by package ID, valid for the marking
+    // generation they were taken at since candidates may change
+    mutable QHash<int, QVector<int> > dependencyClosures;
+    mutable QHash<int, QVector<int> > reverseDependencyClosures;
+    mutable quint64 closureGeneration;
+    QVector<int> closure(int id, bool reverse) const;
+
+    // Concurrency, see Backend::cacheLock(). Writers hold cacheLock for
+    // writing, readers off the backend's thread hold it for reading
+    mutable QReadWriteLock cacheLock;
+    // Guards what const methods fill in lazily: package slots, dense
+    // states, closures and the Package memos
+    mutable QMutex memoMutex;
+    // Guards the (stateful) Xapian searcher and the text index
+    mutable QMutex searchMutex;
+    // Record parsers keep the last looked up record, so each reading
+    // thread gets its own. Only valid for the cache they were made for, and
+    // freed when their thread ends
+    mutable QMutex recordsMutex;
+    mutable QHash<QThread *, pkgRecords *> threadRecords;
+    // Disconnects from the threads along with the backend
+    QObject threadRecordsContext;
+    void clearThreadRecords();
+    void releaseThreadRecords(QThread *thread) const;
 };
 
-QDateTime BackendPrivate::getReleaseDateFromDistroInfo(const QString &releaseId, const QString &releaseCodename) const
+void BackendPrivate::clearThreadRecords()
 {
-    QDateTime releaseDate;
-    QString line;
-    QStringList split;
+    QMutexLocker locker(&recordsMutex);
 
-    QFile distro_info(QStringLiteral("/usr/share/distro-info/%1.csv").arg(releaseId.toLower()));
-    if (distro_info.open(QFile::ReadOnly)) {
-        QTextStream info_stream(&distro_info);
-        line = info_stream.readLine();
-        split = line.split(QLatin1Char(','));
-        const int codenameColumn = split.indexOf(QStringLiteral("series"));
-        const int releaseColumn = split.indexOf(QStringLiteral("release"));
-        if (codenameColumn == -1 || releaseColumn == -1) {
-            return QDateTime();
-        }
-        do {
-            line = info_stream.readLine();
-            split = line.split(QLatin1Char(','));
-            if (split.value(codenameColumn) == releaseCodename) {
-                releaseDate = QDateTime::fromString(split.value(releaseColumn), Qt::ISODate);
-                releaseDate.setTimeSpec(Qt::UTC);;
-                break;
-            }
-        } while (!line.isNull());
+    // Threads stay in the table, so they are not watched twice
+    for (pkgRecords *&records : threadRecords) {
+        delete records;
+        records = nullptr;
     }
-    return releaseDate;
 }
 
-QDateTime BackendPrivate::getReleaseDateFromArchive(const QString &releaseId, const QString &releaseCodename) const
+void BackendPrivate::releaseThreadRecords(QThread *thread) const
 {
-    pkgDepCache *depCache = cache->depCache();
+    QMutexLocker locker(&recordsMutex);
 
-    // We are only interested in `*ubuntu_dists_<codename>_[In]Release`
-    // in order to get the release date. In `<codename>-updates` and
-    // `-security` the Date gets updated throughout the life of the release.
-    pkgCache::RlsFileIterator rls;
-    for (rls = depCache->GetCache().RlsFileBegin(); !rls.end(); ++rls) {
-        if (rls.Origin() == releaseId
-                && rls.Label() == releaseId
-                && rls.Archive() == releaseCodename) {
+    delete threadRecords.take(thread);
+}
 
-            FileFd fd;
-            if (!OpenMaybeClearSignedFile(rls.FileName(), fd)) {
-                continue;
-            }
+class CacheReloadProgress : public OpProgress
+{
+public:
+    explicit CacheReloadProgress(Backend *backend)
+        : m_backend(backend)
+        , m_step(0)
+        , m_lastProgress(-1)
+    {
+    }
 
-            time_t releaseDate = -1;
-            pkgTagSection sec;
-            pkgTagFile tag(&fd);
-            tag.Step(sec);
+    void Update()
+    {
+        if (!MajorChange && !CheckChange(0.1)) {
+            return;
+        }
 
-            if(!RFC1123StrToTime(sec.FindS("Date").data(), releaseDate)) {
-                continue;
-            }
+        // APT opens the cache in 4 "steps", each of which goes up to 100%.
+        // Spread those over 0-90%, the rest is for building our own tables
+        if (MajorChange && m_lastProgress >= 0) {
+            m_step = qMin(m_step + 1, 3);
+        }
 
-            return QDateTime::fromSecsSinceEpoch(releaseDate);
+        int progress = qRound((m_step * 100 + qMin(Percent, 100.0f)) * 0.9 / 4);
+        report(progress);
+    }
+
+    void report(int progress)
+    {
+        if (progress == m_lastProgress) {
+            return;
         }
+
+        m_lastProgress = progress;
+
+        // We are not running in the thread of the backend
+        QMetaObject::invokeMethod(m_backend, "cacheReloadProgress",
+                                  Qt::QueuedConnection, Q_ARG(int, progress));
     }
-    return QDateTime();
+
+private:
+    Backend *m_backend;
+    int m_step;
+    int m_lastProgress;
+};
+
+class CacheReloadThread : public QThread
+{
+public:
+    CacheReloadThread(const BackendPrivate *backendPrivate, Cache *newCache, Backend *backend)
+        : QThread(backend)
+        , cache(newCache)
+        , records(nullptr)
+        , success(false)
+        , m_backendPrivate(backendPrivate)
+        , m_backend(backend)
+    {
+        // What buildTables() needs from the configuration is read here, on
+        // the main thread. Opening the cache reads it under Config::lock()
+        m_snapshotFiles = backendPrivate->snapshotFiles();
+        m_isMultiArch = backendPrivate->config->architectures().size() > 1;
+    }
+
+    Cache *cache;
+    pkgRecords *records;
+    BackendPrivate::PackageTables tables;
+    bool success;
+    QString errorMessage;
+
+protected:
+    void run()
+    {
+        CacheReloadProgress progress(m_backend);
+
+        {
+            // Keeps Config::writeEntry() on the main thread from changing
+            // the configuration while the cache is opened from it
+            QReadLocker locker(Config::lock());
+            success = cache->open(&progress);
+        }
+        if (!success) {
+            string message;
+            if (_error->PopMessage(message))
+                errorMessage = QString::fromStdString(message);
+            return;
+        }
+
+        records = new pkgRecords(*cache->depCache());
+        m_backendPrivate->buildTables(cache->depCache(), m_snapshotFiles, m_isMultiArch, tables);
+        progress.report(100);
+    }
+
+private:
+    const BackendPrivate *m_backendPrivate;
+    Backend *m_backend;
+    QStringList m_snapshotFiles;
+    bool m_isMultiArch;
+};
+
+QString BackendPrivate::cacheFilePath(const QString &name) const
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) %
+           QLatin1String("/libqapt/") % name % QLatin1Char('-') % rootKey % QLatin1String(".bin");
 }
 
-bool BackendPrivate::writeSelectionFile(const QString &selectionDocument, const QString &path) const
+QString BackendPrivate::snapshotPath() const
 {
-    QFile file(path);
-    if (!file.open(QFile::WriteOnly | QFile::Text)) {
-        return false;
-    } else {
-        QTextStream out(&file);
-        out << selectionDocument;
+    return cacheFilePath(QLatin1String("origins-") % nativeArch);
+}
+
+static QByteArray fileStampKey(const QStringList &files)
+{
+    QByteArray key;
+    for (const QString &file : files) {
+        QFileInfo info(file);
+        key += QByteArray::number(info.lastModified().toMSecsSinceEpoch()) % ':' %
+               QByteArray::number(info.size()) % ';';
     }
 
-    return true;
+    return key;
 }
 
-Backend::Backend(QObject *parent)
-        : QObject(parent)
-        , d_ptr(new BackendPrivate)
+QStringList BackendPrivate::snapshotFiles() const
 {
-    Q_D(Backend);
+    // The tables depend on the package lists, the installed packages,
+    // and the pinning that decides which version is the candidate
+    return QStringList({
+        config->findFile(QLatin1String("Dir::Cache::pkgcache")),
+        config->findFile(QLatin1String("Dir::State::status"))
+    }) + sourcesFiles();
+}
 
-    d->worker = new WorkerInterface(QLatin1String(s_workerReverseDomainName),
-                                    QLatin1String("/"), QDBusConnection::systemBus(),
-                                    this);
-    connect(d->worker, SIGNAL(transactionQueueChanged(QString,QStringList)),
-            this, SIGNAL(transactionQueueChanged(QString,QStringList)));
-    DownloadProgress::registerMetaTypes();
+QByteArray BackendPrivate::snapshotKey() const
+{
+    return fileStampKey(snapshotFiles());
 }
 
-Backend::~Backend()
+QStringList BackendPrivate::sourcesFiles() const
 {
-    delete d_ptr;
+    // Everything that goes into the cache apart from the dpkg status file
+    return {
+        config->findDirectory(QLatin1String("Dir::State::lists")),
+        config->findFile(QLatin1String("Dir::Etc::sourcelist")),
+        config->findDirectory(QLatin1String("Dir::Etc::sourceparts")),
+        config->findFile(QLatin1String("Dir::Etc::preferences")),
+        config->findDirectory(QLatin1String("Dir::Etc::preferencesparts"))
+    };
 }
 
-bool Backend::init()
+QByteArray BackendPrivate::sourcesKey() const
 {
-    Q_D(Backend);
-    if (!pkgInitConfig(*_config) || !pkgInitSystem(*_config, _system)) {
-        setInitError();
+    return fileStampKey(sourcesFiles());
+}
+
+bool BackendPrivate::loadSnapshot(const QByteArray &key, PackageTables &tables) const
+{
+    QFile file(snapshotPath());
+    if (!file.open(QIODevice::ReadOnly)) {
         return false;
     }
 
-    d->cache = new Cache(this);
-    d->config = new Config(this);
-    d->nativeArch = config()->readEntry(QLatin1String("APT::Architecture"),
-                                        QLatin1String(""));
-    openXapianIndex();
+    // The tables are hashes that have to be built in memory either way, and
+    // the file only holds a few kilobytes of sections and origins, so it is
+    // streamed rather than mapped
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
 
-    return reloadCache();
-}
+    quint32 version;
+    QByteArray storedKey;
+    stream >> version >> storedKey;
 
-bool Backend::reloadCache()
-{
-    Q_D(Backend);
+    if (version != 1 || storedKey != key) {
+        return false;
+    }
 
-    emit cacheReloadStarted();
+    stream >> tables.groups >> tables.originMap >> tables.siteMap;
 
-    if (!d->cache->open()) {
-        setInitError();
+    if (stream.status() != QDataStream::Ok) {
+        tables.groups.clear();
+        tables.originMap.clear();
+        tables.siteMap.clear();
         return false;
     }
 
-    pkgDepCache *depCache = d->cache->depCache();
+    return true;
+}
 
-    delete d->records;
-    d->records = new pkgRecords(*depCache);
+void BackendPrivate::saveSnapshot(const QByteArray &key, const PackageTables &tables) const
+{
+    QFileInfo info(snapshotPath());
+    QDir().mkpath(info.absolutePath());
+
+    QSaveFile file(info.absoluteFilePath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
 
-    qDeleteAll(d->packages);
-    d->packages.clear();
-    d->groups.clear();
-    d->originMap.clear();
-    d->siteMap.clear();
-    d->packagesIndex.clear();
-    d->installedCount = 0;
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << quint32(1) << key << tables.groups << tables.originMap << tables.siteMap;
+
+    file.commit();
+}
 
+void BackendPrivate::buildTables(pkgDepCache *depCache, const QStringList &snapshotFiles,
+                                 bool isMultiArch, PackageTables &tables) const
+{
     int packageCount = depCache->Head().PackageCount;
-    d->packagesIndex.resize(packageCount);
-    d->packagesIndex.fill(-1);
-    d->packages.reserve(packageCount);
+    tables.packagesIndex.resize(packageCount);
+    tables.packagesIndex.fill(-1);
+    tables.packageIds.reserve(packageCount);
+    tables.isMultiArch = isMultiArch;
+
+    // Stamped only now, after opening the cache may have rebuilt it
+    const QByteArray key = fileStampKey(snapshotFiles);
+    const bool haveSnapshot = loadSnapshot(key, tables);
 
     // Populate internal package cache
     int count = 0;
 
-    d->isMultiArch = architectures().size() > 1;
+    // Slots by the package file their candidate comes from. There are few
+    // files, so this avoids making an origin string for every package
+    pkgCache &cache = depCache->GetCache();
+    QVector<QVector<int> > fileSlots(cache.Head().PackageFileCount);
 
     pkgCache::PkgIterator iter;
     for (iter = depCache->PkgBegin(); !iter.end(); ++iter) {
@@ -278,683 +554,2277 @@ bool Backend::reloadCache()
             continue; // Exclude virtual packages.
         }
 
-        Package *pkg = new Package(this, iter);
-
-        d->packagesIndex[iter->ID] = count;
-        d->packages.append(pkg);
+        // Package objects are created lazily, so only reserve a slot here
+        tables.packagesIndex[iter->ID] = count;
+        tables.packageIds.append(iter->ID);
         ++count;
 
         if (iter->CurrentVer) {
-            d->installedCount++;
+            tables.installedCount++;
+        }
+
+        pkgCache::VerIterator Ver = (*depCache)[iter].CandidateVerIter(*depCache);
+        if (!Ver.end()) {
+            fileSlots[Ver.FileList().File()->ID].append(count - 1);
+        }
+
+        if (haveSnapshot) {
+            continue;
         }
 
-        QString group = pkg->section();
+        QString group = QLatin1String(iter.Section());
 
         // Populate groups
         if (!group.isEmpty()) {
-            d->groups << group;
+            tables.groups << group;
         }
 
-        pkgCache::VerIterator Ver = (*depCache)[iter].CandidateVerIter(*depCache);
-
         if(!Ver.end()) {
             const pkgCache::VerFileIterator VF = Ver.FileList();
-            const QString origin(QLatin1String(VF.File().Origin()));
-            d->originMap[origin] = QLatin1String(VF.File().Label());
-            d->siteMap[origin] = QLatin1String(VF.File().Site());
+            // Like Package::origin(), these are UTF-8
+            const QString origin = QString::fromUtf8(VF.File().Origin());
+            tables.originMap[origin] = QString::fromUtf8(VF.File().Label());
+            tables.siteMap[origin] = QString::fromUtf8(VF.File().Site());
         }
     }
 
-    d->originMap.remove(QString());
+    tables.originMap.remove(QString());
 
-    d->undoStack.clear();
-    d->redoStack.clear();
+    for (int id = 0; id < fileSlots.size(); ++id) {
+        if (fileSlots.at(id).isEmpty()) {
+            continue;
+        }
 
-    // Determine which packages are pinned for display purposes
-    loadPackagePins();
+        pkgCache::PkgFileIterator file(cache, cache.PkgFileP + id);
+        const QString origin = QString::fromUtf8(file.Origin());
+        if (origin.isEmpty()) {
+            continue;
+        }
 
-    loadReleaseDate();
+        tables.originPackages[origin] += fileSlots.at(id);
+    }
 
-    emit cacheReloadFinished();
+    // Several files can share an origin, keep each list in slot order
+    for (QVector<int> &originSlots : tables.originPackages) {
+        std::sort(originSlots.begin(), originSlots.end());
+    }
 
-    return true;
+    if (!haveSnapshot) {
+        saveSnapshot(key, tables);
+    }
 }
 
-void Backend::setInitError()
+QBitArray BackendPrivate::packagesWithStates(int states) const
 {
-    Q_D(Backend);
+    QBitArray result(packages.size());
+    for (int bit = 0; bit < stateBits.size(); ++bit) {
+        if (states & (1 << bit)) {
+            result |= stateBits.at(bit);
+        }
+    }
 
-    string message;
-    if (_error->PopMessage(message))
-        d->initErrorMessage = QString::fromStdString(message);
+    return result;
 }
 
-void Backend::loadPackagePins()
+static bool isDependsType(const pkgCache::DepIterator &dep)
 {
-    Q_D(Backend);
-
-    QString dirBase = d->config->findDirectory(QLatin1String("Dir::Etc"));
-    QString dir = dirBase % QLatin1String("preferences.d/");
-    QDir logDirectory(dir);
-    QStringList pinFiles = logDirectory.entryList(QDir::Files, QDir::Name);
-    pinFiles << dirBase % QLatin1String("preferences");
-
-    for (const QString &pinName : pinFiles) {
-        // Make all paths absolute
-        QString pinPath = pinName.startsWith('/') ? pinName : dir % pinName;
+    return dep->Type == pkgCache::Dep::Depends || dep->Type == pkgCache::Dep::PreDepends;
+}
 
-        if (!QFile::exists(pinPath))
-                continue;
+// The packages the candidate of @p pkg needs. Of an or-group only the first
+// alternative that exists is followed, and of a virtual package only the
+// first provider
+static void addDependencies(pkgDepCache *depCache, const pkgCache::PkgIterator &pkg,
+                            QVector<int> &targets)
+{
+    const pkgCache::VerIterator &ver = depCache->GetCandidateVer(pkg);
+    if (ver.end()) {
+        return;
+    }
 
-        FileFd Fd(pinPath.toUtf8().data(), FileFd::ReadOnly);
+    for (pkgCache::DepIterator dep = ver.DependsList(); !dep.end();) {
+        pkgCache::DepIterator start;
+        pkgCache::DepIterator end;
+        dep.GlobOr(start, end);
 
-        pkgTagFile tagFile(&Fd);
-        if (_error->PendingError()) {
-            _error->Discard();
+        if (!isDependsType(start)) {
             continue;
         }
 
-        pkgTagSection tags;
-        while (tagFile.Step(tags)) {
-            string name = tags.FindS("Package");
-            Package *pkg = package(QLatin1String(name.c_str()));
-            if (pkg)
-                pkg->setPinned(true);
+        while (true) {
+            pkgCache::PkgIterator target = start.TargetPkg();
+            if (target->VersionList) {
+                targets.append(target->ID);
+                break;
+            }
+
+            pkgCache::PrvIterator prv = target.ProvidesList();
+            if (!prv.end()) {
+                targets.append(prv.OwnerPkg()->ID);
+                break;
+            }
+
+            if (start == end) {
+                break;
+            }
+            ++start;
         }
     }
 }
 
-void Backend::loadReleaseDate()
+// Whether the or-group of @p dep is satisfied by an installed package other
+// than @p removed
+static bool isSatisfiedWithout(pkgCache &cache, const pkgCache::DepIterator &dep, int removed)
 {
-    Q_D(Backend);
-
-    // Reset value in case we are re-loading cache
-    d->releaseDate = QDateTime();
+    for (pkgCache::DepIterator it = dep.ParentVer().DependsList(); !it.end();) {
+        pkgCache::DepIterator start;
+        pkgCache::DepIterator end;
+        it.GlobOr(start, end);
 
-    QString releaseId;
-    QString releaseCodename;
+        bool inGroup = false;
+        bool satisfied = false;
+        while (true) {
+            inGroup |= (start == dep);
 
-    QFile lsb_release(QLatin1String("/etc/os-release"));
-    if (!lsb_release.open(QFile::ReadOnly)) {
-        // Though really, your system is screwed if this happens...
-        return;
-    }
+            pkgCache::Version **versions = start.AllTargets();
+            for (pkgCache::Version **version = versions; *version; ++version) {
+                pkgCache::VerIterator ver(cache, *version);
+                pkgCache::PkgIterator owner = ver.ParentPkg();
+                if ((int)owner->ID != removed && owner.CurrentVer() == ver) {
+                    satisfied = true;
+                    break;
+                }
+            }
+            delete[] versions;
 
-    QTextStream stream(&lsb_release);
-    QString line;
-    do {
-        line = stream.readLine();
-        QStringList split = line.split(QLatin1Char('='));
-        if (split.size() != 2) {
-            continue;
+            if (start == end) {
+                break;
+            }
+            ++start;
         }
 
-        if (split.at(0) == QLatin1String("VERSION_CODENAME")) {
-            releaseCodename = split.at(1);
-        } else if (split.at(0) == QLatin1String("ID")) {
-            releaseId = split.at(1);
+        if (inGroup) {
+            return satisfied;
         }
-    } while (!line.isNull());
-
-    d->releaseDate = d->getReleaseDateFromDistroInfo(releaseId, releaseCodename);
-    if (!d->releaseDate.isValid()) {
-        // If we could not find the date in the csv file, we fallback to Apt archive.
-        d->releaseDate = d->getReleaseDateFromArchive(releaseId, releaseCodename);
     }
-}
-
-QString Backend::initErrorMessage() const
-{
-    Q_D(const Backend);
 
-    return d->initErrorMessage;
+    return false;
 }
 
-pkgSourceList *Backend::packageSourceList() const
+// The installed packages whose installed version needs @p pkg, directly or
+// through a virtual package it provides, and can't do with anything else
+// that is installed
+static void addDependers(pkgCache &cache, const pkgCache::PkgIterator &pkg, QVector<int> &dependers)
 {
-    Q_D(const Backend);
+    const pkgCache::VerIterator &installed = pkg.CurrentVer();
+    if (installed.end()) {
+        return;
+    }
 
-    return d->cache->list();
-}
+    QVector<pkgCache::PkgIterator> names;
+    names.append(pkg);
+    for (pkgCache::PrvIterator prv = installed.ProvidesList(); !prv.end(); ++prv) {
+        names.append(prv.ParentPkg());
+    }
 
-Cache *Backend::cache() const
-{
+    for (const pkgCache::PkgIterator &name : names) {
+        for (pkgCache::DepIterator dep = name.RevDependsList(); !dep.end(); ++dep) {
+            if (!isDependsType(dep)) {
+                continue;
+            }
+
+            pkgCache::PkgIterator parent = dep.ParentPkg();
+            if (parent.CurrentVer() != dep.ParentVer()) {
+                continue;
+            }
+
+            if (!isSatisfiedWithout(cache, dep, pkg->ID)) {
+                dependers.append(parent->ID);
+            }
+        }
+    }
+}
+
+QVector<int> BackendPrivate::closure(int id, bool reverse) const
+{
+    QMutexLocker locker(&memoMutex);
+
+    if (closureGeneration != markingGeneration) {
+        dependencyClosures.clear();
+        reverseDependencyClosures.clear();
+        closureGeneration = markingGeneration;
+    }
+
+    QHash<int, QVector<int> > &closures = reverse ? reverseDependencyClosures : dependencyClosures;
+    auto cached = closures.constFind(id);
+    if (cached != closures.constEnd()) {
+        return *cached;
+    }
+
+    pkgDepCache *depCache = cache->depCache();
+    pkgCache &aptCache = depCache->GetCache();
+
+    QBitArray seen(aptCache.HeaderP->PackageCount);
+    seen.setBit(id);
+
+    QVector<int> result;
+    QVector<int> pending;
+    QVector<int> targets;
+    pending.append(id);
+
+    while (!pending.isEmpty()) {
+        const int current = pending.takeLast();
+
+        // A known closure of a reachable package is part of ours as a whole
+        auto known = closures.constFind(current);
+        if (current != id && known != closures.constEnd()) {
+            for (int target : *known) {
+                if (!seen.testBit(target)) {
+                    seen.setBit(target);
+                    result.append(target);
+                }
+            }
+            continue;
+        }
+
+        targets.clear();
+        pkgCache::PkgIterator pkg(aptCache, aptCache.PkgP + current);
+        if (reverse) {
+            addDependers(aptCache, pkg, targets);
+        } else {
+            addDependencies(depCache, pkg, targets);
+        }
+
+        for (int target : targets) {
+            if (!seen.testBit(target)) {
+                seen.setBit(target);
+                result.append(target);
+                pending.append(target);
+            }
+        }
+    }
+
+    closures.insert(id, result);
+    return result;
+}
+
+void BackendPrivate::applyTables(PackageTables &tables, bool keepPackages)
+{
+    // Every slot needs to be looked at again
+    states.clear();
+    stateSignatures.clear();
+    stateBits.clear();
+    touchedSlots.clear();
+    baseStates.clear();
+    changedSlots.clear();
+    statesDirty = true;
+    ++markingGeneration;
+
+    textIndex.clear();
+
+    packagesIndex.swap(tables.packagesIndex);
+    packageIds.swap(tables.packageIds);
+    groups.swap(tables.groups);
+    originMap.swap(tables.originMap);
+    siteMap.swap(tables.siteMap);
+    originPackages.swap(tables.originPackages);
+
+    labelMap.clear();
+    hostOrigins.clear();
+    for (auto it = originMap.constBegin(); it != originMap.constEnd(); ++it) {
+        labelMap.insert(it.value(), it.key());
+    }
+    for (auto it = siteMap.constBegin(); it != siteMap.constEnd(); ++it) {
+        hostOrigins.insert(it.value(), it.key());
+    }
+
+    installedCount = tables.installedCount;
+    isMultiArch = tables.isMultiArch;
+
+    if (keepPackages) {
+        return;
+    }
+
+    packages.clear();
+    arena.reset(packageIds.size());
+    packages.reserve(packageIds.size());
+    for (int i = 0; i < packageIds.size(); ++i) {
+        packages.append(nullptr);
+    }
+}
+
+QDateTime BackendPrivate::getReleaseDateFromDistroInfo(const QString &releaseId, const QString &releaseCodename) const
+{
+    QDateTime releaseDate;
+    QString line;
+    QStringList split;
+
+    QFile distro_info(QStringLiteral("/usr/share/distro-info/%1.csv").arg(releaseId.toLower()));
+    if (distro_info.open(QFile::ReadOnly)) {
+        QTextStream info_stream(&distro_info);
+        line = info_stream.readLine();
+        split = line.split(QLatin1Char(','));
+        const int codenameColumn = split.indexOf(QStringLiteral("series"));
+        const int releaseColumn = split.indexOf(QStringLiteral("release"));
+        if (codenameColumn == -1 || releaseColumn == -1) {
+            return QDateTime();
+        }
+        do {
+            line = info_stream.readLine();
+            split = line.split(QLatin1Char(','));
+            if (split.value(codenameColumn) == releaseCodename) {
+                releaseDate = QDateTime::fromString(split.value(releaseColumn), Qt::ISODate);
+                releaseDate.setTimeSpec(Qt::UTC);;
+                break;
+            }
+        } while (!line.isNull());
+    }
+    return releaseDate;
+}
+
+QDateTime BackendPrivate::getReleaseDateFromArchive(const QString &releaseId, const QString &releaseCodename) const
+{
+    pkgDepCache *depCache = cache->depCache();
+
+    // We are only interested in `*ubuntu_dists_<codename>_[In]Release`
+    // in order to get the release date. In `<codename>-updates` and
+    // `-security` the Date gets updated throughout the life of the release.
+    pkgCache::RlsFileIterator rls;
+    for (rls = depCache->GetCache().RlsFileBegin(); !rls.end(); ++rls) {
+        if (rls.Origin() == releaseId
+                && rls.Label() == releaseId
+                && rls.Archive() == releaseCodename) {
+
+            FileFd fd;
+            if (!OpenMaybeClearSignedFile(rls.FileName(), fd)) {
+                continue;
+            }
+
+            time_t releaseDate = -1;
+            pkgTagSection sec;
+            pkgTagFile tag(&fd);
+            tag.Step(sec);
+
+            if(!RFC1123StrToTime(sec.FindS("Date").data(), releaseDate)) {
+                continue;
+            }
+
+            return QDateTime::fromSecsSinceEpoch(releaseDate);
+        }
+    }
+    return QDateTime();
+}
+
+bool BackendPrivate::writePackageLines(QIODevice *device, int states, const char *suffix) const
+{
+    pkgCache &aptCache = cache->depCache()->GetCache();
+    const QBitArray &matching = packagesWithStates(states);
+    const int suffixLength = strlen(suffix);
+
+    // Reserving keeps the buffer allocated across resize(0)
+    QByteArray line;
+    line.reserve(256);
+    for (int i = 0; i < matching.size(); ++i) {
+        if (!matching.testBit(i)) {
+            continue;
+        }
+
+        pkgCache::PkgIterator iter(aptCache, aptCache.PkgP + packageIds.at(i));
+        line.resize(0);
+        line.append(iter.Name());
+        line.append(suffix, suffixLength);
+
+        if (device->write(line) != line.size()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+Backend::Backend(QObject *parent)
+        : QObject(parent)
+        , d_ptr(new BackendPrivate)
+{
+    Q_D(Backend);
+
+    d->worker = new WorkerInterface(QLatin1String(s_workerReverseDomainName),
+                                    QLatin1String("/"), QDBusConnection::systemBus(),
+                                    this);
+    connect(d->worker, SIGNAL(transactionQueueChanged(QString,QStringList)),
+            this, SIGNAL(transactionQueueChanged(QString,QStringList)));
+    connect(this, SIGNAL(packageChanged()), this, SLOT(invalidateStates()));
+    DownloadProgress::registerMetaTypes();
+}
+
+Backend::~Backend()
+{
+    delete d_ptr;
+}
+
+bool Backend::init()
+{
+    Q_D(Backend);
+    if (!pkgInitConfig(*_config) || !pkgInitSystem(*_config, _system)) {
+        setInitError();
+        return false;
+    }
+
+    const QString processName = QCoreApplication::applicationName();
+    Tracing::init(processName.isEmpty() ? "client" : processName.toLocal8Bit().constData());
+
+    d->cache = new Cache(this);
+    d->config = new Config(this);
+    d->nativeArch = config()->readEntry(QLatin1String("APT::Architecture"),
+                                        QLatin1String(""));
+    const QByteArray root = config()->findDirectory(QLatin1String("Dir")).toUtf8() + '\n' +
+                            config()->findDirectory(QLatin1String("Dir::State")).toUtf8();
+    d->rootKey = QString::fromLatin1(QCryptographicHash::hash(root, QCryptographicHash::Sha1).toHex().left(16));
+    openXapianIndex();
+
+    return reloadCache();
+}
+
+bool Backend::reloadCache()
+{
+    Q_D(Backend);
+    TraceSpan span("cache", "reload");
+    QWriteLocker locker(&d->cacheLock);
+
+    emit cacheReloadStarted();
+
+    const QByteArray sourcesKey = d->sourcesKey();
+    QVector<QByteArray> keys;
+    if (sourcesKey == d->loadedSourcesKey) {
+        keys = packageKeys();
+    }
+
+    if (!d->cache->open()) {
+        setInitError();
+        return false;
+    }
+
+    pkgDepCache *depCache = d->cache->depCache();
+
+    d->clearThreadRecords();
+    delete d->records;
+    d->records = new pkgRecords(*depCache);
+
+    BackendPrivate::PackageTables tables;
+    d->buildTables(depCache, d->snapshotFiles(), d->config->architectures().size() > 1, tables);
+    d->applyTables(tables, reusePackages(tables.packageIds, keys));
+    d->loadedSourcesKey = sourcesKey;
+
+    completeCacheReload();
+
+    return true;
+}
+
+void Backend::reloadCacheAsync()
+{
+    Q_D(Backend);
+
+    // A reload is already underway, its result will be just as fresh
+    if (d->reloadThread) {
+        return;
+    }
+
+    d->reloadThread = new CacheReloadThread(d, new Cache(nullptr), this);
+    connect(d->reloadThread, SIGNAL(finished()), this, SLOT(finishAsyncReload()));
+    d->reloadThread->start();
+}
+
+bool Backend::isReloadingCache() const
+{
+    Q_D(const Backend);
+
+    return d->reloadThread;
+}
+
+void Backend::finishAsyncReload()
+{
+    Q_D(Backend);
+
+    CacheReloadThread *thread = d->reloadThread;
+    d->reloadThread = nullptr;
+    thread->deleteLater();
+
+    if (!thread->success) {
+        // The old cache is still open and usable, just report the failure
+        delete thread->cache;
+        d->initErrorMessage = thread->errorMessage;
+        emit cacheReloadFailed();
+        return;
+    }
+
+    emit cacheReloadStarted();
+
+    QWriteLocker locker(&d->cacheLock);
+
+    const QByteArray sourcesKey = d->sourcesKey();
+    QVector<QByteArray> keys;
+    if (sourcesKey == d->loadedSourcesKey) {
+        keys = packageKeys();
+    }
+
+    // Swap the freshly opened cache in
+    Cache *oldCache = d->cache;
+    d->clearThreadRecords();
+    delete d->records;
+
+    d->cache = thread->cache;
+    d->cache->setParent(this);
+    d->records = thread->records;
+
+    if (!reusePackages(thread->tables.packageIds, keys)) {
+        // Package objects point into the old cache, so they have to go first
+        d->packages.clear();
+        d->arena.clear();
+        d->applyTables(thread->tables);
+    } else {
+        d->applyTables(thread->tables, true);
+    }
+    d->loadedSourcesKey = sourcesKey;
+
+    delete oldCache;
+
+    completeCacheReload();
+}
+
+QVector<QByteArray> Backend::packageKeys() const
+{
+    Q_D(const Backend);
+
+    // Identifies a package object along with its installed state, for
+    // reusing it after the cache has been reopened
+    QVector<QByteArray> keys(d->packages.size());
+    for (int i = 0; i < d->packages.size(); ++i) {
+        const Package *pkg = d->packages.at(i);
+        if (!pkg) {
+            continue;
+        }
+
+        const pkgCache::PkgIterator &iter = pkg->packageIterator();
+        keys[i] = QByteArray(iter.FullName().c_str()) % ' ' %
+                  QByteArray(iter.CurrentVer().end() ? "" : iter.CurrentVer().VerStr()) % ' ' %
+                  QByteArray::number(iter->CurrentState);
+    }
+
+    return keys;
+}
+
+bool Backend::reusePackages(const QVector<int> &packageIds, const QVector<QByteArray> &keys)
+{
+    Q_D(Backend);
+
+    // Only possible when the new cache has the very same package layout
+    if (keys.isEmpty() || packageIds != d->packageIds) {
+        return false;
+    }
+
+    pkgCache &cache = d->cache->depCache()->GetCache();
+    QVector<bool> changed(keys.size());
+    for (int i = 0; i < keys.size(); ++i) {
+        if (keys.at(i).isEmpty()) {
+            continue;
+        }
+
+        pkgCache::PkgIterator iter(cache, cache.PkgP + d->packageIds.at(i));
+        const QByteArray name(iter.FullName().c_str());
+        const QByteArray &key = keys.at(i);
+
+        if (!key.startsWith(name) || key.at(name.size()) != ' ') {
+            return false;
+        }
+
+        const QByteArray newKey = name % ' ' %
+                QByteArray(iter.CurrentVer().end() ? "" : iter.CurrentVer().VerStr()) % ' ' %
+                QByteArray::number(iter->CurrentState);
+        changed[i] = (newKey != key);
+    }
+
+    for (int i = 0; i < keys.size(); ++i) {
+        if (keys.at(i).isEmpty()) {
+            continue;
+        }
+
+        pkgCache::PkgIterator iter(cache, cache.PkgP + d->packageIds.at(i));
+        d->packages.at(i)->rebind(iter, changed.at(i));
+    }
+
+    return true;
+}
+
+void Backend::completeCacheReload()
+{
+    Q_D(Backend);
+
+    d->undoStack.clear();
+    d->redoStack.clear();
+
+    // Determine which packages are pinned for display purposes
+    loadPackagePins();
+
+    loadReleaseDate();
+
+    // The states right after loading are what commits, undo and simulations
+    // diff against, so they must be taken before anything can be marked
+    syncStates();
+
+    emit cacheReloadFinished();
+}
+
+void Backend::setInitError()
+{
+    Q_D(Backend);
+
+    string message;
+    if (_error->PopMessage(message))
+        d->initErrorMessage = QString::fromStdString(message);
+}
+
+void Backend::loadPackagePins()
+{
+    Q_D(Backend);
+
+    QString dirBase = d->config->findDirectory(QLatin1String("Dir::Etc"));
+    QString dir = dirBase % QLatin1String("preferences.d/");
+    QDir logDirectory(dir);
+    QStringList pinFiles = logDirectory.entryList(QDir::Files, QDir::Name);
+    pinFiles << dirBase % QLatin1String("preferences");
+
+    QStringList pinPaths;
+    for (const QString &pinName : pinFiles) {
+        // Make all paths absolute
+        QString pinPath = pinName.startsWith('/') ? pinName : dir % pinName;
+
+        if (!QFile::exists(pinPath))
+                continue;
+
+        pinPaths << pinPath;
+    }
+
+    // Only parse the preferences again if any of them changed since the
+    // last reload
+    const QByteArray pinsKey = fileStampKey(QStringList(dir) + pinPaths) % pinPaths.join(QLatin1Char(';')).toUtf8();
+    if (pinsKey != d->pinsKey) {
+        d->pinsKey = pinsKey;
+        d->pinnedNames.clear();
+        d->pinnedIdsKey.clear();
+
+        for (const QString &pinPath : pinPaths) {
+            FileFd Fd(pinPath.toUtf8().data(), FileFd::ReadOnly);
+
+            pkgTagFile tagFile(&Fd);
+            if (_error->PendingError()) {
+                _error->Discard();
+                continue;
+            }
+
+            pkgTagSection tags;
+            while (tagFile.Step(tags)) {
+                string name = tags.FindS("Package");
+                if (!name.empty()) {
+                    d->pinnedNames << QByteArray(name.c_str());
+                }
+            }
+        }
+    }
+
+    // Package IDs stay the same for as long as the cache is built from the
+    // same files
+    const QByteArray idsKey = d->snapshotKey();
+    if (idsKey != d->pinnedIdsKey) {
+        d->pinnedIdsKey = idsKey;
+        d->pinnedIds.clear();
+
+        pkgDepCache *depCache = d->cache->depCache();
+        for (const QByteArray &name : d->pinnedNames) {
+            pkgCache::PkgIterator iter = depCache->FindPkg(name.constData());
+            if (!iter.end()) {
+                d->pinnedIds << iter->ID;
+            }
+        }
+    }
+
+    for (int id : d->pinnedIds) {
+        Package *pkg = packageById(id);
+        if (pkg)
+            pkg->setPinned(true);
+    }
+}
+
+void Backend::loadReleaseDate()
+{
+    Q_D(Backend);
+
+    // Reset value in case we are re-loading cache
+    d->releaseDate = QDateTime();
+
+    QString releaseId;
+    QString releaseCodename;
+
+    QFile lsb_release(QLatin1String("/etc/os-release"));
+    if (!lsb_release.open(QFile::ReadOnly)) {
+        // Though really, your system is screwed if this happens...
+        return;
+    }
+
+    QTextStream stream(&lsb_release);
+    QString line;
+    do {
+        line = stream.readLine();
+        QStringList split = line.split(QLatin1Char('='));
+        if (split.size() != 2) {
+            continue;
+        }
+
+        if (split.at(0) == QLatin1String("VERSION_CODENAME")) {
+            releaseCodename = split.at(1);
+        } else if (split.at(0) == QLatin1String("ID")) {
+            releaseId = split.at(1);
+        }
+    } while (!line.isNull());
+
+    d->releaseDate = d->getReleaseDateFromDistroInfo(releaseId, releaseCodename);
+    if (!d->releaseDate.isValid()) {
+        // If we could not find the date in the csv file, we fallback to Apt archive.
+        d->releaseDate = d->getReleaseDateFromArchive(releaseId, releaseCodename);
+    }
+}
+
+QString Backend::initErrorMessage() const
+{
+    Q_D(const Backend);
+
+    return d->initErrorMessage;
+}
+
+pkgSourceList *Backend::packageSourceList() const
+{
+    Q_D(const Backend);
+
+    return d->cache->list();
+}
+
+Cache *Backend::cache() const
+{
+    Q_D(const Backend);
+
+    return d->cache;
+}
+
+pkgRecords *Backend::records() const
+{
+    Q_D(const Backend);
+
+    QThread *current = QThread::currentThread();
+    if (current == thread()) {
+        return d->records;
+    }
+
+    QMutexLocker locker(&d->recordsMutex);
+    if (!d->threadRecords.contains(current)) {
+        // Threads of QThread finish, adopted ones are only destroyed
+        auto release = [d, current]() { d->releaseThreadRecords(current); };
+        connect(current, &QThread::finished, &d->threadRecordsContext, release, Qt::DirectConnection);
+        connect(current, &QObject::destroyed, &d->threadRecordsContext, release, Qt::DirectConnection);
+    }
+
+    pkgRecords *&records = d->threadRecords[current];
+    if (!records) {
+        records = new pkgRecords(*d->cache->depCache());
+    }
+
+    return records;
+}
+
+QReadWriteLock *Backend::cacheLock() const
+{
+    Q_D(const Backend);
+
+    return &d->cacheLock;
+}
+
+QMutex *Backend::memoMutex() const
+{
+    Q_D(const Backend);
+
+    return &d->memoMutex;
+}
+
+QList<QStringList> Backend::recordFields(const PackageList &packages, const QStringList &fieldNames) const
+{
+    Q_D(const Backend);
+    TraceSpan span("records", "recordFields");
+
+    pkgDepCache *depCache = d->cache->depCache();
+
+    struct Lookup {
+        pkgCache::VerFileIterator file;
+        int index;
+    };
+
+    QVector<Lookup> lookups;
+    lookups.reserve(packages.size());
+    for (int i = 0; i < packages.size(); ++i) {
+        const pkgCache::VerIterator &ver = depCache->GetCandidateVer(packages.at(i)->packageIterator());
+        if (!ver.end()) {
+            lookups.append({ ver.FileList(), i });
+        }
+    }
+
+    // Visit the records in the order they are stored in the index files
+    std::sort(lookups.begin(), lookups.end(), [](const Lookup &a, const Lookup &b) {
+        if (a.file->File != b.file->File) {
+            return a.file->File < b.file->File;
+        }
+        return a.file->Offset < b.file->Offset;
+    });
+
+    std::vector<std::string> names;
+    names.reserve(fieldNames.size());
+    for (const QString &fieldName : fieldNames) {
+        names.push_back(fieldName.toStdString());
+    }
+
+    QList<QStringList> fields;
+    fields.reserve(packages.size());
+    for (int i = 0; i < packages.size(); ++i) {
+        QStringList empty;
+        empty.reserve(fieldNames.size());
+        for (int j = 0; j < fieldNames.size(); ++j) {
+            empty.append(QString());
+        }
+        fields.append(empty);
+    }
+
+    pkgRecords *packageRecords = records();
+    for (const Lookup &lookup : lookups) {
+        pkgRecords::Parser &parser = packageRecords->Lookup(lookup.file);
+        QStringList &values = fields[lookup.index];
+
+        for (size_t j = 0; j < names.size(); ++j) {
+            values[j] = QString::fromStdString(parser.RecordField(names[j].c_str()));
+        }
+    }
+
+    return fields;
+}
+
+Package *Backend::package(pkgCache::PkgIterator &iter) const
+{
+    Q_D(const Backend);
+
+    int index = d->packagesIndex.at(iter->ID);
+    if (index != -1 && index < d->packages.size()) {
+        return packageAt(index);
+    }
+
+    return nullptr;
+}
+
+Package *Backend::packageAt(int index) const
+{
+    Q_D(const Backend);
+
+    // Other threads may be filling slots, and an unguarded read of one
+    // would race with them
+    QMutexLocker locker(&d->memoMutex);
+
+    Package *pkg = d->packages.at(index);
+    if (!pkg) {
+        pkgCache &cache = d->cache->depCache()->GetCache();
+        pkgCache::PkgIterator iter(cache, cache.PkgP + d->packageIds.at(index));
+
+        pkg = d->arena.create(index, const_cast<Backend *>(this), iter);
+        d->packages[index] = pkg;
+    }
+
+    return pkg;
+}
+
+static quint64 markingSignature(const pkgCache &cache, const pkgDepCache::StateCache &stateCache)
+{
+    // Everything in the depCache that Package::state() derives flags from
+    quint64 version = stateCache.InstallVer ? quint64(stateCache.InstallVer - cache.VerP) + 1 : 0;
+    return quint64(stateCache.Mode) |
+           quint64(stateCache.iFlags) << 8 |
+           quint64(stateCache.Flags) << 16 |
+           quint64(quint8(stateCache.Status)) << 24 |
+           version << 32;
+}
+
+void Backend::syncStates() const
+{
+    Q_D(const Backend);
+    QMutexLocker locker(&d->memoMutex);
+
+    if (!d->statesDirty) {
+        return;
+    }
+
+    const int count = d->packages.size();
+    const int flagCount = 27; // Package::IsManuallyHeld is the highest flag
+    bool initial = d->states.isEmpty();
+
+    if (initial) {
+        d->states.fill(0, count);
+        d->stateSignatures.fill(0, count);
+        d->stateBits.fill(QBitArray(count), flagCount);
+    }
+
+    pkgDepCache *depCache = d->cache->depCache();
+    pkgCache &cache = depCache->GetCache();
+
+    // Comparing the raw marking state is cheap, so only the packages whose
+    // marking changed need to have their full state computed again
+    for (int i = 0; i < count; ++i) {
+        const pkgDepCache::StateCache &stateCache = (*depCache)[pkgCache::PkgIterator(cache, cache.PkgP + d->packageIds.at(i))];
+        const quint64 signature = markingSignature(cache, stateCache);
+
+        if (!initial && signature == d->stateSignatures.at(i) && !d->touchedSlots.contains(i)) {
+            continue;
+        }
+
+        d->stateSignatures[i] = signature;
+
+        // Slots without a Package have no QApt-side flags yet, so their
+        // state can be read from the depCache without creating one
+        const int oldState = d->states.at(i);
+        const Package *pkg = d->packages.at(i);
+        const int newState = pkg ? pkg->state()
+                                 : Package::stateOf(depCache, pkgCache::PkgIterator(cache, cache.PkgP + d->packageIds.at(i)));
+        d->states[i] = newState;
+
+        const int changed = initial ? newState : (oldState ^ newState);
+        if (!initial && changed) {
+            d->changedSlots.insert(i);
+        }
+
+        for (int bit = 0; bit < flagCount; ++bit) {
+            if (changed & (1 << bit)) {
+                d->stateBits[bit].setBit(i, newState & (1 << bit));
+            }
+        }
+    }
+
+    if (initial) {
+        d->baseStates = d->states;
+    }
+
+    d->touchedSlots.clear();
+    d->statesDirty = false;
+}
+
+void Backend::touchPackage(const Package *package)
+{
+    Q_D(Backend);
+
+    int index = d->packagesIndex.value(package->id(), -1);
+    if (index != -1) {
+        d->touchedSlots.insert(index);
+    }
+    d->statesDirty = true;
+    ++d->markingGeneration;
+}
+
+void Backend::invalidateStates()
+{
+    Q_D(Backend);
+
+    d->statesDirty = true;
+    ++d->markingGeneration;
+}
+
+void Backend::materializePackages() const
+{
+    Q_D(const Backend);
+
+    for (int i = 0; i < d->packages.size(); ++i) {
+        packageAt(i);
+    }
+}
+
+Package *Backend::package(const QString &name) const
+{
+    return package(QLatin1String(name.toLatin1()));
+}
+
+Package *Backend::package(QLatin1String name) const
+{
+    Q_D(const Backend);
+
+    pkgCache::PkgIterator pkg = d->cache->depCache()->FindPkg(name.latin1());
+    if (!pkg.end()) {
+        return package(pkg);
+    }
+    return nullptr;
+}
+
+PackageLookup Backend::packages(const QStringList &names) const
+{
+    QList<QByteArray> latinNames;
+    latinNames.reserve(names.size());
+    for (const QString &name : names) {
+        latinNames.append(name.toLatin1());
+    }
+
+    return packages(latinNames);
+}
+
+PackageLookup Backend::packages(const QList<QByteArray> &names) const
+{
+    Q_D(const Backend);
+
+    PackageLookup lookup;
+    lookup.packages.reserve(names.size());
+
+    // FindPkg() hashes into the cache's own package table, so the only
+    // per-name cost left is the key, which reuses one buffer
+    pkgDepCache *depCache = d->cache->depCache();
+    std::string key;
+    for (const QByteArray &name : names) {
+        key.assign(name.constData(), name.size());
+        pkgCache::PkgIterator iter = depCache->FindPkg(key);
+
+        Package *pkg = iter.end() ? nullptr : package(iter);
+        if (pkg) {
+            lookup.packages.append(pkg);
+        } else {
+            lookup.unknownNames.append(QString::fromLatin1(name));
+        }
+    }
+
+    return lookup;
+}
+
+Package *Backend::packageById(int id) const
+{
+    Q_D(const Backend);
+
+    if (id < 0 || id >= d->packagesIndex.size()) {
+        return nullptr;
+    }
+
+    int index = d->packagesIndex.at(id);
+    if (index != -1 && index < d->packages.size()) {
+        return packageAt(index);
+    }
+
+    return nullptr;
+}
+
+PackageList Backend::dependencyClosure(const Package *package) const
+{
+    Q_D(const Backend);
+
+    PackageList closure;
+    for (int id : d->closure(package->id(), false)) {
+        if (Package *dependency = packageById(id)) {
+            closure << dependency;
+        }
+    }
+
+    return closure;
+}
+
+PackageList Backend::reverseDependencyClosure(const Package *package) const
+{
+    Q_D(const Backend);
+
+    PackageList closure;
+    for (int id : d->closure(package->id(), true)) {
+        if (Package *depender = packageById(id)) {
+            closure << depender;
+        }
+    }
+
+    return closure;
+}
+
+Package *Backend::packageForFile(const QString &file) const
+{
+    Q_D(const Backend);
+
+    if (file.isEmpty()) {
+        return nullptr;
+    }
+
+    QMutexLocker locker(&d->memoMutex);
+    if (!d->fileOwnerIndex) {
+        const QString statusDir = QFileInfo(d->config->findFile(QLatin1String("Dir::State::status"))).absolutePath();
+        d->fileOwnerIndex = new FileOwnerIndex(statusDir % QLatin1String("/info"),
+                                               d->cacheFilePath(QLatin1String("file-owners")));
+    }
+
+    const QString owner = d->fileOwnerIndex->packageForFile(file);
+    locker.unlock();
+    if (owner.isEmpty()) {
+        return nullptr;
+    }
+
+    return package(owner);
+}
+
+QStringList Backend::origins() const
+{
+    Q_D(const Backend);
+
+    return d->originMap.keys();
+}
+
+QStringList Backend::originLabels() const
+{
+    Q_D(const Backend);
+
+    return d->originMap.values();
+}
+
+QString Backend::originLabel(const QString &origin) const
+{
+    Q_D(const Backend);
+
+    return d->originMap.value(origin);
+}
+
+QString Backend::origin(const QString &originLabel) const
+{
+    Q_D(const Backend);
+
+    return d->labelMap.value(originLabel);
+}
+
+QStringList Backend::originsForHost(const QString& host) const
+{
+    Q_D(const Backend);
+    return d->hostOrigins.values(host);
+}
+
+PackageList Backend::packagesFromOrigin(const QString &origin) const
+{
+    Q_D(const Backend);
+
+    const QVector<int> originSlots = d->originPackages.value(origin);
+
+    PackageList packages;
+    packages.reserve(originSlots.size());
+    for (int index : originSlots) {
+        packages.append(packageAt(index));
+    }
+
+    return packages;
+}
+
+int Backend::packageCount() const
+{
+    Q_D(const Backend);
+
+    return d->packages.size();
+}
+
+int Backend::packageCount(const Package::States &states) const
+{
+    Q_D(const Backend);
+
+    syncStates();
+
+    return d->packagesWithStates(states).count(true);
+}
+
+int Backend::installedCount() const
+{
+    Q_D(const Backend);
+
+    return d->installedCount;
+}
+
+int Backend::toInstallCount() const
+{
+    Q_D(const Backend);
+
+    return d->cache->depCache()->InstCount();
+}
+
+int Backend::toRemoveCount() const
+{
+    Q_D(const Backend);
+
+    return d->cache->depCache()->DelCount();
+}
+
+qint64 Backend::downloadSize() const
+{
+    Q_D(const Backend);
+    QMutexLocker locker(&d->memoMutex);
+
+    if (d->downloadSizeGeneration == d->markingGeneration) {
+        return d->downloadSize;
+    }
+
+    // Raw size, ignoring already-downloaded or partially downloaded archives
+    qint64 downloadSize = d->cache->depCache()->DebSize();
+
+    // If downloadSize() is called during a cache refresh, there is a chance it
+    // will do so at a bad time and produce an error. Discard any errors that
+    // happen during this function, since they will always be innocuous and at
+    // worst will result in the less accurate DebSize() number being returned
+    _error->PushToStack();
+
+    // If possible, get what really needs to be downloaded
+    pkgAcquire fetcher;
+    pkgPackageManager *PM = _system->CreatePM(d->cache->depCache());
+    if (PM->GetArchives(&fetcher, d->cache->list(), d->records)) {
+        downloadSize = fetcher.FetchNeeded();
+    }
+    delete PM;
+
+    _error->Discard();
+    _error->RevertToStack();
+
+    d->downloadSize = downloadSize;
+    d->downloadSizeGeneration = d->markingGeneration;
+
+    return downloadSize;
+}
+
+void Backend::requestDownloadSize()
+{
+    Q_D(Backend);
+
+    if (d->downloadSizeRequested) {
+        return;
+    }
+
+    d->downloadSizeRequested = true;
+    QTimer::singleShot(0, this, SLOT(emitDownloadSize()));
+}
+
+void Backend::emitDownloadSize()
+{
+    Q_D(Backend);
+
+    d->downloadSizeRequested = false;
+    emit downloadSizeCalculated(downloadSize());
+}
+
+qint64 Backend::installSize() const
+{
+    Q_D(const Backend);
+
+    qint64 installSize = d->cache->depCache()->UsrSize();
+
+    return installSize;
+}
+
+PackageList Backend::availablePackages() const
+{
+    Q_D(const Backend);
+
+    materializePackages();
+
+    return d->packages;
+}
+
+PackageList Backend::upgradeablePackages() const
+{
+    Q_D(const Backend);
+
+    PackageList upgradeablePackages;
+
+    syncStates();
+
+    const QBitArray &upgradeable = d->packagesWithStates(Package::Upgradeable);
+    for (int i = 0; i < upgradeable.size(); ++i) {
+        if (upgradeable.testBit(i)) {
+            upgradeablePackages << packageAt(i);
+        }
+    }
+
+    return upgradeablePackages;
+}
+
+PackageList Backend::upgradeablePackagesInUpdatePhase() const
+{
+    const PackageList upgradeable = upgradeablePackages();
+
+    PackageList pending;
+    for (Package *package : upgradeable) {
+        if (!package->isUpdatePhaseCalculated()) {
+            pending << package;
+        }
+    }
+
+    if (!pending.isEmpty()) {
+        const QStringList fieldNames = { QStringLiteral("Phased-Update-Percentage"),
+                                         QStringLiteral("Source") };
+        const QList<QStringList> fields = recordFields(pending, fieldNames);
+
+        UpdatePhase phase;
+        for (int i = 0; i < pending.size(); ++i) {
+            Package *package = pending.at(i);
+
+            bool intConversionOk = true;
+            int phasedUpdatePercent = fields.at(i).at(0).toInt(&intConversionOk);
+            if (!intConversionOk) {
+                // Not being phased, good for upgrade
+                package->setInUpdatePhase(true);
+                continue;
+            }
+
+            if (!phase.isMachineKnown()) {
+                // Counts as in phase, but isn't cached. See Package::isInUpdatePhase()
+                continue;
+            }
+
+            // The Source field may carry the source version in parentheses
+            QString sourcePackage = fields.at(i).at(1).section(QLatin1Char(' '), 0, 0);
+            if (sourcePackage.isEmpty()) {
+                sourcePackage = package->name();
+            }
+
+            package->setInUpdatePhase(phase.isInPhase(sourcePackage, package->availableVersion(),
+                                                      phasedUpdatePercent));
+        }
+    }
+
+    PackageList inPhase;
+    for (Package *package : upgradeable) {
+        if (!package->isUpdatePhaseCalculated() || package->isInUpdatePhase()) {
+            inPhase << package;
+        }
+    }
+
+    return inPhase;
+}
+
+PackageList Backend::markedPackages() const
+{
+    Q_D(const Backend);
+
+    PackageList markedPackages;
+
+    syncStates();
+
+    const QBitArray &marked = d->packagesWithStates(Package::ToInstall | Package::ToReInstall |
+                                                    Package::ToUpgrade | Package::ToDowngrade |
+                                                    Package::ToRemove | Package::ToPurge);
+    for (int i = 0; i < marked.size(); ++i) {
+        if (marked.testBit(i)) {
+            markedPackages << packageAt(i);
+        }
+    }
+    return markedPackages;
+}
+
+PackageList Backend::search(const QString &searchString) const
+{
+    return search(searchString, 0, -1);
+}
+
+PackageList Backend::search(const QString &searchString, int offset, int limit) const
+{
+    Q_D(const Backend);
+    TraceSpan span("search", "search");
+
+    if (d->xapianTimeStamp == 0 || !d->xapianDatabase) {
+        return textSearch(searchString, offset, limit);
+    }
+
+    PackageList searchResult;
+
+    try {
+        QMutexLocker locker(&d->searchMutex);
+        QStringList names;
+        try {
+            names = d->xapianSearch.matches(searchString, offset, limit);
+        } catch (const Xapian::Error &error) {
+            // matches() only deals with newer revisions. Other errors, such
+            // as from files being replaced, may go away on a reopen too
+            qDebug() << "Search error, reopening" << QString::fromStdString(error.get_msg());
+            d->xapianSearch.reopen();
+            names = d->xapianSearch.matches(searchString, offset, limit);
+        }
+        locker.unlock();
+        searchResult.reserve(names.size());
+
+        for (const QString &name : names) {
+            Package* pkg = package(name);
+            // Filter out results that apt doesn't know
+            if (pkg)
+                searchResult.append(pkg);
+        }
+    } catch (const Xapian::Error & error) {
+        qDebug() << "Search error" << QString::fromStdString(error.get_msg());
+        return QApt::PackageList();
+    }
+
+    return searchResult;
+}
+
+PackageList Backend::textSearch(const QString &searchString, int offset, int limit) const
+{
+    Q_D(const Backend);
+
+    QMutexLocker locker(&d->searchMutex);
+    if (d->textIndex.isEmpty()) {
+        pkgRecords *packageRecords = records();
+        pkgDepCache *depCache = d->cache->depCache();
+        pkgCache &cache = depCache->GetCache();
+
+        for (int i = 0; i < d->packageIds.size(); ++i) {
+            pkgCache::PkgIterator iter(cache, cache.PkgP + d->packageIds.at(i));
+            const pkgCache::VerIterator &ver = depCache->GetCandidateVer(iter);
+
+            QString description;
+            if (!ver.end()) {
+                pkgCache::DescIterator desc = ver.TranslatedDescription();
+                if (!desc.end()) {
+                    pkgRecords::Parser &parser = packageRecords->Lookup(desc.FileList());
+                    description = QString::fromUtf8(parser.ShortDesc().data());
+                }
+            }
+
+            d->textIndex.add(i, QLatin1String(iter.Name()), description);
+        }
+    }
+
+    const QVector<int> matches = d->textIndex.search(searchString);
+    locker.unlock();
+    const int start = qBound(0, offset, matches.size());
+    const int end = (limit < 0) ? matches.size()
+                                : int(qMin<qint64>(matches.size(), qint64(start) + limit));
+
+    PackageList searchResult;
+    for (int i = start; i < end; ++i) {
+        searchResult.append(packageAt(matches.at(i)));
+    }
+
+    return searchResult;
+}
+
+void Backend::searchAsync(const QString &searchString)
+{
+    Q_D(Backend);
+
+    if (d->xapianTimeStamp == 0 || !d->xapianDatabase) {
+        const PackageList results = textSearch(searchString, 0, -1);
+        if (!results.isEmpty()) {
+            emit searchResultsAvailable(searchString, results);
+        }
+        emit searchFinished(searchString);
+        return;
+    }
+
+    if (!d->searchThread) {
+        d->searchThread = new XapianSearchThread(QLatin1String("/var/lib/apt-xapian-index/index"), this);
+        d->searchThread->start();
+    }
+
+    d->asyncSearchString = searchString;
+    d->searchThread->search(searchString);
+}
+
+void Backend::deliverSearchPage(const QString &searchString, const QStringList &names, bool finished)
+{
+    Q_D(Backend);
+
+    // Drop pages of searches that have been superseded
+    if (searchString != d->asyncSearchString) {
+        return;
+    }
+
+    PackageList results;
+    results.reserve(names.size());
+    for (const QString &name : names) {
+        Package *pkg = package(name);
+        if (pkg)
+            results.append(pkg);
+    }
+
+    if (!results.isEmpty()) {
+        emit searchResultsAvailable(searchString, results);
+    }
+
+    if (finished) {
+        d->asyncSearchString.clear();
+        emit searchFinished(searchString);
+    }
+}
+
+GroupList Backend::availableGroups() const
+{
+    Q_D(const Backend);
+
+    GroupList groupList = d->groups.toList();
+
+    return groupList;
+}
+
+bool Backend::isMultiArchEnabled() const
+{
+    Q_D(const Backend);
+
+    return d->isMultiArch;
+}
+
+QStringList Backend::architectures() const
+{
     Q_D(const Backend);
 
-    return d->cache;
+    return d->config->architectures();
 }
 
-pkgRecords *Backend::records() const
+QString Backend::nativeArchitecture() const
 {
     Q_D(const Backend);
 
-    return d->records;
+    return d->nativeArch;
 }
 
-Package *Backend::package(pkgCache::PkgIterator &iter) const
+QDateTime Backend::releaseDate() const
 {
     Q_D(const Backend);
 
-    int index = d->packagesIndex.at(iter->ID);
-    if (index != -1 && index < d->packages.size()) {
-        return d->packages.at(index);
-    }
-
-    return nullptr;
+    return d->releaseDate;
 }
 
-Package *Backend::package(const QString &name) const
+bool Backend::areChangesMarked() const
 {
-    return package(QLatin1String(name.toLatin1()));
+    return (toInstallCount() + toRemoveCount());
 }
 
-Package *Backend::package(QLatin1String name) const
+bool Backend::isBroken() const
 {
     Q_D(const Backend);
 
-    pkgCache::PkgIterator pkg = d->cache->depCache()->FindPkg(name.latin1());
-    if (!pkg.end()) {
-        return package(pkg);
+    if (!d->cache->depCache()) {
+        return true;
     }
-    return nullptr;
+
+    // Check for broken things
+    if (d->cache->depCache()->BrokenCount()) {
+        return true;
+    }
+
+    return false;
 }
 
-Package *Backend::packageForFile(const QString &file) const
+QApt::FrontendCaps Backend::frontendCaps() const
 {
     Q_D(const Backend);
 
-    if (file.isEmpty()) {
-        return nullptr;
-    }
+    return d->frontendCaps;
+}
 
-    for (Package *package : d->packages) {
-        if (package->installedFilesList().contains(file)) {
-            return package;
-        }
-    }
+QDateTime Backend::timeCacheLastUpdated() const
+{
+    QDateTime sinceUpdate;
 
-    return nullptr;
+    QFileInfo updateStamp("/var/lib/apt/periodic/update-success-stamp");
+    if (!updateStamp.exists())
+        return sinceUpdate;
+
+    return updateStamp.lastModified();
 }
 
-QStringList Backend::origins() const
+bool Backend::xapianIndexNeedsUpdate() const
 {
     Q_D(const Backend);
 
-    return d->originMap.keys();
+    // If the cache has been modified after the xapian timestamp, we need to rebuild
+    QDateTime aptCacheTime = QFileInfo(d->config->findFile("Dir::Cache::pkgcache")).lastModified();
+
+    return ((d->xapianTimeStamp < aptCacheTime.toTime_t()) || (!d->xapianIndexExists));
 }
 
-QStringList Backend::originLabels() const
+bool Backend::openXapianIndex()
 {
-    Q_D(const Backend);
+    Q_D(Backend);
 
-    return d->originMap.values();
+    QFileInfo timeStamp(QLatin1String("/var/lib/apt-xapian-index/update-timestamp"));
+    d->xapianTimeStamp = timeStamp.lastModified().toTime_t();
+
+    QMutexLocker locker(&d->searchMutex);
+
+    // Incremental updates change the index directory in place, so an open
+    // database only has to move on to the latest revision. Full rebuilds
+    // write a new directory and point the stub at it, which needs a new one
+    const QDateTime stubTime = QFileInfo(QLatin1String("/var/lib/apt-xapian-index/index")).lastModified();
+    if (d->xapianDatabase && stubTime == d->xapianStubTime) {
+        try {
+            d->xapianSearch.reopen();
+            if (d->searchThread) {
+                d->searchThread->reopen();
+            }
+            return true;
+        } catch (const Xapian::Error &error) {
+            qDebug() << "Could not reopen the search index" << QString::fromStdString(error.get_msg());
+        }
+    }
+
+    // Background searches use their own database, and get a fresh one
+    delete d->searchThread;
+    d->searchThread = nullptr;
+
+    d->xapianSearch.setDatabase(nullptr);
+    if(d->xapianDatabase) {
+        delete d->xapianDatabase;
+        d->xapianDatabase = 0;
+    }
+    try {
+        d->xapianDatabase = new Xapian::Database("/var/lib/apt-xapian-index/index");
+        d->xapianSearch.setDatabase(d->xapianDatabase);
+        d->xapianIndexExists = true;
+        d->xapianStubTime = stubTime;
+    } catch (Xapian::DatabaseOpeningError) {
+        d->xapianIndexExists = false;
+        return false;
+    };
+
+    return true;
 }
 
-QString Backend::originLabel(const QString &origin) const
+Config *Backend::config() const
 {
     Q_D(const Backend);
 
-    return d->originMap.value(origin);
+    return d->config;
 }
 
-QString Backend::origin(const QString &originLabel) const
+CacheState Backend::currentCacheState() const
 {
     Q_D(const Backend);
 
-    return d->originMap.key(originLabel);
+    syncStates();
+
+    return d->states.toList();
 }
 
-QStringList Backend::originsForHost(const QString& host) const
+CacheSnapshot Backend::currentCacheSnapshot() const
 {
     Q_D(const Backend);
-    return d->siteMap.keys(host);
+
+    syncStates();
+
+    // Shares the array, the next change to the states detaches it
+    return d->states;
 }
 
-int Backend::packageCount() const
+// Calls @p visit with each index at which @p a and @p b differ. Runs of
+// equal states are skipped a block at a time with memcmp(), which the C
+// library vectorizes, so mostly unchanged snapshots are compared quickly
+template<typename Visitor>
+static void forEachDifference(const int *a, const int *b, int count, Visitor visit)
 {
-    Q_D(const Backend);
+    const int blockSize = 256;
 
-    return d->packages.size();
+    for (int start = 0; start < count; start += blockSize) {
+        const int end = qMin(start + blockSize, count);
+        if (memcmp(a + start, b + start, (end - start) * sizeof(int)) == 0) {
+            continue;
+        }
+
+        for (int i = start; i < end; ++i) {
+            if (a[i] != b[i]) {
+                visit(i);
+            }
+        }
+    }
 }
 
-int Backend::packageCount(const Package::States &states) const
+QHash<Package::State, PackageList> Backend::stateChanges(const CacheState &oldState,
+                                                         const PackageList &excluded) const
+{
+    QSet<const Package *> excludedSet;
+    excludedSet.reserve(excluded.size());
+    for (const Package *pkg : excluded) {
+        excludedSet.insert(pkg);
+    }
+
+    return stateChanges(oldState, excludedSet);
+}
+
+QHash<Package::State, PackageList> Backend::stateChanges(const CacheState &oldState,
+                                                         const QSet<const Package *> &excluded) const
+{
+    return stateChanges(oldState.toVector(), excluded);
+}
+
+QHash<Package::State, PackageList> Backend::stateChanges(const CacheSnapshot &oldState,
+                                                         const QSet<const Package *> &excluded) const
 {
     Q_D(const Backend);
 
-    int packageCount = 0;
+    QHash<Package::State, PackageList> changes;
+
+    // Return an empty change set for invalid state caches
+    if (oldState.isEmpty())
+        return changes;
+
+    Q_ASSERT(d->packages.size() == oldState.size());
+
+    syncStates();
+
+    // Nothing has changed since the snapshot was taken
+    if (oldState.isSharedWith(d->states))
+        return changes;
+
+    QVector<int> changed;
+    forEachDifference(oldState.constData(), d->states.constData(), d->states.size(),
+                      [&changed](int i) { changed.append(i); });
+
+    for (int i : changed) {
+        int status = d->states.at(i);
+
+        Package *pkg = packageAt(i);
+
+        if (excluded.contains(pkg))
+            continue;
+
+        // These flags will never be set together.
+        // We can use this to filter status down to a single flag.
+        status &= (Package::Held |
+                   Package::NewInstall |
+                   Package::ToReInstall |
+                   Package::ToUpgrade |
+                   Package::ToDowngrade |
+                   Package::ToRemove);
 
-    for (const Package *package : d->packages) {
-        if ((package->state() & states)) {
-            packageCount++;
+        if (status == 0) {
+            qWarning() << "Package" << pkg->name() << "had a state change,"
+                       << "it can however not be presented as a unique state."
+                       << "This is often an indication that the package is"
+                       << "supposed to be upgraded but can't because its"
+                       << "dependencies are not satisfied. This is not"
+                       << "considered a held package unless its upgrade is"
+                       << "necessary or causing breakage. A simple unsatisfied"
+                       << "dependency without the need to upgrade is not"
+                       << "considered an issue and thus not reported.\n"
+                       << "States were:"
+                       << (Package::States)oldState.at(i)
+                       << "->"
+                       << (Package::States)d->states.at(i);
+            // Apt pretends packages like this are not held (which is reflected)
+            // in the state loss. Whether or not this is intentional is not
+            // obvious at the time of writing in case it isn't the states
+            // here would add up again and the package rightfully would be
+            // reported as held. So we would never get here.
+            // Until then ignore these packages as we cannot serialize their
+            // state anyway.
+            continue;
         }
+        // Add this package/status pair to the changes hash
+        changes[(Package::State)status].append(pkg);
     }
 
-    return packageCount;
+    return changes;
 }
 
-int Backend::installedCount() const
+void Backend::saveCacheState()
 {
-    Q_D(const Backend);
+    Q_D(Backend);
+    d->undoStack.prepend(currentStateDelta());
+    d->redoStack.clear();
 
-    return d->installedCount;
+    while (d->undoStack.size() > d->maxStackSize) {
+        d->undoStack.removeLast();
+    }
 }
 
-int Backend::toInstallCount() const
+static void restorePackageState(pkgDepCache *deps, const pkgCache::PkgIterator &iter,
+                                int flags, int oldflags)
 {
-    Q_D(const Backend);
+    if ((flags & Package::ToReInstall) && !(oldflags & Package::ToReInstall)) {
+        deps->SetReInstall(iter, false);
+    }
 
-    return d->cache->depCache()->InstCount();
+    if (oldflags & Package::ToReInstall) {
+        deps->MarkInstall(iter, true);
+        deps->SetReInstall(iter, true);
+    } else if (oldflags & Package::ToInstall) {
+        deps->MarkInstall(iter, true);
+    } else if (oldflags & Package::ToRemove) {
+        deps->MarkDelete(iter, (bool)(oldflags & Package::ToPurge));
+    } else if (oldflags & Package::ToKeep) {
+        deps->MarkKeep(iter, false);
+    }
+    // fix the auto flag
+    deps->MarkAuto(iter, (oldflags & Package::IsAuto));
 }
 
-int Backend::toRemoveCount() const
+void Backend::restoreCacheState(const CacheState &state)
 {
-    Q_D(const Backend);
-
-    return d->cache->depCache()->DelCount();
+    restoreCacheState(state.toVector());
 }
 
-qint64 Backend::downloadSize() const
+void Backend::restoreCacheState(const CacheSnapshot &state)
 {
-    Q_D(const Backend);
+    Q_D(Backend);
+    QWriteLocker locker(&d->cacheLock);
 
-    // Raw size, ignoring already-downloaded or partially downloaded archives
-    qint64 downloadSize = d->cache->depCache()->DebSize();
+    Q_ASSERT(d->packages.size() == state.size());
 
-    // If downloadSize() is called during a cache refresh, there is a chance it
-    // will do so at a bad time and produce an error. Discard any errors that
-    // happen during this function, since they will always be innocuous and at
-    // worst will result in the less accurate DebSize() number being returned
-    _error->PushToStack();
+    syncStates();
 
-    // If possible, get what really needs to be downloaded
-    pkgAcquire fetcher;
-    pkgPackageManager *PM = _system->CreatePM(d->cache->depCache());
-    if (PM->GetArchives(&fetcher, d->cache->list(), d->records)) {
-        downloadSize = fetcher.FetchNeeded();
+    QVector<int> changed;
+    if (!state.isSharedWith(d->states)) {
+        forEachDifference(state.constData(), d->states.constData(), d->states.size(),
+                          [&changed](int i) { changed.append(i); });
     }
-    delete PM;
 
-    _error->Discard();
-    _error->RevertToStack();
+    // The states are synced again after the marking, so keep a copy
+    const QVector<int> flags = d->states;
 
-    return downloadSize;
+    pkgDepCache *deps = d->cache->depCache();
+    pkgDepCache::ActionGroup group(*deps);
+
+    for (int i : changed) {
+        restorePackageState(deps, packageAt(i)->packageIterator(), flags.at(i), state.at(i));
+    }
+
+    emit packageChanged();
 }
 
-qint64 Backend::installSize() const
+MarkingSimulation Backend::simulateMarking(const QApt::PackageList &packages, QApt::Package::State action) const
 {
     Q_D(const Backend);
 
-    qint64 installSize = d->cache->depCache()->UsrSize();
+    MarkingSimulation simulation;
 
-    return installSize;
-}
+    pkgDepCache *live = d->cache->depCache();
+    pkgCache &cache = live->GetCache();
 
-PackageList Backend::availablePackages() const
-{
-    Q_D(const Backend);
+    // APT can't share the per-package states between dependency caches, so
+    // set up a fresh one and bring it to the current marking
+    pkgDepCache scratch(&cache, d->cache->policy());
+    if (!scratch.Init(nullptr)) {
+        _error->Discard();
+        return simulation;
+    }
 
-    return d->packages;
-}
+    const QHash<int, int> delta = currentStateDelta();
+    {
+        pkgDepCache::ActionGroup group(scratch);
+
+        for (auto it = delta.constBegin(); it != delta.constEnd(); ++it) {
+            pkgCache::PkgIterator iter(cache, cache.PkgP + d->packageIds.at(it.key()));
+
+            const pkgCache::VerIterator &candidate = live->GetCandidateVer(iter);
+            if (!candidate.end() && scratch.GetCandidateVer(iter) != candidate) {
+                scratch.SetCandidateVersion(candidate);
+            }
+
+            restorePackageState(&scratch, iter, d->baseStates.at(it.key()), it.value());
+        }
+    }
+
+    for (Package *package : packages) {
+        const pkgCache::PkgIterator &iter = package->packageIterator();
+        int state = package->staticState();
+
+        switch (action) {
+        case Package::ToInstall:
+            if (!(state & Package::Installed) || (state & Package::Upgradeable)) {
+                scratch.MarkInstall(iter, true);
+                if (!scratch[iter].Install() || scratch.BrokenCount() > 0) {
+                    pkgProblemResolver Fix(&scratch);
+                    Fix.Clear(iter);
+                    Fix.Protect(iter);
+                    Fix.Resolve(true);
+                }
+            }
+            break;
+        case Package::ToRemove:
+        case Package::ToPurge: {
+            bool purge = (action == Package::ToPurge);
+            if ((state & Package::Installed) || (purge && (state & Package::ResidualConfig))) {
+                pkgProblemResolver Fix(&scratch);
+                Fix.Clear(iter);
+                Fix.Protect(iter);
+                Fix.Remove(iter);
+
+                scratch.SetReInstall(iter, false);
+                scratch.MarkDelete(iter, purge);
+
+                Fix.Resolve(true);
+            }
+            break;
+        }
+        case Package::ToUpgrade: {
+            bool fromUser = !(package->state() & Package::IsAuto);
+            scratch.MarkInstall(iter, true, 0, fromUser);
+            break;
+        }
+        case Package::ToReInstall:
+            if(state & Package::Installed
+               && !(state & Package::NotDownloadable)
+               && !(state & Package::Upgradeable)) {
+                scratch.SetReInstall(iter, true);
+            }
+            break;
+        case Package::ToKeep:
+            scratch.MarkKeep(iter, false);
+            scratch.SetReInstall(iter, false);
+            if (scratch.BrokenCount() > 0) {
+                pkgProblemResolver Fix(&scratch);
+                Fix.ResolveByKeep();
+            }
+            break;
+        default:
+            break;
+        }
+    }
 
-PackageList Backend::upgradeablePackages() const
-{
-    Q_D(const Backend);
+    simulation.downloadSize = scratch.DebSize();
+    simulation.installSize = scratch.UsrSize();
+    simulation.brokenCount = scratch.BrokenCount();
 
-    PackageList upgradeablePackages;
+    for (pkgCache::PkgIterator iter = cache.PkgBegin(); !iter.end(); ++iter) {
+        const pkgDepCache::StateCache &before = (*live)[iter];
+        const pkgDepCache::StateCache &after = scratch[iter];
 
-    for (Package *package : d->packages) {
-        if (package->staticState() & Package::Upgradeable) {
-            upgradeablePackages << package;
+        if (before.Mode != after.Mode || before.iFlags != after.iFlags ||
+            before.InstallVer != after.InstallVer) {
+            if (Package *changed = package(iter)) {
+                simulation.changedPackages << changed;
+            }
         }
     }
 
-    return upgradeablePackages;
+    return simulation;
 }
 
-PackageList Backend::markedPackages() const
+BrokenDiagnosis Backend::brokenReasons() const
 {
     Q_D(const Backend);
 
-    PackageList markedPackages;
+    BrokenDiagnosis diagnosis;
 
-    for (Package *package : d->packages) {
-        if (package->state() & (Package::ToInstall | Package::ToReInstall |
-                                Package::ToUpgrade | Package::ToDowngrade |
-                                Package::ToRemove | Package::ToPurge)) {
-            markedPackages << package;
-        }
+    pkgDepCache *depCache = d->cache->depCache();
+    if (!depCache->BrokenCount()) {
+        return diagnosis;
     }
-    return markedPackages;
-}
 
-PackageList Backend::search(const QString &searchString) const
-{
-    Q_D(const Backend);
+    pkgCache &cache = depCache->GetCache();
+    QHash<const Package *, int> brokenIndexes;
 
-    if (d->xapianTimeStamp == 0 || !d->xapianDatabase) {
-        return QApt::PackageList();
+    for (int i = 0; i < d->packageIds.size(); ++i) {
+        pkgCache::PkgIterator iter(cache, cache.PkgP + d->packageIds.at(i));
+        if (!(*depCache)[iter].InstBroken()) {
+            continue;
+        }
+
+        Package *pkg = packageAt(i);
+        brokenIndexes.insert(pkg, diagnosis.packages.size());
+        diagnosis.packages.append(pkg);
     }
 
-    string unsplitSearchString = searchString.toStdString();
-    static int qualityCutoff = 15;
-    PackageList searchResult;
+    // Causes are the same when they are of the same kind and about the same
+    // dependency, no matter which package they break
+    QHash<QString, int> causeIndexes;
 
-    // Doesn't follow style guidelines to ease merging with synaptic
-    try {
-        int maxItems = d->xapianDatabase->get_doccount();
-        Xapian::Enquire enquire(*(d->xapianDatabase));
-        Xapian::QueryParser parser;
-        parser.set_database(*(d->xapianDatabase));
-        parser.add_prefix("name","XP");
-        parser.add_prefix("section","XS");
-        // default op is AND to narrow down the resultset
-        parser.set_default_op( Xapian::Query::OP_AND );
-
-        /* Workaround to allow searching an hyphenated package name using a prefix (name:)
-        * LP: #282995
-        * Xapian currently doesn't support wildcard for boolean prefix and
-        * doesn't handle implicit wildcards at the end of hypenated phrases.
-        *
-        * e.g searching for name:ubuntu-res will be equivalent to 'name:ubuntu res*'
-        * however 'name:(ubuntu* res*) won't return any result because the
-        * index is built with the full package name
-        */
-        // Always search for the package name
-        string xpString = "name:";
-        string::size_type pos = unsplitSearchString.find_first_of(" ,;");
-        if (pos > 0) {
-            xpString += unsplitSearchString.substr(0,pos);
-        } else {
-            xpString += unsplitSearchString;
-        }
-        Xapian::Query xpQuery = parser.parse_query(xpString);
-
-        pos = 0;
-        while ( (pos = unsplitSearchString.find("-", pos)) != string::npos ) {
-            unsplitSearchString.replace(pos, 1, " ");
-            pos+=1;
-        }
-
-        // Build the query
-        // apply a weight factor to XP term to increase relevancy on package name
-        Xapian::Query query = parser.parse_query(unsplitSearchString,
-           Xapian::QueryParser::FLAG_WILDCARD |
-           Xapian::QueryParser::FLAG_BOOLEAN |
-           Xapian::QueryParser::FLAG_PARTIAL);
-        query = Xapian::Query(Xapian::Query::OP_OR, query,
-                Xapian::Query(Xapian::Query::OP_SCALE_WEIGHT, xpQuery, 3));
-        enquire.set_query(query);
-        Xapian::MSet matches = enquire.get_mset(0, maxItems);
-
-      // Retrieve the results
-      int top_percent = 0;
-      for (Xapian::MSetIterator i = matches.begin(); i != matches.end(); ++i)
-      {
-         std::string pkgName = i.get_document().get_data();
-         Package* pkg = package(QLatin1String(pkgName.c_str()));
-         // Filter out results that apt doesn't know
-         if (!pkg)
-            continue;
+    for (const Package *pkg : diagnosis.packages) {
+        QVector<int> causes;
 
-         // Save the confidence interval of the top value, to use it as
-         // a reference to compute an adaptive quality cutoff
-         if (top_percent == 0)
-            top_percent = i.get_percent();
+        for (const MarkingErrorInfo &reason : pkg->brokenReason()) {
+            const DependencyInfo info = reason.errorInfo();
+            const QString key = QString::number(reason.errorType()) % QLatin1Char(' ') %
+                                QString::number(info.dependencyType()) % QLatin1Char(' ') %
+                                info.packageName() % QLatin1Char(' ') % info.packageVersion();
 
-         // Stop producing if the quality goes below a cutoff point
-         if (i.get_percent() < qualityCutoff * top_percent / 100)
-         {
-            break;
-         }
+            auto it = causeIndexes.constFind(key);
+            if (it == causeIndexes.constEnd()) {
+                it = causeIndexes.insert(key, diagnosis.causes.size());
+                diagnosis.causes.append(reason);
 
-         searchResult.append(pkg);
-         }
-    } catch (const Xapian::Error & error) {
-        qDebug() << "Search error" << QString::fromStdString(error.get_msg());
-        return QApt::PackageList();
+                const Package *target = info.packageName() == pkg->name()
+                                        ? nullptr : package(info.packageName());
+                diagnosis.causePackages.append(brokenIndexes.value(target, -1));
+            }
+
+            if (!causes.contains(*it)) {
+                causes.append(*it);
+            }
+        }
+
+        diagnosis.packageCauses.append(causes);
     }
 
-    return searchResult;
+    return diagnosis;
 }
 
-GroupList Backend::availableGroups() const
+// Records the operations the ordering would hand to dpkg instead of running
+// them, for commitPlan()
+class PlanningPackageManager : public pkgPackageManager
 {
-    Q_D(const Backend);
+public:
+    explicit PlanningPackageManager(pkgDepCache *cache)
+        : pkgPackageManager(cache)
+    {}
 
-    GroupList groupList = d->groups.toList();
+    QList<QPair<CommitStep::Action, pkgCache::PkgIterator> > steps;
 
-    return groupList;
-}
+protected:
+    bool Install(PkgIterator pkg, std::string) override
+    {
+        steps.append(qMakePair(CommitStep::Unpack, pkg));
+        return true;
+    }
 
-bool Backend::isMultiArchEnabled() const
-{
-    Q_D(const Backend);
+    bool Configure(PkgIterator pkg) override
+    {
+        steps.append(qMakePair(CommitStep::Configure, pkg));
+        return true;
+    }
 
-    return d->isMultiArch;
-}
+    bool Remove(PkgIterator pkg, bool purge) override
+    {
+        steps.append(qMakePair(purge ? CommitStep::Purge : CommitStep::Remove, pkg));
+        return true;
+    }
+};
 
-QStringList Backend::architectures() const
+CommitPlan Backend::commitPlan() const
 {
     Q_D(const Backend);
+    QMutexLocker locker(&d->memoMutex);
 
-    return d->config->architectures();
-}
-
-QString Backend::nativeArchitecture() const
-{
-    Q_D(const Backend);
+    if (d->commitPlanGeneration == d->markingGeneration) {
+        return d->commitPlan;
+    }
 
-    return d->nativeArch;
-}
+    TraceSpan span("commit", "commitPlan");
 
-QDateTime Backend::releaseDate() const
-{
-    Q_D(const Backend);
+    pkgDepCache *depCache = d->cache->depCache();
 
-    return d->releaseDate;
-}
+    CommitPlan plan;
+    plan.downloadSize = depCache->DebSize();
+    plan.installSize = depCache->UsrSize();
 
-bool Backend::areChangesMarked() const
-{
-    return (toInstallCount() + toRemoveCount());
-}
+    // As in downloadSize(), errors here only make the plan less accurate
+    _error->PushToStack();
 
-bool Backend::isBroken() const
-{
-    Q_D(const Backend);
+    pkgAcquire fetcher;
+    PlanningPackageManager planner(depCache);
+    // May be called off the backend's thread, see cacheLock()
+    if (planner.GetArchives(&fetcher, d->cache->list(), records())) {
+        plan.downloadSize = 0;
+
+        for (auto it = fetcher.ItemsBegin(); it != fetcher.ItemsEnd(); ++it) {
+            const pkgAcquire::Item *item = *it;
+            if (item->Local || item->Complete) {
+                continue;
+            }
 
-    if (!d->cache->depCache()) {
-        return true;
-    }
+            const qint64 size = item->FileSize - item->PartialSize;
+            const QString host = QUrl(QString::fromStdString(item->DescURI())).host();
+            plan.downloadSizePerHost[host] += size;
+            plan.downloadSize += size;
+        }
 
-    // Check for broken things
-    if (d->cache->depCache()->BrokenCount()) {
-        return true;
+        plan.valid = (planner.DoInstallPreFork() == pkgPackageManager::Completed);
     }
 
-    return false;
-}
+    _error->Discard();
+    _error->RevertToStack();
 
-QApt::FrontendCaps Backend::frontendCaps() const
-{
-    Q_D(const Backend);
+    if (plan.valid) {
+        const QString infoDir = QFileInfo(d->config->findFile(QLatin1String("Dir::State::status"))).absolutePath()
+                                % QLatin1String("/info/");
+        QSet<const Package *> triggering;
 
-    return d->frontendCaps;
-}
+        for (const auto &step : planner.steps) {
+            // package() only takes non-const iterators
+            pkgCache::PkgIterator iter = step.second;
+            Package *pkg = package(iter);
+            if (!pkg) {
+                continue;
+            }
 
-QDateTime Backend::timeCacheLastUpdated() const
-{
-    QDateTime sinceUpdate;
+            plan.steps.append(CommitStep { step.first, pkg });
 
-    QFileInfo updateStamp("/var/lib/apt/periodic/update-success-stamp");
-    if (!updateStamp.exists())
-        return sinceUpdate;
+            // Only what is installed now has its triggers registered with dpkg
+            if (step.first == CommitStep::Configure || !pkg->isInstalled() || triggering.contains(pkg)) {
+                continue;
+            }
 
-    return updateStamp.lastModified();
-}
+            if (QFile::exists(infoDir % pkg->name() % QLatin1String(".triggers")) ||
+                QFile::exists(infoDir % pkg->name() % QLatin1Char(':') % pkg->architecture() % QLatin1String(".triggers"))) {
+                triggering.insert(pkg);
+            }
+        }
 
-bool Backend::xapianIndexNeedsUpdate() const
-{
-    Q_D(const Backend);
+        plan.triggerCount = triggering.size();
+    }
 
-    // If the cache has been modified after the xapian timestamp, we need to rebuild
-    QDateTime aptCacheTime = QFileInfo(d->config->findFile("Dir::Cache::pkgcache")).lastModified();
+    d->commitPlan = plan;
+    d->commitPlanGeneration = d->markingGeneration;
 
-    return ((d->xapianTimeStamp < aptCacheTime.toTime_t()) || (!d->xapianIndexExists));
+    return plan;
 }
 
-bool Backend::openXapianIndex()
+// Rough container sizes for memoryStatistics(). Hash nodes hold a next
+// pointer and the hash next to the key and value
+template<typename T>
+static qint64 vectorBytes(const QVector<T> &vector)
 {
-    Q_D(Backend);
-
-    QFileInfo timeStamp(QLatin1String("/var/lib/apt-xapian-index/update-timestamp"));
-    d->xapianTimeStamp = timeStamp.lastModified().toTime_t();
-
-    if(d->xapianDatabase) {
-        delete d->xapianDatabase;
-        d->xapianDatabase = 0;
-    }
-    try {
-        d->xapianDatabase = new Xapian::Database("/var/lib/apt-xapian-index/index");
-        d->xapianIndexExists = true;
-    } catch (Xapian::DatabaseOpeningError) {
-        d->xapianIndexExists = false;
-        return false;
-    };
+    return qint64(vector.capacity()) * sizeof(T);
+}
 
-    return true;
+template<typename T>
+static qint64 listBytes(const QList<T> &list)
+{
+    return qint64(list.size()) * (sizeof(void *) + (QTypeInfo<T>::isLarge ? sizeof(T) : 0));
 }
 
-Config *Backend::config() const
+template<typename Key, typename Value>
+static qint64 hashBytes(const QHash<Key, Value> &hash)
 {
-    Q_D(const Backend);
+    return qint64(hash.capacity()) * sizeof(void *) +
+           qint64(hash.size()) * (sizeof(void *) + sizeof(uint) + sizeof(Key) + sizeof(Value));
+}
 
-    return d->config;
+template<typename T>
+static qint64 setBytes(const QSet<T> &set)
+{
+    return qint64(set.capacity()) * sizeof(void *) +
+           qint64(set.size()) * (sizeof(void *) + sizeof(uint) + sizeof(T));
 }
 
-CacheState Backend::currentCacheState() const
+static qint64 stringBytes(const QString &string)
 {
-    Q_D(const Backend);
+    return string.isNull() ? 0 : qint64(string.capacity() + 1) * sizeof(QChar);
+}
 
-    CacheState state;
-    int pkgSize = d->packages.size();
-    state.reserve(pkgSize);
-    for (int i = 0; i < pkgSize; ++i) {
-        state.append(d->packages.at(i)->state());
-    }
+static qint64 stringHashBytes(const QHash<QString, QString> &hash)
+{
+    qint64 bytes = hashBytes(hash);
+    for (auto it = hash.constBegin(); it != hash.constEnd(); ++it)
+        bytes += stringBytes(it.key()) + stringBytes(it.value());
+    return bytes;
+}
 
-    return state;
+static qint64 closureBytes(const QHash<int, QVector<int> > &closures)
+{
+    qint64 bytes = hashBytes(closures);
+    for (const QVector<int> &closure : closures)
+        bytes += vectorBytes(closure);
+    return bytes;
 }
 
-QHash<Package::State, PackageList> Backend::stateChanges(const CacheState &oldState,
-                                                         const PackageList &excluded) const
+MemoryStatistics Backend::memoryStatistics() const
 {
     Q_D(const Backend);
 
-    QHash<Package::State, PackageList> changes;
+    MemoryStatistics stats;
 
-    // Return an empty change set for invalid state caches
-    if (oldState.isEmpty())
-        return changes;
+    stats.packages.bytes = d->arena.capacityBytes() + listBytes(d->packages);
+    for (const Package *pkg : d->packages) {
+        if (!pkg)
+            continue;
 
-    Q_ASSERT(d->packages.size() == oldState.size());
+        ++stats.packages.count;
 
-    for (int i = 0; i < d->packages.size(); ++i) {
-        Package *pkg = d->packages.at(i);
+        const qint64 cached = pkg->cachedBytes();
+        if (cached) {
+            stats.recordCaches.bytes += cached;
+            ++stats.recordCaches.count;
+        }
+    }
 
-        if (excluded.contains(pkg))
-            continue;
+    stats.packagesIndex.bytes = vectorBytes(d->packagesIndex) + vectorBytes(d->packageIds);
+    stats.packagesIndex.count = d->packagesIndex.size();
 
-        int status = pkg->state();
+    stats.groups.bytes = setBytes(d->groups);
+    for (const Group &group : d->groups)
+        stats.groups.bytes += stringBytes(group);
+    stats.groups.count = d->groups.size();
 
-        if (oldState.at(i) == status)
-            continue;
+    stats.origins.bytes = stringHashBytes(d->originMap) + stringHashBytes(d->labelMap);
+    for (auto it = d->originPackages.constBegin(); it != d->originPackages.constEnd(); ++it) {
+        stats.origins.bytes += stringBytes(it.key()) + vectorBytes(it.value());
+    }
+    stats.origins.bytes += hashBytes(d->originPackages);
+    stats.origins.count = d->originMap.size();
+    stats.sites.bytes = stringHashBytes(d->siteMap) + hashBytes(d->hostOrigins);
+    stats.sites.count = d->siteMap.size();
+
+    for (const QList<QHash<int, int> > *stack : { &d->undoStack, &d->redoStack }) {
+        stats.undoRedo.bytes += listBytes(*stack);
+        for (const QHash<int, int> &delta : *stack)
+            stats.undoRedo.bytes += hashBytes(delta);
+        stats.undoRedo.count += stack->size();
+    }
 
-        // These flags will never be set together.
-        // We can use this to filter status down to a single flag.
-        status &= (Package::Held |
-                   Package::NewInstall |
-                   Package::ToReInstall |
-                   Package::ToUpgrade |
-                   Package::ToDowngrade |
-                   Package::ToRemove);
+    stats.states.bytes = vectorBytes(d->states) + vectorBytes(d->stateSignatures) +
+                         vectorBytes(d->stateBits) + vectorBytes(d->baseStates) +
+                         setBytes(d->touchedSlots) + setBytes(d->changedSlots);
+    for (const QBitArray &bits : d->stateBits)
+        stats.states.bytes += bits.size() / 8;
+    stats.states.count = d->states.size();
+
+    stats.searchCaches.bytes = d->textIndex.size() +
+                               closureBytes(d->dependencyClosures) +
+                               closureBytes(d->reverseDependencyClosures);
+    stats.searchCaches.count = d->dependencyClosures.size() + d->reverseDependencyClosures.size();
+
+    if (d->fileOwnerIndex) {
+        stats.fileOwnerIndex.bytes = d->fileOwnerIndex->size();
+        stats.fileOwnerIndex.count = 1;
+    }
 
-        if (status == 0) {
-            qWarning() << "Package" << pkg->name() << "had a state change,"
-                       << "it can however not be presented as a unique state."
-                       << "This is often an indication that the package is"
-                       << "supposed to be upgraded but can't because its"
-                       << "dependencies are not satisfied. This is not"
-                       << "considered a held package unless its upgrade is"
-                       << "necessary or causing breakage. A simple unsatisfied"
-                       << "dependency without the need to upgrade is not"
-                       << "considered an issue and thus not reported.\n"
-                       << "States were:"
-                       << (Package::States)oldState.at(i)
-                       << "->"
-                       << (Package::States)pkg->state();
-            // Apt pretends packages like this are not held (which is reflected)
-            // in the state loss. Whether or not this is intentional is not
-            // obvious at the time of writing in case it isn't the states
-            // here would add up again and the package rightfully would be
-            // reported as held. So we would never get here.
-            // Until then ignore these packages as we cannot serialize their
-            // state anyway.
-            continue;
+    if (d->xapianDatabase) {
+        try {
+            stats.xapian.count = d->xapianDatabase->get_doccount();
+        } catch (const Xapian::Error &) {
         }
-        // Add this package/status pair to the changes hash
-        PackageList list = changes.value((Package::State)status);
-        list.append(pkg);
-        changes[(Package::State)status]= list;
     }
 
-    return changes;
+    return stats;
 }
 
-void Backend::saveCacheState()
+QHash<int, int> Backend::currentStateDelta() const
 {
-    Q_D(Backend);
-    CacheState state = currentCacheState();
-    d->undoStack.prepend(state);
-    d->redoStack.clear();
+    Q_D(const Backend);
 
-    while (d->undoStack.size() > d->maxStackSize) {
-        d->undoStack.removeLast();
+    syncStates();
+
+    // Only packages that changed at some point can differ from the base
+    QHash<int, int> delta;
+    for (int index : d->changedSlots) {
+        int state = d->states.at(index);
+        if (state != d->baseStates.at(index)) {
+            delta.insert(index, state);
+        }
     }
+
+    return delta;
 }
 
-void Backend::restoreCacheState(const CacheState &state)
+void Backend::restoreStateDelta(const QHash<int, int> &delta)
 {
     Q_D(Backend);
 
+    // Packages that are neither different now nor in the saved state
+    // already have the state that is being restored
+    QSet<int> indexes = QSet<int>::fromList(delta.keys());
+    for (int index : currentStateDelta().keys()) {
+        indexes.insert(index);
+    }
+
     pkgDepCache *deps = d->cache->depCache();
     pkgDepCache::ActionGroup group(*deps);
 
-    int packageCount = d->packages.size();
-    for (int i = 0; i < packageCount; ++i) {
-        Package *pkg = d->packages.at(i);
+    for (int index : indexes) {
+        Package *pkg = packageAt(index);
         int flags = pkg->state();
-        int oldflags = state.at(i);
+        int oldflags = delta.value(index, d->baseStates.at(index));
 
         if (oldflags == flags)
             continue;
 
-        if ((flags & Package::ToReInstall) && !(oldflags & Package::ToReInstall)) {
-            deps->SetReInstall(pkg->packageIterator(), false);
-        }
-
-        if (oldflags & Package::ToReInstall) {
-            deps->MarkInstall(pkg->packageIterator(), true);
-            deps->SetReInstall(pkg->packageIterator(), true);
-        } else if (oldflags & Package::ToInstall) {
-            deps->MarkInstall(pkg->packageIterator(), true);
-        } else if (oldflags & Package::ToRemove) {
-            deps->MarkDelete(pkg->packageIterator(), (bool)(oldflags & Package::ToPurge));
-        } else if (oldflags & Package::ToKeep) {
-            deps->MarkKeep(pkg->packageIterator(), false);
-        }
-        // fix the auto flag
-        deps->MarkAuto(pkg->packageIterator(), (oldflags & Package::IsAuto));
+        restorePackageState(deps, pkg->packageIterator(), flags, oldflags);
     }
 
     emit packageChanged();
@@ -991,36 +2861,37 @@ bool Backend::areEventsCompressed() const
 void Backend::undo()
 {
     Q_D(Backend);
+    QWriteLocker locker(&d->cacheLock);
 
     if (d->undoStack.isEmpty()) {
         return;
     }
 
     // Place current state on redo stack
-    d->redoStack.prepend(currentCacheState());
+    d->redoStack.prepend(currentStateDelta());
 
-    CacheState state = d->undoStack.takeFirst();
-    restoreCacheState(state);
+    restoreStateDelta(d->undoStack.takeFirst());
 }
 
 void Backend::redo()
 {
     Q_D(Backend);
+    QWriteLocker locker(&d->cacheLock);
 
     if (d->redoStack.isEmpty()) {
         return;
     }
 
     // Place current state on undo stack
-    d->undoStack.append(currentCacheState());
+    d->undoStack.append(currentStateDelta());
 
-    CacheState state = d->redoStack.takeFirst();
-    restoreCacheState(state);
+    restoreStateDelta(d->redoStack.takeFirst());
 }
 
 void Backend::markPackagesForUpgrade()
 {
     Q_D(Backend);
+    QWriteLocker locker(&d->cacheLock);
 
     pkgAllUpgrade(*d->cache->depCache());
     emit packageChanged();
@@ -1029,6 +2900,7 @@ void Backend::markPackagesForUpgrade()
 void Backend::markPackagesForDistUpgrade()
 {
     Q_D(Backend);
+    QWriteLocker locker(&d->cacheLock);
 
     pkgDistUpgrade(*d->cache->depCache());
     emit packageChanged();
@@ -1037,6 +2909,7 @@ void Backend::markPackagesForDistUpgrade()
 void Backend::markPackagesForAutoRemove()
 {
     Q_D(Backend);
+    QWriteLocker locker(&d->cacheLock);
 
     pkgDepCache &cache = *d->cache->depCache();
     bool isResidual;
@@ -1070,6 +2943,8 @@ void Backend::markPackageForRemoval(const QString &name)
 void Backend::markPackages(const QApt::PackageList &packages, QApt::Package::State action)
 {
     Q_D(Backend);
+    TraceSpan span("marking", "markPackages");
+    QWriteLocker locker(&d->cacheLock);
 
     if (packages.isEmpty()) {
         return;
@@ -1115,18 +2990,113 @@ void Backend::markPackages(const QApt::PackageList &packages, QApt::Package::Sta
         case Package::ToPurge: {
             int state = package->staticState();
 
-            if ((state & Package::Installed) || (state & Package::ResidualConfig)) {
-                package->setPurge();
+            if ((state & Package::Installed) || (state & Package::ResidualConfig)) {
+                package->setPurge();
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // Emits packageChanged()
+    setCompressEvents(false);
+}
+
+QHash<Package::State, PackageList> Backend::markPackagesBatch(const QApt::PackageList &packages,
+                                                              QApt::Package::State action)
+{
+    Q_D(Backend);
+    TraceSpan span("marking", "markPackagesBatch");
+    QWriteLocker locker(&d->cacheLock);
+
+    if (packages.isEmpty()) {
+        return QHash<Package::State, PackageList>();
+    }
+
+    const CacheSnapshot snapshot = currentCacheSnapshot();
+    pkgDepCache *deps = d->cache->depCache();
+    pkgProblemResolver fix(deps);
+    bool byKeep = false;
+
+    {
+        // Without resolving in between, as markPackages() does per package
+        pkgDepCache::ActionGroup group(*deps);
+
+        for (Package *package : packages) {
+            const pkgCache::PkgIterator &iter = package->packageIterator();
+            const int state = package->staticState();
+
+            switch (action) {
+            case Package::ToInstall:
+                if ((state & Package::Installed) && !(state & Package::Upgradeable)) {
+                    continue;
+                }
+                deps->MarkInstall(iter, false);
+                fix.Clear(iter);
+                fix.Protect(iter);
+                break;
+            case Package::ToRemove:
+            case Package::ToPurge:
+                if (action == Package::ToRemove ? !package->isInstalled()
+                    : !(state & (Package::Installed | Package::ResidualConfig))) {
+                    continue;
+                }
+                fix.Clear(iter);
+                fix.Protect(iter);
+                fix.Remove(iter);
+                deps->SetReInstall(iter, false);
+                deps->MarkDelete(iter, action == Package::ToPurge);
+                break;
+            case Package::ToUpgrade:
+                deps->MarkInstall(iter, false, 0, !(package->state() & Package::IsAuto));
+                fix.Clear(iter);
+                fix.Protect(iter);
+                break;
+            case Package::ToReInstall:
+                if (!(state & Package::Installed) || (state & Package::NotDownloadable) ||
+                    (state & Package::Upgradeable)) {
+                    continue;
+                }
+                deps->SetReInstall(iter, true);
+                break;
+            case Package::ToKeep:
+                deps->MarkKeep(iter, false);
+                deps->SetReInstall(iter, false);
+                byKeep = true;
+                break;
+            default:
+                continue;
+            }
+
+            package->setManuallyHeld(action == Package::ToKeep);
+            touchPackage(package);
+        }
+    }
+
+    // One pass installs the dependencies of everything marked for install
+    // and settles what the removals broke
+    if (action == Package::ToInstall || action == Package::ToUpgrade) {
+        for (Package *package : packages) {
+            const pkgCache::PkgIterator &iter = package->packageIterator();
+            if ((*deps)[iter].Install()) {
+                deps->MarkInstall(iter, true, 0, !(package->state() & Package::IsAuto));
             }
-            break;
         }
-        default:
-            break;
+    }
+
+    if (deps->BrokenCount() > 0) {
+        if (byKeep) {
+            fix.ResolveByKeep();
+        } else {
+            fix.Resolve(true);
         }
     }
 
-    setCompressEvents(false);
     emit packageChanged();
+
+    return stateChanges(snapshot, QSet<const Package *>());
 }
 
 void Backend::setCompressEvents(bool enabled)
@@ -1147,13 +3117,18 @@ void Backend::setCompressEvents(bool enabled)
     }
 }
 
-QApt::Transaction * Backend::commitChanges()
+QVariantMap Backend::changedPackageList() const
 {
-    Q_D(Backend);
+    // Only packages that differ from the freshly loaded cache can carry
+    // instructions for the worker
+    const QHash<int, int> delta = currentStateDelta();
+    QVector<int> changed = delta.keys().toVector();
+    std::sort(changed.begin(), changed.end());
 
     QVariantMap packageList;
-    for (const Package *package : d->packages) {
-        int flags = package->state();
+    for (int i : changed) {
+        const Package *package = packageAt(i);
+        int flags = delta.value(i);
         std::string fullName = package->packageIterator().FullName();
         // Cannot have any of these flags simultaneously
         int status = flags & (Package::IsManuallyHeld |
@@ -1190,47 +3165,99 @@ QApt::Transaction * Backend::commitChanges()
         }
     }
 
-    QDBusPendingReply<QString> rep = d->worker->commitChanges(packageList);
-    Transaction *trans = new Transaction(rep.value());
-    trans->setFrontendCaps(d->frontendCaps);
-
-    return trans;
+    return packageList;
 }
 
-QApt::Transaction * Backend::installPackages(PackageList packages)
+static QVariantMap packageListWithState(const PackageList &packages, Package::State state)
 {
-    Q_D(Backend);
-
     QVariantMap packageList;
 
     for (const Package *package : packages) {
         std::string fullName = package->packageIterator().FullName();
-        packageList.insert(QString::fromStdString(fullName), Package::ToInstall);
+        packageList.insert(QString::fromStdString(fullName), state);
+    }
+
+    return packageList;
+}
+
+Transaction *BackendPrivate::createTransaction(const QDBusPendingCall &call, bool async) const
+{
+    Transaction *trans = nullptr;
+    QDBusPendingReply<QString> rep = call;
+    if (!async)
+        rep.waitForFinished();
+
+    // A failed call takes the asynchronous path too, which reports the
+    // error through the signals of the transaction
+    if (async || rep.isError() || rep.value().isEmpty())
+        trans = new Transaction(call);
+    else
+        trans = new Transaction(rep.value());
+
+    trans->setFrontendCaps(frontendCaps);
+
+    const FetchPolicy policy = config->fetchPolicy();
+    if (!policy.isDefault()) {
+        trans->setFetchPolicy(policy);
     }
 
-    QDBusPendingReply<QString> rep = d->worker->commitChanges(packageList);
-    Transaction *trans = new Transaction(rep.value());
-    trans->setFrontendCaps(d->frontendCaps);
+    return trans;
+}
+
+QApt::Transaction * Backend::commitChanges()
+{
+    Q_D(Backend);
+    TraceSpan span("commit", "commitChanges");
+
+    Transaction *trans = d->createTransaction(d->worker->commitChanges(changedPackageList()), false);
+    span.setTransactionId(trans->transactionId());
 
     return trans;
 }
 
+QApt::Transaction *Backend::commitChangesAsync()
+{
+    Q_D(Backend);
+    // The transaction ID is not known until the reply arrives
+    TraceSpan span("commit", "commitChangesAsync");
+
+    return d->createTransaction(d->worker->commitChanges(changedPackageList()), true);
+}
+
+QApt::Transaction * Backend::installPackages(PackageList packages)
+{
+    Q_D(Backend);
+
+    QVariantMap packageList = packageListWithState(packages, Package::ToInstall);
+
+    return d->createTransaction(d->worker->commitChanges(packageList), false);
+}
+
+QApt::Transaction *Backend::installPackagesAsync(PackageList packages)
+{
+    Q_D(Backend);
+
+    QVariantMap packageList = packageListWithState(packages, Package::ToInstall);
+
+    return d->createTransaction(d->worker->commitChanges(packageList), true);
+}
+
 QApt::Transaction * Backend::removePackages(PackageList packages)
 {
     Q_D(Backend);
 
-    QVariantMap packageList;
+    QVariantMap packageList = packageListWithState(packages, Package::ToRemove);
 
-    for (const Package *package : packages) {
-        std::string fullName = package->packageIterator().FullName();
-        packageList.insert(QString::fromStdString(fullName), Package::ToRemove);
-    }
+    return d->createTransaction(d->worker->commitChanges(packageList), false);
+}
+
+QApt::Transaction *Backend::removePackagesAsync(PackageList packages)
+{
+    Q_D(Backend);
 
-    QDBusPendingReply<QString> rep = d->worker->commitChanges(packageList);
-    Transaction *trans = new Transaction(rep.value());
-    trans->setFrontendCaps(d->frontendCaps);
+    QVariantMap packageList = packageListWithState(packages, Package::ToRemove);
 
-    return trans;
+    return d->createTransaction(d->worker->commitChanges(packageList), true);
 }
 
 Transaction *Backend::downloadArchives(const QString &listFile, const QString &destination)
@@ -1263,22 +3290,35 @@ Transaction *Backend::downloadArchives(const QString &listFile, const QString &d
     QDir dir(dirName);
     dir.mkdir(QLatin1String("packages"));
 
-    QDBusPendingReply<QString> rep = d->worker->downloadArchives(packages, destination);
-    Transaction *trans = new Transaction(rep.value());
-    trans->setFrontendCaps(d->frontendCaps);
-
-    return trans;
+    return d->createTransaction(d->worker->downloadArchives(packages, destination), false);
 }
 
 Transaction *Backend::installFile(const DebFile &debFile)
 {
     Q_D(Backend);
 
-    QDBusPendingReply<QString> rep = d->worker->installFile(debFile.filePath());
-    Transaction *trans = new Transaction(rep.value());
-    trans->setFrontendCaps(d->frontendCaps);
+    return d->createTransaction(d->worker->installFile(debFile.filePath()), false);
+}
 
-    return trans;
+Transaction *Backend::installFileAsync(const DebFile &debFile)
+{
+    Q_D(Backend);
+
+    return d->createTransaction(d->worker->installFile(debFile.filePath()), true);
+}
+
+Transaction *Backend::installFiles(const QStringList &filePaths)
+{
+    Q_D(Backend);
+
+    return d->createTransaction(d->worker->installFiles(filePaths), false);
+}
+
+Transaction *Backend::installFilesAsync(const QStringList &filePaths)
+{
+    Q_D(Backend);
+
+    return d->createTransaction(d->worker->installFiles(filePaths), true);
 }
 
 void Backend::emitPackageChanged()
@@ -1290,11 +3330,28 @@ Transaction *Backend::updateCache()
 {
     Q_D(Backend);
 
-    QDBusPendingReply<QString> rep = d->worker->updateCache();
-    Transaction *trans = new Transaction(rep.value());
-    trans->setFrontendCaps(d->frontendCaps);
+    return d->createTransaction(d->worker->updateCache(), false);
+}
 
-    return trans;
+Transaction *Backend::updateCacheAsync()
+{
+    Q_D(Backend);
+
+    return d->createTransaction(d->worker->updateCache(), true);
+}
+
+Transaction *Backend::updateCache(const QStringList &sources)
+{
+    Q_D(Backend);
+
+    return d->createTransaction(d->worker->updateSources(sources), false);
+}
+
+Transaction *Backend::updateCacheAsync(const QStringList &sources)
+{
+    Q_D(Backend);
+
+    return d->createTransaction(d->worker->updateSources(sources), true);
 }
 
 Transaction *Backend::upgradeSystem(UpgradeType upgradeType)
@@ -1302,58 +3359,143 @@ Transaction *Backend::upgradeSystem(UpgradeType upgradeType)
     Q_D(Backend);
 
     bool safeUpgrade = (upgradeType == QApt::SafeUpgrade);
-    QDBusPendingReply<QString> rep = d->worker->upgradeSystem(safeUpgrade);
-    Transaction *trans = new Transaction(rep.value());
-    trans->setFrontendCaps(d->frontendCaps);
+    return d->createTransaction(d->worker->upgradeSystem(safeUpgrade), false);
+}
 
-    return trans;
+Transaction *Backend::upgradeSystemAsync(UpgradeType upgradeType)
+{
+    Q_D(Backend);
+
+    bool safeUpgrade = (upgradeType == QApt::SafeUpgrade);
+    return d->createTransaction(d->worker->upgradeSystem(safeUpgrade), true);
+}
+
+void Backend::warmUpWorker()
+{
+    Q_D(Backend);
+
+    // The call activates the worker, nothing to wait for
+    d->worker->keepWarm();
 }
 
 bool Backend::saveInstalledPackagesList(const QString &path) const
 {
     Q_D(const Backend);
 
-    QString selectionDocument;
-    for (int i = 0; i < d->packages.size(); ++i) {
-
-        if (d->packages.at(i)->isInstalled()) {
-            selectionDocument.append(d->packages[i]->name() %
-            QLatin1Literal("\t\tinstall") % QLatin1Char('\n'));
-        }
+    syncStates();
+    if (d->packagesWithStates(Package::Installed).count(true) == 0) {
+        return false;
     }
 
-    if (selectionDocument.isEmpty()) {
+    QFile file(path);
+    if (!file.open(QFile::WriteOnly | QFile::Text)) {
         return false;
     }
 
-    return d->writeSelectionFile(selectionDocument, path);
+    return writeInstalledPackagesList(&file);
+}
+
+bool Backend::writeInstalledPackagesList(QIODevice *device) const
+{
+    Q_D(const Backend);
+
+    syncStates();
+
+    return d->writePackageLines(device, Package::Installed, "\t\tinstall\n");
 }
 
 bool Backend::saveSelections(const QString &path) const
 {
     Q_D(const Backend);
 
-    QString selectionDocument;
-    for (int i = 0; i < d->packages.size(); ++i) {
-        int flags = d->packages.at(i)->state();
+    syncStates();
+    if (d->packagesWithStates(Package::ToInstall | Package::ToRemove).count(true) == 0) {
+        return false;
+    }
+
+    QFile file(path);
+    if (!file.open(QFile::WriteOnly | QFile::Text)) {
+        return false;
+    }
+
+    return writeSelections(&file);
+}
+
+bool Backend::writeSelections(QIODevice *device) const
+{
+    Q_D(const Backend);
+
+    syncStates();
+
+    // A package marked for install takes precedence, like it always did
+    const QBitArray &toInstall = d->packagesWithStates(Package::ToInstall);
+    const QBitArray &toRemove = d->packagesWithStates(Package::ToRemove);
+    pkgCache &cache = d->cache->depCache()->GetCache();
+
+    QByteArray line;
+    line.reserve(256);
+    for (int i = 0; i < toInstall.size(); ++i) {
+        const char *suffix;
+        if (toInstall.testBit(i)) {
+            suffix = "\t\tinstall\n";
+        } else if (toRemove.testBit(i)) {
+            suffix = "\t\tdeinstall\n";
+        } else {
+            continue;
+        }
+
+        pkgCache::PkgIterator iter(cache, cache.PkgP + d->packageIds.at(i));
+        line.resize(0);
+        line.append(iter.Name());
+        line.append(suffix);
 
-        if (flags & Package::ToInstall) {
-            selectionDocument.append(d->packages[i]->name() %
-            QLatin1Literal("\t\tinstall") % QLatin1Char('\n'));
-        } else if (flags & Package::ToRemove) {
-            selectionDocument.append(d->packages[i]->name() %
-            QLatin1Literal("\t\tdeinstall") % QLatin1Char('\n'));
+        if (device->write(line) != line.size()) {
+            return false;
         }
     }
 
-    if (selectionDocument.isEmpty()) {
-        return false;
+    return true;
+}
+
+bool Backend::writeInventory(QIODevice *device) const
+{
+    Q_D(const Backend);
+
+    pkgDepCache *depCache = d->cache->depCache();
+    pkgCache &cache = depCache->GetCache();
+
+    QByteArray line;
+    line.reserve(256);
+    for (pkgCache::PkgIterator iter = cache.PkgBegin(); !iter.end(); ++iter) {
+        const pkgCache::VerIterator &ver = iter.CurrentVer();
+        if (ver.end()) {
+            continue;
+        }
+
+        line.resize(0);
+        line.append(iter.Name());
+        line.append(':');
+        line.append(iter.Arch());
+        line.append('\t');
+        line.append(ver.VerStr());
+        line.append('\t');
+        line.append(((*depCache)[iter].Flags & pkgCache::Flag::Auto) ? 'a' : 'm');
+        line.append('\n');
+
+        if (device->write(line) != line.size()) {
+            return false;
+        }
     }
 
-    return d->writeSelectionFile(selectionDocument, path);
+    return true;
 }
 
 bool Backend::loadSelections(const QString &path)
+{
+    return loadSelections(path, nullptr);
+}
+
+bool Backend::loadSelections(const QString &path, QStringList *unknownPackages)
 {
     Q_D(Backend);
 
@@ -1362,80 +3504,122 @@ bool Backend::loadSelections(const QString &path)
         return false;
     }
 
-    int lineIndex = 0;
-    QByteArray buffer = file.readAll();
+    // Read straight from the page cache where possible
+    QByteArray buffer;
+    const qint64 size = file.size();
+    const char *data = reinterpret_cast<const char *>(file.map(0, size));
+    if (!data) {
+        buffer = file.readAll();
+        data = buffer.constData();
+    }
+    const char *end = data + size;
 
-    QList<QByteArray> lines = buffer.split('\n');
-    QHash<QByteArray, int> actionMap;
+    pkgDepCache &cache = *d->cache->depCache();
 
-    while (lineIndex < lines.size()) {
-        QByteArray line = lines.at(lineIndex);
-        if (line.isEmpty() || line.at(0) == '#') {
-            lineIndex++;
-            continue;
+    // Selections by package ID. Later lines override earlier ones
+    QHash<int, int> actionMap;
+    std::string line;
+    std::string keyString;
+    std::string valueString;
+    int lastPercentage = -1;
+
+    for (const char *pos = data; pos < end;) {
+        const char *lineEnd = static_cast<const char *>(memchr(pos, '\n', end - pos));
+        if (!lineEnd) {
+            lineEnd = end;
         }
 
-        line = line.trimmed();
+        // ParseQuoteWord() needs a terminated string
+        line.assign(pos, lineEnd - pos);
+        pos = lineEnd + 1;
 
-        QByteArray aKey;
-        std::string keyString;
-        const char *data = line.constData();
-        if (ParseQuoteWord(data, keyString) == false)
-            return false;
-        aKey = QByteArray(keyString.c_str());
+        int percentage = (pos - data) * 50 / qMax<qint64>(size, 1);
+        if (percentage != lastPercentage) {
+            lastPercentage = percentage;
+            emit selectionsLoadProgress(qMin(percentage, 50));
+        }
 
-        QByteArray aValue;
-        std::string valueString;
-        if (ParseQuoteWord(data, valueString) == false)
-            return false;
-        aValue = QByteArray(valueString.c_str());
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        const char *word = line.c_str();
+        if (!ParseQuoteWord(word, keyString) || !ParseQuoteWord(word, valueString) ||
+            valueString.empty()) {
+            // Not a selection, but the others may still be fine
+            continue;
+        }
+
+        int action;
+        switch (valueString[0]) {
+        case 'i':
+            action = Package::ToInstall;
+            break;
+        case 'd':
+        case 'u':
+        case 'r':
+            action = Package::ToRemove;
+            break;
+        case 'p':
+            action = Package::ToPurge;
+            break;
+        default:
+            continue;
+        }
 
-        if (aValue.at(0) == 'i') {
-            actionMap[aKey] = Package::ToInstall;
-        } else if ((aValue.at(0) == 'd') || (aValue.at(0) == 'u') || (aValue.at(0) == 'r')) {
-            actionMap[aKey] = Package::ToRemove;
-        } else if (aValue.at(0) == 'p') {
-            actionMap[aKey] = Package::ToPurge;
+        pkgCache::PkgIterator pkgIter = cache.FindPkg(keyString);
+        if (pkgIter.end()) {
+            if (unknownPackages) {
+                unknownPackages->append(QString::fromStdString(keyString));
+            }
+            continue;
         }
 
-        ++lineIndex;
+        actionMap[pkgIter->ID] = action;
     }
 
     if (actionMap.isEmpty()) {
        return false;
     }
 
-    pkgDepCache &cache = *d->cache->depCache();
+    pkgCache &aptCache = cache.GetCache();
     // Should protect whatever is already selected in the cache.
     pkgProblemResolver Fix(&cache);
 
-    pkgCache::PkgIterator pkgIter;
-    auto mapIter = actionMap.constBegin();
-    while (mapIter != actionMap.constEnd()) {
-        pkgIter = d->cache->depCache()->FindPkg(mapIter.key().constData());
-        if (pkgIter.end()) {
-            return false;
-        }
-
-        Fix.Clear(pkgIter);
-        Fix.Protect(pkgIter);
+    {
+        pkgDepCache::ActionGroup group(cache);
+
+        int marked = 0;
+        auto mapIter = actionMap.constBegin();
+        while (mapIter != actionMap.constEnd()) {
+            pkgCache::PkgIterator pkgIter(aptCache, aptCache.PkgP + mapIter.key());
+
+            Fix.Clear(pkgIter);
+            Fix.Protect(pkgIter);
+
+            switch (mapIter.value()) {
+               case Package::ToInstall:
+                   if (pkgIter.CurrentVer().end()) { // Only mark if not already installed
+                      cache.MarkInstall(pkgIter, true);
+                   }
+                   break;
+               case Package::ToRemove:
+                   Fix.Remove(pkgIter);
+                   cache.MarkDelete(pkgIter, false);
+                   break;
+               case Package::ToPurge:
+                   Fix.Remove(pkgIter);
+                   cache.MarkDelete(pkgIter, true);
+                   break;
+            }
+            ++mapIter;
 
-        switch (mapIter.value()) {
-           case Package::ToInstall:
-               if (pkgIter.CurrentVer().end()) { // Only mark if not already installed
-                  cache.MarkInstall(pkgIter, true);
-               }
-               break;
-           case Package::ToRemove:
-               Fix.Remove(pkgIter);
-               cache.MarkDelete(pkgIter, false);
-               break;
-           case Package::ToPurge:
-               Fix.Remove(pkgIter);
-               cache.MarkDelete(pkgIter, true);
-               break;
+            int percentage = 50 + ++marked * 50 / actionMap.size();
+            if (percentage != lastPercentage) {
+                lastPercentage = percentage;
+                emit selectionsLoadProgress(percentage);
+            }
         }
-        ++mapIter;
     }
 
     Fix.Resolve(true);
@@ -1446,54 +3630,85 @@ bool Backend::loadSelections(const QString &path)
 }
 
 bool Backend::saveDownloadList(const QString &path) const
+{
+    QFile file(path);
+    if (!file.open(QFile::WriteOnly | QFile::Text)) {
+        return false;
+    }
+
+    return writeDownloadList(&file);
+}
+
+bool Backend::writeDownloadList(QIODevice *device) const
 {
     Q_D(const Backend);
 
-    QString downloadDocument;
-    downloadDocument.append(QLatin1String("[Download List]") % QLatin1Char('\n'));
-    for (int i = 0; i < d->packages.size(); ++i) {
-        int flags = d->packages.at(i)->state();
+    syncStates();
 
-        if (flags & Package::ToInstall) {
-            downloadDocument.append(d->packages[i]->name() % QLatin1Char('\n'));
-        }
+    const QByteArray header("[Download List]\n");
+    if (device->write(header) != header.size()) {
+        return false;
     }
 
-    return d->writeSelectionFile(downloadDocument, path);
+    return d->writePackageLines(device, Package::ToInstall, "\n");
 }
 
 bool Backend::setPackagePinned(Package *package, bool pin)
+{
+    QHash<Package *, bool> pins;
+    pins.insert(package, pin);
+
+    return setPackagesPinned(pins);
+}
+
+bool Backend::setPackagesPinned(const QHash<Package *, bool> &pins)
 {
     Q_D(Backend);
 
     QString dir = d->config->findDirectory("Dir::Etc") % QLatin1String("preferences.d/");
-    QString path = dir % package->name();
-    QString pinDocument;
 
-    if (pin) {
+    // New contents of every preference file that changes, and the ones
+    // that are left without any stanza
+    QVariantMap files;
+    QStringList removedFiles;
+    QSet<QString> unpinned;
+
+    for (auto iter = pins.constBegin(); iter != pins.constEnd(); ++iter) {
+        Package *package = iter.key();
+
+        if (!iter.value()) {
+            unpinned << package->name();
+            continue;
+        }
+
         if (package->state() & Package::IsPinned) {
-            return true;
+            continue;
         }
 
-        pinDocument = QLatin1Literal("Package: ") % package->name()
-                      % QLatin1Char('\n');
+        QString pinDocument = QLatin1Literal("Package: ") % package->name()
+                              % QLatin1Char('\n');
 
-        if (package->installedVersion().isEmpty()) {
+        const QLatin1String installedVersion = package->installedVersionView();
+        if (!installedVersion.size()) {
             pinDocument += QLatin1String("Pin: version  0.0\n");
         } else {
-            pinDocument += QLatin1Literal("Pin: version ") % package->installedVersion()
+            pinDocument += QLatin1Literal("Pin: version ") % installedVersion
                            % QLatin1Char('\n');
         }
 
         // Make configurable?
         pinDocument += QLatin1String("Pin-Priority: 1001\n\n");
-    } else {
+
+        files.insert(dir % package->name(), pinDocument);
+    }
+
+    if (!unpinned.isEmpty()) {
         QDir logDirectory(dir);
         QStringList pinFiles = logDirectory.entryList(QDir::Files, QDir::Name);
         pinFiles << QString::fromStdString(_config->FindDir("Dir::Etc")) %
                     QLatin1String("preferences");
 
-        // Search all pin files, delete package stanza from file
+        // Search all pin files, drop the stanzas of the unpinned packages
         for (const QString &pinName : pinFiles) {
             QString pinPath;
             if (!pinName.startsWith(QLatin1Char('/'))) {
@@ -1502,73 +3717,86 @@ bool Backend::setPackagePinned(Package *package, bool pin)
                 pinPath = pinName;
             }
 
-            if (!QFile::exists(pinPath))
+            // A file we are about to write for a package that gets pinned
+            if (files.contains(pinPath)) {
                 continue;
-
-            // Open to get a file name
-            QTemporaryFile tempFile;
-            if (!tempFile.open()) {
-                return false;
-            }
-            tempFile.close();
-
-            QString tempFileName = tempFile.fileName();
-            FILE *out = fopen(tempFileName.toUtf8(), "w");
-            if (!out) {
-                return false;
             }
 
-            FileFd Fd(pinPath.toUtf8().data(), FileFd::ReadOnly);
-
-            pkgTagFile tagFile(&Fd);
-            if (_error->PendingError()) {
-                fclose(out);
-                return false;
+            QFile pinFile(pinPath);
+            if (!pinFile.open(QFile::ReadOnly | QFile::Text)) {
+                continue;
             }
 
-            pkgTagSection tags;
-            while (tagFile.Step(tags)) {
-                QString name = QLatin1String(tags.FindS("Package").c_str());
+            const QList<QByteArray> lines = pinFile.readAll().split('\n');
+            QByteArray pinDocument;
+            QByteArray stanza;
+            bool dropStanza = false;
+            bool changed = false;
+
+            for (int i = 0; i <= lines.size(); ++i) {
+                const QByteArray line = (i < lines.size()) ? lines.at(i).trimmed() : QByteArray();
+
+                if (!line.isEmpty()) {
+                    if (line.startsWith("Package:")) {
+                        QString name = QString::fromLatin1(line.mid(8).trimmed());
+                        dropStanza = unpinned.contains(name);
+                    }
+                    stanza += lines.at(i) + '\n';
+                    continue;
+                }
 
-                if (name.isEmpty()) {
-                    return false;
+                // End of a stanza. Include all but the matching ones in the
+                // new pin file
+                if (stanza.isEmpty()) {
+                    continue;
                 }
 
-                // Include all but the matching name in the new pinfile
-                if (name != package->name()) {
-                    TFRewriteData tfrd;
-                    tfrd.Tag = 0;
-                    tfrd.Rewrite = 0;
-                    tfrd.NewTag = 0;
-                    TFRewrite(out, tags, TFRewritePackageOrder, &tfrd);
-                    fprintf(out, "\n");
+                if (dropStanza) {
+                    changed = true;
+                } else {
+                    pinDocument += stanza + '\n';
                 }
+
+                stanza.clear();
+                dropStanza = false;
             }
-            fclose(out);
 
-            if (!tempFile.open()) {
-                return false;
+            if (!changed) {
+                continue;
             }
 
-            pinDocument = tempFile.readAll();
+            if (pinDocument.isEmpty()) {
+                removedFiles << pinPath;
+            } else {
+                files.insert(pinPath, QString::fromLatin1(pinDocument));
+            }
         }
     }
 
-    if (!d->worker->writeFileToDisk(pinDocument, path)) {
-        return false;
+    if (files.isEmpty() && removedFiles.isEmpty()) {
+        return true;
     }
 
-    return true;
+    return d->worker->writeFilesToDisk(files, removedFiles);
 }
 
 void Backend::updateXapianIndex()
 {
+    Q_D(Backend);
+
+    // The running update picks up everything that changed until it is done
+    if (d->xapianUpdating) {
+        return;
+    }
+    d->xapianUpdating = true;
+
     QDBusMessage m = QDBusMessage::createMethodCall(QLatin1String("org.debian.AptXapianIndex"),
                                                     QLatin1String("/"),
                                                     QLatin1String("org.debian.AptXapianIndex"),
                                                     QLatin1String("update_async"));
     QVariantList dbusArgs;
 
+    // update_only has the indexer only reindex the packages that changed
     dbusArgs << /*force*/ true << /*update_only*/ true;
     m.setArguments(dbusArgs);
     QDBusConnection::systemBus().send(m);
@@ -1586,8 +3814,19 @@ void Backend::updateXapianIndex()
     emit xapianUpdateStarted();
 }
 
+bool Backend::isXapianIndexUpdating() const
+{
+    Q_D(const Backend);
+
+    return d->xapianUpdating;
+}
+
 void Backend::emitXapianUpdateFinished()
 {
+    Q_D(Backend);
+
+    d->xapianUpdating = false;
+
     QDBusConnection::systemBus().disconnect(QLatin1String("org.debian.AptXapianIndex"),
                                             QLatin1String("/"),
                                             QLatin1String("org.debian.AptXapianIndex"),
@@ -1597,12 +3836,12 @@ void Backend::emitXapianUpdateFinished()
                                             QLatin1String("/"),
                                             QLatin1String("org.debian.AptXapianIndex"),
                                             QLatin1String("UpdateFinished"),
-                                            this, SLOT(xapianUpdateFinished(bool)));
+                                            this, SLOT(emitXapianUpdateFinished()));
     openXapianIndex();
     emit xapianUpdateFinished();
 }
 
-bool Backend::addArchiveToCache(const DebFile &archive)
+QString Backend::cacheableArchiveMd5(const DebFile &archive)
 {
     Q_D(Backend);
 
@@ -1611,7 +3850,7 @@ bool Backend::addArchiveToCache(const DebFile &archive)
     if (!pkg) {
         // The package is not in the cache, so we can't do anything
         // with this .deb
-        return false;
+        return QString();
     }
 
     QString arch = archive.architecture();
@@ -1619,7 +3858,7 @@ bool Backend::addArchiveToCache(const DebFile &archive)
     if (arch != QLatin1String("all") &&
         arch != d->config->readEntry(QLatin1String("APT::Architecture"), QString())) {
         // Incompatible architecture
-        return false;
+        return QString();
     }
 
     QString debVersion = archive.version();
@@ -1627,16 +3866,39 @@ bool Backend::addArchiveToCache(const DebFile &archive)
 
     if (debVersion != candVersion) {
         // Incompatible version
-        return false;
+        return QString();
     }
 
-    if (archive.md5Sum() != pkg->md5Sum()) {
-        // Not the same as the candidate
-        return false;
+    // Whether the archive is the same as the candidate is checked by the
+    // worker while it stores it, saving a pass over the file here
+    return pkg->md5Sum();
+}
+
+bool Backend::addArchiveToCache(const DebFile &archive)
+{
+    return addArchivesToCache(QStringList(archive.filePath())).size() == 1;
+}
+
+QStringList Backend::addArchivesToCache(const QStringList &archivePaths)
+{
+    Q_D(Backend);
+
+    QVariantMap archives;
+    for (const QString &path : archivePaths) {
+        DebFile archive(path);
+        if (!archive.isValid())
+            continue;
+
+        QString md5 = cacheableArchiveMd5(archive);
+        if (!md5.isEmpty())
+            archives.insert(path, md5);
     }
 
-    // Add the package, but we'll need auth so the worker'll do it
-    return d->worker->copyArchiveToCache(archive.filePath());
+    if (archives.isEmpty())
+        return QStringList();
+
+    // Add the packages, but we'll need auth so the worker'll do it
+    return d->worker->copyArchivesToCache(archives);
 }
 
 void Backend::setFrontendCaps(FrontendCaps caps)
@@ -22,12 +22,18 @@
 #define QAPT_BACKEND_H
 
 #include <QHash>
+#include <QSet>
 #include <QStringList>
 #include <QVariantMap>
+#include <QVector>
 
 #include "globals.h"
+#include "markingerrorinfo.h"
 #include "package.h"
 
+class QIODevice;
+class QMutex;
+class QReadWriteLock;
 class pkgSourceList;
 class pkgRecords;
 
@@ -36,6 +42,9 @@ namespace QApt {
     class Config;
     class DebFile;
     class Transaction;
+#ifdef __CURRENTLY_UNIT_TESTING__
+    class BackendTest;
+#endif
 }
 
 /**
@@ -46,6 +55,172 @@ namespace QApt {
 
 class BackendPrivate;
 
+/**
+ * The outcome of a marking evaluated by Backend::simulateMarking()
+ *
+ * @since 3.1
+ */
+struct MarkingSimulation
+{
+    MarkingSimulation() : downloadSize(0), installSize(0), brokenCount(0) {}
+
+    /// The amount of data to download, including archives that are cached
+    qint64 downloadSize;
+    /// The disk space that would be consumed, or freed if negative
+    qint64 installSize;
+    /// The number of packages that would be broken
+    int brokenCount;
+    /// The packages whose marking would differ from the current one
+    PackageList changedPackages;
+};
+
+/**
+ * The outcome of resolving many package names with Backend::packages()
+ *
+ * @since 3.1
+ */
+struct PackageLookup
+{
+    /// The packages that were found, in the order of the names
+    PackageList packages;
+    /// The names no package was found for, in the order of the names
+    QStringList unknownNames;
+};
+
+/**
+ * One dpkg operation of a CommitPlan
+ *
+ * @since 3.1
+ */
+struct CommitStep
+{
+    enum Action {
+        Unpack,
+        Configure,
+        Remove,
+        Purge
+    };
+
+    Action action;
+    Package *package;
+};
+
+/**
+ * What committing the current marking would do, as planned by
+ * Backend::commitPlan() without downloading anything or running dpkg
+ *
+ * @since 3.1
+ */
+struct CommitPlan
+{
+    CommitPlan() : valid(false), downloadSize(0), installSize(0), triggerCount(0) {}
+
+    /// Whether the operations could be ordered. If not, only the sizes are set
+    bool valid;
+    /// The dpkg operations, in the order they would be run
+    QList<CommitStep> steps;
+    /// The bytes that still have to be downloaded, by host name
+    QHash<QString, qint64> downloadSizePerHost;
+    /// The bytes that still have to be downloaded in total
+    qint64 downloadSize;
+    /// The disk space that would be consumed, or freed if negative
+    qint64 installSize;
+    /// The number of upgraded or removed packages that declare dpkg
+    /// triggers, an estimate of how many trigger runs the commit causes
+    int triggerCount;
+};
+
+/**
+ * Why packages are broken, as diagnosed by Backend::brokenReasons()
+ *
+ * The diagnosis is a graph of broken packages and causes. Each distinct
+ * cause is listed once, however many packages it breaks. A cause whose
+ * target package is broken itself links to that package, so chains of
+ * breakage can be followed down to the root causes.
+ *
+ * @since 3.1
+ */
+struct BrokenDiagnosis
+{
+    /// The broken packages
+    PackageList packages;
+    /// Each distinct cause, as Package::brokenReason() would report it
+    QList<MarkingErrorInfo> causes;
+    /// For each entry of @c packages, the indexes of its causes
+    QList<QVector<int> > packageCauses;
+    /// For each entry of @c causes, the index of the broken package it is
+    /// about, or -1 if its target is not broken itself
+    QVector<int> causePackages;
+
+    /// The indexes of the causes that are not explained by other breakage
+    QVector<int> rootCauses() const
+    {
+        QVector<int> roots;
+        for (int i = 0; i < causePackages.size(); ++i) {
+            if (causePackages.at(i) == -1)
+                roots.append(i);
+        }
+        return roots;
+    }
+};
+
+/**
+ * The memory used by one part of the backend, see Backend::memoryStatistics()
+ *
+ * @since 3.1
+ */
+struct MemoryUsage
+{
+    MemoryUsage() : bytes(0), count(0) {}
+
+    /// The approximate number of bytes in use
+    qint64 bytes;
+    /// The number of objects or entries those bytes are spent on
+    qint64 count;
+};
+
+/**
+ * A breakdown of the memory held by a Backend, as returned by
+ * Backend::memoryStatistics(). The sizes of Qt containers are estimated
+ * from their capacity, so they are approximate but stable.
+ *
+ * @since 3.1
+ */
+struct MemoryStatistics
+{
+    /// The Package objects that have been created so far
+    MemoryUsage packages;
+    /// The index from package IDs to package slots
+    MemoryUsage packagesIndex;
+    /// The set of group names
+    MemoryUsage groups;
+    /// The origin to label map
+    MemoryUsage origins;
+    /// The origin to site map
+    MemoryUsage sites;
+    /// The undo and redo stacks, counted in steps
+    MemoryUsage undoRedo;
+    /// The tracking of package states the state queries use
+    MemoryUsage states;
+    /// Long descriptions and dependency fields cached by the packages
+    MemoryUsage recordCaches;
+    /// The fallback text index and the memoized dependency closures
+    MemoryUsage searchCaches;
+    /// The installed file index, while it is mapped
+    MemoryUsage fileOwnerIndex;
+    /// The Xapian database. Xapian does not report its memory, so only
+    /// the number of indexed documents is known
+    MemoryUsage xapian;
+
+    /// The sum of all bytes above
+    qint64 totalBytes() const
+    {
+        return packages.bytes + packagesIndex.bytes + groups.bytes + origins.bytes +
+               sites.bytes + undoRedo.bytes + states.bytes + recordCaches.bytes +
+               searchCaches.bytes + fileOwnerIndex.bytes + xapian.bytes;
+    }
+};
+
 /**
  * @brief The main entry point for performing operations with the dpkg database
  *
@@ -154,6 +329,14 @@ public:
      */
     bool reloadCache();
 
+    /**
+     * Returns whether a background cache reload started with
+     * reloadCacheAsync() is currently underway.
+     *
+     * @since 3.1
+     */
+    bool isReloadingCache() const;
+
     /**
      * Takes a snapshot of the current state of the package cache. (E.g.
      * which packages are marked for removal, install, etc)
@@ -162,6 +345,17 @@ public:
      */
     CacheState currentCacheState() const;
 
+    /**
+     * Takes a snapshot of the current state of the package cache, like
+     * currentCacheState(). This is constant-time, and comparing snapshots
+     * with stateChanges() or restoreCacheState() skips unchanged packages
+     * in bulk, so it should be preferred for large caches.
+     *
+     * \return The current state of the cache as a @c CacheSnapshot
+     * @since 3.1
+     */
+    CacheSnapshot currentCacheSnapshot() const;
+
    /**
      * Gets changes made to the cache since the given cache state.
      *
@@ -175,6 +369,36 @@ public:
     QHash<Package::State, PackageList> stateChanges(const CacheState &oldState,
                                                     const PackageList &excluded) const;
 
+   /**
+     * Gets changes made to the cache since the given cache state.
+     *
+     * This overload takes the packages to exclude as a set, so that
+     * excluding many packages does not make the check slower. Only the
+     * packages whose state differs from @p oldState are visited.
+     *
+     * @param oldState The CacheState to compare against
+     * @param excluded Set of packages to exlude from the check
+     *
+     * @return A QHash containing lists of changed packages for each
+     *         Package::State change flag.
+     * @since 3.1
+     */
+    QHash<Package::State, PackageList> stateChanges(const CacheState &oldState,
+                                                    const QSet<const Package *> &excluded) const;
+
+   /**
+     * Gets changes made to the cache since the given snapshot.
+     *
+     * @param oldState The CacheSnapshot to compare against
+     * @param excluded Set of packages to exlude from the check
+     *
+     * @return A QHash containing lists of changed packages for each
+     *         Package::State change flag.
+     * @since 3.1
+     */
+    QHash<Package::State, PackageList> stateChanges(const CacheSnapshot &oldState,
+                                                    const QSet<const Package *> &excluded) const;
+
     /**
      * Pointer to the QApt Backend's config object.
      *
@@ -199,10 +423,148 @@ public:
     /** Overload for package(const QString &name) **/
     Package *package(QLatin1String name) const;
 
+    /**
+     * Looks up the packages for many names at once, like package() does
+     * for each of them, but converting every name only once and reusing the
+     * lookup buffers.
+     *
+     * @param names The names of the packages, optionally with an
+     *              architecture qualifier such as "foo:i386"
+     *
+     * @return The packages that were found and the names that were not
+     *
+     * @since 3.1
+     */
+    PackageLookup packages(const QStringList &names) const;
+
+    /** Overload for packages(const QStringList &names) for Latin-1 names **/
+    PackageLookup packages(const QList<QByteArray> &names) const;
+
+    /**
+     * Queries the backend for the Package object with the given identifier.
+     *
+     * @param id The identifier of the package, as returned by Package::id()
+     *
+     * @return A pointer to the @c Package, or a null pointer if there is no
+     *         such package
+     *
+     * @see Package::dependencyEdges()
+     * @since 3.1
+     */
+    Package *packageById(int id) const;
+
+    /**
+     * Returns every package that installing the candidate version of
+     * @p package would pull in, following the Depends and Pre-Depends of
+     * candidate versions. Of alternatives only the first one that exists is
+     * followed, and a virtual package is satisfied by its first provider.
+     * Packages that are already installed are included.
+     *
+     * The package cache is only read, not marked. Results are remembered
+     * until the marking of a package or the cache changes.
+     *
+     * @param package The package to start from, which is not part of the result
+     *
+     * @return The transitive dependencies of @p package
+     *
+     * @see reverseDependencyClosure()
+     * @since 3.1
+     */
+    PackageList dependencyClosure(const Package *package) const;
+
+    /**
+     * Returns every installed package that would break if @p package was
+     * removed. These are the packages whose installed version Depends or
+     * Pre-Depends on it or on a virtual package it provides, without any
+     * other installed package satisfying the dependency, and recursively
+     * the packages that would break by their removal.
+     *
+     * The package cache is only read, not marked. Results are remembered
+     * until the marking of a package or the cache changes.
+     *
+     * @param package The package to start from, which is not part of the result
+     *
+     * @return The transitive installed reverse dependencies of @p package
+     *
+     * @see dependencyClosure()
+     * @since 3.1
+     */
+    PackageList reverseDependencyClosure(const Package *package) const;
+
+    /**
+     * Evaluates what marking @p packages with @p action would do, on top of
+     * the current marking, like markPackages() would. The simulation runs on
+     * a scratch copy of the dependency cache, so the marking of the backend
+     * stays untouched and no signals are emitted. Several alternative
+     * markings can be compared by simulating each of them.
+     *
+     * @param packages The list of packages to be marked
+     * @param action The action to perform on the list of packages
+     *
+     * @return The sizes and changed packages the marking would result in
+     *
+     * @see markPackages()
+     * @since 3.1
+     */
+    MarkingSimulation simulateMarking(const QApt::PackageList &packages, QApt::Package::State action) const;
+
+    /**
+     * Returns how much memory the backend holds, broken down by what it is
+     * used for. Cheap enough to be polled, e.g. to confirm that nothing
+     * grows across cache reloads.
+     *
+     * @since 3.1
+     */
+    MemoryStatistics memoryStatistics() const;
+
+    /**
+     * Diagnoses all broken packages at once. This is much faster than
+     * calling Package::brokenReason() for each broken package, and shared
+     * causes are only reported once.
+     *
+     * @return The broken packages and their causes, see BrokenDiagnosis
+     * @since 3.1
+     */
+    BrokenDiagnosis brokenReasons() const;
+
+    /**
+     * Plans what committing the current marking would do: the order of the
+     * dpkg operations, how much would be downloaded from which host and
+     * how the disk usage would change. Nothing is downloaded and dpkg is
+     * not run, so this needs no privileges. The plan is cached until the
+     * marking changes.
+     *
+     * @since 3.1
+     */
+    CommitPlan commitPlan() const;
+
+    /**
+     * Returns the lock that allows reading from the cache concurrently.
+     *
+     * The backend and its packages belong to the thread that created the
+     * backend. Anything that changes the cache, such as marking packages,
+     * undo(), redo(), restoreCacheState() or reloading the cache, must
+     * happen in that thread, and holds this lock for writing while it does.
+     *
+     * Other threads may call the const methods of Backend and Package, for
+     * example to populate a model or to search, as long as they hold this
+     * lock for reading, e.g. with a QReadLocker. Several threads can read
+     * at the same time: each gets its own package records, and lazily
+     * computed data is guarded internally. Reads from the backend's own
+     * thread do not need the lock.
+     *
+     * @since 3.1
+     */
+    QReadWriteLock *cacheLock() const;
+
     /**
      * Queries the backend for a Package object that installs the specified
      * file.
      *
+     * The lookup uses an index of the files of all installed packages, which
+     * is built on first use and kept in the user's cache directory until
+     * dpkg's database changes.
+     *
      * @b _WARNING_ :
      * Note that if a package with a given name cannot be found, a null pointer
      * will be returned. Also, please note that certain actions like reloading
@@ -251,6 +613,17 @@ public:
      */
     QStringList originsForHost(const QString& host) const;
 
+    /**
+     * Returns the packages whose candidate version comes from @p origin.
+     * The packages are looked up in an index built while loading the cache,
+     * so this does not walk the whole cache.
+     *
+     * @param origin The machine-readable origin, see origins()
+     *
+     * @since 3.1
+     */
+    PackageList packagesFromOrigin(const QString &origin) const;
+
     /**
      * Queries the backend for the total number of packages in the APT
      * database, discarding no-longer-existing packages that linger on in the
@@ -320,7 +693,12 @@ public:
      * Returns the total amount of data that will be downloaded if the user
      * commits changes. Cached packages will not show up in this count.
      *
+     * The result is remembered until the marking of packages changes, so
+     * calling this repeatedly is cheap.
+     *
      * @return The total amount that will be downloaded in bytes.
+     *
+     * @see requestDownloadSize()
      */
     qint64 downloadSize() const;
 
@@ -348,6 +726,20 @@ public:
      */
     PackageList upgradeablePackages() const;
 
+    /**
+     * Returns a list of all upgradeable packages whose upgrade is not held
+     * back by update phasing. This is the same as filtering
+     * upgradeablePackages() through Package::isInUpdatePhase(), but
+     * evaluates all packages in a single pass over the package records.
+     *
+     * The results are kept until the next cache reload.
+     *
+     * @return A @c PackageList of all upgradeable packages in their update phase
+     *
+     * @since 3.1
+     */
+    PackageList upgradeablePackagesInUpdatePhase() const;
+
     /**
      * Returns a list of all packages that have been marked for change. (To be
      * installed, removed, etc)
@@ -364,6 +756,9 @@ public:
      * may be cut.
      *
      * You @e must call the openXapianIndex() function before search will work
+     * with the Xapian index. Without it, a simple index of package names and
+     * short descriptions is built on first use, which requires every word
+     * of the search string to appear in either of them.
      *
      * In the future, a "slow" search that searches by exact matches for
      * certain parameters will be implemented.
@@ -376,6 +771,23 @@ public:
      */
     PackageList search(const QString &searchString) const;
 
+    /**
+     * Overload of search() that only returns a page of the results.
+     *
+     * The parsed query is kept around, so that fetching the following pages
+     * of the same search string is cheaper than the first one.
+     *
+     * @param searchString The string to narrow the search by.
+     * @param offset The number of matches to skip
+     * @param limit The maximum number of matches to return, or -1 for all
+     *
+     * \return A @c PackageList of the matching packages in the given range.
+     *
+     * @see searchAsync()
+     * @since 3.1
+     */
+    PackageList search(const QString &searchString, int offset, int limit) const;
+
     /**
      * Returns a list of all available groups
      *
@@ -393,11 +805,23 @@ public:
    /**
     * Attempts to open the APT Xapian index, needed for searching
     *
+    * If the index is open already, it moves on to the latest revision in
+    * place, unless the index has been rebuilt from scratch.
+    *
     * \returns true if opening was successful
     * \returns false otherwise
     */
     bool openXapianIndex();
 
+    /**
+     * Returns whether an update of the search index started by
+     * updateXapianIndex() is running. Searches keep using the previous
+     * revision of the index meanwhile.
+     *
+     * @since 3.1
+     */
+    bool isXapianIndexUpdating() const;
+
    /**
      * Returns whether there are packages with marked changes waiting to be
      * committed
@@ -427,6 +851,26 @@ public:
      */
     QApt::FrontendCaps frontendCaps() const;
 
+    /**
+     * Reads the given control fields of the candidate versions of many
+     * packages at once. This is much faster than calling
+     * Package::controlField() for each package and field, since the records
+     * are visited in the order they are stored on disk, and each record is
+     * only looked up once for all of the fields.
+     *
+     * @param packages The packages to read the fields of
+     * @param fieldNames The names of the control fields to read, e.g.
+     *                   "Maintainer" or "Homepage"
+     *
+     * @return A list with one entry per package, in the order of
+     *         @p packages, holding the values of the fields in the order of
+     *         @p fieldNames. Packages without a candidate version get empty
+     *         values.
+     *
+     * @since 3.1
+     */
+    QList<QStringList> recordFields(const PackageList &packages, const QStringList &fieldNames) const;
+
 protected:
     BackendPrivate *const d_ptr;
 
@@ -448,7 +892,8 @@ protected:
 
     /**
      * Returns a pointer to the internal package records object. Mainly used
-     * for internal purposes in QApt::Package
+     * for internal purposes in QApt::Package. Threads other than the one of
+     * the backend get records of their own, see cacheLock().
      *
      * @return the package records object used by the backend
      * @since 1.4
@@ -459,12 +904,29 @@ private:
     Q_DECLARE_PRIVATE(Backend)
     friend class Package;
     friend class PackagePrivate;
+    friend class ChangelogFetcher;
+#ifdef __CURRENTLY_UNIT_TESTING__
+    friend class BackendTest;
+#endif
 
     Package *package(pkgCache::PkgIterator &iter) const;
+    Package *packageAt(int index) const;
+    void materializePackages() const;
+    void syncStates() const;
+    void touchPackage(const Package *package);
+    QMutex *memoMutex() const;
+    QHash<int, int> currentStateDelta() const;
+    QVariantMap changedPackageList() const;
+    QString cacheableArchiveMd5(const DebFile &archive);
+    void restoreStateDelta(const QHash<int, int> &delta);
+    PackageList textSearch(const QString &searchString, int offset, int limit) const;
 
     void setInitError();
     void loadPackagePins();
     void loadReleaseDate();
+    void completeCacheReload();
+    QVector<QByteArray> packageKeys() const;
+    bool reusePackages(const QVector<int> &packageIds, const QVector<QByteArray> &keys);
 
 Q_SIGNALS:
     /**
@@ -496,6 +958,66 @@ Q_SIGNALS:
      */
     void cacheReloadFinished();
 
+    /**
+     * Emits the progress of a background cache reload.
+     *
+     * @param percentage The progress percentage of the reload
+     *
+     * @see reloadCacheAsync()
+     * @since 3.1
+     */
+    void cacheReloadProgress(int percentage);
+
+    /**
+     * Emits the progress of loadSelections()
+     *
+     * @param percentage The progress percentage of reading and applying the
+     *        selections
+     *
+     * @since 3.1
+     */
+    void selectionsLoadProgress(int percentage);
+
+    /**
+     * Emitted when a background cache reload could not open the cache. The
+     * previously loaded cache stays valid, and initErrorMessage() describes
+     * what went wrong.
+     *
+     * @see reloadCacheAsync()
+     * @since 3.1
+     */
+    void cacheReloadFailed();
+
+    /**
+     * Emitted with the result of requestDownloadSize().
+     *
+     * @param size The total amount that will be downloaded in bytes
+     *
+     * @since 3.1
+     */
+    void downloadSizeCalculated(qint64 size);
+
+    /**
+     * Emitted when a background search started by searchAsync() has found
+     * another batch of matches, in order of relevancy.
+     *
+     * @param searchString The search string the matches are for
+     * @param results The newly-found packages
+     *
+     * @since 3.1
+     */
+    void searchResultsAvailable(const QString &searchString, const QApt::PackageList &results);
+
+    /**
+     * Emitted when a background search started by searchAsync() has
+     * delivered all of its matches.
+     *
+     * @param searchString The search string that was searched for
+     *
+     * @since 3.1
+     */
+    void searchFinished(const QString &searchString);
+
     /**
      * This signal is emitted when a Xapian search cache update is started.
      *
@@ -529,6 +1051,47 @@ Q_SIGNALS:
     void transactionQueueChanged(QString active, QStringList queue);
 
 public Q_SLOTS:
+    /**
+     * Repopulates the internal package cache like reloadCache(), but opens
+     * the cache and builds the package tables in a background thread, so
+     * that the calling thread is not blocked.
+     *
+     * Progress is reported with the cacheReloadProgress() signal. The
+     * current cache stays usable until the new one is ready, at which point
+     * cacheReloadStarted() and cacheReloadFinished() are emitted in direct
+     * succession. If the cache cannot be opened, cacheReloadFailed() is
+     * emitted instead.
+     *
+     * @since 3.1
+     */
+    void reloadCacheAsync();
+
+    /**
+     * Requests that the download size be calculated once control returns to
+     * the event loop. The result is emitted by downloadSizeCalculated().
+     *
+     * Several requests made in a row, e.g. one per marked package, only
+     * result in a single calculation.
+     *
+     * @since 3.1
+     */
+    void requestDownloadSize();
+
+    /**
+     * Searches for packages like search() does, but in a background thread.
+     * Matches are delivered in batches by searchResultsAvailable(), so that
+     * the first ones can be shown while the search goes on, followed by
+     * searchFinished().
+     *
+     * Starting another search abandons the previous one, which makes this
+     * suitable for searching as the user types.
+     *
+     * @param searchString The string to narrow the search by.
+     *
+     * @since 3.1
+     */
+    void searchAsync(const QString &searchString);
+
    /**
     * Sets the maximum size of the undo and redo stacks.
     * The default size is 20.
@@ -551,6 +1114,15 @@ public Q_SLOTS:
      */
     void restoreCacheState(const CacheState &state);
 
+    /**
+     * Restores the package cache to the given snapshot. Only the packages
+     * whose state differs from @p state are touched.
+     *
+     * @param state The snapshot to restore the cache to
+     * @since 3.1
+     */
+    void restoreCacheState(const CacheSnapshot &state);
+
     /**
      * Un-performs the last action performed to the package cache
      */
@@ -610,6 +1182,27 @@ public Q_SLOTS:
      */
     void markPackages(const QApt::PackageList &packages, QApt::Package::State action);
 
+    /**
+     * Marks multiple packages at once like markPackages(), but with a
+     * single dependency resolution for all of them at the end instead of
+     * one per package. This is much faster for long lists, e.g. manifests,
+     * though the resulting marking can differ from markPackages() where
+     * resolving one package at a time would have picked other solutions.
+     *
+     * packageChanged() is emitted once, after the packages are resolved.
+     *
+     * @param packages The list of packages to be marked
+     * @param action The action to perform on the list of packages
+     *
+     * @return The packages whose state changed, including the ones marked
+     *         to satisfy dependencies, for each Package::State change flag
+     *         as stateChanges() reports them
+     *
+     * @since 3.1
+     */
+    QHash<Package::State, PackageList> markPackagesBatch(const QApt::PackageList &packages,
+                                                         QApt::Package::State action);
+
     /**
      * Manual control for enabling/disabling event compression. Useful for when
      * an application needs to have its own multiple marking loop, but still wants
@@ -627,6 +1220,18 @@ public Q_SLOTS:
      */
     QApt::Transaction *commitChanges();
 
+    /**
+     * Asynchronous version of commitChanges(). Instead of waiting for the
+     * worker, this returns a transaction that emits Transaction::ready() once
+     * the worker created it. The transaction can be set up and run right
+     * away, the calls are forwarded once it is ready.
+     *
+     * @return A pointer to a @c Transaction object tracking the commit
+     *
+     * @since 3.1
+     */
+    QApt::Transaction *commitChangesAsync();
+
     /**
      * Starts a transaction which will install the list of provided packages.
      * This function is useful when you only need a few packages installed and
@@ -642,6 +1247,14 @@ public Q_SLOTS:
      */
     QApt::Transaction *installPackages(QApt::PackageList packages);
 
+    /**
+     * Asynchronous version of installPackages().
+     *
+     * @see commitChangesAsync
+     * @since 3.1
+     */
+    QApt::Transaction *installPackagesAsync(QApt::PackageList packages);
+
     /**
      * Starts a transaction which will remove the list of provided packages.
      * This function is useful when you only need a few packages removed and
@@ -657,10 +1270,23 @@ public Q_SLOTS:
      */
     QApt::Transaction *removePackages(QApt::PackageList packages);
 
+    /**
+     * Asynchronous version of removePackages().
+     *
+     * @see commitChangesAsync
+     * @since 3.1
+     */
+    QApt::Transaction *removePackagesAsync(QApt::PackageList packages);
+
    /**
     * Downloads the packages listed in the provided list file to the provided
     * destination directory.
     *
+    * Archives already in the destination are kept if their hashes match, and
+    * partial ones are resumed. Missing archives that are in the archive cache
+    * or one of the directories listed in QApt::Download-Archives::Pools are
+    * hard linked, reflinked or copied from there instead of being fetched.
+    *
     * If the list file provided cannot be opened, a null pointer will be returned.
     *
     * @return A pointer to a @c Transaction object tracking the download
@@ -692,6 +1318,42 @@ public Q_SLOTS:
     */
     Transaction *installFile(const DebFile &file);
 
+    /**
+     * Asynchronous version of installFile().
+     *
+     * @see commitChangesAsync
+     * @since 3.1
+     */
+    Transaction *installFileAsync(const DebFile &file);
+
+    /**
+     * Starts a transaction that installs several .deb files together, in a
+     * single dpkg run. The files are ordered so that those depending on
+     * others in the set are installed after them.
+     *
+     * Only dependencies between the files themselves are taken into
+     * account. Dependencies on packages outside of the set are not
+     * resolved, so they must already be installed, or dpkg leaves the
+     * dependent files unconfigured and the transaction fails.
+     *
+     * @param filePaths The paths of the .deb files to install, at least one
+     *
+     * @return A pointer to a @c Transaction object tracking the installation.
+     * Its filePath() is the first of the files. An empty list is rejected
+     * by the worker, and the transaction reports the error.
+     *
+     * @since 3.1
+     */
+    Transaction *installFiles(const QStringList &filePaths);
+
+    /**
+     * Asynchronous version of installFiles().
+     *
+     * @see commitChangesAsync
+     * @since 3.1
+     */
+    Transaction *installFilesAsync(const QStringList &filePaths);
+
     /**
      * Starts a transaction that will check for and downloads new package
      * source lists. (Essentially, checking for updates.)
@@ -702,6 +1364,37 @@ public Q_SLOTS:
      */
     Transaction *updateCache();
 
+    /**
+     * Asynchronous version of updateCache().
+     *
+     * @see commitChangesAsync
+     * @since 3.1
+     */
+    Transaction *updateCacheAsync();
+
+    /**
+     * Starts a transaction that only downloads the package source lists of
+     * the given sources, leaving the lists of all other sources as they are.
+     *
+     * @param sources The URIs of the sources to update, as returned by
+     * SourceEntry::uri(), or the paths of sources files whose entries
+     * should all be updated. Files have to be the main sources list or lie
+     * in the sources.list.d directory of APT
+     *
+     * @return A pointer to a @c Transaction object tracking the cache update.
+     *
+     * @since 3.1
+     */
+    Transaction *updateCache(const QStringList &sources);
+
+    /**
+     * Asynchronous version of updateCache(const QStringList &).
+     *
+     * @see commitChangesAsync
+     * @since 3.1
+     */
+    Transaction *updateCacheAsync(const QStringList &sources);
+
     /**
      * Starts a transaction which will upgrade as many of the packages as it can.
      * If the upgrade type is a "safe" upgrade, only packages that can be upgraded
@@ -717,6 +1410,27 @@ public Q_SLOTS:
      */
     Transaction *upgradeSystem(QApt::UpgradeType upgradeType);
 
+    /**
+     * Asynchronous version of upgradeSystem().
+     *
+     * @see commitChangesAsync
+     * @since 3.1
+     */
+    Transaction *upgradeSystemAsync(QApt::UpgradeType upgradeType);
+
+    /**
+     * Starts the worker if it isn't running yet, so that it has its package
+     * cache open by the time the first transaction comes in.
+     *
+     * If QApt::Worker::Keep-Warm is set in the APT configuration, the
+     * worker also stays up for as long as this frontend is connected to the
+     * system bus, provided PolicyKit allows it to update the cache, as it
+     * does for active local sessions. Returns immediately.
+     *
+     * @since 3.1
+     */
+    void warmUpWorker();
+
     /**
      * Exports a list of all packages currently installed on the system. This
      * list can be read by the readSelections() function or by Synaptic.
@@ -733,6 +1447,34 @@ public Q_SLOTS:
      */
     bool saveInstalledPackagesList(const QString &path) const;
 
+    /**
+     * Streams the list written by saveInstalledPackagesList() to @p device,
+     * one package at a time. Use QFile::open(int, QIODevice::OpenMode) to
+     * write to a file descriptor.
+     *
+     * @param device An open device to write to
+     *
+     * @return @c true if writing succeeded
+     *
+     * @since 3.1
+     */
+    bool writeInstalledPackagesList(QIODevice *device) const;
+
+    /**
+     * Streams a compact, machine-readable inventory of all installed
+     * packages to @p device. Every package gets a line of tab-separated
+     * fields: the architecture-qualified name, the installed version, and
+     * @c a or @c m depending on whether it was installed automatically or
+     * manually.
+     *
+     * @param device An open device to write to
+     *
+     * @return @c true if writing succeeded
+     *
+     * @since 3.1
+     */
+    bool writeInventory(QIODevice *device) const;
+
     /**
      * Writes a list of packages that have been marked for install, removal or
      * upgrade.
@@ -749,9 +1491,22 @@ public Q_SLOTS:
      */
     bool saveSelections(const QString &path) const;
 
+    /**
+     * Streams the list written by saveSelections() to @p device, one package
+     * at a time.
+     *
+     * @param device An open device to write to
+     *
+     * @return @c true if writing succeeded
+     *
+     * @since 3.1
+     */
+    bool writeSelections(QIODevice *device) const;
+
     /**
      * Reads and applies selections from a text file generated from either
-     * saveSelections() or from Synaptic
+     * saveSelections() or from Synaptic. Packages that are not in the cache
+     * are skipped.
      *
      * @param path The path from which to read the selection list
      *
@@ -765,6 +1520,26 @@ public Q_SLOTS:
      */
     bool loadSelections(const QString &path);
 
+    /**
+     * Reads and applies selections from a text file generated from either
+     * saveSelections() or from Synaptic, reporting progress with the
+     * selectionsLoadProgress() signal.
+     *
+     * The file is read as a stream. Lines that cannot be parsed and packages
+     * that are not in the cache are skipped, and the remaining selections
+     * are still applied.
+     *
+     * @param path The path from which to read the selection list
+     * @param unknownPackages If not null, the names of the selected packages
+     *        that are not in the cache are appended to it
+     *
+     * @return @c true if at least one selection was applied
+     * @return @c false if the file could not be read or had no usable selections
+     *
+     * @since 3.1
+     */
+    bool loadSelections(const QString &path, QStringList *unknownPackages);
+
    /**
     * Writes a list of packages that have been marked for installation. This
     * list can then be loaded with the loadDownloadList() function to start
@@ -778,6 +1553,18 @@ public Q_SLOTS:
     */
     bool saveDownloadList(const QString &path) const;
 
+   /**
+    * Streams the list written by saveDownloadList() to @p device, one
+    * package at a time.
+    *
+    * @param device An open device to write to
+    *
+    * @return @c true if writing succeeded
+    *
+    * @since 3.1
+    */
+    bool writeDownloadList(QIODevice *device) const;
+
    /**
     * Locks the package at either the current version if installed, or
     * prevents automatic installation if not installed.
@@ -793,6 +1580,24 @@ public Q_SLOTS:
     */
     bool setPackagePinned(QApt::Package *package, bool pin);
 
+   /**
+    * Pins or unpins several packages at once, as setPackagePinned() does for
+    * a single one. The new preferences are worked out in memory, and every
+    * preference file that changes is written exactly once, with a single
+    * request to the worker. Preference files left without any stanza are
+    * removed.
+    *
+    * The backend must be reloaded before the pinning will take effect
+    *
+    * @param pins The packages to control pinning for, and whether to pin
+    *        (@c true) or unpin (@c false) each of them
+    *
+    * @return @c true on success, @c false on failure
+    *
+    * @since 3.1
+    */
+    bool setPackagesPinned(const QHash<QApt::Package *, bool> &pins);
+
    /**
     * Tells the QApt Worker to initiate a rebuild of the Xapian package search
     * index.
@@ -801,6 +1606,11 @@ public Q_SLOTS:
     * events using the workerEvent() signal. Progress is reported by the
     * xapianUpdateProgress() signal.
     *
+    * Only the packages that changed since the last update are reindexed,
+    * and searching remains possible while the update runs. The index is
+    * reopened in place once it is done. Calls made while an update is
+    * running are ignored.
+    *
     * @see xapianUpdateProgress()
     * @see xapianIndexNeedsUpdate()
     */
@@ -824,6 +1634,21 @@ public Q_SLOTS:
     */
     bool addArchiveToCache(const DebFile &archive);
 
+   /**
+    * Adds several .deb package archives to the APT package cache in one go,
+    * under the same conditions as addArchiveToCache().
+    *
+    * The worker checks the md5 sums as it stores the archives, and avoids
+    * copying their data where the file system allows.
+    *
+    * @param archivePaths The paths of the .deb archives to add
+    *
+    * @return The paths of the archives that were added
+    *
+    * @since 3.1
+    */
+    QStringList addArchivesToCache(const QStringList &archivePaths);
+
     /**
      * Sets the capabilities of the frontend. All transactions created after this
      * is set will inherit these capability flags.
@@ -837,6 +1662,10 @@ public Q_SLOTS:
 private Q_SLOTS:
     void emitPackageChanged();
     void emitXapianUpdateFinished();
+    void finishAsyncReload();
+    void invalidateStates();
+    void emitDownloadSize();
+    void deliverSearchPage(const QString &searchString, const QStringList &names, bool finished);
 };
 
 }
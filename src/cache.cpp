@@ -20,9 +20,12 @@
 
 #include "cache.h"
 
+#include <QBitArray>
 #include <QCoreApplication>
 
 #include <apt-pkg/cachefile.h>
+#include <apt-pkg/indexfile.h>
+#include <apt-pkg/sourcelist.h>
 
 namespace QApt {
 
@@ -31,21 +34,38 @@ class CachePrivate
 public:
     CachePrivate()
         : cache(new pkgCacheFile())
-        , trustCache(new QHash<pkgCache::PkgFileIterator, pkgIndexFile*>)
     {
     }
 
     ~CachePrivate()
     {
         delete cache;
-        delete trustCache;
     }
 
+    void buildTrustTable();
+
     pkgCacheFile *cache;
 
-    QHash<pkgCache::PkgFileIterator, pkgIndexFile*> *trustCache;
+    // Indexed by pkgCache::PackageFile::ID
+    QBitArray trustedFiles;
 };
 
+void CachePrivate::buildTrustTable()
+{
+    pkgCache *pkgcache = cache->GetPkgCache();
+    pkgSourceList *sources = cache->GetSourceList();
+
+    trustedFiles.fill(false, pkgcache->HeaderP->PackageFileCount);
+
+    for (pkgCache::PkgFileIterator file = pkgcache->FileBegin(); !file.end(); ++file) {
+        pkgIndexFile *index;
+
+        //FIXME: Should be done in apt
+        if (sources->FindIndex(file, index) && index->IsTrusted())
+            trustedFiles.setBit(file->ID);
+    }
+}
+
 Cache::Cache(QObject* parent)
         : QObject(parent)
         , d_ptr(new CachePrivate)
@@ -57,16 +77,21 @@ Cache::~Cache()
     delete d_ptr;
 }
 
-bool Cache::open()
+bool Cache::open(OpProgress *progress)
 {
     Q_D(Cache);
 
     // Close cache in case it's been opened
     d->cache->Close();
-    d->trustCache->clear();
+    d->trustedFiles.clear();
 
     // Build the cache, return whether it opened
-    return d->cache->ReadOnlyOpen();
+    if (!d->cache->ReadOnlyOpen(progress))
+        return false;
+
+    d->buildTrustTable();
+
+    return true;
 }
 
 pkgDepCache *Cache::depCache() const
@@ -83,11 +108,18 @@ pkgSourceList *Cache::list() const
     return d->cache->GetSourceList();
 }
 
-QHash<pkgCache::PkgFileIterator, pkgIndexFile*> *Cache::trustCache() const
+pkgPolicy *Cache::policy() const
+{
+    Q_D(const Cache);
+
+    return d->cache->GetPolicy();
+}
+
+bool Cache::isTrusted(const pkgCache::PkgFileIterator &file) const
 {
     Q_D(const Cache);
 
-    return d->trustCache;
+    return d->trustedFiles.testBit(file->ID);
 }
 
 }
@@ -26,8 +26,9 @@
 
 #include <apt-pkg/pkgcache.h>
 
+class OpProgress;
 class pkgDepCache;
-class pkgIndexFile;
+class pkgPolicy;
 class pkgSourceList;
 
 namespace QApt {
@@ -68,12 +69,16 @@ public:
     /// Returns a pointer to the interal package source list.
     pkgSourceList *list() const;
 
+    /// Returns a pointer to the policy that picks candidate versions.
+    pkgPolicy *policy() const;
+
    /**
-    * Returns a pointer to QApt's cache of trusted package source index
-    * files. These are used by QApt::Package to determine whether or not
-    * a package is trusted
+    * Returns whether the given package file comes from a trusted index.
+    * The trust of every package file is determined once when the cache is
+    * opened, so that QApt::Package can determine whether or not a package
+    * is trusted without searching the source list.
     */
-    QHash<pkgCache::PkgFileIterator, pkgIndexFile*> *trustCache() const;
+    bool isTrusted(const pkgCache::PkgFileIterator &file) const;
 
 public Q_SLOTS:
     /**
@@ -81,9 +86,11 @@ public Q_SLOTS:
      * cache when the need arises. (E.g. such as an updated sources list, or a
      * package installation or removal)
      *
+     * @param progress An optional progress object to report opening progress to
+     *
      * @return @c true if opening succeeds, false otherwise
      */
-    bool open();
+    bool open(OpProgress *progress = nullptr);
 
 protected:
     CachePrivate *const d_ptr;
@@ -25,6 +25,7 @@
 #include <QSharedData>
 #include <QStringBuilder>
 #include <QStringList>
+#include <QVector>
 
 // QApt includes
 #include "package.h"
@@ -80,13 +81,15 @@ void ChangelogEntryPrivate::parseData(const QString &sourcePackage)
         version = list.at(1);
     }
 
+    QRegExp rxCVE("CVE-\\d{4}-\\d{4}");
+    QRegExp rxDate("^ -- (.+) (<.+>)  (.+)$");
+
     foreach (const QString &line, lines) {
         // Populate description
         if (line.startsWith(QLatin1String("  "))) {
             description.append(line % '\n');
 
             // Grab CVEs
-            QRegExp rxCVE("CVE-\\d{4}-\\d{4}");
             rxCVE.indexIn(line);
             QStringList cveMatches = rxCVE.capturedTexts();
 
@@ -99,7 +102,6 @@ void ChangelogEntryPrivate::parseData(const QString &sourcePackage)
             continue;
         }
 
-        QRegExp rxDate("^ -- (.+) (<.+>)  (.+)$");
         rxDate.indexIn(line);
         list = rxDate.capturedTexts();
 
@@ -170,20 +172,69 @@ public:
         : QSharedData()
         , data(cData)
         , sourcePackage(sData)
+        , indexed(false)
         {
         }
     ChangelogPrivate(const ChangelogPrivate &other)
         : QSharedData(other)
         , data(other.data),
         sourcePackage(other.sourcePackage)
+        , indexed(other.indexed)
+        , entryRanges(other.entryRanges)
+        , parsedEntries(other.parsedEntries)
         {
         }
     ~ChangelogPrivate() {}
 
     QString data;
     QString sourcePackage;
+
+    // Start and end of each entry in data, found once and parsed on demand
+    mutable bool indexed;
+    mutable QVector<QPair<int, int> > entryRanges;
+    mutable ChangelogEntryList parsedEntries;
+
+    int entryCount() const;
+    ChangelogEntry entryAt(int index) const;
 };
 
+int ChangelogPrivate::entryCount() const
+{
+    if (indexed)
+        return entryRanges.size();
+
+    indexed = true;
+
+    // Each entry starts with a line beginning with the source package name
+    int pos = 0;
+    while (pos < data.size()) {
+        int lineEnd = data.indexOf(QLatin1Char('\n'), pos);
+        if (lineEnd == -1)
+            lineEnd = data.size();
+
+        if (data.midRef(pos, lineEnd - pos).startsWith(sourcePackage)) {
+            if (!entryRanges.isEmpty())
+                entryRanges.last().second = pos;
+            entryRanges.append(qMakePair(pos, data.size()));
+        }
+
+        pos = lineEnd + 1;
+    }
+
+    return entryRanges.size();
+}
+
+ChangelogEntry ChangelogPrivate::entryAt(int index) const
+{
+    while (parsedEntries.size() <= index) {
+        const QPair<int, int> &range = entryRanges.at(parsedEntries.size());
+        parsedEntries << ChangelogEntry(data.mid(range.first, range.second - range.first),
+                                        sourcePackage);
+    }
+
+    return parsedEntries.at(index);
+}
+
 Changelog::Changelog(const QString &data, const QString &sourcePackage)
         : d(new ChangelogPrivate(data, sourcePackage))
 {
@@ -215,46 +266,26 @@ QString Changelog::text() const
 
 ChangelogEntryList Changelog::entries() const
 {
+    const int count = d->entryCount();
+    if (count)
+        d->entryAt(count - 1);
 
-    ChangelogEntryList entries;
-    QStringList entryTexts;
-
-    foreach (const QString &line, d->data.split('\n')) {
-        if (line.startsWith(d->sourcePackage)) {
-            entryTexts.append(line % '\n');
-            continue;
-        }
-
-        int curIndex = entryTexts.count() -1;
-        if (curIndex < 0) {
-            continue;
-        }
-        QString curEntry = entryTexts.at(curIndex);
-
-        curEntry.append(line % '\n');
-        entryTexts[curIndex] = curEntry;
-    }
-
-    for (const QString &stanza : entryTexts) {
-        ChangelogEntry entry(stanza, d->sourcePackage);
-
-        entries << entry;
-    }
-
-    return entries;
+    return d->parsedEntries;
 }
 
 ChangelogEntryList Changelog::newEntriesSince(const QString &version) const
 {
     ChangelogEntryList newEntries;
 
-    for (const ChangelogEntry &entry : entries()) {
-        int res = Package::compareVersion(entry.version(), version);
+    // Entries are ordered newest first, so stop at the first older one
+    const QByteArray since = version.toLatin1();
+    const int count = d->entryCount();
+    for (int i = 0; i < count; ++i) {
+        const ChangelogEntry entry = d->entryAt(i);
+        if (Package::compareVersion(QLatin1String(entry.version().toLatin1()), QLatin1String(since)) <= 0)
+            break;
 
-        // Add entries newer than the given version
-        if (res > 0) {
-            newEntries << entry;
-        }
+        newEntries << entry;
     }
 
     return newEntries;
@@ -0,0 +1,281 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "changelogfetcher.h"
+
+// Qt includes
+#include <QDir>
+#include <QFile>
+#include <QQueue>
+#include <QStandardPaths>
+#include <QStringBuilder>
+
+// Apt includes
+#include <apt-pkg/acquire.h>
+#include <apt-pkg/acquire-item.h>
+#include <apt-pkg/depcache.h>
+#include <apt-pkg/error.h>
+#include <apt-pkg/pkgrecords.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Own includes
+#include "backend.h"
+#include "cache.h"
+
+namespace QApt {
+
+struct ChangelogRequest
+{
+    QString packageName;
+    QString sourcePackage;
+    QString cachePath;
+    pkgAcqChangelog *item;
+};
+
+// Cancels the download once the fetcher it belongs to is gone
+class ChangelogStatus : public pkgAcquireStatus
+{
+public:
+    ChangelogStatus() : cancelled(false) {}
+
+    bool Pulse(pkgAcquire *owner)
+    {
+        pkgAcquireStatus::Pulse(owner);
+        return !cancelled;
+    }
+
+    std::atomic<bool> cancelled;
+};
+
+// A batch of downloads. It is shared with the download thread, so that the
+// fetcher can be deleted without waiting for the thread to finish.
+struct ChangelogBatch
+{
+    ChangelogBatch() : owner(nullptr), fetcher(new pkgAcquire(&status)) {}
+    // Also deletes the items
+    ~ChangelogBatch() { delete fetcher; }
+
+    // Guards owner, which is cleared once the fetcher is deleted
+    std::mutex ownerMutex;
+    QObject *owner;
+    ChangelogStatus status;
+    pkgAcquire *fetcher;
+    QList<ChangelogRequest> requests;
+};
+
+class ChangelogFetcherPrivate
+{
+public:
+    ChangelogFetcherPrivate(Backend *b)
+        : backend(b)
+        , maxParallel(4)
+    {
+        cacheDir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+                   + QLatin1String("/qapt/changelogs");
+    }
+
+    Backend *backend;
+    int maxParallel;
+    QString cacheDir;
+
+    // Names rather than packages, which are deleted on cache reloads
+    QQueue<QString> queue;
+    std::shared_ptr<ChangelogBatch> batch;
+};
+
+static QString readChangelog(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QString();
+
+    return QString::fromUtf8(file.readAll());
+}
+
+ChangelogFetcher::ChangelogFetcher(Backend *backend, QObject *parent)
+        : QObject(parent)
+        , d_ptr(new ChangelogFetcherPrivate(backend))
+{
+    connect(backend, SIGNAL(cacheReloadStarted()), this, SLOT(cancel()));
+}
+
+ChangelogFetcher::~ChangelogFetcher()
+{
+    Q_D(ChangelogFetcher);
+
+    // The download thread stops at its next pulse and cleans up after itself
+    if (d->batch) {
+        std::lock_guard<std::mutex> lock(d->batch->ownerMutex);
+        d->batch->owner = nullptr;
+        d->batch->status.cancelled = true;
+    }
+
+    delete d_ptr;
+}
+
+int ChangelogFetcher::maxParallel() const
+{
+    Q_D(const ChangelogFetcher);
+
+    return d->maxParallel;
+}
+
+void ChangelogFetcher::setMaxParallel(int maxParallel)
+{
+    Q_D(ChangelogFetcher);
+
+    d->maxParallel = qMax(1, maxParallel);
+}
+
+void ChangelogFetcher::fetch(const PackageList &packages)
+{
+    Q_D(ChangelogFetcher);
+
+    for (Package *package : packages)
+        d->queue.enqueue(package->name());
+
+    if (!d->batch)
+        startBatch();
+}
+
+void ChangelogFetcher::cancel()
+{
+    Q_D(ChangelogFetcher);
+
+    d->queue.clear();
+}
+
+bool ChangelogFetcher::isBusy() const
+{
+    Q_D(const ChangelogFetcher);
+
+    return d->batch || !d->queue.isEmpty();
+}
+
+void ChangelogFetcher::startBatch()
+{
+    Q_D(ChangelogFetcher);
+
+    QDir().mkpath(d->cacheDir);
+
+    pkgDepCache *depCache = d->backend->cache()->depCache();
+    std::shared_ptr<ChangelogBatch> batch;
+
+    while (!d->queue.isEmpty() && (!batch || batch->requests.size() < d->maxParallel)) {
+        const QString packageName = d->queue.dequeue();
+        Package *package = d->backend->package(packageName);
+        if (!package) {
+            emit changelogFailed(packageName, QString());
+            continue;
+        }
+
+        const pkgCache::VerIterator &ver = depCache->GetCandidateVer(package->packageIterator());
+        if (ver.end()) {
+            emit changelogFailed(packageName, QString());
+            continue;
+        }
+
+        // Binary NMUs share the changelog of their source version
+        pkgRecords::Parser &rec = d->backend->records()->Lookup(ver.FileList());
+        QString sourcePackage = QString::fromStdString(rec.SourcePkg());
+        if (sourcePackage.isEmpty())
+            sourcePackage = packageName;
+        QString sourceVersion = QString::fromStdString(rec.SourceVer());
+        if (sourceVersion.isEmpty())
+            sourceVersion = QLatin1String(ver.VerStr());
+
+        // Epochs would put a ':' in the file name
+        const QString fileName = sourcePackage % QLatin1Char('_')
+                                 % QString(sourceVersion).replace(QLatin1Char(':'), QLatin1String("%3a"));
+        const QString cachePath = d->cacheDir % QLatin1Char('/') % fileName;
+
+        if (QFile::exists(cachePath)) {
+            emit changelogFetched(packageName, Changelog(readChangelog(cachePath), sourcePackage));
+            continue;
+        }
+
+        if (!batch) {
+            batch = std::make_shared<ChangelogBatch>();
+            batch->owner = this;
+        }
+
+        ChangelogRequest request;
+        request.packageName = packageName;
+        request.sourcePackage = sourcePackage;
+        request.cachePath = cachePath;
+        // Downloaded next to the cached copy, and only renamed once complete.
+        // Binary packages of the same source each get a file of their own.
+        request.item = new pkgAcqChangelog(batch->fetcher, ver, d->cacheDir.toStdString(),
+                                           (fileName % QLatin1Char('.') % packageName
+                                            % QLatin1String(".partial")).toStdString());
+        batch->requests << request;
+    }
+
+    if (!batch) {
+        emit finished();
+        return;
+    }
+
+    d->batch = batch;
+    std::thread([batch]() {
+        batch->fetcher->Run();
+        _error->Discard();
+
+        std::lock_guard<std::mutex> lock(batch->ownerMutex);
+        if (batch->owner)
+            QMetaObject::invokeMethod(batch->owner, "batchFinished", Qt::QueuedConnection);
+    }).detach();
+}
+
+void ChangelogFetcher::batchFinished()
+{
+    Q_D(ChangelogFetcher);
+
+    std::shared_ptr<ChangelogBatch> batch;
+    batch.swap(d->batch);
+
+    for (const ChangelogRequest &request : batch->requests) {
+        const QString partialPath = QString::fromStdString(request.item->DestFile);
+
+        // Another package of the same source may have been renamed first
+        bool done = request.item->Status == pkgAcquire::Item::StatDone;
+        if (done && !QFile::rename(partialPath, request.cachePath)) {
+            QFile::remove(partialPath);
+            done = QFile::exists(request.cachePath);
+        }
+
+        if (done) {
+            emit changelogFetched(request.packageName,
+                                  Changelog(readChangelog(request.cachePath), request.sourcePackage));
+        } else {
+            QFile::remove(partialPath);
+            emit changelogFailed(request.packageName,
+                                 QString::fromStdString(request.item->ErrorText));
+        }
+    }
+
+    startBatch();
+}
+
+}
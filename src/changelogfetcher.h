@@ -0,0 +1,116 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef QAPT_CHANGELOGFETCHER_H
+#define QAPT_CHANGELOGFETCHER_H
+
+#include <QObject>
+#include <QString>
+
+#include "changelog.h"
+#include "package.h"
+
+namespace QApt {
+
+class Backend;
+class ChangelogFetcherPrivate;
+
+/**
+ * The ChangelogFetcher class downloads the changelogs of the candidate
+ * versions of packages in the background.
+ *
+ * Changelogs are stored in a per-user cache, keyed by source package and
+ * source version. Since the changelog of a given source version never
+ * changes, cached changelogs are returned without touching the network.
+ * At most maxParallel() changelogs are downloaded at the same time.
+ *
+ * @since 3.1
+ */
+class Q_DECL_EXPORT ChangelogFetcher : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * Constructor
+     *
+     * @param backend The backend the packages to fetch changelogs for belong to
+     * @param parent The parent object
+     */
+    explicit ChangelogFetcher(Backend *backend, QObject *parent = 0);
+
+    /// Destructor. Running downloads are cancelled in the background.
+    ~ChangelogFetcher();
+
+    /// Returns how many changelogs are downloaded at the same time
+    int maxParallel() const;
+
+    /// Sets how many changelogs are downloaded at the same time
+    void setMaxParallel(int maxParallel);
+
+    /**
+     * Queues the changelogs of the candidate versions of @p packages.
+     * changelogFetched() or changelogFailed() is emitted for each of them,
+     * immediately for the ones that are cached already.
+     */
+    void fetch(const QApt::PackageList &packages);
+
+    /// Returns whether changelogs are being downloaded or are queued
+    bool isBusy() const;
+
+public Q_SLOTS:
+    /**
+     * Drops all changelogs that have not started downloading yet. Called
+     * when the cache of the backend is reloaded.
+     */
+    void cancel();
+
+Q_SIGNALS:
+    /**
+     * Emitted once the changelog of a package is available
+     *
+     * @param packageName The name of the package
+     * @param changelog The parsed changelog
+     */
+    void changelogFetched(const QString &packageName, const QApt::Changelog &changelog);
+
+    /**
+     * Emitted when the changelog of a package could not be fetched
+     *
+     * @param packageName The name of the package
+     * @param errorText The reason reported by APT
+     */
+    void changelogFailed(const QString &packageName, const QString &errorText);
+
+    /// Emitted once all queued changelogs have been handled
+    void finished();
+
+private:
+    Q_DECLARE_PRIVATE(ChangelogFetcher)
+    ChangelogFetcherPrivate *const d_ptr;
+
+    void startBatch();
+
+private Q_SLOTS:
+    void batchFinished();
+};
+
+}
+
+#endif
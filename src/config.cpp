@@ -25,12 +25,20 @@
 #include <QFile>
 #include <QHash>
 #include <QLatin1String>
+#include <QList>
+#include <QPair>
+#include <QReadWriteLock>
+#include <QVector>
+#include <QDBusArgument>
 #include <QDBusConnection>
+#include <QDBusMetaType>
 
 // APT includes
 #include <apt-pkg/aptconfiguration.h>
 #include <apt-pkg/configuration.h>
 
+#include <string>
+
 // Own includes
 #include "dbusinterfaces_p.h"
 
@@ -41,72 +49,86 @@ const QString APT_CONFIG_PATH = QString("/etc/apt/apt.conf");
 class ConfigPrivate
 {
     public:
+        ConfigPrivate() : batchDepth(0) {}
+
         // DBus
         WorkerInterface *worker;
 
         // Data
         QByteArray buffer;
-        bool newFile;
 
-        void writeBufferEntry(const QByteArray &key, const QByteArray &value);
+        // Entries waiting to be written, in the order they were set
+        QList<QPair<QByteArray, QByteArray> > pending;
+        int batchDepth;
+
+        void writeEntry(const QString &key, const QByteArray &value);
+        void applyPending();
 };
 
-void ConfigPrivate::writeBufferEntry(const QByteArray &key, const QByteArray &value)
+void ConfigPrivate::writeEntry(const QString &key, const QByteArray &value)
 {
-    int lineIndex = 0;
-    bool changed = false;
-
-    QList<QByteArray> lines = buffer.split('\n');
+    const QByteArray latinKey = key.toLatin1();
 
-    // We will re-add final newline on write
-    if (lines.last().isEmpty()) {
-        lines.removeLast();
+    bool replaced = false;
+    for (auto &entry : pending) {
+        if (entry.first == latinKey) {
+            entry.second = value;
+            replaced = true;
+        }
     }
+    if (!replaced)
+        pending.append(qMakePair(latinKey, value));
 
-    // Try to replace key if it's there
-    while (lineIndex < lines.size()) {
-        QByteArray line = lines[lineIndex];
-        // skip empty lines and lines beginning with '#'
-        if (line.isEmpty() || line.at(0) == '#') {
-            lineIndex++;
-            continue;
-        }
+    if (batchDepth == 0)
+        applyPending();
+}
 
-        QByteArray aKey;
-        int eqpos = line.indexOf(' ');
+void ConfigPrivate::applyPending()
+{
+    if (pending.isEmpty())
+        return;
 
-        if (eqpos < 0) {
-            // Invalid
-            lineIndex++;
-            continue;
-        } else {
-            aKey = line.left(eqpos);
+    QHash<QByteArray, int> keys;
+    for (int i = 0; i < pending.size(); ++i)
+        keys.insert(pending.at(i).first, i);
+    QVector<bool> written(pending.size(), false);
 
-            if (aKey == key) {
-                lines[lineIndex] = QByteArray(key + ' ' + value);
-                changed = true;
-            }
-        }
+    QByteArray tempBuffer;
+    tempBuffer.reserve(buffer.size() + pending.size() * 64);
 
-        lineIndex++;
-    }
+    // Replace keys that are already there, all in one pass
+    int pos = 0;
+    while (pos < buffer.size()) {
+        int end = buffer.indexOf('\n', pos);
+        if (end == -1)
+            end = buffer.size();
 
-    QByteArray tempBuffer;
+        const QByteArray line = buffer.mid(pos, end - pos);
+        pos = end + 1;
 
-    if (changed) {
-        // No new keys. Recompose lines and set buffer to new buffer
-        Q_FOREACH (const QByteArray &line, lines) {
-            tempBuffer += QByteArray(line + '\n');
-        }
+        // skip empty lines and lines beginning with '#'
+        int eqpos = (line.isEmpty() || line.at(0) == '#') ? -1 : line.indexOf(' ');
+        auto it = (eqpos < 0) ? keys.constEnd() : keys.constFind(line.left(eqpos));
 
-        buffer = tempBuffer;
-    } else {
-        // New key or new file. Append to existing buffer
-        tempBuffer = QByteArray(key + ' ' + value);
-        tempBuffer.append('\n');
+        if (it != keys.constEnd()) {
+            const QPair<QByteArray, QByteArray> &entry = pending.at(*it);
+            tempBuffer += entry.first + ' ' + entry.second + '\n';
+            written[*it] = true;
+        } else {
+            tempBuffer += line + '\n';
+        }
+    }
 
-        buffer += tempBuffer;
+    // New keys, or a new file
+    for (int i = 0; i < pending.size(); ++i) {
+        if (!written.at(i))
+            tempBuffer += pending.at(i).first + ' ' + pending.at(i).second + '\n';
     }
+
+    buffer = tempBuffer;
+    pending.clear();
+
+    worker->writeFileToDisk(QString(buffer), APT_CONFIG_PATH);
 }
 
 Config::Config(QObject *parent)
@@ -125,9 +147,6 @@ Config::Config(QObject *parent)
         file.open(QIODevice::ReadOnly | QIODevice::Text);
 
         d->buffer = file.readAll();
-        d->newFile = false;
-    } else {
-        d->newFile = true;
     }
 }
 
@@ -138,6 +157,8 @@ Config::~Config()
 
 bool Config::readEntry(const QString &key, const bool defaultValue) const
 {
+    // Not cached, since a Config is not told about writes through others,
+    // the worker or reloads of the configuration
     return _config->FindB(key.toStdString(), defaultValue);
 }
 
@@ -161,6 +182,75 @@ QString Config::findFile(const QString& key, const QString& defaultValue) const
     return QString::fromStdString(_config->FindFile(key.toLocal8Bit().data(), defaultValue.toLocal8Bit().data()));
 }
 
+bool FetchPolicy::isDefault() const
+{
+    return queueMode == QueueByHost && !queueLimit && !retries && hostPipelineDepths.isEmpty();
+}
+
+QVariantMap FetchPolicy::toMap() const
+{
+    QVariantMap depths;
+    for (auto it = hostPipelineDepths.constBegin(); it != hostPipelineDepths.constEnd(); ++it)
+        depths.insert(it.key(), it.value());
+
+    QVariantMap map;
+    map[QLatin1String("queueMode")] = (int)queueMode;
+    map[QLatin1String("queueLimit")] = queueLimit;
+    map[QLatin1String("retries")] = retries;
+    map[QLatin1String("hostPipelineDepths")] = depths;
+
+    return map;
+}
+
+FetchPolicy FetchPolicy::fromMap(const QVariantMap &map)
+{
+    FetchPolicy policy;
+    policy.queueMode = (QueueMode)map.value(QLatin1String("queueMode")).toInt();
+    policy.queueLimit = map.value(QLatin1String("queueLimit")).toInt();
+    policy.retries = map.value(QLatin1String("retries")).toInt();
+
+    // Maps within maps arrive from D-Bus still marshalled
+    const QVariant depthsValue = map.value(QLatin1String("hostPipelineDepths"));
+    const QVariantMap depths = depthsValue.canConvert<QDBusArgument>()
+                               ? qdbus_cast<QVariantMap>(depthsValue.value<QDBusArgument>())
+                               : depthsValue.toMap();
+    for (auto it = depths.constBegin(); it != depths.constEnd(); ++it)
+        policy.hostPipelineDepths.insert(it.key(), it.value().toInt());
+
+    return policy;
+}
+
+FetchPolicy Config::fetchPolicy() const
+{
+    FetchPolicy policy;
+    if (readEntry(QLatin1String("QApt::Acquire::Queue-Mode"), QString()) == QLatin1String("access"))
+        policy.queueMode = FetchPolicy::QueueByAccess;
+    policy.queueLimit = readEntry(QLatin1String("QApt::Acquire::Queue-Limit"), 0);
+    policy.retries = readEntry(QLatin1String("QApt::Acquire::Retries"), 0);
+
+    const Configuration::Item *depths = _config->Tree("QApt::Acquire::Pipeline-Depth");
+    for (const Configuration::Item *host = depths ? depths->Child : nullptr; host; host = host->Next) {
+        policy.hostPipelineDepths.insert(QString::fromStdString(host->Tag),
+                                         QString::fromStdString(host->Value).toInt());
+    }
+
+    return policy;
+}
+
+void Config::setFetchPolicy(const FetchPolicy &policy)
+{
+    beginBatch();
+
+    writeEntry(QLatin1String("QApt::Acquire::Queue-Mode"),
+               policy.queueMode == FetchPolicy::QueueByAccess ? QLatin1String("access") : QLatin1String("host"));
+    writeEntry(QLatin1String("QApt::Acquire::Queue-Limit"), policy.queueLimit);
+    writeEntry(QLatin1String("QApt::Acquire::Retries"), policy.retries);
+    for (auto it = policy.hostPipelineDepths.constBegin(); it != policy.hostPipelineDepths.constEnd(); ++it)
+        writeEntry(QLatin1String("QApt::Acquire::Pipeline-Depth::") + it.key(), it.value());
+
+    commitBatch();
+}
+
 QStringList Config::architectures() const
 {
     QStringList archList;
@@ -178,57 +268,56 @@ void Config::writeEntry(const QString &key, const bool value)
 {
     Q_D(Config);
 
-    QByteArray boolString;
-
-    boolString = value ? "\"true\";" : "\"false\";";
-
-    if (d->newFile) {
-        d->buffer.append(key + ' ' + boolString);
-        d->newFile = false;
-    } else {
-        d->writeBufferEntry(key.toLatin1(), boolString);
+    {
+        QWriteLocker locker(lock());
+        _config->Set(key.toLatin1(), value);
     }
-
-    _config->Set(key.toLatin1(), value);
-    d->worker->writeFileToDisk(QString(d->buffer), APT_CONFIG_PATH);
+    d->writeEntry(key, value ? "\"true\";" : "\"false\";");
 }
 
 void Config::writeEntry(const QString &key, const int value)
 {
     Q_D(Config);
 
-    QByteArray intString;
+    {
+        QWriteLocker locker(lock());
+        _config->Set(key.toLatin1(), value);
+    }
+    d->writeEntry(key, '\"' + QString::number(value).toLatin1() + "\";");
+}
 
-    intString = '\"' + QString::number(value).toLatin1() + "\";";
+void Config::writeEntry(const QString &key, const QString &value)
+{
+    Q_D(Config);
 
-    if (d->newFile) {
-        d->buffer.append(key.toLatin1() + ' ' + intString);
-        d->newFile = false;
-    } else {
-        d->writeBufferEntry(key.toLatin1(), intString);
+    {
+        QWriteLocker locker(lock());
+        _config->Set(key.toStdString(), value.toStdString());
     }
+    d->writeEntry(key, '\"' + value.toLatin1() + "\";");
+}
 
-    _config->Set(key.toLatin1(), value);
-    d->worker->writeFileToDisk(QString(d->buffer), APT_CONFIG_PATH);
+QReadWriteLock *Config::lock()
+{
+    static QReadWriteLock configLock;
+    return &configLock;
 }
 
-void Config::writeEntry(const QString &key, const QString &value)
+void Config::beginBatch()
 {
     Q_D(Config);
 
-    QByteArray valueString;
+    ++d->batchDepth;
+}
 
-    valueString = '\"' + value.toLatin1() + "\";";
+void Config::commitBatch()
+{
+    Q_D(Config);
 
-    if (d->newFile) {
-        d->buffer.append(key + ' ' + valueString);
-        d->newFile = false;
-    } else {
-        d->writeBufferEntry(key.toLatin1(), valueString);
-    }
+    if (d->batchDepth == 0 || --d->batchDepth > 0)
+        return;
 
-    _config->Set(key.toStdString(), value.toStdString());
-    d->worker->writeFileToDisk(QString(d->buffer), APT_CONFIG_PATH);
+    d->applyPending();
 }
 
 }
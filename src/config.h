@@ -21,8 +21,12 @@
 #ifndef QAPT_CONFIG_H
 #define QAPT_CONFIG_H
 
+#include <QHash>
 #include <QObject>
 #include <QString>
+#include <QVariantMap>
+
+class QReadWriteLock;
 
 /**
  * The QApt namespace is the main namespace for LibQApt. All classes in this
@@ -35,6 +39,44 @@ namespace QApt {
  */
 class ConfigPrivate;
 
+/**
+ * How the worker fetches the files of a transaction
+ *
+ * @see Config::fetchPolicy()
+ * @see Transaction::setFetchPolicy()
+ * @since 3.1
+ */
+struct Q_DECL_EXPORT FetchPolicy
+{
+    enum QueueMode {
+        /// One queue per host, so different hosts are fetched from in parallel
+        QueueByHost,
+        /// One queue per access method, e.g. one for all http:// sources
+        QueueByAccess
+    };
+
+    FetchPolicy() : queueMode(QueueByHost), queueLimit(0), retries(0) {}
+
+    /// Acquire::Queue-Mode
+    QueueMode queueMode;
+    /// How many queues run at the same time, 0 for APT's default.
+    /// Acquire::QueueHost::Limit
+    int queueLimit;
+    /// How often failed downloads are retried. APT then falls back to the
+    /// other sources of a package, in the order of the sources lists.
+    /// Acquire::Retries
+    int retries;
+    /// How many requests are sent to a host at a time over its connection,
+    /// by host name. Acquire::http::<host>::Pipeline-Depth
+    QHash<QString, int> hostPipelineDepths;
+
+    /// Whether the worker can leave the APT configuration as it is
+    bool isDefault() const;
+
+    QVariantMap toMap() const;
+    static FetchPolicy fromMap(const QVariantMap &map);
+};
+
 /**
  * @brief Config wrapper for the libapt-pkg config API
  *
@@ -133,6 +175,50 @@ public:
      */
     QStringList architectures() const;
 
+    /**
+     * Returns the fetch policy configured with the QApt::Acquire keys,
+     * which the Backend sets for every transaction it creates
+     *
+     * @since 3.1
+     */
+    FetchPolicy fetchPolicy() const;
+
+    /**
+     * Writes @p policy to the QApt::Acquire keys, in a single batch
+     *
+     * @since 3.1
+     */
+    void setFetchPolicy(const FetchPolicy &policy);
+
+    /**
+     * Starts a batch of writeEntry() calls. Until the matching
+     * commitBatch(), new values only take effect in memory; the apt
+     * configuration file is then updated in a single pass and written once.
+     *
+     * Batches can be nested, only the outermost commitBatch() writes.
+     *
+     * @since 3.1
+     */
+    void beginBatch();
+
+    /**
+     * Ends a batch started with beginBatch(), writing all entries set since
+     * then to the apt configuration file.
+     *
+     * @since 3.1
+     */
+    void commitBatch();
+
+    /**
+     * Returns the lock guarding the global APT configuration, shared by all
+     * Config objects. writeEntry() holds it for writing while it changes a
+     * value. Threads that read the APT configuration in the background, for
+     * example to open a cache, should hold it for reading while they do.
+     *
+     * @since 3.1
+     */
+    static QReadWriteLock *lock();
+
 private:
     Q_DECLARE_PRIVATE(Config)
     ConfigPrivate *const d_ptr;
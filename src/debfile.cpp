@@ -20,18 +20,28 @@
 
 #include "debfile.h"
 
+#include <QCryptographicHash>
 #include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QMutex>
 #include <QProcess>
 #include <QStringBuilder>
 #include <QTemporaryFile>
 
 #include <apt-pkg/debfile.h>
+#include <apt-pkg/dirstream.h>
+#include <apt-pkg/error.h>
 #include <apt-pkg/fileutl.h>
-#include <apt-pkg/md5.h>
 #include <apt-pkg/tagfile.h>
 
+#include <QThread>
 #include <QDebug>
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 namespace QApt {
 
 class DebFilePrivate
@@ -54,6 +64,8 @@ class DebFilePrivate
         QString filePath;
         debDebFile::MemControlExtract *extractor;
         pkgTagSection *controlData;
+        // Computed on first use, see DebFile::hashes()
+        QMap<QString, QByteArray> hashes;
 
         void init();
 };
@@ -143,7 +155,7 @@ QString DebFile::homepage() const
 
 QString DebFile::longDescription() const
 {
-    QString rawDescription = QLatin1String(d->controlData->FindS("Description").c_str());
+    QString rawDescription = QString::fromStdString(d->controlData->FindS("Description"));
     // Remove short description
     rawDescription.remove(shortDescription() + '\n');
 
@@ -174,7 +186,7 @@ QString DebFile::longDescription() const
 
 QString DebFile::shortDescription() const
 {
-    QString longDesc = QLatin1String(d->controlData->FindS("Description").c_str());
+    QString longDesc = QString::fromStdString(d->controlData->FindS("Description"));
 
     return longDesc.left(longDesc.indexOf(QLatin1Char('\n')));
 }
@@ -191,55 +203,212 @@ QString DebFile::controlField(const QString &field) const
 
 QByteArray DebFile::md5Sum() const
 {
-    FileFd in(d->filePath.toStdString(), FileFd::ReadOnly);
-    debDebFile deb(in);
-    MD5Summation debMD5;
+    return hashes().value(QLatin1String("MD5Sum"));
+}
+
+QMap<QString, QByteArray> DebFile::hashes() const
+{
+    if (!d->hashes.isEmpty())
+        return d->hashes;
+
+    QFile file(d->filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return d->hashes;
 
-    in.Seek(0);
+    QCryptographicHash md5(QCryptographicHash::Md5);
+    QCryptographicHash sha1(QCryptographicHash::Sha1);
+    QCryptographicHash sha256(QCryptographicHash::Sha256);
 
-    debMD5.AddFD(in.Fd(), in.Size());
+    // All three sums are fed each chunk in turn, so the archive is read once
+    const qint64 chunkSize = 1024 * 1024;
+    const qint64 size = file.size();
+    const uchar *map = file.map(0, size);
+
+    if (map) {
+        for (qint64 pos = 0; pos < size; pos += chunkSize) {
+            const char *chunk = reinterpret_cast<const char *>(map) + pos;
+            const int length = qMin(chunkSize, size - pos);
+
+            md5.addData(chunk, length);
+            sha1.addData(chunk, length);
+            sha256.addData(chunk, length);
+        }
+
+        file.unmap(const_cast<uchar *>(map));
+    } else {
+        QByteArray chunk(chunkSize, Qt::Uninitialized);
+        qint64 length;
+
+        while ((length = file.read(chunk.data(), chunkSize)) > 0) {
+            md5.addData(chunk.constData(), length);
+            sha1.addData(chunk.constData(), length);
+            sha256.addData(chunk.constData(), length);
+        }
 
-    return QByteArray(debMD5.Result().Value().c_str());
+        if (length < 0)
+            return d->hashes;
+    }
+
+    d->hashes.insert(QLatin1String("MD5Sum"), md5.result().toHex());
+    d->hashes.insert(QLatin1String("SHA1"), sha1.result().toHex());
+    d->hashes.insert(QLatin1String("SHA256"), sha256.result().toHex());
+
+    return d->hashes;
 }
 
-QStringList DebFile::fileList() const
+// Lists the entries of the data tarball as it streams by, without
+// extracting anything
+class FileListStream : public pkgDirStream
 {
-    QTemporaryFile tempFile;
-    if (!tempFile.open()) {
-        return QStringList();
+public:
+    bool DoItem(Item &item, int &fd) {
+        fd = -1;
+
+        QString name = QString::fromUtf8(item.Name);
+        if (item.Type == Item::Directory && !name.endsWith(QLatin1Char('/')))
+            name += QLatin1Char('/');
+
+        // Directories are listed only if they turn out to be empty, which
+        // is known once the next entry isn't within them
+        if (!m_directory.isEmpty() && !name.startsWith(m_directory))
+            files << m_directory;
+        m_directory.clear();
+
+        if (item.Type == Item::Directory) {
+            // The first entry is the "./" entry
+            if (name != QLatin1String("./"))
+                m_directory = name;
+        } else {
+            files << name;
+        }
+
+        return true;
     }
 
-    QString tempFileName = tempFile.fileName();
-    QProcess dpkg;
-    QProcess tar;
+    void finish() {
+        if (!m_directory.isEmpty())
+            files << m_directory;
+        m_directory.clear();
+    }
 
-    // dpkg --fsys-tarfile filename
-    QString program = QLatin1String("dpkg --fsys-tarfile ") + d->filePath;
+    QStringList files;
 
-    dpkg.setStandardOutputFile(tempFileName);
-    dpkg.start(program);
-    dpkg.waitForFinished();
+private:
+    QString m_directory;
+};
 
-    QString program2 = QLatin1String("tar -tf ") + tempFileName;
-    tar.start(program2);
-    tar.waitForFinished();
+// Picks a single file out of the data tarball as it streams by
+class ReadFileStream : public pkgDirStream
+{
+public:
+    explicit ReadFileStream(const QString &fileName)
+        : found(false)
+        , m_fileName(normalized(fileName))
+    {
+    }
 
-    QString files = tar.readAllStandardOutput();
+    bool DoItem(Item &item, int &fd) {
+        fd = -1;
 
-    QStringList filesList = files.split('\n');
-    filesList.removeFirst(); // First entry is the "./" entry
-    filesList.removeAll(QLatin1String("")); // Remove empty entries
+        if (item.Type == Item::File && normalized(QString::fromUtf8(item.Name)) == m_fileName) {
+            found = true;
+            contents.reserve(item.Size);
 
-    // Remove non-file directory listings
-    for (int i = 0; i < filesList.size() - 1; ++i) {
-        if (filesList.at(i+1).contains(filesList.at(i))) {
-            filesList[i] = QString(QLatin1Char(' '));
+            // Has the data passed to Process()
+            fd = -2;
         }
 
-        filesList.removeAll(QChar::fromLatin1(' '));
+        return true;
+    }
+
+    bool Process(Item &, const unsigned char *data, unsigned long long size,
+                 unsigned long long) {
+        contents.append(reinterpret_cast<const char *>(data), size);
+
+        return true;
     }
 
-    return filesList;
+    bool FinishedFile(Item &item, int fd) {
+        // Stops the extraction once we have what we came for
+        if (found)
+            return false;
+
+        return pkgDirStream::FinishedFile(item, fd);
+    }
+
+    bool found;
+    QByteArray contents;
+
+private:
+    QString m_fileName;
+
+    static QString normalized(QString name) {
+        while (name.startsWith(QLatin1String("./")))
+            name.remove(0, 2);
+        while (name.startsWith(QLatin1Char('/')))
+            name.remove(0, 1);
+
+        return name;
+    }
+};
+
+// Reads the contents of every file of the data tarball and drops them
+class VerifyStream : public pkgDirStream
+{
+public:
+    bool DoItem(Item &item, int &fd) {
+        // Has the data of files passed to Process()
+        fd = (item.Type == Item::File) ? -2 : -1;
+
+        return true;
+    }
+
+    bool Process(Item &, const unsigned char *, unsigned long long,
+                 unsigned long long) {
+        return true;
+    }
+};
+
+QStringList DebFile::fileList() const
+{
+    FileFd in(d->filePath.toStdString(), FileFd::ReadOnly);
+    debDebFile deb(in);
+    FileListStream stream;
+
+    if (!deb.ExtractArchive(stream)) {
+        _error->Discard();
+        return QStringList();
+    }
+
+    stream.finish();
+    return stream.files;
+}
+
+QByteArray DebFile::readFile(const QString &fileName) const
+{
+    FileFd in(d->filePath.toStdString(), FileFd::ReadOnly);
+    debDebFile deb(in);
+    ReadFileStream stream(fileName);
+
+    // Fails on purpose once the file is found
+    deb.ExtractArchive(stream);
+    _error->Discard();
+
+    return stream.found ? stream.contents : QByteArray();
+}
+
+bool DebFile::verifyData() const
+{
+    FileFd in(d->filePath.toStdString(), FileFd::ReadOnly);
+    debDebFile deb(in);
+    VerifyStream stream;
+
+    if (!deb.ExtractArchive(stream)) {
+        _error->Discard();
+        return false;
+    }
+
+    return true;
 }
 
 QStringList DebFile::iconList() const
@@ -366,4 +535,49 @@ bool DebFile::extractFileFromArchive(const QString &fileName, const QString &des
     return !tar.exitCode();
 }
 
+void DebFile::scan(const QStringList &filePaths, const ScanCallback &callback,
+                   bool withHashes, int threads)
+{
+    if (threads <= 0)
+        threads = QThread::idealThreadCount();
+    threads = qBound(1, threads, filePaths.size());
+
+    std::atomic<int> next(0);
+    QMutex callbackMutex;
+
+    auto work = [&]() {
+        int index;
+        while ((index = next++) < filePaths.size()) {
+            const DebFile debFile(filePaths.at(index));
+            if (withHashes && debFile.isValid())
+                debFile.hashes();
+
+            QMutexLocker locker(&callbackMutex);
+            callback(debFile);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; ++i)
+        pool.emplace_back(work);
+
+    // The calling thread does its share
+    work();
+
+    for (std::thread &thread : pool)
+        thread.join();
+}
+
+void DebFile::scanDirectory(const QString &directory, const ScanCallback &callback,
+                            bool withHashes, int threads)
+{
+    QStringList filePaths;
+    QDirIterator it(directory, QStringList(QLatin1String("*.deb")), QDir::Files,
+                    QDirIterator::Subdirectories | QDirIterator::FollowSymlinks);
+    while (it.hasNext())
+        filePaths << it.next();
+
+    scan(filePaths, callback, withHashes, threads);
+}
+
 }
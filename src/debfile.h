@@ -21,8 +21,11 @@
 #ifndef QAPT_DEBFILE_H
 #define QAPT_DEBFILE_H
 
+#include <QMap>
 #include <QStringList>
 
+#include <functional>
+
 #include "dependencyinfo.h"
 
 namespace QApt {
@@ -157,6 +160,19 @@ public:
     */
     QByteArray md5Sum() const;
 
+   /**
+    * Returns the hex encoded MD5, SHA1 and SHA256 sums of the archive, keyed
+    * by their APT field names "MD5Sum", "SHA1" and "SHA256".
+    *
+    * All of them are computed in a single read of the archive the first
+    * time they're asked for, and kept from then on. md5Sum() shares them.
+    *
+    * @return The sums, or an empty map if the archive can't be read
+    *
+    * @since 3.1
+    */
+    QMap<QString, QByteArray> hashes() const;
+
    /**
     * Returns a list of files that this archive contains
     *
@@ -218,6 +234,63 @@ public:
     */
     bool extractFileFromArchive(const QString &fileName, const QString &destination) const;
 
+   /**
+    * Reads a file from the data of the archive into memory, without
+    * extracting anything to disk. Decompression stops as soon as the file
+    * has been read.
+    *
+    * @param fileName The path of the file in the archive, as returned by
+    * fileList(). The leading "./" may be left out
+    *
+    * @return The contents of the file, or an empty @c QByteArray if the
+    * archive has no regular file of that name
+    *
+    * @since 3.1
+    */
+    QByteArray readFile(const QString &fileName) const;
+
+   /**
+    * Decompresses all of the data of the archive without writing anything,
+    * to find out whether dpkg will be able to unpack it. Leaves the archive
+    * in the page cache.
+    *
+    * @return @c true if the data tarball decompressed without errors
+    *
+    * @since 3.1
+    */
+    bool verifyData() const;
+
+    /// Receives each archive analyzed by scan()
+    typedef std::function<void (const DebFile &debFile)> ScanCallback;
+
+   /**
+    * Opens many archives in parallel, handing each to @p callback as soon
+    * as it has been read. Only the archives being worked on are kept in
+    * memory, each DebFile is destroyed once @p callback returns.
+    *
+    * @p callback is called from the scanning threads, but never for two
+    * archives at the same time. Invalid archives are passed on as well.
+    *
+    * @param filePaths The archives to scan
+    * @param callback What to do with each archive
+    * @param withHashes Whether to compute hashes() in the scanning threads
+    * before handing the archives over
+    * @param threads How many threads to use, all cores if 0
+    *
+    * @since 3.1
+    */
+    static void scan(const QStringList &filePaths, const ScanCallback &callback,
+                     bool withHashes = false, int threads = 0);
+
+   /**
+    * Overload of scan() that scans all .deb files in @p directory and its
+    * subdirectories.
+    *
+    * @since 3.1
+    */
+    static void scanDirectory(const QString &directory, const ScanCallback &callback,
+                              bool withHashes = false, int threads = 0);
+
 private:
     DebFilePrivate *const d;
 };
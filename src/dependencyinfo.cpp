@@ -50,11 +50,11 @@ public:
         , multiArchAnnotation()
     {
         // Check for Multiarch annotation.
-        QStringList parts = package.split(':');
-        Q_ASSERT(parts.size() <= 2);
-        if (parts.size() >= 2) {
-            packageName = parts.takeFirst();
-            multiArchAnnotation = parts.takeFirst();
+        const int colon = package.indexOf(QLatin1Char(':'));
+        Q_ASSERT(colon == -1 || package.indexOf(QLatin1Char(':'), colon + 1) == -1);
+        if (colon != -1) {
+            packageName = package.left(colon);
+            multiArchAnnotation = package.mid(colon + 1);
         }
     }
 
@@ -101,16 +101,19 @@ DependencyInfo &DependencyInfo::operator=(const DependencyInfo &rhs)
 }
 
 QList<DependencyItem> DependencyInfo::parseDepends(const QString &field, DependencyType type)
+{
+    const QByteArray fieldStr = field.toUtf8();
+
+    return parseDepends(fieldStr.constData(), fieldStr.constData() + fieldStr.size(), type);
+}
+
+QList<DependencyItem> DependencyInfo::parseDepends(const char *start, const char *stop,
+                                                   DependencyType type)
 {
     string package;
     string version;
     unsigned int op;
 
-    string fieldStr = field.toStdString();
-
-    const char *start = fieldStr.c_str();
-    const char *stop = start + strlen(start);
-
     QList<DependencyItem> depends;
 
     bool hadOr = false;
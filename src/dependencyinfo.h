@@ -72,6 +72,16 @@ public:
 
     static QList<QList<DependencyInfo> > parseDepends(const QString &field, DependencyType type);
 
+   /**
+    * Overload of parseDepends() that parses the UTF-8 field text in the
+    * range from @p start to @p stop in place, for example straight out of a
+    * package record.
+    *
+    * @since 3.1
+    */
+    static QList<QList<DependencyInfo> > parseDepends(const char *start, const char *stop,
+                                                       DependencyType type);
+
    /**
     * The name of the package that the dependency describes.
     *
@@ -0,0 +1,114 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef QAPT_DESCRIPTIONFORMATTER_H
+#define QAPT_DESCRIPTIONFORMATTER_H
+
+#include <QString>
+#include <QStringBuilder>
+
+namespace QApt {
+
+/**
+ * Formats the extended part of a raw Debian package description for
+ * display, as returned by Package::longDescription().
+ *
+ * Paragraphs separated by " ." lines are separated by a blank line, lines
+ * within a paragraph are joined, runs of spaces are collapsed and items
+ * starting with '-' or '*' are turned into bullet points on lines of
+ * their own. This is done in a single pass over each paragraph.
+ *
+ * @param rawDescription The description with the short description removed
+ */
+inline QString formatLongDescription(const QString &rawDescription)
+{
+    static const QChar bullet(0x2022);
+
+    QString parsedDescription;
+    parsedDescription.reserve(rawDescription.size());
+
+    const QChar *data = rawDescription.constData();
+    const int size = rawDescription.size();
+    int pos = 0;
+    bool firstSection = true;
+
+    while (pos <= size) {
+        // Sections are separated by "\n ."
+        int end = rawDescription.indexOf(QLatin1String("\n ."), pos);
+        if (end == -1) {
+            end = size;
+        }
+
+        QString section;
+        section.reserve(end - pos);
+
+        for (int i = pos; i < end; ++i) {
+            const QChar c = data[i];
+
+            if (c == QLatin1Char('\n')) {
+                // A newline followed by indentation and '-' or '*' is a list item
+                int j = i + 1;
+                while (j < end && (data[j] == QLatin1Char(' ') || data[j] == QLatin1Char('\t'))) {
+                    ++j;
+                }
+
+                if (j > i + 1 && j < end && (data[j] == QLatin1Char('-') || data[j] == QLatin1Char('*'))) {
+                    section += QLatin1Char('\n');
+                    section += QLatin1Char(' ');
+                    section += bullet;
+                    i = j;
+                }
+                // There should be no other new lines within a section.
+                continue;
+            }
+
+            if (c == QLatin1Char('\r')) {
+                section += QLatin1Char('\n');
+            } else if (c == QLatin1Char(' ')) {
+                // Merge multiple whitespace chars into one
+                if (!section.endsWith(QLatin1Char(' '))) {
+                    section += c;
+                }
+            } else {
+                section += c;
+            }
+        }
+
+        // Remove the initial whitespace
+        if (section.startsWith(QLatin1Char(' '))) {
+            section.remove(0, 1);
+        }
+
+        if (firstSection || section.startsWith(QLatin1String("\n ") % bullet % QLatin1Char(' '))) {
+            parsedDescription += section;
+        } else {
+            parsedDescription += QLatin1String("\n\n") % section;
+        }
+
+        firstSection = false;
+        pos = end + 3;
+    }
+
+    return parsedDescription;
+}
+
+}
+
+#endif
@@ -33,9 +33,11 @@ class DownloadProgressPrivate : public QSharedData
 public:
     DownloadProgressPrivate()
         : QSharedData()
+        , id(0)
         , status(QApt::IdleState)
         , fileSize(0)
         , fetchedSize(0)
+        , isUpdate(false)
     {
     }
 
@@ -43,34 +45,40 @@ public:
                             const QString &sDesc, quint64 fSize, quint64 pSize,
                             const QString &sMessage)
         : QSharedData()
+        , id(0)
         , uri(dUri)
         , status(dStatus)
         , shortDesc(sDesc)
         , fileSize(fSize)
         , fetchedSize(pSize)
         , statusMessage(sMessage)
+        , isUpdate(false)
     {
     }
 
     DownloadProgressPrivate(const DownloadProgressPrivate &other)
         : QSharedData(other)
     {
+        id = other.id;
         uri = other.uri;
         status = other.status;
         shortDesc = other.shortDesc;
         fileSize = other.fileSize;
         fetchedSize = other.fetchedSize;
         statusMessage = other.statusMessage;
+        isUpdate = other.isUpdate;
     }
 
     ~DownloadProgressPrivate() {}
 
+    quint32 id;
     QString uri;
     QApt::DownloadStatus status;
     QString shortDesc;
     quint64 fileSize;
     quint64 fetchedSize;
     QString statusMessage;
+    bool isUpdate;
 };
 
 DownloadProgress::DownloadProgress()
@@ -85,6 +93,23 @@ DownloadProgress::DownloadProgress(const QString &uri, QApt::DownloadStatus stat
 {
 }
 
+DownloadProgress::DownloadProgress(quint32 id, const QString &uri, QApt::DownloadStatus status,
+                                   const QString &shortDesc, quint64 fileSize,
+                                   quint64 partialSize, const QString &statusMessage)
+    : d(new DownloadProgressPrivate(uri, status, shortDesc, fileSize, partialSize, statusMessage))
+{
+    d->id = id;
+}
+
+DownloadProgress::DownloadProgress(quint32 id, QApt::DownloadStatus status, quint64 fetchedSize)
+    : d(new DownloadProgressPrivate)
+{
+    d->id = id;
+    d->status = status;
+    d->fetchedSize = fetchedSize;
+    d->isUpdate = true;
+}
+
 DownloadProgress::DownloadProgress(const DownloadProgress &other)
     : d(other.d)
 {
@@ -104,6 +129,32 @@ DownloadProgress &DownloadProgress::operator=(const DownloadProgress &rhs)
     return *this;
 }
 
+quint32 DownloadProgress::id() const
+{
+    return d->id;
+}
+
+bool DownloadProgress::isUpdate() const
+{
+    return d->isUpdate;
+}
+
+DownloadProgress DownloadProgress::applied(const DownloadProgress &update) const
+{
+    DownloadProgress progress(*this);
+    progress.d->status = update.d->status;
+    progress.d->fetchedSize = update.d->fetchedSize;
+
+    if (!update.d->isUpdate) {
+        progress.d->uri = update.d->uri;
+        progress.d->shortDesc = update.d->shortDesc;
+        progress.d->fileSize = update.d->fileSize;
+        progress.d->statusMessage = update.d->statusMessage;
+    }
+
+    return progress;
+}
+
 QString DownloadProgress::uri() const
 {
     return d->uri;
@@ -173,20 +224,37 @@ void DownloadProgress::registerMetaTypes()
 {
     qRegisterMetaType<QApt::DownloadProgress>("QApt::DownloadProgress");
     qDBusRegisterMetaType<QApt::DownloadProgress>();
+    qRegisterMetaType<QList<QApt::DownloadProgress> >("QList<QApt::DownloadProgress>");
+    qDBusRegisterMetaType<QList<QApt::DownloadProgress> >();
 }
 
+// The changing fields come first. D-Bus arrays need a fixed signature, so
+// updates still carry the other fields, but empty: an update costs a few
+// bytes however long the URI and description of its item are
 const QDBusArgument &operator>>(const QDBusArgument &argument,
                                 DownloadProgress &progress)
 {
     argument.beginStructure();
-    QString uri;
-    argument >> uri;
-    progress.setUri(uri);
+    quint32 id;
+    argument >> id;
+    progress.d->id = id;
 
     int status;
     argument >> status;
     progress.setStatus((QApt::DownloadStatus)status);
 
+    quint64 fetchedSize;
+    argument >> fetchedSize;
+    progress.setFetchedSize(fetchedSize);
+
+    bool isUpdate;
+    argument >> isUpdate;
+    progress.d->isUpdate = isUpdate;
+
+    QString uri;
+    argument >> uri;
+    progress.setUri(uri);
+
     QString shortDesc;
     argument >> shortDesc;
     progress.setShortDescription(shortDesc);
@@ -195,10 +263,6 @@ const QDBusArgument &operator>>(const QDBusArgument &argument,
     argument >> fileSize;
     progress.setFileSize(fileSize);
 
-    quint64 fetchedSize;
-    argument >> fetchedSize;
-    progress.setFetchedSize(fetchedSize);
-
     QString statusMessage;
     argument >> statusMessage;
     progress.setStatusMessage(statusMessage);
@@ -211,9 +275,10 @@ const QDBusArgument &operator>>(const QDBusArgument &argument,
 QDBusArgument &operator<<(QDBusArgument &argument, const DownloadProgress &progress)
 {
     argument.beginStructure();
-    argument << progress.uri() << (int)progress.status()
-             << progress.shortDescription() << progress.fileSize()
-             << progress.fetchedSize() << progress.statusMessage();
+    argument << progress.id() << (int)progress.status()
+             << progress.fetchedSize() << progress.isUpdate()
+             << progress.uri() << progress.shortDescription()
+             << progress.fileSize() << progress.statusMessage();
     argument.endStructure();
 
     return argument;
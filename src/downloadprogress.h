@@ -51,6 +51,25 @@ public:
                      const QString &shortDesc, quint64 fileSize,
                      quint64 fetchedSize, const QString &statusMessage);
 
+    /**
+     * Constructs a new download progress for the item with the numeric
+     * ID @p id from the given data.
+     *
+     * @since 3.1
+     */
+    DownloadProgress(quint32 id, const QString &uri, QApt::DownloadStatus status,
+                     const QString &shortDesc, quint64 fileSize,
+                     quint64 fetchedSize, const QString &statusMessage);
+
+    /**
+     * Constructs an update for the item with the ID @p id that only carries
+     * what changes while an item is fetched. The other data is the same as
+     * in the last full progress sent for that ID.
+     *
+     * @since 3.1
+     */
+    DownloadProgress(quint32 id, QApt::DownloadStatus status, quint64 fetchedSize);
+
     /**
      * Constructs a copy of the @a other download progress.
      */
@@ -67,6 +86,35 @@ public:
      */
     DownloadProgress &operator=(const DownloadProgress &rhs);
 
+    /**
+     * Returns the numeric ID of the item, which stays the same for all
+     * progress reported for it during a transaction, or 0 if the progress
+     * was not reported for a specific item.
+     *
+     * @since 3.1
+     */
+    quint32 id() const;
+
+    /**
+     * Returns whether this progress only carries the ID, status and fetched
+     * size of an item, and the rest has to be taken from the last full
+     * progress with the same ID.
+     *
+     * Transaction does that for its clients, so this is only ever true for
+     * progress that was received before the full progress of the item.
+     *
+     * @since 3.1
+     */
+    bool isUpdate() const;
+
+    /**
+     * Returns a copy of the @p update for this item with the data that the
+     * update does not carry filled in from this progress.
+     *
+     * @since 3.1
+     */
+    DownloadProgress applied(const DownloadProgress &update) const;
+
     /**
      * Returns the uniform resource identifier for the file being
      * downloaded. (Its remote path.)
@@ -0,0 +1,277 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "fileownerindex.h"
+
+// Qt includes
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QVector>
+
+#include <algorithm>
+#include <cstring>
+
+namespace QApt {
+
+namespace {
+    struct Header {
+        char magic[4];
+        quint32 version;
+        qint64 stamp;
+        quint32 entryCount;
+        quint32 namesSize;
+        quint64 reserved;
+    };
+
+    const char indexMagic[4] = { 'Q', 'A', 'F', 'O' };
+    // 2 keeps all owners of colliding hashes
+    const quint32 indexVersion = 2;
+
+    struct BuildEntry {
+        quint64 hash;
+        QByteArray path;
+        quint32 nameOffset;
+    };
+}
+
+FileOwnerIndex::FileOwnerIndex(const QString &infoDir, const QString &indexPath)
+    : m_infoDir(infoDir)
+    , m_file(indexPath)
+    , m_stamp(-1)
+    , m_data(nullptr)
+    , m_entries(nullptr)
+    , m_entryCount(0)
+    , m_names(nullptr)
+{
+}
+
+FileOwnerIndex::~FileOwnerIndex()
+{
+    unload();
+}
+
+QString FileOwnerIndex::packageForFile(const QString &file)
+{
+    if (file.isEmpty() || !ensureLoaded()) {
+        return QString();
+    }
+
+    const QByteArray path = QFile::encodeName(file);
+    const quint64 hash = hashPath(path.constData(), path.size());
+
+    const Entry *end = m_entries + m_entryCount;
+    const Entry *found = std::lower_bound(m_entries, end, hash,
+                                          [](const Entry &entry, quint64 value) {
+        return entry.hash < value;
+    });
+
+    // Only the hashes are stored, so check the file lists of the candidates
+    // in case another path has the same hash
+    for (; found != end && found->hash == hash; ++found) {
+        const QString name = QString::fromLatin1(m_names + found->nameOffset);
+        if (listsPath(name, path)) {
+            return name;
+        }
+    }
+
+    return QString();
+}
+
+bool FileOwnerIndex::listsPath(const QString &name, const QByteArray &path) const
+{
+    QFile file(QDir(m_infoDir).filePath(name + QLatin1String(".list")));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    while (!file.atEnd()) {
+        QByteArray line = file.readLine();
+        line.chop(line.endsWith('\n') ? 1 : 0);
+        if (line == path) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+qint64 FileOwnerIndex::size() const
+{
+    return m_data ? m_file.size() : 0;
+}
+
+quint64 FileOwnerIndex::hashPath(const char *path, int length)
+{
+    // 64-bit FNV-1a
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    for (int i = 0; i < length; ++i) {
+        hash ^= static_cast<uchar>(path[i]);
+        hash *= Q_UINT64_C(1099511628211);
+    }
+
+    return hash;
+}
+
+bool FileOwnerIndex::ensureLoaded()
+{
+    const qint64 stamp = QFileInfo(m_infoDir).lastModified().toMSecsSinceEpoch();
+
+    if (m_data && stamp == m_stamp) {
+        return true;
+    }
+
+    unload();
+
+    return load(stamp) || (build(stamp) && load(stamp));
+}
+
+bool FileOwnerIndex::load(qint64 stamp)
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const qint64 fileSize = m_file.size();
+    if (fileSize < qint64(sizeof(Header))) {
+        m_file.close();
+        return false;
+    }
+
+    const uchar *data = m_file.map(0, fileSize);
+    if (!data) {
+        m_file.close();
+        return false;
+    }
+
+    const Header *header = reinterpret_cast<const Header *>(data);
+    const qint64 expectedSize = sizeof(Header) + qint64(header->entryCount) * sizeof(Entry) +
+                                header->namesSize;
+
+    if (memcmp(header->magic, indexMagic, sizeof(indexMagic)) ||
+        header->version != indexVersion || header->stamp != stamp ||
+        expectedSize != fileSize) {
+        m_file.unmap(const_cast<uchar *>(data));
+        m_file.close();
+        return false;
+    }
+
+    m_data = data;
+    m_stamp = stamp;
+    m_entryCount = header->entryCount;
+    m_entries = reinterpret_cast<const Entry *>(data + sizeof(Header));
+    m_names = reinterpret_cast<const char *>(m_entries + m_entryCount);
+
+    return true;
+}
+
+bool FileOwnerIndex::build(qint64 stamp)
+{
+    QDir infoDir(m_infoDir);
+    const QStringList listFiles = infoDir.entryList(QStringList(QLatin1String("*.list")),
+                                                    QDir::Files, QDir::Name);
+
+    QVector<BuildEntry> entries;
+    QByteArray names;
+
+    for (const QString &listFile : listFiles) {
+        QFile file(infoDir.filePath(listFile));
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+
+        const quint32 nameOffset = names.size();
+        names += listFile.leftRef(listFile.size() - 5).toLatin1();
+        names += '\0';
+
+        // A path followed by one of its children is a directory, which
+        // isn't considered to be owned by the package
+        QByteArray previous;
+        while (!file.atEnd()) {
+            QByteArray line = file.readLine();
+            line.chop(line.endsWith('\n') ? 1 : 0);
+
+            if (!previous.isEmpty() && previous != "/." &&
+                !(line.startsWith(previous) && line.size() > previous.size() &&
+                  line.at(previous.size()) == '/')) {
+                entries.append({ hashPath(previous.constData(), previous.size()), previous, nameOffset });
+            }
+
+            previous = line;
+        }
+
+        if (!previous.isEmpty() && previous != "/.") {
+            entries.append({ hashPath(previous.constData(), previous.size()), previous, nameOffset });
+        }
+    }
+
+    // Keep the first owner of each path, like the linear search used to.
+    // Different paths with the same hash all stay
+    std::stable_sort(entries.begin(), entries.end(), [](const BuildEntry &a, const BuildEntry &b) {
+        return a.hash < b.hash || (a.hash == b.hash && a.path < b.path);
+    });
+    entries.erase(std::unique(entries.begin(), entries.end(), [](const BuildEntry &a, const BuildEntry &b) {
+        return a.hash == b.hash && a.path == b.path;
+    }), entries.end());
+
+    QVector<Entry> table;
+    table.reserve(entries.size());
+    for (const BuildEntry &entry : entries) {
+        table.append({ entry.hash, entry.nameOffset, 0 });
+    }
+
+    Header header;
+    memcpy(header.magic, indexMagic, sizeof(indexMagic));
+    header.version = indexVersion;
+    header.stamp = stamp;
+    header.entryCount = table.size();
+    header.namesSize = names.size();
+    header.reserved = 0;
+
+    QDir().mkpath(QFileInfo(m_file.fileName()).absolutePath());
+
+    QSaveFile out(m_file.fileName());
+    if (!out.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(table.constData()), table.size() * sizeof(Entry));
+    out.write(names);
+
+    return out.commit();
+}
+
+void FileOwnerIndex::unload()
+{
+    if (m_data) {
+        m_file.unmap(const_cast<uchar *>(m_data));
+        m_data = nullptr;
+    }
+
+    m_file.close();
+    m_entries = nullptr;
+    m_entryCount = 0;
+    m_names = nullptr;
+    m_stamp = -1;
+}
+
+}
@@ -0,0 +1,88 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef QAPT_FILEOWNERINDEX_H
+#define QAPT_FILEOWNERINDEX_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+namespace QApt {
+
+/**
+ * The FileOwnerIndex class maps installed files to the packages that own
+ * them, much like "dpkg -S" does. It is used internally by QApt::Backend.
+ *
+ * The index is built from the *.list files in the dpkg info directory. It
+ * is stored on disk as a sorted table of path hashes, which is memory-mapped
+ * on load and searched in place. Since different paths can have the same
+ * hash, a match is confirmed against the file list of its package. The
+ * stored index is rebuilt whenever the modification time of the info
+ * directory changes.
+ */
+class FileOwnerIndex
+{
+public:
+    FileOwnerIndex(const QString &infoDir, const QString &indexPath);
+    ~FileOwnerIndex();
+
+    /**
+     * Returns the name of the package owning @p file, in the form used by
+     * the dpkg info directory (with an ":arch" suffix for multiarch
+     * packages). Loads or rebuilds the index first if it is out of date.
+     *
+     * @return the owning package, or an empty string if there is none
+     */
+    QString packageForFile(const QString &file);
+
+    /// Returns the number of bytes the loaded index occupies
+    qint64 size() const;
+
+private:
+    Q_DISABLE_COPY(FileOwnerIndex)
+
+    struct Entry {
+        quint64 hash;
+        quint32 nameOffset;
+        quint32 reserved;
+    };
+
+    static quint64 hashPath(const char *path, int length);
+
+    bool ensureLoaded();
+    // Whether the dpkg file list of package @p name has @p path
+    bool listsPath(const QString &name, const QByteArray &path) const;
+    bool load(qint64 stamp);
+    bool build(qint64 stamp);
+    void unload();
+
+    QString m_infoDir;
+    QFile m_file;
+    qint64 m_stamp;
+    const uchar *m_data;
+    const Entry *m_entries;
+    quint32 m_entryCount;
+    const char *m_names;
+};
+
+}
+
+#endif
@@ -24,6 +24,7 @@
 #include <QFlags>
 #include <QList>
 #include <QVariantMap>
+#include <QVector>
 
 namespace QApt
 {
@@ -44,6 +45,15 @@ namespace QApt
     */
     typedef QList<int> CacheState;
 
+   /**
+    * Defines the CacheSnapshot type, a CacheState that is stored
+    * contiguously. Taking one is constant-time, since it shares the
+    * backend's own state array until the next marking.
+    *
+    * @since 3.1
+    */
+    typedef QVector<int> CacheSnapshot;
+
    /**
     * Defines the GroupList type, which is a QList of Groups (QStrings)
     */
@@ -196,7 +206,35 @@ namespace QApt
         /// The transaction will download package archives
         DownloadArchivesRole,
         /// The transaction will install a .deb file
-        InstallFileRole
+        InstallFileRole,
+        /**
+         * The transaction will download the archives of pending upgrades
+         * into the archive cache without installing them. These are started
+         * by the worker after cache updates if QApt::Prefetch-Upgrades is set
+         * in the APT configuration.
+         *
+         * @since 3.1
+         */
+        PrefetchUpgradesRole
+    };
+
+    /**
+     * @brief How urgently the worker should run a transaction
+     *
+     * Queued transactions run in order of priority, and in the order they
+     * were queued within a priority. A running cache update or archive
+     * download of BackgroundPriority is preempted by more important
+     * transactions while it can be cancelled.
+     *
+     * @since 3.1
+     */
+    enum TransactionPriority {
+        /// A transaction the user is waiting for
+        InteractivePriority = 0,
+        /// A transaction started by a scheduled task
+        ScheduledPriority,
+        /// Optional work, such as prefetching
+        BackgroundPriority
     };
 
     /**
@@ -248,7 +286,31 @@ namespace QApt
         /// QString, the string describing the current error in detail
         ErrorDetailsProperty,
         /// int, the frontend capabilities for the transaction
-        FrontendCapsProperty
+        FrontendCapsProperty,
+        /// quint64, how long marking the packages took in milliseconds
+        MarkingTimeProperty,
+        /// int, the PID of the process holding a lock the transaction waits for
+        LockHolderPidProperty,
+        /// QString, the name of the process holding the lock
+        LockHolderNameProperty,
+        /// quint64, how long the transaction waited for locks in milliseconds
+        LockWaitTimeProperty,
+        /// int, the minimum time between download progress batches in milliseconds
+        DownloadProgressIntervalProperty,
+        /// int, the TransactionPriority of the transaction
+        PriorityProperty,
+        /// quint64, how long the transaction was queued in milliseconds
+        QueueWaitTimeProperty,
+        /**
+         * QVariantMap, the milliseconds spent in each phase of the transaction
+         * as quint64, keyed by "queue", "lock", "cacheOpen", "marking",
+         * "fetch", "dpkg" and "reopen". Phases that didn't happen are missing
+         */
+        PhaseTimesProperty,
+        /// QVariantMap, the FetchPolicy of the transaction, see FetchPolicy::toMap()
+        FetchPolicyProperty,
+        /// QVariantMap, the current download rate from each host in bytes per second
+        HostDownloadSpeedsProperty
     };
 
     /**
@@ -291,7 +353,9 @@ namespace QApt
         ExitCancelled,
         ExitFailed,
         ExitPreviousFailed,
-        ExitUnfinished
+        ExitUnfinished,
+        /// Stopped to let a more important transaction run (@since 3.1)
+        ExitPreempted
     };
 
     /**
@@ -23,12 +23,24 @@
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
-#include <QProcess>
+#include <QHash>
+#include <QMultiMap>
+#include <QSet>
 #include <QSharedData>
 #include <QStringBuilder>
+#include <QVector>
 
 // APT includes
 #include <apt-pkg/configuration.h>
+#include <apt-pkg/error.h>
+#include <apt-pkg/fileutl.h>
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <iterator>
+
+#include <sys/stat.h>
 
 namespace QApt {
 
@@ -50,6 +62,7 @@ class HistoryItemPrivate : public QSharedData
             , downgradedPackages(other.downgradedPackages)
             , removedPackages(other.removedPackages)
             , purgedPackages(other.purgedPackages)
+            , packages(other.packages)
             , error(other.error)
             , isValid(other.isValid)
         {
@@ -62,102 +75,165 @@ class HistoryItemPrivate : public QSharedData
         QStringList downgradedPackages;
         QStringList removedPackages;
         QStringList purgedPackages;
+        QList<HistoryPackage> packages;
         QString error;
         bool isValid;
 
         void parseData(const QString &data);
+        void parsePackages(Package::State action, const QChar *begin, const QChar *end);
 };
 
-void HistoryItemPrivate::parseData(const QString &data)
+static inline bool keyIs(const QChar *begin, const QChar *end, const char *key)
 {
-    QStringList lines = data.split(QLatin1Char('\n'));
+    for (; begin < end && *key; ++begin, ++key) {
+        if (*begin != QLatin1Char(*key))
+            return false;
+    }
 
-    int lineIndex = 0;
+    return begin == end && !*key;
+}
+
+void HistoryItemPrivate::parseData(const QString &data)
+{
+    const QChar *pos = data.constData();
+    const QChar *const dataEnd = pos + data.size();
     bool dateFound = false;
     bool errorFound = false;
 
-    QStringList actionStrings;
-    actionStrings << QLatin1String("Install") << QLatin1String("Upgrade")
-                  << QLatin1String("Downgrade") << QLatin1String("Remove")
-                  << QLatin1String("Purge");
+    while (pos < dataEnd) {
+        const QChar *lineEnd = pos;
+        while (lineEnd < dataEnd && *lineEnd != QLatin1Char('\n'))
+            ++lineEnd;
 
+        const QChar *line = pos;
+        pos = lineEnd + 1;
 
-    while (lineIndex < lines.size()) {
-        QString line = lines.at(lineIndex);
         // skip empty lines and lines beginning with '#'
-        if (line.isEmpty() || line.at(0) == '#') {
-            lineIndex++;
+        if (line == lineEnd || *line == QLatin1Char('#'))
             continue;
-        }
 
-        QStringList keyValue = line.split(QLatin1String(": "));
-        int actionIndex = actionStrings.indexOf(keyValue.value(0));
-        Package::State action;
+        const QChar *keyEnd = line;
+        while (keyEnd + 1 < lineEnd && !(*keyEnd == QLatin1Char(':') && keyEnd[1] == QLatin1Char(' ')))
+            ++keyEnd;
 
         // Invalid
-        if (keyValue.size() < 2) {
+        if (keyEnd + 1 >= lineEnd) {
             isValid = false;
-            lineIndex++;
             continue;
         }
 
-        if (!dateFound && (keyValue.value(0) == QLatin1String("Start-Date"))) {
-            startDate = QDateTime::fromString(keyValue.value(1), QLatin1String("yyyy-MM-dd  hh:mm:ss"));
-        } else if (actionIndex > -1) {
-            switch(actionIndex) {
-            case 0:
-                action = Package::ToInstall;
-                break;
-            case 1:
-                action = Package::ToUpgrade;
-                break;
-            case 2:
-                action = Package::ToDowngrade;
-                break;
-            case 3:
-                action = Package::ToRemove;
-                break;
-            case 4:
-                action = Package::ToPurge;
-                break;
-            default:
-                break;
-            }
-
-            QString actionPackages = keyValue.value(1);
-            // Remove arch info
-            actionPackages.remove(QRegExp(QLatin1String(":\\w+")));
-
-            for (QString package : actionPackages.split(QLatin1String("), "))) {
-                if (!package.endsWith(QLatin1Char(')'))) {
-                    package.append(QLatin1Char(')'));
-                }
-
-                switch (action) {
-                case Package::ToInstall:
-                    installedPackages << package;
-                    break;
-                case Package::ToUpgrade:
-                    upgradedPackages << package;
-                    break;
-                case Package::ToDowngrade:
-                    downgradedPackages << package;
-                    break;
-                case Package::ToRemove:
-                    removedPackages << package;
-                    break;
-                case Package::ToPurge:
-                    purgedPackages << package;
-                    break;
-                default:
-                    break;
-                }
-            }
-        } else if (!errorFound && (keyValue.value(0) == QLatin1String("Error"))) {
-            error = keyValue.value(1);
+        const QChar *value = keyEnd + 2;
+
+        if (keyIs(line, keyEnd, "Install")) {
+            parsePackages(Package::ToInstall, value, lineEnd);
+        } else if (keyIs(line, keyEnd, "Upgrade")) {
+            parsePackages(Package::ToUpgrade, value, lineEnd);
+        } else if (keyIs(line, keyEnd, "Downgrade")) {
+            parsePackages(Package::ToDowngrade, value, lineEnd);
+        } else if (keyIs(line, keyEnd, "Remove")) {
+            parsePackages(Package::ToRemove, value, lineEnd);
+        } else if (keyIs(line, keyEnd, "Purge")) {
+            parsePackages(Package::ToPurge, value, lineEnd);
+        } else if (!dateFound && keyIs(line, keyEnd, "Start-Date")) {
+            startDate = QDateTime::fromString(QString(value, lineEnd - value),
+                                              QLatin1String("yyyy-MM-dd  hh:mm:ss"));
+            dateFound = true;
+        } else if (!errorFound && keyIs(line, keyEnd, "Error")) {
+            error = QString(value, lineEnd - value);
+            errorFound = true;
+        }
+    }
+}
+
+void HistoryItemPrivate::parsePackages(Package::State action, const QChar *begin, const QChar *end)
+{
+    QStringList *list;
+    switch (action) {
+    case Package::ToInstall:
+        list = &installedPackages;
+        break;
+    case Package::ToUpgrade:
+        list = &upgradedPackages;
+        break;
+    case Package::ToDowngrade:
+        list = &downgradedPackages;
+        break;
+    case Package::ToRemove:
+        list = &removedPackages;
+        break;
+    default:
+        list = &purgedPackages;
+        break;
+    }
+
+    // Entries look like "name:arch (version[, version][, automatic])",
+    // separated by ", "
+    const QChar *pos = begin;
+    while (pos < end) {
+        while (pos < end && (*pos == QLatin1Char(' ') || *pos == QLatin1Char(',')))
+            ++pos;
+        if (pos == end)
+            break;
+
+        HistoryPackage package;
+        package.action = action;
+        package.automatic = false;
+
+        const QChar *nameStart = pos;
+        while (pos < end && *pos != QLatin1Char(':') && *pos != QLatin1Char(' ') && *pos != QLatin1Char('('))
+            ++pos;
+        package.name = QString(nameStart, pos - nameStart);
+
+        if (pos < end && *pos == QLatin1Char(':')) {
+            const QChar *archStart = ++pos;
+            while (pos < end && *pos != QLatin1Char(' ') && *pos != QLatin1Char('('))
+                ++pos;
+            package.architecture = QString(archStart, pos - archStart);
+        }
+
+        while (pos < end && *pos == QLatin1Char(' '))
+            ++pos;
+
+        const QChar *detailsStart = pos;
+        const QChar *detailsEnd = pos;
+        if (pos < end && *pos == QLatin1Char('(')) {
+            detailsStart = ++pos;
+            while (pos < end && *pos != QLatin1Char(')'))
+                ++pos;
+            detailsEnd = pos;
+            if (pos < end)
+                ++pos;
+        }
+
+        // Split the details on ", "
+        QString fields[2];
+        int fieldCount = 0;
+        const QChar *field = detailsStart;
+        while (field < detailsEnd) {
+            const QChar *fieldEnd = field;
+            while (fieldEnd < detailsEnd && *fieldEnd != QLatin1Char(','))
+                ++fieldEnd;
+
+            if (keyIs(field, fieldEnd, "automatic"))
+                package.automatic = true;
+            else if (fieldCount < 2)
+                fields[fieldCount++] = QString(field, fieldEnd - field);
+
+            field = fieldEnd + 1;
+            while (field < detailsEnd && *field == QLatin1Char(' '))
+                ++field;
         }
 
-        lineIndex++;
+        if (fieldCount == 2) {
+            package.previousVersion = fields[0];
+            package.version = fields[1];
+        } else {
+            package.version = fields[0];
+        }
+
+        *list << QString(package.name % QLatin1String(" (")
+                         % QString(detailsStart, detailsEnd - detailsStart) % QLatin1Char(')'));
+        packages << package;
     }
 }
 
@@ -210,6 +286,11 @@ QString HistoryItem::errorString() const
     return d->error;
 }
 
+QList<HistoryPackage> HistoryItem::packages() const
+{
+    return d->packages;
+}
+
 bool HistoryItem::isValid() const
 {
     return d->isValid;
@@ -217,6 +298,16 @@ bool HistoryItem::isValid() const
 
 
 
+struct HistoryLog
+{
+    QString filePath;
+    // The decompressed log, empty until it's needed
+    QByteArray data;
+    // Start and end of each stanza in data, oldest first
+    QVector<QPair<int, int> > stanzas;
+    bool loaded;
+};
+
 class HistoryPrivate
 {
     public:
@@ -227,47 +318,239 @@ class HistoryPrivate
 
         // Data
         QString historyFilePath;
-        HistoryItemList historyItemList;
+        mutable QVector<HistoryLog> logs;
+        // Parsed items, newest first
+        mutable HistoryItemList historyItemList;
+        // Where parsing stopped: the log being read and the number of its
+        // stanzas that are still to be parsed
+        mutable int logIndex;
+        mutable int stanzasLeft;
+        // The inode of the current log when it was listed, and how much of
+        // it has been read (-1 if nothing yet)
+        ino_t currentInode;
+        mutable qint64 currentOffset;
+
+        // Parsed items by package name and by start date, newest first
+        mutable QHash<QString, HistoryItemList> packageIndex;
+        mutable QMultiMap<QDateTime, HistoryItem> dateIndex;
 
         void init();
+        void parseItems(int count) const;
+        void index(const HistoryItem &item, bool newest) const;
+        void loadLog(HistoryLog &log) const;
+        bool appendNewItems(HistoryItemList *added);
 };
 
+static QVector<QPair<int, int> > splitStanzas(const QByteArray &text)
+{
+    // Stanzas are separated by empty lines
+    QVector<QPair<int, int> > stanzas;
+    const QByteArray separator("\n\n");
+    const char *data = text.constData();
+    int pos = 0;
+
+    while (pos < text.size()) {
+        int end = text.indexOf(separator, pos);
+        if (end == -1)
+            end = text.size();
+
+        int start = pos;
+        while (start < end && isspace(uchar(data[start])))
+            ++start;
+        int stop = end;
+        while (stop > start && isspace(uchar(data[stop - 1])))
+            --stop;
+
+        if (stop > start)
+            stanzas.append(qMakePair(start, stop));
+
+        pos = end + separator.size();
+    }
+
+    return stanzas;
+}
+
+static bool isComplete(const QByteArray &text, const QPair<int, int> &stanza)
+{
+    // APT adds End-Date once the transaction has finished
+    int end = text.indexOf("End-Date:", stanza.first);
+    return end != -1 && end < stanza.second;
+}
+
+static int rotationNumber(const QString &suffix)
+{
+    // history.log is 0, history.log.1.gz is 1, etc.
+    if (suffix.isEmpty())
+        return 0;
+
+    QString number = suffix.mid(1);
+    if (number.endsWith(QLatin1String(".gz")))
+        number.chop(3);
+
+    bool ok;
+    int rotation = number.toInt(&ok);
+    return ok ? rotation : INT_MAX;
+}
+
 void HistoryPrivate::init()
 {
-    QString data;
+    logs.clear();
+    historyItemList.clear();
+    packageIndex.clear();
+    dateIndex.clear();
+    logIndex = 0;
+    stanzasLeft = -1;
+    currentInode = 0;
+    currentOffset = -1;
+
+    struct stat buf;
+    if (stat(QFile::encodeName(historyFilePath).constData(), &buf) == 0)
+        currentInode = buf.st_ino;
 
     QFileInfo historyFile(historyFilePath);
-    QString directoryPath = historyFile.absoluteDir().absolutePath();
-    QDir logDirectory(directoryPath);
-    QStringList logFiles = logDirectory.entryList(QDir::Files, QDir::Name);
+    const QString baseName = historyFile.fileName();
+    QDir logDirectory(historyFile.absolutePath());
+    QStringList logFiles = logDirectory.entryList(QStringList(baseName + QLatin1Char('*')),
+                                                  QDir::Files, QDir::Name);
 
-    QString fullPath;
+    // Newest first
+    std::stable_sort(logFiles.begin(), logFiles.end(),
+                     [&baseName](const QString &a, const QString &b) {
+        return rotationNumber(a.mid(baseName.size())) < rotationNumber(b.mid(baseName.size()));
+    });
 
     for (const QString &file : logFiles) {
-        fullPath = directoryPath % '/' % file;
-        if (fullPath.contains(QLatin1String("history"))) {
-            if (fullPath.endsWith(QLatin1String(".gz"))) {
-                QProcess gunzip;
-                gunzip.start(QLatin1String("gunzip"), QStringList() << QLatin1String("-c") << fullPath);
-                gunzip.waitForFinished();
-
-                data.append(gunzip.readAll());
-            } else {
-                QFile historyFile(fullPath);
-
-                if (historyFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-                    data.append(historyFile.readAll());
-                }
-            }
+        HistoryLog log;
+        log.filePath = logDirectory.filePath(file);
+        log.loaded = false;
+        logs.append(log);
+    }
+}
+
+void HistoryPrivate::loadLog(HistoryLog &log) const
+{
+    log.loaded = true;
+
+    // FileFd takes care of decompressing rotated logs
+    FileFd fd;
+    if (!fd.Open(log.filePath.toStdString(), FileFd::ReadOnly, FileFd::Extension)) {
+        _error->Discard();
+        return;
+    }
+
+    char buffer[64 * 1024];
+    unsigned long long actual = 0;
+    while (fd.Read(buffer, sizeof(buffer), &actual) && actual > 0)
+        log.data.append(buffer, actual);
+    _error->Discard();
+
+    log.stanzas = splitStanzas(log.data);
+
+    if (&log == &logs.first() && log.filePath == historyFilePath) {
+        // A transaction that is still running gets picked up by reload()
+        // once it has finished
+        if (!log.stanzas.isEmpty() && !isComplete(log.data, log.stanzas.last())) {
+            currentOffset = log.stanzas.last().first;
+            log.stanzas.removeLast();
+        } else {
+            currentOffset = log.data.size();
         }
     }
+}
 
-    data = data.trimmed();
-    QStringList stanzas = data.split(QLatin1String("\n\n"));
-    for (const QString &stanza : stanzas) {
-        const HistoryItem historyItem(stanza);
+bool HistoryPrivate::appendNewItems(HistoryItemList *added)
+{
+    if (logs.isEmpty() || logs.first().filePath != historyFilePath)
+        return false;
+
+    struct stat buf;
+    if (stat(QFile::encodeName(historyFilePath).constData(), &buf) != 0 ||
+        buf.st_ino != currentInode) {
+        // Rotated
+        return false;
+    }
+
+    // Nothing read yet, loading the log will see the new items
+    if (currentOffset == -1)
+        return true;
+
+    if (buf.st_size < currentOffset)
+        return false;
+
+    QFile file(historyFilePath);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(currentOffset))
+        return false;
+
+    const QByteArray text = file.readAll();
+    QVector<QPair<int, int> > stanzas = splitStanzas(text);
+
+    if (!stanzas.isEmpty() && !isComplete(text, stanzas.last())) {
+        currentOffset += stanzas.last().first;
+        stanzas.removeLast();
+    } else {
+        currentOffset += text.size();
+    }
+
+    // Newest first
+    for (int i = stanzas.size() - 1; i >= 0; --i) {
+        const QPair<int, int> &stanza = stanzas.at(i);
+        const HistoryItem historyItem(QString::fromUtf8(text.constData() + stanza.first,
+                                                        stanza.second - stanza.first));
         if (historyItem.isValid())
+            *added << historyItem;
+    }
+
+    historyItemList = *added + historyItemList;
+    for (int i = added->size() - 1; i >= 0; --i)
+        index(added->at(i), true);
+
+    return true;
+}
+
+void HistoryPrivate::parseItems(int count) const
+{
+    while (historyItemList.size() < count && logIndex < logs.size()) {
+        HistoryLog &log = logs[logIndex];
+
+        if (!log.loaded) {
+            loadLog(log);
+            stanzasLeft = log.stanzas.size();
+        }
+
+        if (stanzasLeft <= 0) {
+            // Done with this log, its text is no longer needed
+            log.data.clear();
+            log.stanzas.clear();
+            ++logIndex;
+            stanzasLeft = -1;
+            continue;
+        }
+
+        --stanzasLeft;
+        const QPair<int, int> &stanza = log.stanzas.at(stanzasLeft);
+        const HistoryItem historyItem(QString::fromUtf8(log.data.constData() + stanza.first,
+                                                        stanza.second - stanza.first));
+        if (historyItem.isValid()) {
             historyItemList << historyItem;
+            index(historyItem, false);
+        }
+    }
+}
+
+void HistoryPrivate::index(const HistoryItem &item, bool newest) const
+{
+    dateIndex.insert(item.startDate(), item);
+
+    QSet<QString> names;
+    for (const HistoryPackage &package : item.packages())
+        names << package.name;
+
+    for (const QString &name : names) {
+        HistoryItemList &items = packageIndex[name];
+        if (newest)
+            items.prepend(item);
+        else
+            items.append(item);
     }
 }
 
@@ -286,15 +569,73 @@ HistoryItemList History::historyItems() const
 {
     Q_D(const History);
 
-    return d->historyItemList;
+    d->parseItems(INT_MAX);
+
+    HistoryItemList items;
+    items.reserve(d->historyItemList.size());
+    std::reverse_copy(d->historyItemList.constBegin(), d->historyItemList.constEnd(),
+                      std::back_inserter(items));
+
+    return items;
+}
+
+HistoryItemList History::items(int offset, int count) const
+{
+    Q_D(const History);
+
+    if (offset < 0 || count <= 0)
+        return HistoryItemList();
+
+    d->parseItems(count > INT_MAX - offset ? INT_MAX : offset + count);
+
+    return d->historyItemList.mid(offset, count);
+}
+
+HistoryItemList History::itemsForPackage(const QString &name) const
+{
+    Q_D(const History);
+
+    d->parseItems(INT_MAX);
+
+    return d->packageIndex.value(name);
+}
+
+HistoryItemList History::itemsBetween(const QDateTime &from, const QDateTime &to) const
+{
+    Q_D(const History);
+
+    // Items come newest first, so parsing can stop once one predates from
+    int parsed = d->historyItemList.size();
+    while (parsed == 0 || d->historyItemList.last().startDate() >= from) {
+        d->parseItems(parsed + 1);
+        if (d->historyItemList.size() == parsed)
+            break;
+        parsed = d->historyItemList.size();
+    }
+
+    HistoryItemList items;
+    auto begin = d->dateIndex.lowerBound(from);
+    auto it = d->dateIndex.upperBound(to);
+    while (it != begin) {
+        --it;
+        items << it.value();
+    }
+
+    return items;
 }
 
 void History::reload()
 {
     Q_D(History);
 
-    d->historyItemList.clear();
-    d->init();
+    HistoryItemList added;
+    if (!d->appendNewItems(&added)) {
+        d->init();
+        return;
+    }
+
+    if (!added.isEmpty())
+        emit itemsAdded(added);
 }
  
 }
@@ -35,6 +35,27 @@
  */
 namespace QApt {
 
+/**
+ * A single package change recorded in a HistoryItem
+ *
+ * @since 3.1
+ */
+struct HistoryPackage
+{
+    /// Whether the package was installed, upgraded, downgraded, removed or purged
+    Package::State action;
+    /// The name of the package
+    QString name;
+    /// The architecture of the package, if the log records it
+    QString architecture;
+    /// The version installed, or removed for removals and purges
+    QString version;
+    /// The version that was replaced by an upgrade or downgrade
+    QString previousVersion;
+    /// Whether the package was installed automatically
+    bool automatic;
+};
+
 /**
  * HistoryItemPrivate is a class containing all private members of the HistoryItem class
  */
@@ -117,6 +138,14 @@ public:
     */
     QStringList purgedPackages() const;
 
+   /**
+    * Returns every package changed by the transaction, in the order they
+    * appear in the log
+    *
+    * @since 3.1
+    */
+    QList<HistoryPackage> packages() const;
+
    /**
     * Returns the error reported by dpkg, if there is one. If the transaction
     * did not encounter an error, this will return an empty QString.
@@ -165,10 +194,58 @@ public:
     ~History();
 
     /**
-     * Returns a list of all history items in APT's history logs.
+     * Returns a list of all history items in APT's history logs, oldest
+     * first.
+     *
+     * This reads and parses every log, including all rotated ones. Use
+     * items() to only read as much as will be shown.
      */
     HistoryItemList historyItems() const;
 
+    /**
+     * Returns up to @p count history items, newest first, skipping the
+     * @p offset most recent ones. Fewer items are returned once the oldest
+     * log has been reached.
+     *
+     * Logs are only read and decompressed as far back as the requested
+     * items go, and each stanza is parsed once.
+     *
+     * @since 3.1
+     */
+    HistoryItemList items(int offset, int count) const;
+
+    /**
+     * Returns all history items in which the package @p name was installed,
+     * upgraded, downgraded, removed or purged, newest first.
+     *
+     * All logs are read the first time this is called; later calls are
+     * answered from an index.
+     *
+     * @since 3.1
+     */
+    HistoryItemList itemsForPackage(const QString &name) const;
+
+    /**
+     * Returns all history items that started between @p from and @p to,
+     * inclusive, newest first.
+     *
+     * Logs are only read as far back as @p from.
+     *
+     * @since 3.1
+     */
+    HistoryItemList itemsBetween(const QDateTime &from, const QDateTime &to) const;
+
+Q_SIGNALS:
+   /**
+    * Emitted by reload() when new transactions have been appended to the
+    * current history log.
+    *
+    * @param items The new items, newest first
+    *
+    * @since 3.1
+    */
+    void itemsAdded(const QApt::HistoryItemList &items);
+
 private:
     Q_DECLARE_PRIVATE(History)
     HistoryPrivate *const d_ptr;
@@ -178,6 +255,11 @@ public Q_SLOTS:
     * Re-initializes the history log data. This should be connected to a
     * directory watch (such as KDirWatch) to catch changes to the history
     * file on-the-fly, if desired
+    *
+    * Only the part of the history log written since it was last read is
+    * parsed, and itemsAdded() is emitted for it. If the logs have been
+    * rotated in the meantime, everything is read again. Transactions that
+    * are still running are only listed once they have finished.
     */
     void reload();
 };
@@ -185,5 +267,6 @@ public Q_SLOTS:
 }
 
 Q_DECLARE_TYPEINFO(QApt::HistoryItem, Q_MOVABLE_TYPE);
+Q_DECLARE_TYPEINFO(QApt::HistoryPackage, Q_MOVABLE_TYPE);
 
 #endif
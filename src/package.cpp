@@ -25,9 +25,11 @@
 #include "package.h"
 
 // Qt includes
-#include <QCryptographicHash>
 #include <QDebug>
 #include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QReadWriteLock>
 #include <QStringBuilder>
 #include <QStringList>
 #include <QTemporaryFile>
@@ -47,13 +49,16 @@
 #include <apt-pkg/versionmatch.h>
 
 #include <algorithm>
-#include <random>
+#include <cstring>
+#include <new>
 
 // Own includes
 #include "backend.h"
 #include "cache.h"
 #include "config.h" // krazy:exclude=includes
+#include "descriptionformatter.h"
 #include "markingerrorinfo.h"
+#include "updatephase.h"
 
 namespace QApt {
 
@@ -68,6 +73,9 @@ class PackagePrivate
             , foreignArchCalculated(false)
             , isInUpdatePhase(false)
             , inUpdatePhaseCalculated(false)
+            , arenaAllocated(false)
+            , longDescriptionVersion(-1)
+            , dependsVersion(-1)
         {
         }
 
@@ -83,15 +91,59 @@ class PackagePrivate
         bool foreignArchCalculated;
         bool isInUpdatePhase;
         bool inUpdatePhaseCalculated;
+        // Whether we live in a PackageArena rather than on the heap
+        bool arenaAllocated;
+        // Formatted long description, and the ID of the version it is for
+        QString longDescription;
+        qint64 longDescriptionVersion;
+        // Parsed dependency fields by type, and the ID of the version they are for
+        QHash<int, QList<DependencyItem> > depends;
+        qint64 dependsVersion;
+
+        QList<DependencyItem> parsedDepends(const char *field, DependencyType type);
 
         pkgCache::PkgFileIterator searchPkgFileIter(QLatin1String label, const QString &release) const;
 
         // Calculate state flags that cannot change
         void initStaticState(const pkgCache::VerIterator &ver, pkgDepCache::StateCache &stateCache);
+        // Recalculate the static state flags that other packages influence
+        void refreshDependencyState(pkgDepCache::StateCache &stateCache);
 
         bool setInUpdatePhase(bool inUpdatePhase);
 };
 
+QList<DependencyItem> PackagePrivate::parsedDepends(const char *field, DependencyType type)
+{
+    const pkgCache::VerIterator &ver = (*backend->cache()->depCache()).GetCandidateVer(packageIter);
+    if (ver.end()) {
+        return QList<DependencyItem>();
+    }
+
+    // Dependency fields only change along with the candidate
+    QMutexLocker locker(backend->memoMutex());
+    if (dependsVersion != ver->ID) {
+        depends.clear();
+        dependsVersion = ver->ID;
+    }
+
+    auto it = depends.constFind(type);
+    if (it != depends.constEnd()) {
+        return *it;
+    }
+    locker.unlock();
+
+    pkgRecords::Parser &rec = backend->records()->Lookup(ver.FileList());
+    const std::string text = rec.RecordField(field);
+    const QList<DependencyItem> parsed = DependencyInfo::parseDepends(text.data(), text.data() + text.size(), type);
+
+    locker.relock();
+    if (dependsVersion == ver->ID) {
+        depends.insert(type, parsed);
+    }
+
+    return parsed;
+}
+
 pkgCache::PkgFileIterator PackagePrivate::searchPkgFileIter(QLatin1String label, const QString &release) const
 {
     pkgCache::VerIterator verIter = packageIter.VersionList();
@@ -118,7 +170,10 @@ pkgCache::PkgFileIterator PackagePrivate::searchPkgFileIter(QLatin1String label,
     return found;
 }
 
-void PackagePrivate::initStaticState(const pkgCache::VerIterator &ver, pkgDepCache::StateCache &stateCache)
+// The flags of Package::state() that only change with a cache reload, or
+// that other packages influence
+static int staticStateFlags(pkgDepCache *depCache, const pkgCache::PkgIterator &iter,
+                            const pkgCache::VerIterator &ver, pkgDepCache::StateCache &stateCache)
 {
     int packageState = 0;
 
@@ -154,12 +209,12 @@ void PackagePrivate::initStaticState(const pkgCache::VerIterator &ver, pkgDepCac
     }
 
     // Essential/important status can only be changed by cache reload
-    if (packageIter->Flags & (pkgCache::Flag::Important |
-                             pkgCache::Flag::Essential)) {
+    if (iter->Flags & (pkgCache::Flag::Important |
+                       pkgCache::Flag::Essential)) {
         packageState |= QApt::Package::IsImportant;
     }
 
-    if (packageIter->CurrentState == pkgCache::State::ConfigFiles) {
+    if (iter->CurrentState == pkgCache::State::ConfigFiles) {
         packageState |= QApt::Package::ResidualConfig;
     }
 
@@ -167,17 +222,87 @@ void PackagePrivate::initStaticState(const pkgCache::VerIterator &ver, pkgDepCac
     // and the cache is reloaded.
     bool downloadable = true;
     if (!stateCache.CandidateVer ||
-        !stateCache.CandidateVerIter(*backend->cache()->depCache()).Downloadable())
+        !stateCache.CandidateVerIter(*depCache).Downloadable())
         downloadable = false;
 
     if (!downloadable)
         packageState |= QApt::Package::NotDownloadable;
 
-    state |= packageState;
+    return packageState;
+}
+
+// The flags of Package::state() that follow the marking
+static int markingStateFlags(pkgDepCache::StateCache &stateCache)
+{
+    int packageState = 0;
+
+    if (stateCache.Install()) {
+        packageState |= Package::ToInstall;
+    }
+
+    if (stateCache.Flags & pkgCache::Flag::Auto) {
+        packageState |= QApt::Package::IsAuto;
+    }
+
+    if (stateCache.iFlags & pkgDepCache::ReInstall) {
+        packageState |= Package::ToReInstall;
+    } else if (stateCache.NewInstall()) { // Order matters here.
+        packageState |= Package::NewInstall;
+    } else if (stateCache.Upgrade()) {
+        packageState |= Package::ToUpgrade;
+    } else if (stateCache.Downgrade()) {
+        packageState |= Package::ToDowngrade;
+    } else if (stateCache.Delete()) {
+        packageState |= Package::ToRemove;
+        if (stateCache.iFlags & pkgDepCache::Purge) {
+            packageState |= Package::ToPurge;
+        }
+    } else if (stateCache.Keep()) {
+        packageState |= Package::ToKeep;
+        if (stateCache.Held()) {
+            packageState |= QApt::Package::Held;
+        }
+    }
+
+    return packageState;
+}
+
+void PackagePrivate::initStaticState(const pkgCache::VerIterator &ver, pkgDepCache::StateCache &stateCache)
+{
+    state |= staticStateFlags(backend->cache()->depCache(), packageIter, ver, stateCache);
 
     staticStateCalculated = true;
 }
 
+void PackagePrivate::refreshDependencyState(pkgDepCache::StateCache &stateCache)
+{
+    // These depend on the rest of the system rather than on the package
+    // itself, so they can change without the package being touched
+    state &= ~(QApt::Package::NowBroken | QApt::Package::InstallBroken |
+               QApt::Package::IsGarbage | QApt::Package::NowPolicyBroken |
+               QApt::Package::InstallPolicyBroken);
+
+    if (stateCache.NowBroken()) {
+        state |= QApt::Package::NowBroken;
+    }
+
+    if (stateCache.InstBroken()) {
+        state |= QApt::Package::InstallBroken;
+    }
+
+    if (stateCache.Garbage) {
+        state |= QApt::Package::IsGarbage;
+    }
+
+    if (stateCache.NowPolicyBroken()) {
+        state |= QApt::Package::NowPolicyBroken;
+    }
+
+    if (stateCache.InstPolicyBroken()) {
+        state |= QApt::Package::InstallPolicyBroken;
+    }
+}
+
 bool PackagePrivate::setInUpdatePhase(bool inUpdatePhase)
 {
     inUpdatePhaseCalculated = true;
@@ -190,9 +315,73 @@ Package::Package(QApt::Backend* backend, pkgCache::PkgIterator &packageIter)
 {
 }
 
+Package::Package(QApt::Backend* backend, pkgCache::PkgIterator &packageIter, void *privateStorage)
+        : d(new (privateStorage) PackagePrivate(packageIter, backend))
+{
+    d->arenaAllocated = true;
+}
+
 Package::~Package()
 {
-    delete d;
+    if (d->arenaAllocated) {
+        // The arena owns the memory, only tear down the object itself
+        d->~PackagePrivate();
+    } else {
+        delete d;
+    }
+}
+
+qint64 Package::cachedBytes() const
+{
+    qint64 bytes = d->longDescription.capacity() * sizeof(QChar);
+
+    for (auto it = d->depends.constBegin(); it != d->depends.constEnd(); ++it) {
+        for (const DependencyItem &item : it.value()) {
+            bytes += sizeof(DependencyItem);
+            for (const DependencyInfo &info : item) {
+                bytes += sizeof(DependencyInfo) +
+                         (info.packageName().size() + info.packageVersion().size()) * sizeof(QChar);
+            }
+        }
+    }
+
+    return bytes;
+}
+
+size_t Package::privateSize()
+{
+    return sizeof(PackagePrivate);
+}
+
+void Package::rebind(pkgCache::PkgIterator &packageIter, bool installedChanged)
+{
+    d->packageIter = packageIter;
+    d->longDescriptionVersion = -1;
+    d->dependsVersion = -1;
+    d->depends.clear();
+    // The candidate may have changed
+    d->inUpdatePhaseCalculated = false;
+
+    // Marking flags do not survive a reload, neither do pins (the backend
+    // loads those again)
+    d->state &= ~(IsManuallyHeld | OverrideVersion | IsPinned);
+
+    if (installedChanged) {
+        d->state = 0;
+        d->staticStateCalculated = false;
+    } else if (d->staticStateCalculated) {
+        d->refreshDependencyState((*d->backend->cache()->depCache())[d->packageIter]);
+    }
+}
+
+bool Package::isUpdatePhaseCalculated() const
+{
+    return d->inUpdatePhaseCalculated;
+}
+
+void Package::setInUpdatePhase(bool inUpdatePhase)
+{
+    d->setInUpdatePhase(inUpdatePhase);
 }
 
 const pkgCache::PkgIterator &Package::packageIterator() const
@@ -256,40 +445,26 @@ QString Package::longDescription() const
     const pkgCache::VerIterator &ver = (*d->backend->cache()->depCache()).GetCandidateVer(d->packageIter);
 
     if (!ver.end()) {
-        QString rawDescription;
+        // The formatted description only changes along with the candidate
+        QMutexLocker locker(d->backend->memoMutex());
+        if (d->longDescriptionVersion == ver->ID) {
+            return d->longDescription;
+        }
+        locker.unlock();
+
         pkgCache::DescIterator Desc = ver.TranslatedDescription();
         pkgRecords::Parser & parser = d->backend->records()->Lookup(Desc.FileList());
-        rawDescription = QString::fromUtf8(parser.LongDesc().data());
+        QString rawDescription = QString::fromUtf8(parser.LongDesc().data());
         // Apt acutally returns the whole description, we just want the
         // extended part.
-        rawDescription.remove(shortDescription() % '\n');
-        // *Now* we're really raw. Sort of. ;)
-
-        QString parsedDescription;
-        // Split at double newline, by "section"
-        QStringList sections = rawDescription.split(QLatin1String("\n ."));
-
-        for (int i = 0; i < sections.count(); ++i) {
-            sections[i].replace(QRegExp(QLatin1String("\n( |\t)+(-|\\*)")),
-                                QLatin1Literal("\n\r ") % QString::fromUtf8("\xE2\x80\xA2"));
-            // There should be no new lines within a section.
-            sections[i].remove(QLatin1Char('\n'));
-            // Hack to get the lists working again.
-            sections[i].replace(QLatin1Char('\r'), QLatin1Char('\n'));
-            // Merge multiple whitespace chars into one
-            sections[i].replace(QRegExp(QLatin1String("\\ \\ +")), QChar::fromLatin1(' '));
-            // Remove the initial whitespace
-            if (sections[i].startsWith(QChar::Space)) {
-                sections[i].remove(0, 1);
-            }
-            // Append to parsedDescription
-            if (sections[i].startsWith(QLatin1String("\n ") % QString::fromUtf8("\xE2\x80\xA2 ")) || !i) {
-                parsedDescription += sections[i];
-            }  else {
-                parsedDescription += QLatin1Literal("\n\n") % sections[i];
-            }
-        }
-        return parsedDescription;
+        rawDescription.remove(QString::fromUtf8(parser.ShortDesc().data()) % '\n');
+
+        const QString longDescription = formatLongDescription(rawDescription);
+
+        locker.relock();
+        d->longDescription = longDescription;
+        d->longDescriptionVersion = ver->ID;
+        return longDescription;
     }
 
     return QString();
@@ -321,11 +496,17 @@ QString Package::homepage() const
 }
 
 QString Package::version() const
+{
+    const QLatin1String view = versionView();
+    return view.data() ? QString(view) : QString();
+}
+
+QLatin1String Package::versionView() const
 {
     if (!d->packageIter->CurrentVer) {
         pkgDepCache::StateCache &State = (*d->backend->cache()->depCache())[d->packageIter];
         if (!State.CandidateVer) {
-            return QString();
+            return QLatin1String();
         } else {
             return QLatin1String(State.CandidateVerIter(*d->backend->cache()->depCache()).VerStr());
         }
@@ -359,6 +540,11 @@ QString Package::upstreamVersion(const QString &version)
 }
 
 QString Package::architecture() const
+{
+    return architectureView();
+}
+
+QLatin1String Package::architectureView() const
 {
     pkgDepCache *depCache = d->backend->cache()->depCache();
     pkgCache::VerIterator ver = (*depCache)[d->packageIter].InstVerIter(*depCache);
@@ -396,74 +582,129 @@ QStringList Package::availableVersions() const
 }
 
 QString Package::installedVersion() const
+{
+    const QLatin1String view = installedVersionView();
+    return view.data() ? QString(view) : QString();
+}
+
+QLatin1String Package::installedVersionView() const
 {
     if (!d->packageIter->CurrentVer) {
-        return QString();
+        return QLatin1String();
     }
 
     return QLatin1String(d->packageIter.CurrentVer().VerStr());
 }
 
 QString Package::availableVersion() const
+{
+    const QLatin1String view = availableVersionView();
+    return view.data() ? QString(view) : QString();
+}
+
+QLatin1String Package::availableVersionView() const
 {
     pkgDepCache::StateCache &State = (*d->backend->cache()->depCache())[d->packageIter];
     if (!State.CandidateVer) {
-        return QString();
+        return QLatin1String();
     }
 
     return QLatin1String(State.CandidateVerIter(*d->backend->cache()->depCache()).VerStr());
 }
 
 QString Package::priority() const
+{
+    const QLatin1String view = priorityView();
+    return view.data() ? QString(view) : QString();
+}
+
+QLatin1String Package::priorityView() const
 {
     const pkgCache::VerIterator &ver = (*d->backend->cache()->depCache()).GetCandidateVer(d->packageIter);
     if (ver.end())
-        return QString();
+        return QLatin1String();
 
+    // PriorityType() returns static strings
     return QLatin1String(ver.PriorityType());
 }
 
 QStringList Package::installedFilesList() const
 {
     QStringList installedFilesList;
-    QString path = QLatin1String("/var/lib/dpkg/info/") % name() % QLatin1String(".list");
 
-    // Fallback for multiarch packages
-    if (!QFile::exists(path)) {
-        path = QLatin1String("/var/lib/dpkg/info/") % name() % ':' %
-                             architecture() % QLatin1String(".list");
+    forEachInstalledFile([&installedFilesList](const QByteArray &path) {
+        installedFilesList << QFile::decodeName(path);
+        return true;
+    });
+
+    return installedFilesList;
+}
+
+bool Package::forEachInstalledFile(const std::function<bool (const QByteArray &path)> &callback) const
+{
+    const QString base = QLatin1String("/var/lib/dpkg/info/") % name();
+    const QString multiArchPath = base % ':' % architecture() % QLatin1String(".list");
+    const QString plainPath = base % QLatin1String(".list");
+
+    // Multi-Arch: same packages have their list named after the architecture
+    const pkgCache::VerIterator ver = d->packageIter.CurrentVer();
+    bool archQualified = !ver.end() && (ver->MultiArch & pkgCache::Version::Same);
+
+    QFile infoFile(archQualified ? multiArchPath : plainPath);
+    if (!infoFile.open(QFile::ReadOnly)) {
+        // Fallback, in case the guess was wrong
+        infoFile.setFileName(archQualified ? plainPath : multiArchPath);
+        if (!infoFile.open(QFile::ReadOnly)) {
+            return false;
+        }
     }
 
-    QFile infoFile(path);
+    const qint64 size = infoFile.size();
+    if (!size) {
+        return true;
+    }
 
-    if (infoFile.open(QFile::ReadOnly)) {
-        QTextStream stream(&infoFile);
-        QString line;
+    const char *data = reinterpret_cast<const char *>(infoFile.map(0, size));
+    if (!data) {
+        return false;
+    }
 
-        do {
-            line = stream.readLine();
-            installedFilesList << line;
-        } while (!line.isNull());
+    const char *end = data + size;
+    const char *lineStart = data;
+    QByteArray previous;
+
+    // A path followed by one of its children is a directory. The list is
+    // ordered so that is decided with a single lookahead.
+    while (lineStart < end) {
+        const char *lineEnd = static_cast<const char *>(memchr(lineStart, '\n', end - lineStart));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
 
-        // The first item won't be a file
-        installedFilesList.removeFirst();
+        const QByteArray line = QByteArray::fromRawData(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+
+        if (line.isEmpty() || line == "/.") {
+            continue;
+        }
 
-        // Remove non-file directory listings
-        for (int i = 0; i < installedFilesList.size() - 1; ++i) {
-            if (installedFilesList.at(i+1).contains(installedFilesList.at(i) + '/')) {
-                installedFilesList[i] = QString(QLatin1Char(' '));
+        if (!previous.isEmpty()) {
+            bool isDirectory = line.size() > previous.size() &&
+                               line.startsWith(previous) &&
+                               line.at(previous.size()) == '/';
+            if (!isDirectory && !callback(previous)) {
+                return true;
             }
         }
 
-        installedFilesList.removeAll(QChar::fromLatin1(' '));
-        // Last line is empty for some reason...
+        previous = line;
+    }
 
-        if (!installedFilesList.isEmpty()) {
-            installedFilesList.removeLast();
-        }
+    if (!previous.isEmpty()) {
+        callback(previous);
     }
 
-    return installedFilesList;
+    return true;
 }
 
 QString Package::origin() const
@@ -504,16 +745,21 @@ QStringList Package::archives() const
 
 QString Package::component() const
 {
-    QString sect = section();
-    if(sect.isEmpty())
-        return QString();
+    const QLatin1String view = componentView();
+    return view.size() ? QString(view) : QString();
+}
 
-    QStringList split = sect.split('/');
+QLatin1String Package::componentView() const
+{
+    const QLatin1String sect = section();
+    if (!sect.size())
+        return QLatin1String();
 
-    if (split.count() > 1)
-        return split.first();
+    const char *slash = static_cast<const char *>(memchr(sect.data(), '/', sect.size()));
+    if (slash)
+        return QLatin1String(sect.data(), slash - sect.data());
 
-    return QString("main");
+    return QLatin1String("main");
 }
 
 QByteArray Package::md5Sum() const
@@ -667,46 +913,33 @@ int Package::state() const
     pkgDepCache::StateCache &stateCache = (*d->backend->cache()->depCache())[d->packageIter];
 
     if (!d->staticStateCalculated) {
-        d->initStaticState(ver, stateCache);
+        QMutexLocker locker(d->backend->memoMutex());
+        if (!d->staticStateCalculated) {
+            d->initStaticState(ver, stateCache);
+        }
     }
 
-    if (stateCache.Install()) {
-        packageState |= ToInstall;
-    }
+    packageState |= markingStateFlags(stateCache);
 
-    if (stateCache.Flags & pkgCache::Flag::Auto) {
-        packageState |= QApt::Package::IsAuto;
-    }
+   return packageState | d->state;
+}
 
-    if (stateCache.iFlags & pkgDepCache::ReInstall) {
-        packageState |= ToReInstall;
-    } else if (stateCache.NewInstall()) { // Order matters here.
-        packageState |= NewInstall;
-    } else if (stateCache.Upgrade()) {
-        packageState |= ToUpgrade;
-    } else if (stateCache.Downgrade()) {
-        packageState |= ToDowngrade;
-    } else if (stateCache.Delete()) {
-        packageState |= ToRemove;
-        if (stateCache.iFlags & pkgDepCache::Purge) {
-            packageState |= ToPurge;
-        }
-    } else if (stateCache.Keep()) {
-        packageState |= ToKeep;
-        if (stateCache.Held()) {
-            packageState |= QApt::Package::Held;
-        }
-    }
+int Package::stateOf(pkgDepCache *depCache, const pkgCache::PkgIterator &iter)
+{
+    pkgDepCache::StateCache &stateCache = (*depCache)[iter];
 
-   return packageState | d->state;
+    return markingStateFlags(stateCache) | staticStateFlags(depCache, iter, iter.CurrentVer(), stateCache);
 }
 
 int Package::staticState() const
 {
     if (!d->staticStateCalculated) {
-        const pkgCache::VerIterator &ver = d->packageIter.CurrentVer();
-        pkgDepCache::StateCache &stateCache = (*d->backend->cache()->depCache())[d->packageIter];
-        d->initStaticState(ver, stateCache);
+        QMutexLocker locker(d->backend->memoMutex());
+        if (!d->staticStateCalculated) {
+            const pkgCache::VerIterator &ver = d->packageIter.CurrentVer();
+            pkgDepCache::StateCache &stateCache = (*d->backend->cache()->depCache())[d->packageIter];
+            d->initStaticState(ver, stateCache);
+        }
     }
 
     return d->state;
@@ -714,17 +947,42 @@ int Package::staticState() const
 
 int Package::compareVersion(const QString &v1, const QString &v2)
 {
-    // Make deep copies of toStdString(), since otherwise they would
-    // go out of scope when we call c_str()
-    string s1 = v1.toStdString();
-    string s2 = v2.toStdString();
+    // Versions are ASCII, no need to go through std::string
+    const QByteArray a = v1.toLatin1();
+    const QByteArray b = v2.toLatin1();
 
-    const char *a = s1.c_str();
-    const char *b = s2.c_str();
-    int lenA = strlen(a);
-    int lenB = strlen(b);
+    return compareVersion(QLatin1String(a), QLatin1String(b));
+}
+
+int Package::compareVersion(QLatin1String v1, QLatin1String v2)
+{
+    const char *a = v1.data() ? v1.data() : "";
+    const char *b = v2.data() ? v2.data() : "";
+
+    return _system->VS->DoCmpVersion(a, a + v1.size(), b, b + v2.size());
+}
+
+void Package::sortByVersion(PackageList &packages, Qt::SortOrder order)
+{
+    struct VersionKey {
+        QLatin1String version;
+        Package *package;
+    };
 
-    return _system->VS->DoCmpVersion(a, a+lenA, b, b+lenB);
+    // The views point into the cache, so the keys are extracted without
+    // copying and stay valid while sorting
+    QVector<VersionKey> keys;
+    keys.reserve(packages.size());
+    for (Package *package : packages)
+        keys.append({ package->availableVersionView(), package });
+
+    std::stable_sort(keys.begin(), keys.end(), [order](const VersionKey &a, const VersionKey &b) {
+        const int res = compareVersion(a.version, b.version);
+        return (order == Qt::AscendingOrder) ? res < 0 : res > 0;
+    });
+
+    for (int i = 0; i < keys.size(); ++i)
+        packages[i] = keys.at(i).package;
 }
 
 bool Package::isInstalled() const
@@ -765,58 +1023,15 @@ bool Package::isInUpdatePhase() const
         return d->setInUpdatePhase(true);
     }
 
-    // This is a more or less an exact reimplementation of the update phasing
-    // algorithm Ubuntu uses.
-    // Deciding whether a machine is in the phasing pool or not happens in
-    // two steps.
-    // 1. repeatable random number generation between 0..100
-    // 2. comparison of random number with phasing percentage and marking
-    //    as upgradable if rand is greater than the phasing.
-
-    // Repeatable discrete random number generation is based on
-    // the MD5 hash of "sourcename-sourceversion-dbusmachineid", this
-    // hash is used as seed for the random number generator to provide
-    // stable randomness based on the stable seed. Combined with the discrete
-    // quasi-randomiziation we get about even distribution of machines across
-    // phases.
-    static QString machineId;
-    if (machineId.isNull()) {
-        QFile file(QStringLiteral("/var/lib/dbus/machine-id"));
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            machineId = file.readLine().trimmed();
-        }
-    }
-
-    if (machineId.isEmpty()) {
+    UpdatePhase phase;
+    if (!phase.isMachineKnown()) {
         // Without machineId we cannot differentiate one machine from another, so
         // we have no way to build a unique hash.
         return true; // Don't change cache as we might have more luck next time.
     }
 
-    QString seedString = QStringLiteral("%1-%2-%3").arg(sourcePackage(),
-                                                        availableVersion(),
-                                                        machineId);
-    QByteArray seed = QCryptographicHash::hash(seedString.toLatin1(), QCryptographicHash::Md5);
-    // MD5 would be 128bits, that's two quint64 stdlib random default_engine
-    // uses a uint32 seed though, so we'd loose precision anyway, so screw
-    // this, we'll get the first 32bit and screw the rest! This is not
-    // rocket science, worst case the update only arrives once the phasing
-    // tag is removed.
-    seed = seed.toHex();
-    seed.truncate(8 /* each character in a hex string values 4 bit, 8*4=32bit */);
-
-    bool ok = false;
-    uint a = seed.toUInt(&ok, 16);
-    Q_ASSERT(ok); // Hex conversion always is supposed to work at this point.
-
-    std::default_random_engine generator(a);
-    std::uniform_int_distribution<int> distribution(0, 100);
-    int rand = distribution(generator);
-
-    // rand is the percentage at which the machine starts to be in the phase.
-    // Once rand is less than the phasing percentage e.g. 40rand vs. 50phase
-    // the machine is supposed to start phasing.
-    return d->setInUpdatePhase(rand <= phasedUpdatePercent);
+    return d->setInUpdatePhase(phase.isInPhase(sourcePackage(), availableVersion(),
+                                               phasedUpdatePercent));
 }
 
 bool Package::isMultiArchDuplicate() const
@@ -862,47 +1077,87 @@ bool Package::isForeignArch() const
 
 QList<DependencyItem> Package::depends() const
 {
-    return DependencyInfo::parseDepends(controlField("Depends"), Depends);
+    return d->parsedDepends("Depends", Depends);
 }
 
 QList<DependencyItem> Package::preDepends() const
 {
-    return DependencyInfo::parseDepends(controlField("Pre-Depends"), PreDepends);
+    return d->parsedDepends("Pre-Depends", PreDepends);
 }
 
 QList<DependencyItem> Package::suggests() const
 {
-    return DependencyInfo::parseDepends(controlField("Suggests"), Suggests);
+    return d->parsedDepends("Suggests", Suggests);
 }
 
 QList<DependencyItem> Package::recommends() const
 {
-    return DependencyInfo::parseDepends(controlField("Recommends"), Recommends);
+    return d->parsedDepends("Recommends", Recommends);
 }
 
 QList<DependencyItem> Package::conflicts() const
 {
-    return DependencyInfo::parseDepends(controlField("Conflicts"), Conflicts);
+    return d->parsedDepends("Conflicts", Conflicts);
 }
 
 QList<DependencyItem> Package::replaces() const
 {
-    return DependencyInfo::parseDepends(controlField("Replaces"), Replaces);
+    return d->parsedDepends("Replaces", Replaces);
 }
 
 QList<DependencyItem> Package::obsoletes() const
 {
-    return DependencyInfo::parseDepends(controlField("Obsoletes"), Obsoletes);
+    return d->parsedDepends("Obsoletes", Obsoletes);
 }
 
 QList<DependencyItem> Package::breaks() const
 {
-    return DependencyInfo::parseDepends(controlField("Breaks"), Breaks);
+    return d->parsedDepends("Breaks", Breaks);
 }
 
 QList<DependencyItem> Package::enhances() const
 {
-    return DependencyInfo::parseDepends(controlField("Enhance"), Enhances);
+    return d->parsedDepends("Enhances", Enhances);
+}
+
+QList<DependencyItem> Package::cachedDependencies(DependencyType type) const
+{
+    QList<DependencyItem> depends;
+
+    const pkgCache::VerIterator &ver = (*d->backend->cache()->depCache()).GetCandidateVer(d->packageIter);
+    if (ver.end()) {
+        return depends;
+    }
+
+    bool hadOr = false;
+    for (pkgCache::DepIterator dep = ver.DependsList(); !dep.end(); ++dep) {
+        if (dep->Type != type) {
+            hadOr = false;
+            continue;
+        }
+
+        const pkgCache::PkgIterator target = dep.TargetPkg();
+        QString package = QLatin1String(target.Name());
+        // Only ":any" survives as an annotation, the cache resolves the rest
+        if (qstrcmp(target.Arch(), "any") == 0) {
+            package += QLatin1String(":any");
+        }
+
+        DependencyInfo info(package,
+                            dep.TargetVer() ? QString::fromUtf8(dep.TargetVer()) : QString(),
+                            (RelationType)(dep->CompareOp & ~pkgCache::Dep::Or),
+                            type);
+
+        if (hadOr) {
+            depends.last().append(info);
+        } else {
+            depends.append(DependencyItem() << info);
+        }
+
+        hadOr = dep->CompareOp & pkgCache::Dep::Or;
+    }
+
+    return depends;
 }
 
 QStringList Package::dependencyList(bool useCandidateVersion) const
@@ -974,6 +1229,48 @@ QStringList Package::dependencyList(bool useCandidateVersion) const
     return dependsList;
 }
 
+static DependencyEdge dependencyEdge(pkgCache::DepIterator &dep)
+{
+    pkgCache::PkgIterator target = dep.TargetPkg();
+
+    DependencyEdge edge;
+    // Our enums share their values with the ones of APT
+    edge.type = static_cast<DependencyType>(dep->Type);
+    edge.relation = static_cast<RelationType>(dep->CompareOp & 0x0F);
+    edge.parentId = dep.ParentPkg()->ID;
+    edge.targetId = target->ID;
+    edge.targetVersion = dep.TargetVer();
+    edge.isOr = (dep->CompareOp & pkgCache::Dep::Or) == pkgCache::Dep::Or;
+    edge.isVirtual = !target->VersionList;
+
+    return edge;
+}
+
+QVector<DependencyEdge> Package::dependencyEdges(bool useCandidateVersion) const
+{
+    QVector<DependencyEdge> edges;
+    pkgDepCache *depCache = d->backend->cache()->depCache();
+    pkgDepCache::StateCache &State = (*depCache)[d->packageIter];
+
+    pkgCache::VerIterator current;
+    if (!useCandidateVersion) {
+        current = State.InstVerIter(*depCache);
+    }
+    if (useCandidateVersion || current.end()) {
+        current = State.CandidateVerIter(*depCache);
+    }
+
+    if (current.end()) {
+        return edges;
+    }
+
+    for (pkgCache::DepIterator it = current.DependsList(); !it.end(); ++it) {
+        edges.append(dependencyEdge(it));
+    }
+
+    return edges;
+}
+
 QStringList Package::requiredByList() const
 {
     QStringList reverseDependsList;
@@ -985,6 +1282,17 @@ QStringList Package::requiredByList() const
     return reverseDependsList;
 }
 
+bool Package::forEachReverseDependency(const std::function<bool (const DependencyEdge &edge)> &callback) const
+{
+    for (pkgCache::DepIterator it = d->packageIter.RevDependsList(); !it.end(); ++it) {
+        if (!callback(dependencyEdge(it))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 QStringList Package::providesList() const
 {
     pkgDepCache::StateCache &State = (*d->backend->cache()->depCache())[d->packageIter];
@@ -1176,29 +1484,11 @@ bool Package::isTrusted() const
     if (!Ver)
         return false;
 
-    pkgSourceList *Sources = d->backend->packageSourceList();
-    QHash<pkgCache::PkgFileIterator, pkgIndexFile*> *trustCache = d->backend->cache()->trustCache();
+    const Cache *cache = d->backend->cache();
 
     for (pkgCache::VerFileIterator i = Ver.FileList(); !i.end(); ++i)
     {
-        pkgIndexFile *Index;
-
-        //FIXME: Should be done in apt
-        auto trustIter = trustCache->constBegin();
-        while (trustIter != trustCache->constEnd()) {
-            if (trustIter.key() == i.File())
-                break; // Found it
-            trustIter++;
-        }
-
-        // Find the index of the package file from the package sources
-        if (trustIter == trustCache->constEnd()) { // Not found
-            if (!Sources->FindIndex(i.File(), Index))
-              continue;
-        } else
-            Index = trustIter.value();
-
-        if (Index->IsTrusted())
+        if (cache->isTrusted(i.File()))
             return true;
     }
 
@@ -1217,12 +1507,15 @@ bool Package::wouldBreak() const
 
 void Package::setAuto(bool flag)
 {
+    QWriteLocker locker(d->backend->cacheLock());
     d->backend->cache()->depCache()->MarkAuto(d->packageIter, flag);
+    d->backend->touchPackage(this);
 }
 
 
 void Package::setKeep()
 {
+    QWriteLocker locker(d->backend->cacheLock());
     d->backend->cache()->depCache()->MarkKeep(d->packageIter, false);
     if (state() & ToReInstall) {
         d->backend->cache()->depCache()->SetReInstall(d->packageIter, false);
@@ -1234,13 +1527,24 @@ void Package::setKeep()
 
     d->state |= IsManuallyHeld;
 
+    d->backend->touchPackage(this);
+
     if (!d->backend->areEventsCompressed()) {
         d->backend->emitPackageChanged();
     }
 }
 
+void Package::setManuallyHeld(bool held)
+{
+    if (held)
+        d->state |= IsManuallyHeld;
+    else
+        d->state &= ~IsManuallyHeld;
+}
+
 void Package::setInstall()
 {
+    QWriteLocker locker(d->backend->cacheLock());
     d->backend->cache()->depCache()->MarkInstall(d->packageIter, true);
     d->state &= ~IsManuallyHeld;
 
@@ -1253,6 +1557,8 @@ void Package::setInstall()
         Fix.Resolve(true);
     }
 
+    d->backend->touchPackage(this);
+
     if (!d->backend->areEventsCompressed()) {
         d->backend->emitPackageChanged();
     }
@@ -1260,9 +1566,12 @@ void Package::setInstall()
 
 void Package::setReInstall()
 {
+    QWriteLocker locker(d->backend->cacheLock());
     d->backend->cache()->depCache()->SetReInstall(d->packageIter, true);
     d->state &= ~IsManuallyHeld;
 
+    d->backend->touchPackage(this);
+
     if (!d->backend->areEventsCompressed()) {
         d->backend->emitPackageChanged();
     }
@@ -1271,6 +1580,7 @@ void Package::setReInstall()
 // TODO: merge into one function with bool_purge param
 void Package::setRemove()
 {
+    QWriteLocker locker(d->backend->cacheLock());
     pkgProblemResolver Fix(d->backend->cache()->depCache());
 
     Fix.Clear(d->packageIter);
@@ -1284,6 +1594,8 @@ void Package::setRemove()
 
     d->state &= ~IsManuallyHeld;
 
+    d->backend->touchPackage(this);
+
     if (!d->backend->areEventsCompressed()) {
         d->backend->emitPackageChanged();
     }
@@ -1291,6 +1603,7 @@ void Package::setRemove()
 
 void Package::setPurge()
 {
+    QWriteLocker locker(d->backend->cacheLock());
     pkgProblemResolver Fix(d->backend->cache()->depCache());
 
     Fix.Clear(d->packageIter);
@@ -1304,6 +1617,8 @@ void Package::setPurge()
 
     d->state &= ~IsManuallyHeld;
 
+    d->backend->touchPackage(this);
+
     if (!d->backend->areEventsCompressed()) {
         d->backend->emitPackageChanged();
     }
@@ -1311,6 +1626,7 @@ void Package::setPurge()
 
 bool Package::setVersion(const QString &version)
 {
+    QWriteLocker locker(d->backend->cacheLock());
     pkgDepCache::StateCache &state = (*d->backend->cache()->depCache())[d->packageIter];
     QLatin1String defaultCandVer(state.CandVersion);
 
@@ -1336,12 +1652,16 @@ bool Package::setVersion(const QString &version)
     else
         d->state |= OverrideVersion;
 
+    d->backend->touchPackage(this);
+
     return true;
 }
 
 void Package::setPinned(bool pin)
 {
+    QWriteLocker locker(d->backend->cacheLock());
     pin ? d->state |= IsPinned : d->state &= ~IsPinned;
+    d->backend->touchPackage(this);
 }
 
 }
@@ -26,12 +26,17 @@
 #include <QUrl>
 #include <QDateTime>
 #include <QVariantMap>
+#include <QVector>
+
+#include <functional>
 
 #include <apt-pkg/pkgcache.h>
 
 #include "dependencyinfo.h"
 #include "globals.h"
 
+class pkgDepCache;
+
 namespace QApt {
 
 class Backend;
@@ -42,6 +47,32 @@ class MarkingErrorInfo;
  */
 class PackagePrivate;
 
+/**
+ * A single dependency of a package version, as stored in the APT cache.
+ * Packages are referred to by their Package::id(), see Backend::packageById().
+ *
+ * The edge stays valid until the cache is reloaded.
+ *
+ * @since 3.1
+ */
+struct DependencyEdge
+{
+    /// The kind of the dependency
+    DependencyType type;
+    /// The relation to targetVersion
+    RelationType relation;
+    /// The package the dependency belongs to
+    int parentId;
+    /// The package that is depended upon
+    int targetId;
+    /// The version the relation refers to, or @c nullptr if unversioned
+    const char *targetVersion;
+    /// Whether the next dependency is an alternative to this one
+    bool isOr;
+    /// Whether the target is a purely virtual package
+    bool isVirtual;
+};
+
 /**
  * The Package class is an object for referencing a software package in the Apt
  * package database. You will be getting most of your information about your
@@ -84,6 +115,18 @@ public:
     */
     QString version() const;
 
+   /**
+    * Returns version() without copying it out of the package cache. The
+    * view stays valid until the cache is reloaded.
+    *
+    * Like name() and section(), the view variants below are meant for hot
+    * paths such as sorting and filtering, where allocating a QString for
+    * each call adds up.
+    *
+    * @since 3.1
+    */
+    QLatin1String versionView() const;
+
    /**
     * Returns the upstream version of the package. This is the Debian version
     * with the epoch and Debian revision information (if any) removed.
@@ -112,6 +155,13 @@ public:
     */
     QString architecture() const;
 
+   /**
+    * Returns architecture() without copying it out of the package cache.
+    *
+    * @since 3.1
+    */
+    QLatin1String architectureView() const;
+
    /**
     * Returns a list of all available versions of the package in the form of
     * "version, release" (E.g. "0.2-0ubuntu1, maverick")
@@ -164,6 +214,14 @@ public:
     */
     QString installedVersion() const;
 
+   /**
+    * Returns installedVersion() without copying it out of the package
+    * cache. The view is empty if the package is not installed.
+    *
+    * @since 3.1
+    */
+    QLatin1String installedVersionView() const;
+
    /**
     * Returns the newest available version of the package if it is not
     * installed.
@@ -173,6 +231,14 @@ public:
     */
     QString availableVersion() const;
 
+   /**
+    * Returns availableVersion() without copying it out of the package
+    * cache. The view is empty if there is no candidate version.
+    *
+    * @since 3.1
+    */
+    QLatin1String availableVersionView() const;
+
    /**
     * Returns the priority of the package
     *
@@ -180,6 +246,13 @@ public:
     */
     QString priority() const;
 
+   /**
+    * Returns priority() without allocating a string.
+    *
+    * @since 3.1
+    */
+    QLatin1String priorityView() const;
+
    /**
     * Returns the files that this package has installed. 
     *
@@ -188,6 +261,23 @@ public:
     */
     QStringList installedFilesList() const;
 
+   /**
+    * Calls @p callback for each file that this package has installed,
+    * without building a list of all of them first. Directories are skipped,
+    * as they are by installedFilesList().
+    *
+    * The byte array passed to the callback refers directly to the mapped
+    * dpkg file list, and is only valid for the duration of the call.
+    *
+    * \param callback Called with the path of each file. Iteration stops
+    *                 early if it returns @c false.
+    *
+    * \return @c false if the file list of the package could not be read
+    *
+    * @since 3.1
+    */
+    bool forEachInstalledFile(const std::function<bool (const QByteArray &path)> &callback) const;
+
    /**
     * Returns the long description of the package.
     *
@@ -230,6 +320,13 @@ public:
     */
     QString component() const;
 
+   /**
+    * Returns component() as a view into section(), without allocating.
+    *
+    * @since 3.1
+    */
+    QLatin1String componentView() const;
+
    /**
     * Returns the md5sum of the candidate version of the package
     *
@@ -357,6 +454,28 @@ public:
     */
     static int compareVersion(const QString &v1, const QString &v2);
 
+   /**
+    * Overloaded compareVersion() for versions which are already in 8-bit
+    * form, e.g. from availableVersionView(), so that comparing them needs
+    * no conversion.
+    *
+    * @since 3.1
+    */
+    static int compareVersion(QLatin1String v1, QLatin1String v2);
+
+   /**
+    * Sorts @p packages by their available version. The versions are picked
+    * out of the package cache once before sorting instead of for each
+    * comparison. Packages without an available version sort first in
+    * ascending order. Packages with equal versions keep their order.
+    *
+    * @param packages The packages to sort
+    * @param order The order to sort in
+    *
+    * @since 3.1
+    */
+    static void sortByVersion(QApt::PackageList &packages, Qt::SortOrder order = Qt::AscendingOrder);
+
    /**
     * Returns whether the Package is installed
     */
@@ -382,6 +501,7 @@ public:
      * @warning this function uses statics and is not in the least way threadsafe
      *          nor reentrant.
      *
+     * @see Backend::upgradeablePackagesInUpdatePhase()
      * @since 3.1
      */
     bool isInUpdatePhase() const;
@@ -472,21 +592,67 @@ public:
     /// Returns a list of DependencyItems that this package enhances.
     QList<DependencyItem> enhances() const;
 
+   /**
+    * Returns the dependencies of type @p type of the candidate version,
+    * built from APT's parsed package cache rather than from the package
+    * record. This avoids reading and parsing the record, but names are the
+    * ones APT resolved them to, so architecture qualifiers other than
+    * ":any" do not appear, and architecture-restricted dependencies that do
+    * not apply to this system are left out.
+    *
+    * @since 3.1
+    */
+    QList<DependencyItem> cachedDependencies(DependencyType type) const;
+
    /**
     * Returns a display-ready list of the names of all the dependencies of this package.
     *
     * \return A \c QStringList of packages that this package depends on
+    *
+    * @see dependencyEdges()
     */
     QStringList dependencyList(bool useCandidateVersion) const;
 
+   /**
+    * Returns the dependencies of this package, in the order they are
+    * declared in. Alternatives are consecutive edges, all but the last of
+    * which have DependencyEdge::isOr set.
+    *
+    * @param useCandidateVersion Whether to use the candidate version rather
+    *        than the installed one. The candidate is also used when the
+    *        package is not installed
+    *
+    * \return The dependencies of the chosen version, or an empty vector if
+    *         there is none
+    *
+    * @since 3.1
+    */
+    QVector<DependencyEdge> dependencyEdges(bool useCandidateVersion) const;
+
    /**
     * Returns a list of the names of all the packages that depend on this
     * package. (Reverse dependencies)
     *
     * \return A \c QStringList of packages that depend on this package
+    *
+    * @see forEachReverseDependency()
     */
     QStringList requiredByList() const;
 
+   /**
+    * Calls @p callback for every dependency of any version of another package
+    * on this package, without building a list of them.
+    *
+    * @param callback Called with each reverse dependency, whose
+    *        DependencyEdge::parentId is the depending package. Returning
+    *        @c false stops the iteration
+    *
+    * \return @c false if the iteration was stopped by @p callback
+    *
+    * @since 3.1
+    */
+    bool forEachReverseDependency(const std::function<bool (const DependencyEdge &edge)> &callback) const;
+
    /**
     * Returns a list of the names of all the virtual packages that this package
     * provides.
@@ -660,6 +826,31 @@ private:
      */
      Package(QApt::Backend* parent, pkgCache::PkgIterator &packageIter);
 
+    /**
+     * Internal constructor used by QApt::PackageArena, which constructs the
+     * private data in @p privateStorage rather than on the heap.
+     */
+     Package(QApt::Backend* parent, pkgCache::PkgIterator &packageIter, void *privateStorage);
+
+     /// Returns the size of the private data, for QApt::PackageArena
+     static size_t privateSize();
+
+    /**
+     * Points the package at its counterpart in a reopened cache, so that
+     * the object can be kept across a cache reload.
+     *
+     * @param packageIter The package in the reopened cache
+     * @param installedChanged Whether the installed version or state changed
+     */
+     void rebind(pkgCache::PkgIterator &packageIter, bool installedChanged);
+
+    /**
+     * Whether isInUpdatePhase() has a cached result, and storing one for
+     * phases evaluated by Backend::upgradeablePackagesInUpdatePhase()
+     */
+     bool isUpdatePhaseCalculated() const;
+     void setInUpdatePhase(bool inUpdatePhase);
+
     /**
      * Returns the internal APT representation of the package
      *
@@ -675,7 +866,20 @@ private:
       */
      int staticState() const;
 
+     // The bytes taken by cached descriptions and dependencies
+     qint64 cachedBytes() const;
+
+     // Sets IsManuallyHeld like setKeep() does and the other setters clear
+     // it, for Backend::markPackagesBatch()
+     void setManuallyHeld(bool held);
+
+     // What state() would return for a package that has no Package object
+     // yet, so that Backend::syncStates() need not create one
+     static int stateOf(pkgDepCache *depCache, const pkgCache::PkgIterator &iter);
+
      friend class Backend;
+     friend class ChangelogFetcher;
+     friend class PackageArena;
 };
 
 /**
@@ -686,4 +890,6 @@ typedef QHash<Package::State, PackageList> StateChanges;
 
 }
 
+Q_DECLARE_TYPEINFO(QApt::DependencyEdge, Q_PRIMITIVE_TYPE);
+
 #endif
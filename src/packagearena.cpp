@@ -0,0 +1,100 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "packagearena.h"
+
+#include <cstddef>
+#include <new>
+
+#include "package.h"
+
+namespace QApt {
+
+static size_t alignedSize(size_t size)
+{
+    const size_t alignment = alignof(std::max_align_t);
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+PackageArena::PackageArena()
+    : m_storage(nullptr)
+    , m_slotSize(alignedSize(sizeof(Package)) + alignedSize(Package::privateSize()))
+    , m_capacity(0)
+{
+}
+
+PackageArena::~PackageArena()
+{
+    clear();
+}
+
+void PackageArena::reset(int count)
+{
+    destroyAll();
+
+    if (count > m_capacity) {
+        ::operator delete(m_storage);
+        m_storage = static_cast<char *>(::operator new(m_slotSize * count));
+        m_capacity = count;
+    }
+
+    m_used.fill(false, count);
+}
+
+void PackageArena::clear()
+{
+    destroyAll();
+
+    ::operator delete(m_storage);
+    m_storage = nullptr;
+    m_capacity = 0;
+    m_used.clear();
+}
+
+Package *PackageArena::create(int index, Backend *backend, pkgCache::PkgIterator &iter)
+{
+    Q_ASSERT(index >= 0 && index < m_used.size());
+    Q_ASSERT(!m_used.testBit(index));
+
+    // Each slot holds the Package, directly followed by its private data
+    char *slot = m_storage + m_slotSize * index;
+    void *privateStorage = slot + alignedSize(sizeof(Package));
+
+    m_used.setBit(index);
+    return new (slot) Package(backend, iter, privateStorage);
+}
+
+size_t PackageArena::capacityBytes() const
+{
+    return m_slotSize * m_capacity;
+}
+
+void PackageArena::destroyAll()
+{
+    for (int i = 0; i < m_used.size(); ++i) {
+        if (m_used.testBit(i)) {
+            reinterpret_cast<Package *>(m_storage + m_slotSize * i)->~Package();
+        }
+    }
+
+    m_used.fill(false);
+}
+
+}
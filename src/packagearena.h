@@ -0,0 +1,80 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef QAPT_PACKAGEARENA_H
+#define QAPT_PACKAGEARENA_H
+
+#include <QBitArray>
+
+#include <apt-pkg/pkgcache.h>
+
+namespace QApt {
+
+class Backend;
+class Package;
+
+/**
+ * The PackageArena class is a slab of memory that holds all the Package
+ * objects of a QApt::Backend. It is used internally by the backend so that
+ * a cache reload costs a single allocation and a single bulk free instead of
+ * one allocation per package, and so that the packages are laid out next to
+ * each other when they are scanned.
+ */
+class PackageArena
+{
+public:
+    PackageArena();
+    ~PackageArena();
+
+    /**
+     * Destroys all packages in the arena, and makes room for @p count new
+     * ones. The underlying memory is only reallocated when it is too small.
+     */
+    void reset(int count);
+
+    /**
+     * Destroys all packages in the arena and frees its memory.
+     */
+    void clear();
+
+    /**
+     * Constructs a package in slot @p index of the arena.
+     *
+     * @return the newly-created package
+     */
+    Package *create(int index, Backend *backend, pkgCache::PkgIterator &iter);
+
+    /// Returns the number of bytes currently reserved by the arena
+    size_t capacityBytes() const;
+
+private:
+    Q_DISABLE_COPY(PackageArena)
+
+    void destroyAll();
+
+    char *m_storage;
+    size_t m_slotSize;
+    int m_capacity;
+    QBitArray m_used;
+};
+
+}
+
+#endif
@@ -0,0 +1,720 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "packagemodel.h"
+
+// Qt includes
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <algorithm>
+
+// Own includes
+#include "backend.h"
+
+namespace QApt {
+
+// Rows handed out per fetchMore()
+static const int fetchBatchSize = 256;
+// Rows whose record fields are read together
+static const int recordBlockSize = 64;
+
+struct ArrangeRequest
+{
+    enum KeyKind {
+        TextKey,
+        VersionKey,
+        NumberKey
+    };
+
+    int generation = 0;
+    QVector<QByteArray> names;
+    QVector<int> states;
+    QByteArray nameFilter;
+    int stateMask = 0;
+
+    bool sorted = false;
+    KeyKind keyKind = TextKey;
+    QVector<QByteArray> textKeys;
+    QVector<qint64> numberKeys;
+    Qt::SortOrder order = Qt::AscendingOrder;
+};
+
+// Filters and sorts the indexes of the keys. Only works on the keys, so it
+// needs no access to the cache
+static QVector<int> arrangeRows(const ArrangeRequest &request)
+{
+    QVector<int> rows;
+    rows.reserve(request.names.size());
+    for (int i = 0; i < request.names.size(); ++i) {
+        if (request.stateMask && !(request.states.at(i) & request.stateMask))
+            continue;
+        if (!request.nameFilter.isEmpty() && !request.names.at(i).contains(request.nameFilter))
+            continue;
+
+        rows.append(i);
+    }
+
+    if (!request.sorted)
+        return rows;
+
+    const bool ascending = (request.order == Qt::AscendingOrder);
+    switch (request.keyKind) {
+    case ArrangeRequest::TextKey: {
+        const QVector<QByteArray> &keys = request.textKeys;
+        std::stable_sort(rows.begin(), rows.end(), [&keys, ascending](int a, int b) {
+            return ascending ? keys.at(a) < keys.at(b) : keys.at(b) < keys.at(a);
+        });
+        break;
+    }
+    case ArrangeRequest::VersionKey: {
+        const QVector<QByteArray> &keys = request.textKeys;
+        std::stable_sort(rows.begin(), rows.end(), [&keys, ascending](int a, int b) {
+            const int res = Package::compareVersion(QLatin1String(keys.at(a)), QLatin1String(keys.at(b)));
+            return ascending ? res < 0 : res > 0;
+        });
+        break;
+    }
+    case ArrangeRequest::NumberKey: {
+        const QVector<qint64> &keys = request.numberKeys;
+        std::stable_sort(rows.begin(), rows.end(), [&keys, ascending](int a, int b) {
+            return ascending ? keys.at(a) < keys.at(b) : keys.at(b) < keys.at(a);
+        });
+        break;
+    }
+    }
+
+    return rows;
+}
+
+/**
+ * Runs arrangeRows() in the background and invokes the
+ * applyArrangement(int, QVector<int>) slot of the receiver with the result.
+ * Queuing a request abandons the one that was not done yet.
+ */
+class PackageArrangeThread : public QThread
+{
+public:
+    explicit PackageArrangeThread(QObject *receiver)
+        : m_receiver(receiver)
+        , m_hasPending(false)
+        , m_stopping(false)
+    {
+    }
+
+    ~PackageArrangeThread()
+    {
+        {
+            QMutexLocker locker(&m_mutex);
+            m_stopping = true;
+            m_condition.wakeOne();
+        }
+        wait();
+    }
+
+    void arrange(const ArrangeRequest &request)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_pending = request;
+        m_hasPending = true;
+        m_condition.wakeOne();
+    }
+
+protected:
+    void run()
+    {
+        forever {
+            ArrangeRequest request;
+            {
+                QMutexLocker locker(&m_mutex);
+                while (!m_hasPending && !m_stopping) {
+                    m_condition.wait(&m_mutex);
+                }
+
+                if (m_stopping) {
+                    break;
+                }
+
+                request = m_pending;
+                m_pending = ArrangeRequest();
+                m_hasPending = false;
+            }
+
+            const QVector<int> rows = arrangeRows(request);
+
+            // A newer request makes this result outdated
+            QMutexLocker locker(&m_mutex);
+            if (m_hasPending || m_stopping) {
+                continue;
+            }
+
+            QMetaObject::invokeMethod(m_receiver, "applyArrangement", Qt::QueuedConnection,
+                                      Q_ARG(int, request.generation),
+                                      Q_ARG(QVector<int>, rows));
+        }
+    }
+
+private:
+    QObject *m_receiver;
+
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+    ArrangeRequest m_pending;
+    bool m_hasPending;
+    bool m_stopping;
+};
+
+class PackageModelPrivate
+{
+public:
+    PackageModelPrivate(Backend *b)
+        : backend(b)
+        , followsBackend(true)
+        , statesValid(false)
+        , fetched(0)
+        , stateMask(0)
+        , sortRole(PackageModel::NameRole)
+        , order(Qt::AscendingOrder)
+        , sorted(false)
+        , generation(0)
+        , arranging(false)
+        , membershipChanged(false)
+        , thread(nullptr)
+    {
+    }
+
+    ~PackageModelPrivate()
+    {
+        delete thread;
+    }
+
+    Backend *backend;
+    bool followsBackend;
+
+    // The packages and their keys, by source index
+    PackageList packages;
+    QHash<const Package *, int> sourceIndexes;
+    QVector<QByteArray> names;
+    QVector<int> states;
+    bool statesValid;
+    CacheSnapshot snapshot;
+
+    // The source indexes of the rows, and the rows of the source indexes
+    QVector<int> rows;
+    QVector<int> sourceRows;
+    int fetched;
+
+    QByteArray nameFilter;
+    int stateMask;
+    int sortRole;
+    Qt::SortOrder order;
+    bool sorted;
+
+    int generation;
+    bool arranging;
+    bool membershipChanged;
+    PackageArrangeThread *thread;
+
+    // Record fields of blocks of rows, see recordField()
+    mutable QHash<int, QList<QStringList> > recordBlocks;
+
+    void load(const PackageList &list);
+    void setRows(const QVector<int> &newRows);
+    void ensureStates();
+    QString recordField(int row, int field) const;
+};
+
+void PackageModelPrivate::load(const PackageList &list)
+{
+    packages = list;
+    sourceIndexes.clear();
+    sourceIndexes.reserve(packages.size());
+    names.clear();
+    names.reserve(packages.size());
+
+    for (int i = 0; i < packages.size(); ++i) {
+        const QLatin1String name = packages.at(i)->name();
+        sourceIndexes.insert(packages.at(i), i);
+        names.append(QByteArray(name.data(), name.size()).toLower());
+    }
+
+    states.clear();
+    statesValid = false;
+    // Cleared while the cache is reloading, when it must not be read
+    snapshot = packages.isEmpty() ? CacheSnapshot() : backend->currentCacheSnapshot();
+
+    QVector<int> identity(packages.size());
+    for (int i = 0; i < identity.size(); ++i)
+        identity[i] = i;
+    setRows(identity);
+    fetched = qMin(fetchBatchSize, rows.size());
+}
+
+void PackageModelPrivate::setRows(const QVector<int> &newRows)
+{
+    rows = newRows;
+    sourceRows.fill(-1, packages.size());
+    for (int row = 0; row < rows.size(); ++row)
+        sourceRows[rows.at(row)] = row;
+
+    recordBlocks.clear();
+}
+
+void PackageModelPrivate::ensureStates()
+{
+    if (statesValid)
+        return;
+
+    states.resize(packages.size());
+    for (int i = 0; i < packages.size(); ++i)
+        states[i] = packages.at(i)->state();
+    statesValid = true;
+}
+
+QString PackageModelPrivate::recordField(int row, int field) const
+{
+    const int block = row / recordBlockSize;
+
+    auto it = recordBlocks.constFind(block);
+    if (it == recordBlocks.constEnd()) {
+        PackageList blockPackages;
+        const int end = qMin(rows.size(), (block + 1) * recordBlockSize);
+        for (int i = block * recordBlockSize; i < end; ++i)
+            blockPackages.append(packages.at(rows.at(i)));
+
+        static const QStringList fieldNames = {
+            QStringLiteral("Maintainer"),
+            QStringLiteral("Homepage"),
+            QStringLiteral("Source")
+        };
+        it = recordBlocks.insert(block, backend->recordFields(blockPackages, fieldNames));
+    }
+
+    const QStringList &values = it->at(row % recordBlockSize);
+    QString value = values.at(field);
+
+    // Like Package::sourcePackage(), the field is only there if the names
+    // differ, and may carry the source version
+    if (field == PackageModel::SourcePackageRole - PackageModel::MaintainerRole) {
+        value = value.section(QLatin1Char(' '), 0, 0);
+        if (value.isEmpty())
+            value = packages.at(rows.at(row))->name();
+    }
+
+    return value;
+}
+
+PackageModel::PackageModel(Backend *backend, QObject *parent)
+    : QAbstractListModel(parent)
+    , d_ptr(new PackageModelPrivate(backend))
+{
+    Q_D(PackageModel);
+
+    // Passed from the thread that sorts
+    qRegisterMetaType<QVector<int> >();
+
+    connect(backend, SIGNAL(packageChanged()), this, SLOT(updateChangedPackages()));
+    connect(backend, SIGNAL(cacheReloadStarted()), this, SLOT(cacheReloadStarted()));
+    connect(backend, SIGNAL(cacheReloadFinished()), this, SLOT(cacheReloadFinished()));
+
+    d->load(backend->availablePackages());
+}
+
+PackageModel::~PackageModel()
+{
+    delete d_ptr;
+}
+
+void PackageModel::setPackages(const PackageList &packages)
+{
+    Q_D(PackageModel);
+
+    beginResetModel();
+    ++d->generation;
+    d->followsBackend = false;
+    d->load(packages);
+    endResetModel();
+
+    if (d->sorted || d->stateMask || !d->nameFilter.isEmpty())
+        arrange(false);
+}
+
+PackageList PackageModel::packages() const
+{
+    Q_D(const PackageModel);
+
+    return d->packages;
+}
+
+Package *PackageModel::packageAt(int row) const
+{
+    Q_D(const PackageModel);
+
+    if (row < 0 || row >= d->fetched)
+        return nullptr;
+
+    return d->packages.at(d->rows.at(row));
+}
+
+int PackageModel::rowOf(const Package *package) const
+{
+    Q_D(const PackageModel);
+
+    const int source = d->sourceIndexes.value(package, -1);
+    if (source < 0)
+        return -1;
+
+    const int row = d->sourceRows.at(source);
+    return (row < d->fetched) ? row : -1;
+}
+
+void PackageModel::setNameFilter(const QString &text)
+{
+    Q_D(PackageModel);
+
+    const QByteArray filter = text.toLower().toLatin1();
+    if (filter == d->nameFilter)
+        return;
+
+    d->nameFilter = filter;
+    arrange(false);
+}
+
+void PackageModel::setStateFilter(int stateMask)
+{
+    Q_D(PackageModel);
+
+    if (stateMask == d->stateMask)
+        return;
+
+    d->stateMask = stateMask;
+    arrange(false);
+}
+
+void PackageModel::setSortRole(int role)
+{
+    Q_D(PackageModel);
+
+    d->sortRole = role;
+}
+
+int PackageModel::sortRole() const
+{
+    Q_D(const PackageModel);
+
+    return d->sortRole;
+}
+
+bool PackageModel::isArranging() const
+{
+    Q_D(const PackageModel);
+
+    return d->arranging;
+}
+
+int PackageModel::rowCount(const QModelIndex &parent) const
+{
+    Q_D(const PackageModel);
+
+    return parent.isValid() ? 0 : d->fetched;
+}
+
+QVariant PackageModel::data(const QModelIndex &index, int role) const
+{
+    Q_D(const PackageModel);
+
+    if (!index.isValid() || index.row() >= d->fetched)
+        return QVariant();
+
+    Package *package = d->packages.at(d->rows.at(index.row()));
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case NameRole:
+        return QString(package->name());
+    case PackageRole:
+        return QVariant::fromValue(package);
+    case ShortDescriptionRole:
+        return package->shortDescription();
+    case SectionRole:
+        return QString(package->section());
+    case InstalledVersionRole:
+        return package->installedVersion();
+    case AvailableVersionRole:
+        return package->availableVersion();
+    case StateRole:
+        return package->state();
+    case InstalledSizeRole:
+        return package->installedSize();
+    case DownloadSizeRole:
+        return package->downloadSize();
+    case MaintainerRole:
+    case HomepageRole:
+    case SourcePackageRole:
+        return d->recordField(index.row(), role - MaintainerRole);
+    default:
+        break;
+    }
+
+    return QVariant();
+}
+
+QHash<int, QByteArray> PackageModel::roleNames() const
+{
+    QHash<int, QByteArray> roles = QAbstractListModel::roleNames();
+    roles.insert(NameRole, "name");
+    roles.insert(PackageRole, "package");
+    roles.insert(ShortDescriptionRole, "shortDescription");
+    roles.insert(SectionRole, "section");
+    roles.insert(InstalledVersionRole, "installedVersion");
+    roles.insert(AvailableVersionRole, "availableVersion");
+    roles.insert(StateRole, "state");
+    roles.insert(InstalledSizeRole, "installedSize");
+    roles.insert(DownloadSizeRole, "downloadSize");
+    roles.insert(MaintainerRole, "maintainer");
+    roles.insert(HomepageRole, "homepage");
+    roles.insert(SourcePackageRole, "sourcePackage");
+
+    return roles;
+}
+
+bool PackageModel::canFetchMore(const QModelIndex &parent) const
+{
+    Q_D(const PackageModel);
+
+    return !parent.isValid() && d->fetched < d->rows.size();
+}
+
+void PackageModel::fetchMore(const QModelIndex &parent)
+{
+    Q_D(PackageModel);
+
+    if (parent.isValid())
+        return;
+
+    const int count = qMin(fetchBatchSize, d->rows.size() - d->fetched);
+    if (count <= 0)
+        return;
+
+    beginInsertRows(QModelIndex(), d->fetched, d->fetched + count - 1);
+    d->fetched += count;
+    endInsertRows();
+}
+
+void PackageModel::sort(int column, Qt::SortOrder order)
+{
+    Q_D(PackageModel);
+
+    // Like QSortFilterProxyModel, a negative column restores the source order
+    d->sorted = (column >= 0);
+    d->order = order;
+    arrange(true);
+}
+
+void PackageModel::arrange(bool sortOnly)
+{
+    Q_D(PackageModel);
+
+    ++d->generation;
+    d->membershipChanged |= !sortOnly;
+
+    if (!d->sorted && !d->stateMask && d->nameFilter.isEmpty()) {
+        QVector<int> identity(d->packages.size());
+        for (int i = 0; i < identity.size(); ++i)
+            identity[i] = i;
+        applyArrangement(d->generation, identity);
+        return;
+    }
+
+    ArrangeRequest request;
+    request.generation = d->generation;
+    request.names = d->names;
+    request.nameFilter = d->nameFilter;
+    request.stateMask = d->stateMask;
+    request.sorted = d->sorted;
+    request.order = d->order;
+
+    if (d->stateMask || (d->sorted && d->sortRole == StateRole)) {
+        d->ensureStates();
+        request.states = d->states;
+    }
+
+    // The keys are picked out here, since the thread may not use the cache
+    if (d->sorted) {
+        switch (d->sortRole) {
+        case SectionRole:
+            request.textKeys.reserve(d->packages.size());
+            for (const Package *package : d->packages) {
+                const QLatin1String section = package->section();
+                request.textKeys.append(QByteArray(section.data(), section.size()));
+            }
+            break;
+        case InstalledVersionRole:
+        case AvailableVersionRole:
+            request.keyKind = ArrangeRequest::VersionKey;
+            request.textKeys.reserve(d->packages.size());
+            for (const Package *package : d->packages) {
+                const QLatin1String version = (d->sortRole == InstalledVersionRole)
+                                              ? package->installedVersionView()
+                                              : package->availableVersionView();
+                request.textKeys.append(QByteArray(version.data(), version.size()));
+            }
+            break;
+        case StateRole:
+            request.keyKind = ArrangeRequest::NumberKey;
+            request.numberKeys.reserve(d->states.size());
+            for (int state : d->states)
+                request.numberKeys.append(state);
+            break;
+        case InstalledSizeRole:
+        case DownloadSizeRole:
+            request.keyKind = ArrangeRequest::NumberKey;
+            request.numberKeys.reserve(d->packages.size());
+            for (const Package *package : d->packages) {
+                request.numberKeys.append((d->sortRole == InstalledSizeRole)
+                                          ? package->installedSize()
+                                          : package->downloadSize());
+            }
+            break;
+        default:
+            request.textKeys = d->names;
+            break;
+        }
+    }
+
+    d->arranging = true;
+    if (!d->thread) {
+        d->thread = new PackageArrangeThread(this);
+        d->thread->start();
+    }
+    d->thread->arrange(request);
+}
+
+void PackageModel::applyArrangement(int generation, const QVector<int> &rows)
+{
+    Q_D(PackageModel);
+
+    // Drop results of arrangements that have been superseded
+    if (generation != d->generation)
+        return;
+
+    if (d->membershipChanged || rows.size() != d->rows.size()) {
+        beginResetModel();
+        d->setRows(rows);
+        d->fetched = qMin(fetchBatchSize, rows.size());
+        endResetModel();
+    } else {
+        // Sorting keeps the fetched rows, and moves persistent indexes along
+        emit layoutAboutToBeChanged();
+        const QVector<int> oldRows = d->rows;
+        d->setRows(rows);
+
+        const QModelIndexList from = persistentIndexList();
+        QModelIndexList to;
+        to.reserve(from.size());
+        for (const QModelIndex &index : from) {
+            const int row = d->sourceRows.at(oldRows.at(index.row()));
+            to.append(row < d->fetched ? createIndex(row, index.column()) : QModelIndex());
+        }
+        changePersistentIndexList(from, to);
+        emit layoutChanged();
+    }
+
+    d->membershipChanged = false;
+    d->arranging = false;
+    emit arranged();
+}
+
+void PackageModel::updateChangedPackages()
+{
+    Q_D(PackageModel);
+
+    if (d->packages.isEmpty())
+        return;
+
+    const QHash<Package::State, PackageList> changes = d->backend->stateChanges(d->snapshot, QSet<const Package *>());
+    d->snapshot = d->backend->currentCacheSnapshot();
+
+    QSet<int> changed;
+    for (const PackageList &list : changes) {
+        for (const Package *package : list) {
+            const int source = d->sourceIndexes.value(package, -1);
+            if (source >= 0)
+                changed.insert(source);
+        }
+    }
+
+    bool filterChanged = false;
+    bool sortChanged = false;
+    for (int source : changed) {
+        if (d->statesValid) {
+            const int oldState = d->states.at(source);
+            const int newState = d->packages.at(source)->state();
+            d->states[source] = newState;
+
+            if (d->stateMask && bool(oldState & d->stateMask) != bool(newState & d->stateMask))
+                filterChanged = true;
+        }
+
+        const int row = d->sourceRows.at(source);
+        if (row >= 0 && row < d->fetched) {
+            const QModelIndex changedIndex = index(row);
+            emit dataChanged(changedIndex, changedIndex);
+        }
+    }
+
+    // Marking changes the sizes and states sorted by, but no other key
+    if (!changed.isEmpty() && d->sorted) {
+        sortChanged = (d->sortRole == StateRole || d->sortRole == InstalledSizeRole ||
+                       d->sortRole == DownloadSizeRole);
+    }
+
+    if (filterChanged || sortChanged)
+        arrange(!filterChanged);
+}
+
+void PackageModel::cacheReloadStarted()
+{
+    Q_D(PackageModel);
+
+    // The packages are about to be deleted
+    beginResetModel();
+    ++d->generation;
+    d->arranging = false;
+    d->load(PackageList());
+}
+
+void PackageModel::cacheReloadFinished()
+{
+    Q_D(PackageModel);
+
+    if (d->followsBackend)
+        d->load(d->backend->availablePackages());
+    endResetModel();
+
+    if (!d->packages.isEmpty() && (d->sorted || d->stateMask || !d->nameFilter.isEmpty()))
+        arrange(false);
+}
+
+}
@@ -0,0 +1,157 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef QAPT_PACKAGEMODEL_H
+#define QAPT_PACKAGEMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+
+#include "package.h"
+
+namespace QApt {
+
+class Backend;
+class PackageModelPrivate;
+
+/**
+ * The PackageModel class is a list model of packages for views.
+ *
+ * Nothing is read from a package before a view asks for it: rows are
+ * handed out in batches through fetchMore(), and the data of a row is only
+ * looked up for the roles that are requested. Roles that come from the
+ * package records, such as MaintainerRole, are read for a block of rows at
+ * a time with Backend::recordFields().
+ *
+ * Filtering and sorting work on keys that are picked out of the packages
+ * once, and run in a background thread. When packages change state, only
+ * the rows of the packages that changed are updated.
+ *
+ * The model follows availablePackages() of the backend, unless a list of
+ * packages is set with setPackages().
+ *
+ * @since 3.1
+ */
+class Q_DECL_EXPORT PackageModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    enum Roles {
+        /// The name of the package, also used for Qt::DisplayRole
+        NameRole = Qt::UserRole + 1,
+        /// The QApt::Package pointer
+        PackageRole,
+        ShortDescriptionRole,
+        SectionRole,
+        InstalledVersionRole,
+        AvailableVersionRole,
+        /// The Package::State flags
+        StateRole,
+        InstalledSizeRole,
+        DownloadSizeRole,
+        /// Read from the package records
+        MaintainerRole,
+        /// Read from the package records
+        HomepageRole,
+        /// Read from the package records
+        SourcePackageRole
+    };
+
+    /**
+     * Constructor
+     *
+     * @param backend The backend to show the packages of
+     * @param parent The parent object
+     */
+    explicit PackageModel(Backend *backend, QObject *parent = 0);
+
+    /// Destructor. Waits for a running sort to finish.
+    ~PackageModel();
+
+    /**
+     * Shows @p packages instead of all available packages, e.g. search
+     * results. The list is dropped when the cache is reloaded, since its
+     * packages are deleted then.
+     */
+    void setPackages(const QApt::PackageList &packages);
+
+    /// Returns the packages shown, in the order of setPackages()
+    PackageList packages() const;
+
+    /// Returns the package at @p row, or @c nullptr
+    Package *packageAt(int row) const;
+
+    /// Returns the row of @p package, or -1 if it is filtered out or not fetched yet
+    int rowOf(const Package *package) const;
+
+    /**
+     * Only shows packages whose name contains @p text. Matching ignores
+     * case.
+     */
+    void setNameFilter(const QString &text);
+
+    /**
+     * Only shows packages with any of the Package::State flags in
+     * @p stateMask, or all packages if it is 0.
+     */
+    void setStateFilter(int stateMask);
+
+    /**
+     * Sets the role to sort by in sort(). Roles read from the package
+     * records must be read for all packages to sort on them, so they
+     * sort by name instead. The default is NameRole.
+     */
+    void setSortRole(int role);
+
+    /// Returns the role to sort by
+    int sortRole() const;
+
+    /// Returns whether filtering or sorting is underway in the background
+    bool isArranging() const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QHash<int, QByteArray> roleNames() const;
+    bool canFetchMore(const QModelIndex &parent) const;
+    void fetchMore(const QModelIndex &parent);
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+
+Q_SIGNALS:
+    /// Emitted once the rows have been filtered and sorted
+    void arranged();
+
+private:
+    Q_DECLARE_PRIVATE(PackageModel)
+    PackageModelPrivate *const d_ptr;
+
+    void arrange(bool sortOnly);
+
+private Q_SLOTS:
+    void applyArrangement(int generation, const QVector<int> &rows);
+    void updateChangedPackages();
+    void cacheReloadStarted();
+    void cacheReloadFinished();
+};
+
+}
+
+Q_DECLARE_METATYPE(QApt::Package *)
+
+#endif
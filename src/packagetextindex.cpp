@@ -0,0 +1,188 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "packagetextindex.h"
+
+#include <QRegularExpression>
+#include <QSet>
+#include <QStringList>
+
+#include <algorithm>
+#include <numeric>
+
+namespace QApt {
+
+static quint64 trigramAt(const QString &text, int pos)
+{
+    return quint64(text.at(pos).unicode()) << 32 |
+           quint64(text.at(pos + 1).unicode()) << 16 |
+           quint64(text.at(pos + 2).unicode());
+}
+
+static QVector<int> intersect(const QVector<int> &a, const QVector<int> &b)
+{
+    QVector<int> result;
+    std::set_intersection(a.constBegin(), a.constEnd(), b.constBegin(), b.constEnd(),
+                          std::back_inserter(result));
+    return result;
+}
+
+PackageTextIndex::PackageTextIndex()
+{
+}
+
+void PackageTextIndex::clear()
+{
+    m_ids.clear();
+    m_names.clear();
+    m_descriptions.clear();
+    m_trigrams.clear();
+}
+
+bool PackageTextIndex::isEmpty() const
+{
+    return m_ids.isEmpty();
+}
+
+void PackageTextIndex::add(int id, const QString &name, const QString &description)
+{
+    const int entry = m_ids.size();
+    const QString lowerName = name.toLower();
+    const QString lowerDescription = description.toLower();
+
+    m_ids.append(id);
+    m_names.append(lowerName);
+    m_descriptions.append(lowerDescription);
+
+    QSet<quint64> trigrams;
+    for (const QString &text : { lowerName, lowerDescription }) {
+        for (int i = 0; i + 2 < text.size(); ++i) {
+            trigrams.insert(trigramAt(text, i));
+        }
+    }
+
+    for (quint64 trigram : trigrams) {
+        m_trigrams[trigram].append(entry);
+    }
+}
+
+QVector<int> PackageTextIndex::candidates(const QString &term) const
+{
+    // Terms too short for a trigram have to be checked against everything
+    if (term.size() < 3) {
+        QVector<int> all(m_ids.size());
+        std::iota(all.begin(), all.end(), 0);
+        return all;
+    }
+
+    // Start with the rarest trigram, to keep the intersections small
+    QVector<const QVector<int> *> postings;
+    for (int i = 0; i + 2 < term.size(); ++i) {
+        auto it = m_trigrams.constFind(trigramAt(term, i));
+        if (it == m_trigrams.constEnd()) {
+            return QVector<int>();
+        }
+        postings.append(&it.value());
+    }
+
+    std::sort(postings.begin(), postings.end(), [](const QVector<int> *a, const QVector<int> *b) {
+        return a->size() < b->size();
+    });
+
+    QVector<int> result = *postings.first();
+    for (int i = 1; i < postings.size() && !result.isEmpty(); ++i) {
+        result = intersect(result, *postings.at(i));
+    }
+
+    return result;
+}
+
+QVector<int> PackageTextIndex::search(const QString &searchString) const
+{
+    const QStringList terms = searchString.toLower().split(QRegularExpression(QLatin1String("[\\s,;]+")),
+                                                           QString::SkipEmptyParts);
+    if (terms.isEmpty() || m_ids.isEmpty()) {
+        return QVector<int>();
+    }
+
+    QVector<int> entries;
+    for (int i = 0; i < terms.size(); ++i) {
+        QVector<int> termEntries = candidates(terms.at(i));
+        entries = i ? intersect(entries, termEntries) : termEntries;
+        if (entries.isEmpty()) {
+            return entries;
+        }
+    }
+
+    // Trigrams only narrow things down, check the actual text and rank
+    QVector<QPair<int, int> > scored;
+    for (int entry : entries) {
+        const QString &name = m_names.at(entry);
+        const QString &description = m_descriptions.at(entry);
+        int score = 0;
+
+        for (const QString &term : terms) {
+            if (name == term) {
+                score += 100;
+            } else if (name.startsWith(term)) {
+                score += 50;
+            } else if (name.contains(term)) {
+                score += 20;
+            } else if (description.contains(term)) {
+                score += 5;
+            } else {
+                score = -1;
+                break;
+            }
+        }
+
+        if (score >= 0) {
+            scored.append(qMakePair(score, entry));
+        }
+    }
+
+    std::stable_sort(scored.begin(), scored.end(), [](const QPair<int, int> &a, const QPair<int, int> &b) {
+        return a.first > b.first;
+    });
+
+    QVector<int> ids;
+    ids.reserve(scored.size());
+    for (const auto &match : scored) {
+        ids.append(m_ids.at(match.second));
+    }
+
+    return ids;
+}
+
+qint64 PackageTextIndex::size() const
+{
+    qint64 bytes = m_ids.size() * sizeof(int);
+    for (int i = 0; i < m_ids.size(); ++i) {
+        bytes += (m_names.at(i).size() + m_descriptions.at(i).size()) * sizeof(QChar);
+    }
+
+    for (const QVector<int> &posting : m_trigrams) {
+        bytes += sizeof(quint64) + posting.size() * sizeof(int);
+    }
+
+    return bytes;
+}
+
+}
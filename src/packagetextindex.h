@@ -0,0 +1,74 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef QAPT_PACKAGETEXTINDEX_H
+#define QAPT_PACKAGETEXTINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+namespace QApt {
+
+/**
+ * The PackageTextIndex class is a small trigram index over package names
+ * and short descriptions. It is used internally by QApt::Backend to search
+ * packages when the APT Xapian index is not available.
+ */
+class PackageTextIndex
+{
+public:
+    PackageTextIndex();
+
+    /// Removes all entries from the index
+    void clear();
+
+    /// Returns whether nothing has been added to the index
+    bool isEmpty() const;
+
+    /**
+     * Adds a package to the index. Packages have to be added in order of
+     * increasing @p id.
+     */
+    void add(int id, const QString &name, const QString &description);
+
+    /**
+     * Returns the ids of the packages that contain every word of
+     * @p searchString in their name or description. Packages whose name
+     * matches come first.
+     */
+    QVector<int> search(const QString &searchString) const;
+
+    /// Returns the approximate number of bytes used by the index
+    qint64 size() const;
+
+private:
+    QVector<int> candidates(const QString &term) const;
+
+    QVector<int> m_ids;
+    QVector<QString> m_names;
+    QVector<QString> m_descriptions;
+    // Trigram -> entries containing it, in increasing order
+    QHash<quint64, QVector<int> > m_trigrams;
+};
+
+}
+
+#endif
@@ -25,7 +25,6 @@
 #include <QStringBuilder>
 #include <QStringList>
 #include <QDebug>
-#include <QRegularExpression>
 
 // APT includes
 #include <apt-pkg/configuration.h>
@@ -61,18 +60,25 @@ public:
     QString dist;
     QStringList components;
     QString comment;
+    QMap<QString, QString> options;
     QString line;
     QString file;
 
     void parseData(const QString &data);
 };
 
+static bool isKnownType(const QStringRef &type)
+{
+    return type == QLatin1String("deb") || type == QLatin1String("deb-src") ||
+           type == QLatin1String("rpm") || type == QLatin1String("rpm-src");
+}
+
 void SourceEntryPrivate::parseData(const QString &data)
 {
     if (data.isEmpty())
         return;
 
-    QString tData = data.simplified();
+    const QString tData = data.simplified();
 
     // Check for nonvalid input
     if (tData.isEmpty() || tData == QChar('#')) {
@@ -80,40 +86,52 @@ void SourceEntryPrivate::parseData(const QString &data)
         return;
     }
 
+    int start = 0;
+    int end = tData.size();
+
     // Check source enable state
     if (tData.at(0) == '#') {
         isEnabled = false;
     }
     // Handle multiple comment characters (hey, it happens!)
-    while (tData.size() > 0 && tData.at(0) == '#') {
-        // Remove starting '#' from tData
-        tData = tData.remove(0, 1);
-        tData = tData.trimmed();
+    while (start < end && (tData.at(start) == '#' || tData.at(start) == ' ')) {
+        ++start;
     }
 
     // Find any #'s past the start (these are comments)
-    int idx = tData.indexOf('#');
-    if (idx > 0) {
-        // Save the comment, then remove from tData
-        comment = tData.right(tData.size() - idx - 1);
-        tData.remove(idx, tData.size() - idx + 1);
+    int idx = tData.indexOf('#', start);
+    if (idx > start) {
+        // Save the comment, then leave it out of the rest
+        comment = tData.mid(idx + 1);
+        end = idx;
     }
 
-    const QRegularExpression rx("^([a-z\\-]+) *");
-    QRegularExpressionMatch match = rx.match(tData);
-
     // Parse type
-    type = match.captured(1);
-    const QSet<QString> types = { QLatin1String("rpm"), QLatin1String("rpm-src"), QLatin1String("deb"), QLatin1String("deb-src") };
-    if (!match.isValid() || !types.contains(type)) {
+    int typeEnd = start;
+    while (typeEnd < end && ((tData.at(typeEnd) >= 'a' && tData.at(typeEnd) <= 'z') || tData.at(typeEnd) == '-')) {
+        ++typeEnd;
+    }
+
+    const QStringRef typeRef = tData.midRef(start, typeEnd - start);
+    if (!isKnownType(typeRef)) {
+        type = typeRef.toString();
         isValid = false;
         return;
     }
-    
-    int start = match.capturedEnd(), end = tData.size();
+    type = typeRef.toString();
+
+    for (start = typeEnd; start < end && tData.at(start) == ' '; ++start)
+    {}
+
     // Parse architecture, see https://wiki.debian.org/Multiarch/HOWTO, Setting up sources
-    if (tData[start] == '[') {
-        QString metadata = tData.mid(start+1, tData.indexOf(']')-start-1);
+    if (start < end && tData.at(start) == '[') {
+        const int close = tData.indexOf(']', start);
+        if (close == -1 || close >= end) {
+            isValid = false;
+            return;
+        }
+
+        QString metadata = tData.mid(start+1, close-start-1);
         QStringList options = metadata.split(';');
         for (const QString &option : options) {
             QStringList parts = option.split('=');
@@ -132,16 +150,15 @@ void SourceEntryPrivate::parseData(const QString &data)
             QString value = parts.at(1);
             architectures = value.split(',');
         }
-        
-        start+=metadata.size()+2;
-        for (; tData[start] == ' '; ++start)
+
+        for (start = close + 1; start < end && tData.at(start) == ' '; ++start)
         {}
     }
-    
+
     bool inString = false;
     bool done = false;
     for (int i = start; !done && i<end; ++i) {
-        switch (tData[i].toLatin1()) {
+        switch (tData.at(i).toLatin1()) {
         case ' ':
             if (!inString) {
                 uri = tData.mid(start, i-start);
@@ -161,7 +178,7 @@ void SourceEntryPrivate::parseData(const QString &data)
         return;
     }
 
-    QStringList pieces = tData.mid(start).split(' ', QString::SkipEmptyParts);
+    QStringList pieces = tData.mid(start, end - start).split(' ', QString::SkipEmptyParts);
     if (pieces.isEmpty()) {
         // Invalid source entry
         isValid = false;
@@ -263,6 +280,11 @@ QString SourceEntry::comment() const
     return d->comment;
 }
 
+QMap<QString, QString> SourceEntry::options() const
+{
+    return d->options;
+}
+
 QString SourceEntry::file() const
 {
     return d->file;
@@ -340,6 +362,11 @@ void SourceEntry::setComment(const QString &comment)
     d->comment = comment;
 }
 
+void SourceEntry::setOptions(const QMap<QString, QString> &options)
+{
+    d->options = options;
+}
+
 void SourceEntry::setFile(const QString &file)
 {
     d->file = file;
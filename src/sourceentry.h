@@ -22,6 +22,7 @@
 #define SOURCEENTRY_H
 
 // Qt includes
+#include <QMap>
 #include <QSharedDataPointer>
 #include <QStringList>
 
@@ -51,6 +52,14 @@ public:
     QString dist() const;
     QStringList components() const;
     QString comment() const;
+    /**
+     * Additional options of the source such as Signed-By, keyed by their
+     * deb822 field name. These are read from and written to deb822 .sources
+     * files only.
+     *
+     * @since 3.1
+     */
+    QMap<QString, QString> options() const;
     QString file() const;
     QString toString() const;
 
@@ -61,6 +70,8 @@ public:
     void setDist(const QString &dist);
     void setComponents(const QStringList &comps);
     void setComment(const QString &comment);
+    /// @since 3.1
+    void setOptions(const QMap<QString, QString> &options);
     void setFile(const QString &file);
 
 private:
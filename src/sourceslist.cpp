@@ -23,6 +23,14 @@
 // Qt includes
 #include <QDir>
 #include <QDebug>
+#include <QSet>
+#include <QStringBuilder>
+#include <QThread>
+#include <QVector>
+
+#include <atomic>
+#include <thread>
+#include <vector>
 
 // APT includes
 #include <apt-pkg/configuration.h>
@@ -55,10 +63,13 @@ public:
 
     // Data
     QHash< QString, QApt::SourceEntryList > list;
+    // Files with changes that have not been saved yet
+    QSet<QString> modifiedFiles;
 
     void setDefaultSourcesFiles();
     void reload();
-    void load(const QString &filePath);
+    static SourceEntryList load(const QString &filePath);
+    static SourceEntryList parseDeb822(const QString &data, const QString &filePath);
 
     void addSourcesFile(const QString &filePath);
     void addSourcesFileList(const QStringList &filePathList);
@@ -87,7 +98,7 @@ void SourcesListPrivate::setDefaultSourcesFiles()
 
     // Go through the parts dir and append those
     QDir partsDir(QString::fromStdString(_config->FindFile("Dir::Etc::sourceparts")));
-    for (const QString& file : partsDir.entryList(QStringList() << "*.list")) {
+    for (const QString& file : partsDir.entryList(QStringList() << "*.list" << "*.sources")) {
         addSourcesFile(partsDir.filePath(file));
     }
 
@@ -97,28 +108,174 @@ void SourcesListPrivate::setDefaultSourcesFiles()
 void SourcesListPrivate::reload()
 {
     list.clear();
+    modifiedFiles.clear();
 
+    QStringList files;
     for (const QString &file : sourceFiles) {
         if (!file.isNull() && !file.isEmpty() ) {
-            load(file);
+            files << file;
+        }
+    }
+
+    // Files are independent of each other, so parse them concurrently
+    QVector<SourceEntryList> entries(files.size());
+    std::atomic<int> next(0);
+
+    auto work = [&]() {
+        int index;
+        while ((index = next++) < files.size()) {
+            entries[index] = load(files.at(index));
+        }
+    };
+
+    const int threads = qBound(1, QThread::idealThreadCount(), files.size() / 4 + 1);
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; ++i) {
+        pool.emplace_back(work);
+    }
+    work();
+    for (std::thread &thread : pool) {
+        thread.join();
+    }
+
+    for (int i = 0; i < files.size(); ++i) {
+        if (!entries.at(i).isEmpty()) {
+            list[files.at(i)] = entries.at(i);
         }
     }
 }
 
-void SourcesListPrivate::load(const QString &filePath)
+SourceEntryList SourcesListPrivate::load(const QString &filePath)
 {
     QFile file(filePath);
 
     if (!file.open(QFile::Text | QIODevice::ReadOnly)) {
         qWarning() << "Unable to open the file " << filePath << " as read-only text: " << file.errorString();
-        return;
+        return SourceEntryList();
+    }
+
+    const QString data = QString::fromUtf8(file.readAll());
+
+    if (filePath.endsWith(QLatin1String(".sources"))) {
+        return parseDeb822(data, filePath);
     }
 
     // Make a source entry for each line in the file
-    while (!file.atEnd()) {
-        QString line = file.readLine();
-        list[filePath].append(SourceEntry(line, filePath));
+    SourceEntryList entries;
+    int pos = 0;
+    while (pos < data.size()) {
+        int end = data.indexOf(QLatin1Char('\n'), pos);
+        end = (end == -1) ? data.size() : end + 1;
+
+        entries.append(SourceEntry(data.mid(pos, end - pos), filePath));
+        pos = end;
     }
+
+    return entries;
+}
+
+static QString fieldValue(const QList<QPair<QString, QString> > &fields, const char *name)
+{
+    for (const auto &field : fields) {
+        if (field.first.compare(QLatin1String(name), Qt::CaseInsensitive) == 0) {
+            return field.second;
+        }
+    }
+
+    return QString();
+}
+
+static void addDeb822Entries(const QList<QPair<QString, QString> > &fields,
+                             const QString &filePath, SourceEntryList &entries)
+{
+    static const char *const knownFields[] = {
+        "Types", "URIs", "Suites", "Components", "Architectures", "Enabled"
+    };
+
+    if (fields.isEmpty()) {
+        return;
+    }
+
+    const QStringList types = fieldValue(fields, "Types").simplified().split(' ', QString::SkipEmptyParts);
+    const QStringList uris = fieldValue(fields, "URIs").simplified().split(' ', QString::SkipEmptyParts);
+    const QStringList suites = fieldValue(fields, "Suites").simplified().split(' ', QString::SkipEmptyParts);
+    const QStringList components = fieldValue(fields, "Components").simplified().split(' ', QString::SkipEmptyParts);
+    const QStringList archs = fieldValue(fields, "Architectures").simplified().split(' ', QString::SkipEmptyParts);
+    const bool enabled = fieldValue(fields, "Enabled").trimmed().compare(QLatin1String("no"), Qt::CaseInsensitive) != 0;
+
+    // Everything else, e.g. Signed-By, is kept as is
+    QMap<QString, QString> options;
+    for (const auto &field : fields) {
+        bool known = false;
+        for (const char *name : knownFields) {
+            if (field.first.compare(QLatin1String(name), Qt::CaseInsensitive) == 0) {
+                known = true;
+                break;
+            }
+        }
+        if (!known) {
+            options.insert(field.first, field.second);
+        }
+    }
+
+    // A stanza stands for every combination of its types, URIs and suites
+    for (const QString &type : types) {
+        for (const QString &uri : uris) {
+            for (const QString &suite : suites) {
+                SourceEntry entry(type, uri, suite, components, QString(), archs, filePath);
+                entry.setEnabled(enabled);
+                entry.setOptions(options);
+                entries.append(entry);
+            }
+        }
+    }
+}
+
+SourceEntryList SourcesListPrivate::parseDeb822(const QString &data, const QString &filePath)
+{
+    SourceEntryList entries;
+    QList<QPair<QString, QString> > fields;
+
+    int pos = 0;
+    while (pos <= data.size()) {
+        int end = data.indexOf(QLatin1Char('\n'), pos);
+        if (end == -1) {
+            end = data.size();
+        }
+        const QStringRef line = data.midRef(pos, end - pos);
+        pos = end + 1;
+
+        if (line.startsWith(QLatin1Char('#'))) {
+            continue;
+        }
+
+        // Stanzas are separated by empty lines
+        if (line.trimmed().isEmpty()) {
+            addDeb822Entries(fields, filePath, entries);
+            fields.clear();
+            continue;
+        }
+
+        // Continuation lines are kept verbatim, for multi-line options
+        if (line.at(0) == QLatin1Char(' ') || line.at(0) == QLatin1Char('\t')) {
+            if (!fields.isEmpty()) {
+                fields.last().second += QLatin1Char('\n') + line.toString();
+            }
+            continue;
+        }
+
+        const int colon = line.indexOf(QLatin1Char(':'));
+        if (colon <= 0) {
+            continue;
+        }
+
+        fields.append(qMakePair(line.left(colon).trimmed().toString(),
+                                line.mid(colon + 1).trimmed().toString()));
+    }
+
+    addDeb822Entries(fields, filePath, entries);
+
+    return entries;
 }
 
 SourcesList::SourcesList(QObject *parent)
@@ -194,6 +351,7 @@ void SourcesList::addEntry(const SourceEntry &entry)
     }
 
     d->list[entryForFile].append(entry);
+    d->modifiedFiles << entryForFile;
 }
 
 void SourcesList::removeEntry(const SourceEntry &entry)
@@ -203,12 +361,16 @@ void SourcesList::removeEntry(const SourceEntry &entry)
     // If we have a file in the entry given, optimize the remove.
     const QString &entryForFile = entry.file();
     if (!entryForFile.isEmpty()) {
-        d->list[entryForFile].removeAll(entry);
+        if (d->list[entryForFile].removeAll(entry)) {
+            d->modifiedFiles << entryForFile;
+        }
         return;
     }
 
     for (QString &sourcesFile : sourceFiles()) {
-        d->list[sourcesFile].removeAll(entry);
+        if (d->list[sourcesFile].removeAll(entry)) {
+            d->modifiedFiles << sourcesFile;
+        }
     }
 
     return;
@@ -235,6 +397,39 @@ QString SourcesList::dataForSourceFile(const QString& sourceFile)
 {
     QString to_return;
 
+    if (sourceFile.endsWith(QLatin1String(".sources"))) {
+        // One deb822 stanza per entry
+        for (const SourceEntry &listEntry : entries(sourceFile)) {
+            if (!listEntry.isValid()) {
+                continue;
+            }
+
+            if (!to_return.isEmpty()) {
+                to_return += '\n';
+            }
+
+            to_return += QLatin1String("Types: ") % listEntry.type() % '\n'
+                         % QLatin1String("URIs: ") % listEntry.uri() % '\n'
+                         % QLatin1String("Suites: ") % listEntry.dist() % '\n';
+            if (!listEntry.components().isEmpty()) {
+                to_return += QLatin1String("Components: ") % listEntry.components().join(' ') % '\n';
+            }
+            if (!listEntry.architectures().isEmpty()) {
+                to_return += QLatin1String("Architectures: ") % listEntry.architectures().join(' ') % '\n';
+            }
+            if (!listEntry.isEnabled()) {
+                to_return += QLatin1String("Enabled: no\n");
+            }
+
+            const QMap<QString, QString> options = listEntry.options();
+            for (auto it = options.constBegin(); it != options.constEnd(); ++it) {
+                to_return += it.key() % QLatin1String(": ") % it.value() % '\n';
+            }
+        }
+
+        return to_return;
+    }
+
     for (const SourceEntry &listEntry : entries(sourceFile)) {
         to_return.append(listEntry.toString() + '\n');
     }
@@ -264,16 +459,42 @@ QString SourcesList::toString() const
     return toReturn;
 }
 
+QStringList SourcesList::modifiedFiles() const
+{
+    Q_D(const SourcesList);
+
+    QStringList files;
+    for (const QString &sourceFile : d->sourceFiles) {
+        if (d->modifiedFiles.contains(sourceFile)) {
+            files << sourceFile;
+        }
+    }
+
+    return files;
+}
+
 void SourcesList::save()
 {
     Q_D(SourcesList);
 
-    for (const QString &sourceFile : sourceFiles()) {
-        qDebug() << "Writing file " << sourceFile << " with: " << dataForSourceFile(sourceFile);
-        if (! d->worker->writeFileToDisk(dataForSourceFile(sourceFile), sourceFile)) {
-            qWarning() << "Failed to write the file to disk (dbus call failed)!";
-        }
+    if (d->modifiedFiles.isEmpty()) {
+        return;
+    }
+
+    // Only write what changed, all in one go
+    QVariantMap files;
+    for (const QString &sourceFile : modifiedFiles()) {
+        const QString data = dataForSourceFile(sourceFile);
+        qDebug() << "Writing file " << sourceFile << " with: " << data;
+        files[sourceFile] = data;
     }
+
+    if (! d->worker->writeFilesToDisk(files, QStringList())) {
+        qWarning() << "Failed to write the files to disk (dbus call failed)!";
+        return;
+    }
+
+    d->modifiedFiles.clear();
 }
 
 }
@@ -46,6 +46,20 @@ public:
     bool containsEntry(const SourceEntry &entry, const QString &sourceFile = QString());
     QStringList sourceFiles();
     QString toString() const;
+
+    /**
+     * Returns the sources files with entries added or removed since they
+     * were last loaded or saved. These can be passed to
+     * Backend::updateCache(const QStringList &) after save().
+     *
+     * @since 3.1
+     */
+    QStringList modifiedFiles() const;
+
+    /**
+     * Writes the modified sources files to disk, in a single call to the
+     * worker. Files without changes are left alone.
+     */
     void save();
 
 private:
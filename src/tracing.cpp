@@ -0,0 +1,165 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "tracing.h"
+
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <apt-pkg/configuration.h>
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <time.h>
+#include <unistd.h>
+
+namespace QApt {
+
+namespace {
+
+std::atomic<bool> s_enabled(false);
+std::mutex s_mutex;
+FILE *s_file = nullptr;
+bool s_firstEvent = true;
+
+int currentThread()
+{
+    // Small, stable numbers read better in trace viewers than pthread_ts
+    static std::atomic<int> nextThread(1);
+    thread_local int thread = nextThread++;
+    return thread;
+}
+
+void writeEvent(const QJsonObject &event)
+{
+    const QByteArray json = QJsonDocument(event).toJson(QJsonDocument::Compact);
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (!s_file)
+        return;
+
+    // The closing bracket is optional, so a trace stays valid when the
+    // process does not shut down cleanly
+    fputs(s_firstEvent ? "[\n" : ",\n", s_file);
+    fwrite(json.constData(), 1, json.size(), s_file);
+    fflush(s_file);
+    s_firstEvent = false;
+}
+
+}
+
+namespace Tracing {
+
+void init(const char *processName)
+{
+    if (s_enabled)
+        return;
+
+    QString directory = QFile::decodeName(qgetenv("QAPT_TRACE_DIR"));
+    if (directory.isEmpty())
+        directory = QString::fromStdString(_config->Find("QApt::Trace::Directory"));
+    if (directory.isEmpty())
+        return;
+
+    QDir().mkpath(directory);
+    const QString fileName = QStringLiteral("%1/qapt-%2-%3.json")
+                             .arg(directory, QLatin1String(processName))
+                             .arg(getpid());
+
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_file = fopen(QFile::encodeName(fileName).constData(), "w");
+        if (!s_file)
+            return;
+    }
+
+    QJsonObject args;
+    args[QStringLiteral("name")] = QLatin1String(processName);
+
+    QJsonObject event;
+    event[QStringLiteral("name")] = QStringLiteral("process_name");
+    event[QStringLiteral("ph")] = QStringLiteral("M");
+    event[QStringLiteral("pid")] = getpid();
+    event[QStringLiteral("args")] = args;
+    writeEvent(event);
+
+    s_enabled = true;
+}
+
+bool isEnabled()
+{
+    return s_enabled;
+}
+
+qint64 now()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return qint64(time.tv_sec) * 1000000 + time.tv_nsec / 1000;
+}
+
+void complete(const char *category, const QString &name, qint64 start, qint64 end,
+              const QString &transactionId)
+{
+    if (!s_enabled)
+        return;
+
+    QJsonObject event;
+    event[QStringLiteral("name")] = name;
+    event[QStringLiteral("cat")] = QLatin1String(category);
+    event[QStringLiteral("ph")] = QStringLiteral("X");
+    event[QStringLiteral("ts")] = double(start);
+    event[QStringLiteral("dur")] = double(end - start);
+    event[QStringLiteral("pid")] = getpid();
+    event[QStringLiteral("tid")] = currentThread();
+
+    if (!transactionId.isEmpty()) {
+        QJsonObject args;
+        args[QStringLiteral("transaction")] = transactionId;
+        event[QStringLiteral("args")] = args;
+    }
+
+    writeEvent(event);
+}
+
+}
+
+TraceSpan::TraceSpan(const char *category, const char *name)
+    : m_category(category)
+    , m_name(name)
+    , m_start(Tracing::isEnabled() ? Tracing::now() : 0)
+{
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (m_start)
+        Tracing::complete(m_category, QLatin1String(m_name), m_start, Tracing::now(), m_transactionId);
+}
+
+void TraceSpan::setTransactionId(const QString &transactionId)
+{
+    m_transactionId = transactionId;
+}
+
+}
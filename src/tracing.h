@@ -0,0 +1,86 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef QAPT_TRACING_H
+#define QAPT_TRACING_H
+
+#include <QString>
+
+namespace QApt {
+
+/**
+ * Opt-in tracing of the expensive operations of LibQApt and its worker.
+ *
+ * Tracing is enabled by setting QApt::Trace::Directory in the APT
+ * configuration, or the QAPT_TRACE_DIR environment variable for client
+ * processes. Each process then writes its spans to
+ * <directory>/qapt-<process>-<pid>.json in the Chrome trace event format,
+ * which can be loaded by chrome://tracing or Perfetto.
+ *
+ * Timestamps are taken from the monotonic clock, so the traces of the
+ * client and worker share one time base. Spans belonging to a transaction
+ * carry its ID in their "transaction" argument, which correlates both
+ * sides of one install across the D-Bus boundary.
+ */
+namespace Tracing {
+    /**
+     * Enables tracing if a trace directory has been configured. Has to be
+     * called after the APT configuration has been initialized, spans
+     * before that are dropped.
+     */
+    Q_DECL_EXPORT void init(const char *processName);
+
+    /// Returns whether spans are being written
+    Q_DECL_EXPORT bool isEnabled();
+
+    /// The current time in microseconds, in the time base of the trace
+    Q_DECL_EXPORT qint64 now();
+
+    /// Writes a span that ran from @p start to @p end, as given by now()
+    Q_DECL_EXPORT void complete(const char *category, const QString &name,
+                                qint64 start, qint64 end,
+                                const QString &transactionId = QString());
+}
+
+/**
+ * Writes a tracing span covering its own lifetime. Does nothing unless
+ * tracing is enabled.
+ */
+class Q_DECL_EXPORT TraceSpan
+{
+public:
+    TraceSpan(const char *category, const char *name);
+    ~TraceSpan();
+
+    /// Attaches the span to a transaction, for spans ending after it is known
+    void setTransactionId(const QString &transactionId);
+
+private:
+    Q_DISABLE_COPY(TraceSpan)
+
+    const char *m_category;
+    const char *m_name;
+    QString m_transactionId;
+    qint64 m_start;
+};
+
+}
+
+#endif
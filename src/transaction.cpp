@@ -21,8 +21,10 @@
 #include "transaction.h"
 
 // Qt includes
+#include <QDBusMetaType>
 #include <QDBusPendingCallWatcher>
 #include <QDBusVariant>
+#include <QHash>
 
 #include <QDebug>
 
@@ -35,7 +37,10 @@ class TransactionPrivate
 {
     public:
         TransactionPrivate(const QString &id)
-            : tid(id)
+            : dbus(nullptr)
+            , peer(nullptr)
+            , watcher(nullptr)
+            , tid(id)
             , uid(0)
             , role(EmptyRole)
             , status(QApt::SetupStatus)
@@ -47,6 +52,22 @@ class TransactionPrivate
             , progress(0)
             , downloadSpeed(0)
             , downloadETA(0)
+            , markingTime(0)
+            , lockHolderPid(0)
+            , lockWaitTime(0)
+            , downloadProgressInterval(250)
+            , priority(QApt::InteractivePriority)
+            , queueWaitTime(0)
+            , isReady(false)
+            , runRequested(false)
+            , cancelRequested(false)
+        {
+            qDBusRegisterMetaType<QMap<int, QDBusVariant> >();
+            if (!tid.isEmpty())
+                createInterface();
+        }
+
+        void createInterface()
         {
             dbus = new TransactionInterface(QLatin1String(s_workerReverseDomainName),
                                             tid, QDBusConnection::systemBus(),
@@ -55,11 +76,36 @@ class TransactionPrivate
 
         ~TransactionPrivate()
         {
+            delete peer;
             delete dbus;
+
+            if (!peerName.isEmpty())
+                QDBusConnection::disconnectFromPeer(peerName);
+        }
+
+        DownloadProgress resolveDownloadProgress(const DownloadProgress &progress)
+        {
+            if (!progress.id())
+                return progress;
+
+            // Full progress is kept for the updates that follow it
+            auto known = downloadItems.find(progress.id());
+            if (known == downloadItems.end()) {
+                if (!progress.isUpdate())
+                    downloadItems.insert(progress.id(), progress);
+                return progress;
+            }
+
+            *known = known->applied(progress);
+            return *known;
         }
 
         // DBus
         TransactionInterface *dbus;
+        // The same transaction over the private channel of the worker, which
+        // carries the download progress once it is connected
+        TransactionInterface *peer;
+        QString peerName;
         QDBusServiceWatcher *watcher;
 
         // Data
@@ -79,36 +125,146 @@ class TransactionPrivate
         QString statusDetails;
         int progress;
         DownloadProgress downloadProgress;
+        QHash<quint32, DownloadProgress> downloadItems;
         QStringList untrustedPackages;
         quint64 downloadSpeed;
         quint64 downloadETA;
         QString filePath;
         QString errorDetails;
         QApt::FrontendCaps frontendCaps;
+        quint64 markingTime;
+        int lockHolderPid;
+        QString lockHolderName;
+        quint64 lockWaitTime;
+        int downloadProgressInterval;
+        QApt::TransactionPriority priority;
+        quint64 queueWaitTime;
+        QVariantMap phaseTimes;
+        QVariantMap hostDownloadSpeeds;
+
+        // Asynchronous setup
+        bool isReady;
+        bool runRequested;
+        bool cancelRequested;
+        QList<QPair<int, QDBusVariant> > pendingProperties;
 };
 
 Transaction::Transaction(const QString &tid)
     : QObject()
     , d(new TransactionPrivate(tid))
 {
+    // The worker could not be reached. Calls on us stay queued forever,
+    // since there is no transaction to send them to.
+    if (!d->dbus) {
+        updateError(QApt::WorkerDisappeared);
+        updateStatus(QApt::FinishedStatus);
+        updateExitStatus(QApt::ExitFailed);
+        return;
+    }
+
     // Fetch property data from D-Bus
     sync();
+    connectToWorker();
+    d->isReady = true;
+}
 
+Transaction::Transaction(const QDBusPendingCall &call)
+    : QObject()
+    , d(new TransactionPrivate(QString()))
+{
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onTransactionCreated(QDBusPendingCallWatcher*)));
+}
+
+void Transaction::connectToWorker()
+{
     d->watcher = new QDBusServiceWatcher(this);
     d->watcher->setConnection(QDBusConnection::systemBus());
     d->watcher->setWatchMode(QDBusServiceWatcher::WatchForOwnerChange);
     d->watcher->addWatchedService(QLatin1String(s_workerReverseDomainName));
 
-    connect(d->dbus, SIGNAL(propertyChanged(int,QDBusVariant)),
-            this, SLOT(updateProperty(int,QDBusVariant)));
-    connect(d->dbus, SIGNAL(mediumRequired(QString,QString)),
+    connectSignals(d->dbus);
+    connect(d->watcher, SIGNAL(serviceOwnerChanged(QString,QString,QString)),
+            this, SLOT(serviceOwnerChanged(QString,QString,QString)));
+
+    // Progress is streamed over a private channel if the worker offers one,
+    // the system bus keeps working until it is up
+    QDBusPendingCallWatcher *channelWatcher =
+            new QDBusPendingCallWatcher(d->dbus->openProgressChannel(), this);
+    connect(channelWatcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onProgressChannelOpened(QDBusPendingCallWatcher*)));
+}
+
+void Transaction::connectSignals(QObject *interface)
+{
+    connect(interface, SIGNAL(propertiesChanged(QMap<int,QDBusVariant>)),
+            this, SLOT(updateProperties(QMap<int,QDBusVariant>)));
+    connect(interface, SIGNAL(mediumRequired(QString,QString)),
             this, SIGNAL(mediumRequired(QString,QString)));
-    connect(d->dbus, SIGNAL(promptUntrusted(QStringList)),
+    connect(interface, SIGNAL(promptUntrusted(QStringList)),
             this, SIGNAL(promptUntrusted(QStringList)));
-    connect(d->dbus, SIGNAL(configFileConflict(QString,QString)),
+    connect(interface, SIGNAL(configFileConflict(QString,QString)),
             this, SIGNAL(configFileConflict(QString,QString)));
-    connect(d->watcher, SIGNAL(serviceOwnerChanged(QString,QString,QString)),
-            this, SLOT(serviceOwnerChanged(QString,QString,QString)));
+    connect(interface, SIGNAL(downloadProgressBatch(QList<QApt::DownloadProgress>)),
+            this, SLOT(updateDownloadProgressBatch(QList<QApt::DownloadProgress>)));
+}
+
+void Transaction::onProgressChannelOpened(QDBusPendingCallWatcher *watcher)
+{
+    QDBusPendingReply<QVariantMap> reply = *watcher;
+    watcher->deleteLater();
+
+    // Older workers have no channel
+    if (reply.isError())
+        return;
+
+    const QVariantMap channel = reply.value();
+    d->peerName = QLatin1String("qapt-channel-") + d->tid;
+
+    QDBusConnection connection =
+            QDBusConnection::connectToPeer(channel.value(QLatin1String("address")).toString(), d->peerName);
+    if (!connection.isConnected()) {
+        QDBusConnection::disconnectFromPeer(d->peerName);
+        d->peerName.clear();
+        return;
+    }
+
+    d->peer = new TransactionInterface(QString(), d->tid, connection, 0);
+
+    QDBusMessage authenticate =
+            QDBusMessage::createMethodCall(QString(), d->tid,
+                                           QString::fromLatin1(s_workerReverseDomainName) +
+                                           QLatin1String(".transactionchannel"),
+                                           QLatin1String("authenticate"));
+    authenticate << channel.value(QLatin1String("token")).toString();
+
+    QDBusPendingCallWatcher *authWatcher =
+            new QDBusPendingCallWatcher(connection.asyncCall(authenticate), this);
+    connect(authWatcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onProgressChannelAuthenticated(QDBusPendingCallWatcher*)));
+}
+
+void Transaction::onProgressChannelAuthenticated(QDBusPendingCallWatcher *watcher)
+{
+    QDBusPendingReply<bool> reply = *watcher;
+    watcher->deleteLater();
+
+    // Download progress comes over the channel from now on, everything else
+    // keeps coming over the system bus
+    if (!reply.isError() && reply.value()) {
+        disconnect(d->dbus, SIGNAL(downloadProgressBatch(QList<QApt::DownloadProgress>)),
+                   this, SLOT(updateDownloadProgressBatch(QList<QApt::DownloadProgress>)));
+        connect(d->peer, SIGNAL(downloadProgressBatch(QList<QApt::DownloadProgress>)),
+                this, SLOT(updateDownloadProgressBatch(QList<QApt::DownloadProgress>)));
+        return;
+    }
+
+    qWarning() << "could not authenticate with the transaction channel" << reply.error();
+    delete d->peer;
+    d->peer = nullptr;
+    QDBusConnection::disconnectFromPeer(d->peerName);
+    d->peerName.clear();
 }
 
 Transaction::~Transaction()
@@ -126,6 +282,11 @@ QString Transaction::transactionId() const
     return d->tid;
 }
 
+bool Transaction::isReady() const
+{
+    return d->isReady;
+}
+
 void Transaction::updateTransactionId(const QString &tid)
 {
     d->tid = tid;
@@ -385,7 +546,7 @@ DownloadProgress Transaction::downloadProgress() const
 
 void Transaction::updateDownloadProgress(const DownloadProgress &downloadProgress)
 {
-    d->downloadProgress = downloadProgress;
+    d->downloadProgress = d->resolveDownloadProgress(downloadProgress);
 }
 
 QStringList Transaction::untrustedPackages() const
@@ -445,22 +606,12 @@ void Transaction::updateErrorDetails(const QString &errorDetails)
 
 void Transaction::setLocale(const QString &locale)
 {
-    QDBusPendingCall call = d->dbus->setProperty(QApt::LocaleProperty,
-                                                 QDBusVariant(locale));
-
-    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
-    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
-            this, SLOT(onCallFinished(QDBusPendingCallWatcher*)));
+    setWorkerProperty(QApt::LocaleProperty, QDBusVariant(locale));
 }
 
 void Transaction::setFrontendCaps(FrontendCaps frontendCaps)
 {
-    QDBusPendingCall call = d->dbus->setProperty(QApt::FrontendCapsProperty,
-                                                 QDBusVariant((int)frontendCaps));
-
-    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
-    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
-            this, SLOT(onCallFinished(QDBusPendingCallWatcher*)));
+    setWorkerProperty(QApt::FrontendCapsProperty, QDBusVariant((int)frontendCaps));
 }
 
 void Transaction::updateFrontendCaps(FrontendCaps frontendCaps)
@@ -468,28 +619,128 @@ void Transaction::updateFrontendCaps(FrontendCaps frontendCaps)
     d->frontendCaps = frontendCaps;
 }
 
-void Transaction::setProxy(const QString &proxy)
+quint64 Transaction::markingTime() const
 {
-    QDBusPendingCall call = d->dbus->setProperty(QApt::ProxyProperty,
-                                                 QDBusVariant(proxy));
+    return d->markingTime;
+}
 
-    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
-    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
-            this, SLOT(onCallFinished(QDBusPendingCallWatcher*)));
+void Transaction::updateMarkingTime(quint64 markingTime)
+{
+    d->markingTime = markingTime;
 }
 
-void Transaction::setDebconfPipe(const QString &pipe)
+int Transaction::lockHolderPid() const
 {
-    QDBusPendingCall call = d->dbus->setProperty(QApt::DebconfPipeProperty,
-                                                 QDBusVariant(pipe));
+    return d->lockHolderPid;
+}
 
-    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
-    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
-            this, SLOT(onCallFinished(QDBusPendingCallWatcher*)));
+void Transaction::updateLockHolderPid(int pid)
+{
+    d->lockHolderPid = pid;
+}
+
+QString Transaction::lockHolderName() const
+{
+    return d->lockHolderName;
+}
+
+void Transaction::updateLockHolderName(const QString &name)
+{
+    d->lockHolderName = name;
+}
+
+quint64 Transaction::lockWaitTime() const
+{
+    return d->lockWaitTime;
+}
+
+void Transaction::updateLockWaitTime(quint64 lockWaitTime)
+{
+    d->lockWaitTime = lockWaitTime;
+}
+
+int Transaction::downloadProgressInterval() const
+{
+    return d->downloadProgressInterval;
+}
+
+void Transaction::setDownloadProgressInterval(int msecs)
+{
+    setWorkerProperty(QApt::DownloadProgressIntervalProperty, QDBusVariant(msecs));
+}
+
+void Transaction::updateDownloadProgressInterval(int msecs)
+{
+    d->downloadProgressInterval = msecs;
+}
+
+QApt::TransactionPriority Transaction::priority() const
+{
+    return d->priority;
+}
+
+void Transaction::setPriority(QApt::TransactionPriority priority)
+{
+    setWorkerProperty(QApt::PriorityProperty, QDBusVariant((int)priority));
+}
+
+void Transaction::updatePriority(int priority)
+{
+    d->priority = (QApt::TransactionPriority)priority;
+}
+
+quint64 Transaction::queueWaitTime() const
+{
+    return d->queueWaitTime;
+}
+
+void Transaction::updateQueueWaitTime(quint64 queueWaitTime)
+{
+    d->queueWaitTime = queueWaitTime;
+}
+
+QVariantMap Transaction::phaseTimes() const
+{
+    return d->phaseTimes;
+}
+
+void Transaction::updatePhaseTimes(const QVariantMap &phaseTimes)
+{
+    d->phaseTimes = phaseTimes;
+}
+
+QVariantMap Transaction::hostDownloadSpeeds() const
+{
+    return d->hostDownloadSpeeds;
+}
+
+void Transaction::updateHostDownloadSpeeds(const QVariantMap &speeds)
+{
+    d->hostDownloadSpeeds = speeds;
+}
+
+void Transaction::setFetchPolicy(const FetchPolicy &policy)
+{
+    setWorkerProperty(QApt::FetchPolicyProperty, QDBusVariant(policy.toMap()));
+}
+
+void Transaction::setProxy(const QString &proxy)
+{
+    setWorkerProperty(QApt::ProxyProperty, QDBusVariant(proxy));
+}
+
+void Transaction::setDebconfPipe(const QString &pipe)
+{
+    setWorkerProperty(QApt::DebconfPipeProperty, QDBusVariant(pipe));
 }
 
 void Transaction::run()
 {
+    if (!d->isReady) {
+        d->runRequested = true;
+        return;
+    }
+
     QDBusPendingCall call = d->dbus->run();
 
     QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
@@ -499,6 +750,11 @@ void Transaction::run()
 
 void Transaction::cancel()
 {
+    if (!d->isReady) {
+        d->cancelRequested = true;
+        return;
+    }
+
     QDBusPendingCall call = d->dbus->cancel();
 
     QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
@@ -508,6 +764,9 @@ void Transaction::cancel()
 
 void Transaction::provideMedium(const QString &medium)
 {
+    if (!d->dbus)
+        return;
+
     QDBusPendingCall call = d->dbus->provideMedium(medium);
 
     QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
@@ -517,6 +776,9 @@ void Transaction::provideMedium(const QString &medium)
 
 void Transaction::replyUntrustedPrompt(bool approved)
 {
+    if (!d->dbus)
+        return;
+
     QDBusPendingCall call = d->dbus->replyUntrustedPrompt(approved);
 
     QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
@@ -526,6 +788,9 @@ void Transaction::replyUntrustedPrompt(bool approved)
 
 void Transaction::resolveConfigFileConflict(const QString &currentPath, bool replace)
 {
+    if (!d->dbus)
+        return;
+
     QDBusPendingCall call = d->dbus->resolveConfigFileConflict(currentPath, replace);
 
     QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
@@ -533,6 +798,68 @@ void Transaction::resolveConfigFileConflict(const QString &currentPath, bool rep
             this, SLOT(onCallFinished(QDBusPendingCallWatcher*)));
 }
 
+void Transaction::setWorkerProperty(int property, const QDBusVariant &value)
+{
+    // Sent once the worker told us which transaction we are
+    if (!d->isReady) {
+        d->pendingProperties.append(qMakePair(property, value));
+        return;
+    }
+
+    QDBusPendingCall call = d->dbus->setProperty(property, value);
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onCallFinished(QDBusPendingCallWatcher*)));
+}
+
+void Transaction::onTransactionCreated(QDBusPendingCallWatcher *watcher)
+{
+    QDBusPendingReply<QString> reply = *watcher;
+    watcher->deleteLater();
+
+    if (reply.isError() || reply.value().isEmpty()) {
+        qWarning() << "could not create transaction" << reply.error();
+        if (reply.error().type() == QDBusError::AccessDenied)
+            finishWithError(QApt::AuthError);
+        else
+            finishWithError(QApt::WorkerDisappeared);
+        return;
+    }
+
+    d->tid = reply.value();
+    d->createInterface();
+    connectToWorker();
+
+    QDBusPendingCallWatcher *syncWatcher =
+            new QDBusPendingCallWatcher(QDBusConnection::systemBus().asyncCall(syncMessage()), this);
+    connect(syncWatcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onSyncFinished(QDBusPendingCallWatcher*)));
+}
+
+void Transaction::onSyncFinished(QDBusPendingCallWatcher *watcher)
+{
+    QDBusPendingReply<QVariantMap> reply = *watcher;
+    watcher->deleteLater();
+
+    if (!reply.isError())
+        applyProperties(reply.value());
+
+    d->isReady = true;
+
+    // Replay what was asked of us while we were waiting
+    for (const auto &property : d->pendingProperties)
+        setWorkerProperty(property.first, property.second);
+    d->pendingProperties.clear();
+
+    if (d->cancelRequested)
+        cancel();
+    else if (d->runRequested)
+        run();
+
+    emit ready();
+}
+
 void Transaction::onCallFinished(QDBusPendingCallWatcher *watcher)
 {
     QDBusPendingReply<> reply = *watcher;
@@ -559,27 +886,50 @@ void Transaction::onCallFinished(QDBusPendingCallWatcher *watcher)
     watcher->deleteLater();
 }
 
+void Transaction::updateDownloadProgressBatch(const QList<QApt::DownloadProgress> &progress)
+{
+    if (progress.isEmpty())
+        return;
+
+    QList<DownloadProgress> resolved;
+    resolved.reserve(progress.size());
+    for (const DownloadProgress &item : progress)
+        resolved.append(d->resolveDownloadProgress(item));
+
+    d->downloadProgress = resolved.last();
+
+    // Keep per-item listeners working
+    for (const DownloadProgress &item : resolved)
+        emit downloadProgressChanged(item);
+
+    emit downloadProgressBatch(resolved);
+}
+
 void Transaction::serviceOwnerChanged(QString name, QString oldOwner, QString newOwner)
 {
     Q_UNUSED(name)
     Q_UNUSED(oldOwner)
 
-    if (newOwner.isEmpty() && d->exitStatus == QApt::ExitUnfinished) {
-        updateError(QApt::WorkerDisappeared);
-        emit errorOccurred(QApt::WorkerDisappeared);
+    if (newOwner.isEmpty() && d->exitStatus == QApt::ExitUnfinished)
+        finishWithError(QApt::WorkerDisappeared);
+}
 
-        updateCancellable(false);
-        emit cancellableChanged(false);
+void Transaction::finishWithError(QApt::ErrorCode error)
+{
+    updateError(error);
+    emit errorOccurred(error);
 
-        updateStatus(QApt::FinishedStatus);
-        emit statusChanged(QApt::FinishedStatus);
+    updateCancellable(false);
+    emit cancellableChanged(false);
 
-        updateExitStatus(QApt::ExitFailed);
-        emit finished(exitStatus());
-    }
+    updateStatus(QApt::FinishedStatus);
+    emit statusChanged(QApt::FinishedStatus);
+
+    updateExitStatus(QApt::ExitFailed);
+    emit finished(exitStatus());
 }
 
-void Transaction::sync()
+QDBusMessage Transaction::syncMessage() const
 {
     QString arg = QString("%1.%2").arg(QLatin1String(s_workerReverseDomainName),
                                        QLatin1String("transaction"));
@@ -587,12 +937,17 @@ void Transaction::sync()
                                                        "org.freedesktop.DBus.Properties", "GetAll");
     call.setArguments(QList<QVariant>() << arg);
 
-    QDBusReply<QVariantMap> reply = QDBusConnection::systemBus().call(call);
-    QVariantMap propertyMap = reply.value();
+    return call;
+}
 
-    if (propertyMap.isEmpty())
-        return;
+void Transaction::sync()
+{
+    QDBusReply<QVariantMap> reply = QDBusConnection::systemBus().call(syncMessage());
+    applyProperties(reply.value());
+}
 
+void Transaction::applyProperties(const QVariantMap &propertyMap)
+{
     for (auto iter = propertyMap.constBegin(); iter != propertyMap.constEnd(); ++iter) {
         if (!setProperty(iter.key().toLatin1(), iter.value())) {
             // Qt won't support arbitrary enums over dbus until "maybe Qt 6 or 7"
@@ -607,8 +962,12 @@ void Transaction::sync()
                 updateExitStatus((ExitStatus)iter.value().toInt());
             else if (iter.key() == QLatin1String("packages"))
                 // iter.value() for the QVariantMap is QDBusArgument, so we have to
-                // set this manually
-                setProperty(iter.key().toLatin1(), d->dbus->property(iter.key().toLatin1()));
+                // demarshall it manually
+                updatePackages(qdbus_cast<QVariantMap>(iter.value().value<QDBusArgument>()));
+            else if (iter.key() == QLatin1String("phaseTimes"))
+                updatePhaseTimes(qdbus_cast<QVariantMap>(iter.value().value<QDBusArgument>()));
+            else if (iter.key() == QLatin1String("hostDownloadSpeeds"))
+                updateHostDownloadSpeeds(qdbus_cast<QVariantMap>(iter.value().value<QDBusArgument>()));
             else if (iter.key() == QLatin1String("downloadProgress"))
                 updateDownloadProgress(iter.value().value<QApt::DownloadProgress>());
             else if (iter.key() == QLatin1String("frontendCaps"))
@@ -619,7 +978,24 @@ void Transaction::sync()
     }
 }
 
-void Transaction::updateProperty(int type, const QDBusVariant &variant)
+void Transaction::updateProperties(const QMap<int, QDBusVariant> &changes)
+{
+    // Apply all values before notifying anyone, so that listeners never
+    // see a transaction that is only partially updated
+    for (auto iter = changes.constBegin(); iter != changes.constEnd(); ++iter)
+        applyProperty(iter.key(), iter.value());
+
+    for (auto iter = changes.constBegin(); iter != changes.constEnd(); ++iter) {
+        if (iter.key() != ExitStatusProperty)
+            notifyProperty(iter.key());
+    }
+
+    // finished() comes last, listeners tend to delete the transaction
+    if (changes.contains(ExitStatusProperty))
+        notifyProperty(ExitStatusProperty);
+}
+
+void Transaction::applyProperty(int type, const QDBusVariant &variant)
 {
     switch (type) {
     case TransactionIdProperty:
@@ -631,11 +1007,9 @@ void Transaction::updateProperty(int type, const QDBusVariant &variant)
         break;
     case StatusProperty:
         updateStatus((TransactionStatus)variant.variant().toInt());
-        emit statusChanged(status());
         break;
     case ErrorProperty:
         updateError((ErrorCode)variant.variant().toInt());
-        emit errorOccurred(error());
         break;
     case LocaleProperty:
         updateLocale(variant.variant().toString());
@@ -651,26 +1025,18 @@ void Transaction::updateProperty(int type, const QDBusVariant &variant)
         break;
     case CancellableProperty:
         updateCancellable(variant.variant().toBool());
-        emit cancellableChanged(isCancellable());
         break;
     case CancelledProperty:
         updateCancelled(variant.variant().toBool());
         break;
     case ExitStatusProperty:
         updateExitStatus((ExitStatus)variant.variant().toInt());
-        if (exitStatus() != QApt::ExitUnfinished)
-            emit finished(exitStatus());
         break;
     case PausedProperty:
         updatePaused(variant.variant().toBool());
-        if (isPaused())
-            emit paused();
-        else
-            emit resumed();
         break;
     case StatusDetailsProperty:
         updateStatusDetails(variant.variant().toString());
-        emit statusDetailsChanged(statusDetails());
         break;
     case ProgressProperty:
         updateProgress(variant.variant().toInt());
@@ -681,19 +1047,31 @@ void Transaction::updateProperty(int type, const QDBusVariant &variant)
         arg >> prog;
 
         updateDownloadProgress(prog);
-        emit downloadProgressChanged(downloadProgress());
         break;
     }
+    case DownloadProgressIntervalProperty:
+        updateDownloadProgressInterval(variant.variant().toInt());
+        break;
+    case PriorityProperty:
+        updatePriority(variant.variant().toInt());
+        break;
+    case QueueWaitTimeProperty:
+        updateQueueWaitTime(variant.variant().toULongLong());
+        break;
+    case PhaseTimesProperty:
+        updatePhaseTimes(qdbus_cast<QVariantMap>(variant.variant()));
+        break;
+    case HostDownloadSpeedsProperty:
+        updateHostDownloadSpeeds(qdbus_cast<QVariantMap>(variant.variant()));
+        break;
     case UntrustedPackagesProperty:
         updateUntrustedPackages(variant.variant().toStringList());
         break;
     case DownloadSpeedProperty:
         updateDownloadSpeed(variant.variant().toULongLong());
-        emit downloadSpeedChanged(downloadSpeed());
         break;
     case DownloadETAProperty:
         updateDownloadETA(variant.variant().toULongLong());
-        emit downloadETAChanged(downloadETA());
         break;
     case FilePathProperty:
         updateFilePath(variant.variant().toString());
@@ -704,6 +1082,60 @@ void Transaction::updateProperty(int type, const QDBusVariant &variant)
     case FrontendCapsProperty:
         updateFrontendCaps((FrontendCaps)variant.variant().toInt());
         break;
+    case MarkingTimeProperty:
+        updateMarkingTime(variant.variant().toULongLong());
+        break;
+    case LockHolderPidProperty:
+        updateLockHolderPid(variant.variant().toInt());
+        break;
+    case LockHolderNameProperty:
+        updateLockHolderName(variant.variant().toString());
+        break;
+    case LockWaitTimeProperty:
+        updateLockWaitTime(variant.variant().toULongLong());
+        break;
+    default:
+        break;
+    }
+}
+
+void Transaction::notifyProperty(int type)
+{
+    switch (type) {
+    case StatusProperty:
+        emit statusChanged(status());
+        break;
+    case ErrorProperty:
+        emit errorOccurred(error());
+        break;
+    case CancellableProperty:
+        emit cancellableChanged(isCancellable());
+        break;
+    case ExitStatusProperty:
+        if (exitStatus() != QApt::ExitUnfinished)
+            emit finished(exitStatus());
+        break;
+    case PausedProperty:
+        if (isPaused())
+            emit paused();
+        else
+            emit resumed();
+        break;
+    case StatusDetailsProperty:
+        emit statusDetailsChanged(statusDetails());
+        break;
+    case DownloadProgressProperty:
+        emit downloadProgressChanged(downloadProgress());
+        break;
+    case DownloadSpeedProperty:
+        emit downloadSpeedChanged(downloadSpeed());
+        break;
+    case DownloadETAProperty:
+        emit downloadETAChanged(downloadETA());
+        break;
+    case HostDownloadSpeedsProperty:
+        emit hostDownloadSpeedsChanged(hostDownloadSpeeds());
+        break;
     default:
         break;
     }
@@ -24,8 +24,11 @@
 #include <QObject>
 #include <QVariantMap>
 
+#include "config.h"
 #include "downloadprogress.h"
 
+class QDBusMessage;
+class QDBusPendingCall;
 class QDBusPendingCallWatcher;
 class QDBusVariant;
 
@@ -39,6 +42,7 @@ class TransactionErrorHandlingTest;
  */
 namespace QApt {
 
+class BackendPrivate;
 class TransactionPrivate;
 
 /**
@@ -58,6 +62,7 @@ class Q_DECL_EXPORT Transaction : public QObject
 #ifdef __CURRENTLY_UNIT_TESTING__
     friend TransactionErrorHandlingTest;
 #endif
+    friend class BackendPrivate;
     
     Q_ENUMS(TransactionRole)
     Q_ENUMS(TransactionStatus)
@@ -86,6 +91,15 @@ class Q_DECL_EXPORT Transaction : public QObject
     Q_PROPERTY(QString filePath READ filePath WRITE updateFilePath)
     Q_PROPERTY(QString errorDetails READ errorDetails WRITE updateErrorDetails)
     Q_PROPERTY(FrontendCaps frontendCaps READ frontendCaps WRITE updateFrontendCaps)
+    Q_PROPERTY(quint64 markingTime READ markingTime WRITE updateMarkingTime)
+    Q_PROPERTY(int lockHolderPid READ lockHolderPid WRITE updateLockHolderPid)
+    Q_PROPERTY(QString lockHolderName READ lockHolderName WRITE updateLockHolderName)
+    Q_PROPERTY(quint64 lockWaitTime READ lockWaitTime WRITE updateLockWaitTime)
+    Q_PROPERTY(int downloadProgressInterval READ downloadProgressInterval WRITE updateDownloadProgressInterval)
+    Q_PROPERTY(int priority READ priority WRITE updatePriority)
+    Q_PROPERTY(quint64 queueWaitTime READ queueWaitTime WRITE updateQueueWaitTime)
+    Q_PROPERTY(QVariantMap phaseTimes READ phaseTimes WRITE updatePhaseTimes)
+    Q_PROPERTY(QVariantMap hostDownloadSpeeds READ hostDownloadSpeeds WRITE updateHostDownloadSpeeds)
 
 public:
     /**
@@ -116,6 +130,15 @@ public:
      */
     QString transactionId() const;
 
+    /**
+     * Returns whether the transaction has been set up by the worker and its
+     * properties are known. Transactions created by the asynchronous
+     * QApt::Backend functions are not ready until ready() is emitted.
+     *
+     * @since 3.1
+     */
+    bool isReady() const;
+
     /// Returns the user ID of the user that initiated the transaction.
     int userId() const;
 
@@ -268,9 +291,98 @@ public:
      */
     QApt::FrontendCaps frontendCaps() const;
 
+    /**
+     * Returns how long the worker took to mark the packages of a transaction
+     * with a TransactionRole of CommitChangesRole, in milliseconds.
+     *
+     * @since 3.1
+     */
+    quint64 markingTime() const;
+
+    /**
+     * Returns the PID of the process holding a package system lock while
+     * the transaction has a status of WaitingLockStatus, or 0 if unknown.
+     *
+     * @since 3.1
+     */
+    int lockHolderPid() const;
+
+    /**
+     * Returns the name of the process holding a package system lock while
+     * the transaction has a status of WaitingLockStatus, if known.
+     *
+     * @see lockHolderPid()
+     * @since 3.1
+     */
+    QString lockHolderName() const;
+
+    /**
+     * Returns how long the transaction waited for the package system locks,
+     * in milliseconds.
+     *
+     * @since 3.1
+     */
+    quint64 lockWaitTime() const;
+
+    /**
+     * Returns the minimum time between two downloadProgressBatch()
+     * signals, in milliseconds.
+     *
+     * @see setDownloadProgressInterval
+     * @since 3.1
+     */
+    int downloadProgressInterval() const;
+
+    /**
+     * Returns the priority the worker schedules the transaction with.
+     *
+     * @see setPriority
+     * @since 3.1
+     */
+    QApt::TransactionPriority priority() const;
+
+    /**
+     * Returns how long the transaction waited in the worker's queue before
+     * it started running, in milliseconds.
+     *
+     * @since 3.1
+     */
+    quint64 queueWaitTime() const;
+
+    /**
+     * Returns where the transaction spent its time so far, in milliseconds
+     * per phase. The keys are "queue", "lock", "cacheOpen", "marking",
+     * "fetch", "dpkg" and "reopen" for opening the cache again after making
+     * changes. Phases the transaction didn't go through are left out.
+     *
+     * Fetching may overlap with dpkg in pipelined commits.
+     *
+     * @since 3.1
+     */
+    QVariantMap phaseTimes() const;
+
+    /**
+     * Returns the current download rate from each host the transaction is
+     * fetching from, in bytes per second as quint64, keyed by host name.
+     *
+     * @see hostDownloadSpeedsChanged
+     * @since 3.1
+     */
+    QVariantMap hostDownloadSpeeds() const;
+
 private:
     TransactionPrivate *const d;
 
+    // Sets up a transaction once the worker replies to @p call with its id
+    explicit Transaction(const QDBusPendingCall &call);
+
+    void connectToWorker();
+    void connectSignals(QObject *interface);
+    QDBusMessage syncMessage() const;
+    void applyProperties(const QVariantMap &propertyMap);
+    void setWorkerProperty(int property, const QDBusVariant &value);
+    void finishWithError(QApt::ErrorCode error);
+
     void updateTransactionId(const QString &tid);
     void updateUserId(int id);
     void updateRole(QApt::TransactionRole role);
@@ -293,8 +405,33 @@ private:
     void updateFilePath(const QString &filePath);
     void updateErrorDetails(const QString &errorDetails);
     void updateFrontendCaps(QApt::FrontendCaps frontendCaps);
+    void updateMarkingTime(quint64 markingTime);
+    void updateLockHolderPid(int pid);
+    void updateLockHolderName(const QString &name);
+    void updateLockWaitTime(quint64 lockWaitTime);
+    void updateDownloadProgressInterval(int msecs);
+    void updatePriority(int priority);
+    void updateQueueWaitTime(quint64 queueWaitTime);
+    void updatePhaseTimes(const QVariantMap &phaseTimes);
+    void updateHostDownloadSpeeds(const QVariantMap &speeds);
+
+    void applyProperty(int type, const QDBusVariant &variant);
+    void notifyProperty(int type);
 
 Q_SIGNALS:
+    /**
+     * This signal is emitted when a transaction created asynchronously has
+     * received its transaction ID and initial properties from the worker.
+     *
+     * Properties set and run() or cancel() calls made before this are sent
+     * to the worker right before the signal is emitted. If the worker cannot
+     * create the transaction, finished() is emitted instead.
+     *
+     * @see isReady
+     * @since 3.1
+     */
+    void ready();
+
     /**
      * This signal is emitted when the transaction encounters a fatal error
      * that prevents the transaction from successfully finishing.
@@ -355,6 +492,17 @@ Q_SIGNALS:
      */
     void downloadProgressChanged(QApt::DownloadProgress progress);
 
+    /**
+     * This signal is emitted with the progress of all downloads that changed
+     * since the previous batch, at most once per downloadProgressInterval().
+     * downloadProgressChanged() is still emitted for each of the items.
+     *
+     * @param progress The latest download progress info of the changed items
+     *
+     * @since 3.1
+     */
+    void downloadProgressBatch(const QList<QApt::DownloadProgress> &progress);
+
     /**
      * This signal is emitted when the transaction reaches the Finished state.
      *
@@ -437,6 +585,17 @@ Q_SIGNALS:
      */
     void downloadETAChanged(quint64 ETA);
 
+    /**
+     * This signal is emitted about once a second while downloading, with
+     * the download rate from each host.
+     *
+     * @param speeds Bytes per second as quint64, keyed by host name
+     *
+     * @see hostDownloadSpeeds
+     * @since 3.1
+     */
+    void hostDownloadSpeedsChanged(const QVariantMap &speeds);
+
 public Q_SLOTS:
     /**
      * Sets the locale code to be used by the transaction for translation and
@@ -481,6 +640,43 @@ public Q_SLOTS:
      */
     void setFrontendCaps(QApt::FrontendCaps frontendCaps);
 
+    /**
+     * Sets how often the worker may report download progress, in
+     * milliseconds. Progress of items that changed in between is collected
+     * into a single downloadProgressBatch() signal. Defaults to 250ms.
+     *
+     * @param msecs The minimum time between two progress reports
+     *
+     * @since 3.1
+     */
+    void setDownloadProgressInterval(int msecs);
+
+    /**
+     * Sets the priority the worker schedules the transaction with. Running
+     * cache updates and archive downloads with a priority of
+     * QApt::BackgroundPriority are preempted by more important transactions,
+     * and finish with QApt::ExitPreempted.
+     *
+     * This property can only be changed before the transaction is run.
+     *
+     * @param priority The priority of the transaction
+     *
+     * @since 3.1
+     */
+    void setPriority(QApt::TransactionPriority priority);
+
+    /**
+     * Sets how the worker fetches the files of the transaction. Transactions
+     * created by Backend start with Config::fetchPolicy().
+     *
+     * This property can only be changed before the transaction is run.
+     *
+     * @param policy The fetch policy of the transaction
+     *
+     * @since 3.1
+     */
+    void setFetchPolicy(const QApt::FetchPolicy &policy);
+
     /**
      * Queues the transaction to be processed by the QApt Worker.
      */
@@ -527,8 +723,13 @@ public Q_SLOTS:
 
 private Q_SLOTS:
     void sync();
-    void updateProperty(int type, const QDBusVariant &variant);
+    void updateProperties(const QMap<int, QDBusVariant> &changes);
+    void updateDownloadProgressBatch(const QList<QApt::DownloadProgress> &progress);
     void onCallFinished(QDBusPendingCallWatcher *watcher);
+    void onTransactionCreated(QDBusPendingCallWatcher *watcher);
+    void onSyncFinished(QDBusPendingCallWatcher *watcher);
+    void onProgressChannelOpened(QDBusPendingCallWatcher *watcher);
+    void onProgressChannelAuthenticated(QDBusPendingCallWatcher *watcher);
     void serviceOwnerChanged(QString name, QString oldOwner, QString newOwner);
     void emitFinished(int exitStatus);
 };
@@ -0,0 +1,126 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef QAPT_UPDATEPHASE_H
+#define QAPT_UPDATEPHASE_H
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QString>
+#include <QtEndian>
+
+#include <random>
+
+namespace QApt {
+
+/**
+ * Decides whether updates that are being phased in apply to this machine.
+ * This is a more or less exact reimplementation of the update phasing
+ * algorithm Ubuntu uses.
+ *
+ * One instance can be used to evaluate any number of packages, sharing
+ * the machine ID and the hashing state between them.
+ */
+class UpdatePhase
+{
+public:
+    UpdatePhase()
+        : m_machineId(machineId())
+        , m_hash(QCryptographicHash::Md5)
+    {
+    }
+
+    /**
+     * Whether the machine can be told apart from others. Without this we
+     * have no way to build a unique hash, and isInPhase() must not be used.
+     */
+    bool isMachineKnown() const
+    {
+        return !m_machineId.isEmpty();
+    }
+
+    /**
+     * Returns whether the machine falls into the update phase of the given
+     * version of a source package.
+     *
+     * Deciding whether a machine is in the phasing pool or not happens in
+     * two steps.
+     * 1. repeatable random number generation between 0..100
+     * 2. comparison of random number with phasing percentage and marking
+     *    as upgradable if rand is greater than the phasing.
+     *
+     * @param sourcePackage The name of the source package
+     * @param version The version that is being phased in
+     * @param percentage The Phased-Update-Percentage of the version
+     */
+    bool isInPhase(const QString &sourcePackage, const QString &version, int percentage)
+    {
+        // Repeatable discrete random number generation is based on
+        // the MD5 hash of "sourcename-sourceversion-dbusmachineid", this
+        // hash is used as seed for the random number generator to provide
+        // stable randomness based on the stable seed. Combined with the discrete
+        // quasi-randomiziation we get about even distribution of machines across
+        // phases.
+        m_hash.reset();
+        m_hash.addData(sourcePackage.toLatin1());
+        m_hash.addData("-", 1);
+        m_hash.addData(version.toLatin1());
+        m_hash.addData("-", 1);
+        m_hash.addData(m_machineId);
+
+        // MD5 would be 128bits, stdlib random default_engine uses a uint32
+        // seed though, so we take the first 32bit and ignore the rest. This
+        // is not rocket science, worst case the update only arrives once the
+        // phasing tag is removed.
+        const QByteArray digest = m_hash.result();
+        uint seed = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(digest.constData()));
+
+        std::default_random_engine generator(seed);
+        std::uniform_int_distribution<int> distribution(0, 100);
+        int rand = distribution(generator);
+
+        // rand is the percentage at which the machine starts to be in the phase.
+        // Once rand is less than the phasing percentage e.g. 40rand vs. 50phase
+        // the machine is supposed to start phasing.
+        return rand <= percentage;
+    }
+
+private:
+    static QByteArray machineId()
+    {
+        static QByteArray machineId;
+        if (machineId.isEmpty()) {
+            QFile file(QStringLiteral("/var/lib/dbus/machine-id"));
+            if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+                machineId = file.readLine().trimmed();
+            }
+        }
+
+        return machineId;
+    }
+
+    QByteArray m_machineId;
+    QCryptographicHash m_hash;
+};
+
+}
+
+#endif
@@ -23,10 +23,22 @@
 #include <apt-pkg/error.h>
 #include <QDebug>
 
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
 AptLock::AptLock(const QString &path)
     : m_path(path.toUtf8())
     , m_fd(-1)
+    , m_watchFd(-1)
+    , m_inotifyFd(-1)
+{
+}
+
+AptLock::~AptLock()
 {
+    closeWatch();
 }
 
 bool AptLock::isLocked() const
@@ -39,6 +51,8 @@ bool AptLock::acquire()
     if (isLocked())
         return true;
 
+    closeWatch();
+
     std::string str = m_path.data();
     m_fd = GetLock(str + "lock");
     m_lock.Fd(m_fd);
@@ -55,3 +69,76 @@ void AptLock::release()
     ::close(m_fd);
     m_fd = -1;
 }
+
+int AptLock::holderPid()
+{
+    if (isLocked() || !openWatch())
+        return 0;
+
+    struct flock fl = {};
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+
+    if (fcntl(m_watchFd, F_GETLK, &fl) == -1)
+        return -1;
+
+    if (fl.l_type == F_UNLCK)
+        return 0;
+
+    // Open file description locks have no owning process
+    return fl.l_pid > 0 ? fl.l_pid : -1;
+}
+
+bool AptLock::waitForRelease(int timeout)
+{
+    // The watch is set up before checking the lock, so a release in
+    // between still wakes up the poll below
+    if (!openWatch() || holderPid() == 0)
+        return true;
+
+    struct pollfd pfd = { m_inotifyFd, POLLIN, 0 };
+    if (poll(&pfd, m_inotifyFd != -1 ? 1 : 0, timeout) > 0) {
+        char buffer[4096];
+        while (read(m_inotifyFd, buffer, sizeof(buffer)) > 0) {}
+    }
+
+    return holderPid() == 0;
+}
+
+bool AptLock::openWatch()
+{
+    if (m_watchFd != -1)
+        return true;
+
+    const QByteArray lockFile = m_path + "lock";
+    m_watchFd = ::open(lockFile.constData(), O_RDONLY | O_CLOEXEC);
+    if (m_watchFd == -1)
+        return false;
+
+    // Lock holders open the lock file for writing, so closing it (or
+    // exiting) triggers IN_CLOSE_WRITE. Our own read-only descriptor doesn't
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd != -1 &&
+        inotify_add_watch(m_inotifyFd, lockFile.constData(),
+                          IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF) == -1) {
+        ::close(m_inotifyFd);
+        m_inotifyFd = -1;
+    }
+
+    return true;
+}
+
+void AptLock::closeWatch()
+{
+    // Closing any descriptor of the lock file drops the fcntl() locks this
+    // process holds on it, so this has to happen before taking the lock
+    if (m_inotifyFd != -1) {
+        ::close(m_inotifyFd);
+        m_inotifyFd = -1;
+    }
+
+    if (m_watchFd != -1) {
+        ::close(m_watchFd);
+        m_watchFd = -1;
+    }
+}
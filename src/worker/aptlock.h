@@ -29,15 +29,28 @@ class AptLock
 {
 public:
     AptLock(const QString &path);
+    ~AptLock();
 
     bool isLocked() const;
     bool acquire();
     void release();
 
+    // Returns the PID of the other process holding the lock, 0 if the lock
+    // is free and -1 if the holder isn't known
+    int holderPid();
+    // Blocks until the holder closes the lock file or @p timeout ms passed.
+    // Returns whether the lock looks free
+    bool waitForRelease(int timeout);
+
 private:
     QByteArray m_path;
     int m_fd;
     FileFd m_lock;
+    int m_watchFd;
+    int m_inotifyFd;
+
+    bool openWatch();
+    void closeWatch();
 };
 
 #endif // APTLOCK_H
@@ -23,10 +23,16 @@
 // Qt includes
 #include <QDateTime>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QFileInfo>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QSet>
 #include <QStringBuilder>
 #include <QStringList>
 #include <QThread>
+#include <QWaitCondition>
 #include <QDebug>
 
 // Apt-pkg includes
@@ -34,25 +40,123 @@
 #include <apt-pkg/algorithms.h>
 #include <apt-pkg/cachefile.h>
 #include <apt-pkg/configuration.h>
+#include <apt-pkg/fileutl.h>
 #include <apt-pkg/init.h>
 #include <apt-pkg/pkgrecords.h>
 #include <apt-pkg/pkgsystem.h>
+#include <apt-pkg/sourcelist.h>
+#include <apt-pkg/strutl.h>
+#include <apt-pkg/update.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
 
 // System includes
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
 #include <sys/statvfs.h>
 #include <sys/statfs.h>
+#include <unistd.h>
 #define RAMFS_MAGIC     0x858458f6
 
 // Own includes
 #include "aptlock.h"
 #include "cache.h"
+#include "config.h"
 #include "debfile.h"
 #include "package.h"
+#include "tracing.h"
 #include "transaction.h"
 #include "workeracquire.h"
 #include "workerinstallprogress.h"
 
+// The APT configuration is global and not thread-safe, and fetchers hand it
+// to their methods as they start. The lanes share it for reading, but a
+// transaction that changes it shuts out the other lane while it runs
+static QReadWriteLock s_configLock;
+
+class ConfigLocker
+{
+public:
+    explicit ConfigLocker(bool write)
+    {
+        if (write)
+            s_configLock.lockForWrite();
+        else
+            s_configLock.lockForRead();
+    }
+
+    ~ConfigLocker()
+    {
+        s_configLock.unlock();
+    }
+};
+
+// Sets APT options while it lives, and restores the earlier values
+// afterwards. Only for transactions that hold the ConfigLocker for writing
+class ScopedConfig
+{
+public:
+    ScopedConfig() {}
+
+    ~ScopedConfig()
+    {
+        for (auto it = m_saved.rbegin(); it != m_saved.rend(); ++it) {
+            if (it->exists)
+                _config->Set(it->key, it->value);
+            else
+                _config->Clear(it->key);
+        }
+    }
+
+    void set(const std::string &key, const std::string &value)
+    {
+        m_saved.push_back({ key, _config->Exists(key), _config->Find(key) });
+        _config->Set(key, value);
+    }
+
+private:
+    struct Saved {
+        std::string key;
+        bool exists;
+        std::string value;
+    };
+    std::vector<Saved> m_saved;
+};
+
+// Sets the APT options for the FetchPolicy of a transaction while it runs.
+// The other lane is shut out meanwhile, see runTransaction()
+class ScopedFetchPolicy : public ScopedConfig
+{
+public:
+    explicit ScopedFetchPolicy(const QVariantMap &map)
+    {
+        if (map.isEmpty())
+            return;
+
+        const QApt::FetchPolicy policy = QApt::FetchPolicy::fromMap(map);
+        set("Acquire::Queue-Mode",
+            policy.queueMode == QApt::FetchPolicy::QueueByAccess ? "access" : "host");
+        if (policy.queueLimit > 0)
+            set("Acquire::QueueHost::Limit", std::to_string(policy.queueLimit));
+        if (policy.retries > 0)
+            set("Acquire::Retries", std::to_string(policy.retries));
+
+        // The http method reads the options of the host before its own
+        for (auto it = policy.hostPipelineDepths.constBegin(); it != policy.hostPipelineDepths.constEnd(); ++it) {
+            const std::string host = it.key().toStdString();
+            const std::string depth = std::to_string(it.value());
+            set("Acquire::http::" + host + "::Pipeline-Depth", depth);
+            set("Acquire::https::" + host + "::Pipeline-Depth", depth);
+        }
+    }
+};
+
 class CacheOpenProgress : public OpProgress
 {
 public:
@@ -108,12 +212,95 @@ private:
     int m_lastProgress;
 };
 
-AptWorker::AptWorker(QObject *parent)
+// Keeps track of the archives fetched for a pipelined commit, which runs the
+// fetcher in a thread of its own. All members are guarded by the mutex
+class PipelineAcquire : public WorkerAcquire
+{
+public:
+    PipelineAcquire(QObject *parent, QMutex *mutex, QWaitCondition *changed)
+        : WorkerAcquire(parent, 15, 50)
+        , finished(false)
+        , aborted(false)
+        , paused(false)
+        , parked(false)
+        , m_mutex(mutex)
+        , m_changed(changed)
+    {
+    }
+
+    void Done(pkgAcquire::ItemDesc &item) {
+        WorkerAcquire::Done(item);
+
+        QMutexLocker locker(m_mutex);
+        done.insert(item.Owner->DestFile);
+        m_changed->wakeAll();
+    }
+
+    void Fail(pkgAcquire::ItemDesc &item) {
+        WorkerAcquire::Fail(item);
+
+        if (item.Owner->Status != pkgAcquire::Item::StatError &&
+            item.Owner->Status != pkgAcquire::Item::StatAuthError)
+            return;
+
+        QMutexLocker locker(m_mutex);
+        failed.insert(item.Owner->DestFile);
+        m_changed->wakeAll();
+    }
+
+    bool Pulse(pkgAcquire *owner) {
+        m_mutex->lock();
+        // Park the fetcher while dpkg is forked, see pause()
+        while (paused && !aborted) {
+            parked = true;
+            m_changed->wakeAll();
+            m_changed->wait(m_mutex);
+        }
+        parked = false;
+        bool stop = aborted;
+        m_mutex->unlock();
+
+        return !stop && WorkerAcquire::Pulse(owner);
+    }
+
+    // Waits for the fetcher thread to be parked in Pulse(), or to be done.
+    // Expects the mutex to be locked
+    void pause() {
+        paused = true;
+        while (!parked && !finished)
+            m_changed->wait(m_mutex);
+    }
+
+    // Expects the mutex to be locked
+    void resume() {
+        paused = false;
+        m_changed->wakeAll();
+    }
+
+    std::set<std::string> done;
+    std::set<std::string> failed;
+    // What the fetcher left on the _error of its thread
+    QStringList errors;
+    bool finished;
+    bool aborted;
+    bool paused;
+    bool parked;
+
+private:
+    QMutex *m_mutex;
+    QWaitCondition *m_changed;
+};
+
+AptWorker::AptWorker(QObject *parent, bool downloadOnly)
     : QObject(parent)
     , m_cache(nullptr)
     , m_records(nullptr)
     , m_trans(nullptr)
     , m_ready(false)
+    , m_downloadOnly(downloadOnly)
+    , m_dpkgProcess(nullptr)
+    , m_dpkgPackages(0)
+    , m_dpkgSteps(0)
     , m_lastActiveTimestamp(QDateTime::currentMSecsSinceEpoch())
 {
 }
@@ -142,15 +329,30 @@ quint64 AptWorker::lastActiveTimestamp()
     return m_lastActiveTimestamp;
 }
 
+void AptWorker::initConfig()
+{
+    // The configuration and system are global, shared by all workers
+    static std::once_flag aptInitialized;
+    std::call_once(aptInitialized, [] {
+        pkgInitConfig(*_config);
+        pkgInitSystem(*_config, _system);
+        QApt::Tracing::init("qaptworker");
+    });
+}
+
 void AptWorker::init()
 {
     if (m_ready)
         return;
 
-    pkgInitConfig(*_config);
-    pkgInitSystem(*_config, _system);
+    initConfig();
     m_cache = new pkgCacheFile;
 
+    if (m_downloadOnly) {
+        m_ready = true;
+        return;
+    }
+
     // Prepare locks to be used later
     QStringList dirs;
 
@@ -168,6 +370,26 @@ void AptWorker::init()
     m_ready = true;
 }
 
+void AptWorker::preloadCache()
+{
+    ConfigLocker configLocker(false);
+
+    if (!m_ready || m_trans || m_records ||
+        !_config->FindB("QApt::Worker::Preload-Cache", true))
+        return;
+
+    // Like openCache(), without a transaction to report to. A cache that
+    // fails to open is left for the first transaction to report
+    const QByteArray stamp = cacheStamp();
+    if (!m_cache->ReadOnlyOpen()) {
+        _error->Discard();
+        return;
+    }
+
+    m_records = new pkgRecords(*(m_cache));
+    m_cacheStamp = stamp;
+}
+
 void AptWorker::runTransaction(Transaction *trans)
 {
     // Check for running transactions or uninitialized worker
@@ -179,8 +401,21 @@ void AptWorker::runTransaction(Transaction *trans)
     m_timestampMutex.unlock();
     m_trans = trans;
     trans->setStatus(QApt::RunningStatus);
-    waitForLocks();
+    // Prefetching only fills the archive cache, and must not keep dpkg from
+    // a commit from somewhere else
+    if (!m_downloadOnly)
+        waitForLocks(trans->role() == QApt::PrefetchUpgradesRole);
+
+    // APT methods only take options from the global configuration, so
+    // transactions that change it, such as with a fetch policy or the rate
+    // limit of prefetchUpgrades(), keep it to themselves while they run
+    ConfigLocker configLocker(trans->role() == QApt::PrefetchUpgradesRole ||
+                              !trans->fetchPolicy().isEmpty());
+
+    QElapsedTimer openTimer;
+    openTimer.start();
     openCache();
+    m_trans->addPhaseTime(QStringLiteral("cacheOpen"), openTimer.elapsed());
 
     // Check for init error
     if (m_trans->error() != QApt::Success) {
@@ -188,6 +423,8 @@ void AptWorker::runTransaction(Transaction *trans)
         return;
     }
 
+    ScopedFetchPolicy fetchPolicy(trans->fetchPolicy());
+
     // Process transactions requiring a cache
     switch (trans->role()) {
     // Transactions that can use a broken cache
@@ -198,17 +435,32 @@ void AptWorker::runTransaction(Transaction *trans)
     case QApt::UpgradeSystemRole:
         upgradeSystem();
         break;
-    case QApt::CommitChangesRole:
-        if (markChanges())
+    case QApt::CommitChangesRole: {
+        QElapsedTimer markingTimer;
+        markingTimer.start();
+
+        bool marked = markChanges();
+        m_trans->setMarkingTime(markingTimer.elapsed());
+
+        if (marked)
             commitChanges();
         break;
-    case QApt::InstallFileRole:
+    }
+    case QApt::InstallFileRole: {
+        QElapsedTimer dpkgTimer;
+        dpkgTimer.start();
+
         installFile();
         m_dpkgProcess->waitForFinished(-1);
+        m_trans->addPhaseTime(QStringLiteral("dpkg"), dpkgTimer.elapsed());
         break;
+    }
     case QApt::DownloadArchivesRole:
         downloadArchives();
         break;
+    case QApt::PrefetchUpgradesRole:
+        prefetchUpgrades();
+        break;
     // Other
     case QApt::EmptyRole:
     default:
@@ -229,15 +481,29 @@ void AptWorker::cleanupCurrentTransaction()
         lock->release();
     }
 
+    QApt::ExitStatus exitStatus = QApt::ExitSuccess;
+    if (m_trans->isPreempted())
+        exitStatus = QApt::ExitPreempted;
+    else if (m_trans->isCancelled())
+        exitStatus = QApt::ExitCancelled;
+    else if (m_trans->error() != QApt::Success)
+        exitStatus = QApt::ExitFailed;
+
+    // Merged transactions end the same way, before the one that ran them so
+    // that the queue moves on only once all of them are done
+    for (Transaction *merged : m_trans->mergedTransactions()) {
+        if (m_trans->error() != QApt::Success) {
+            merged->setError((QApt::ErrorCode)m_trans->error());
+            merged->setErrorDetails(m_trans->errorDetails());
+        }
+        merged->setExitStatus(exitStatus);
+    }
+    m_trans->setMergedTransactions(QList<Transaction *>());
+
     // Set transaction exit status
     // This will notify the transaction queue of the transaction's completion
     // as well as mark the transaction for deletion in 5 seconds
-    if (m_trans->isCancelled())
-        m_trans->setExitStatus(QApt::ExitCancelled);
-    else if (m_trans->error() != QApt::Success)
-        m_trans->setExitStatus(QApt::ExitFailed);
-    else
-        m_trans->setExitStatus(QApt::ExitSuccess);
+    m_trans->setExitStatus(exitStatus);
 
     m_trans = nullptr;
 
@@ -245,31 +511,114 @@ void AptWorker::cleanupCurrentTransaction()
     m_lastActiveTimestamp = QDateTime::currentMSecsSinceEpoch();
 }
 
-void AptWorker::waitForLocks()
+static QString processName(int pid)
 {
-    for (AptLock *lock : m_locks) {
+    if (pid <= 0)
+        return QString();
+
+    QFile comm(QStringLiteral("/proc/%1/comm").arg(pid));
+    if (!comm.open(QIODevice::ReadOnly))
+        return QString();
+
+    return QString::fromLocal8Bit(comm.readAll().trimmed());
+}
+
+void AptWorker::waitForLocks(bool archivesOnly)
+{
+    QElapsedTimer waitTimer;
+    waitTimer.start();
+
+    // The lock on the archive cache comes first, see init()
+    for (AptLock *lock : archivesOnly ? m_locks.mid(0, 1) : m_locks) {
         if (lock->acquire()) {
             qDebug() << "locked?" << lock->isLocked();
             continue;
         }
 
         // Couldn't get lock
+        _error->Discard();
         m_trans->setIsPaused(true);
         m_trans->setStatus(QApt::WaitingLockStatus);
 
+        int holder = 0;
         while (!lock->isLocked() && m_trans->isPaused() && !m_trans->isCancelled()) {
-            // Wait 3 seconds and try again
-            sleep(3);
-            lock->acquire();
+            int pid = lock->holderPid();
+            if (pid != holder) {
+                holder = pid;
+                m_trans->setLockHolder(pid, processName(pid));
+            }
+
+            // Retry as soon as the holder lets go of the lock file, waking
+            // up regularly to notice cancellation
+            if (lock->waitForRelease(500) && !lock->acquire())
+                _error->Discard();
         }
 
+        if (holder)
+            m_trans->setLockHolder(0, QString());
         m_trans->setIsPaused(false);
     }
+
+    m_trans->setLockWaitTime(waitTimer.elapsed());
+}
+
+// Describes the state of the files that go into building the cache
+static QByteArray cacheStamp()
+{
+    const QString statusFile = QString::fromStdString(_config->FindFile("Dir::State::status"));
+
+    QStringList files;
+    files << statusFile
+          << QString::fromStdString(_config->FindFile("Dir::State::extended_states"))
+          << QString::fromStdString(_config->FindFile("Dir::Etc::sourcelist"))
+          << QString::fromStdString(_config->FindFile("Dir::Etc::preferences"));
+
+    QStringList dirs;
+    dirs << QFileInfo(statusFile).absolutePath() + QLatin1String("/updates")
+         << QString::fromStdString(_config->FindDir("Dir::State::lists"))
+         << QString::fromStdString(_config->FindDir("Dir::Etc::sourceparts"))
+         << QString::fromStdString(_config->FindDir("Dir::Etc::preferencesparts"))
+         << QString::fromStdString(_config->FindDir("Dir::Etc::parts"));
+
+    QFileInfoList infos;
+    for (const QString &file : files)
+        infos << QFileInfo(file);
+
+    // Files in the directories may be edited in place
+    for (const QString &dir : dirs) {
+        infos << QFileInfo(dir);
+        infos << QDir(dir).entryInfoList(QDir::Files, QDir::Name);
+    }
+
+    QByteArray stamp;
+    for (const QFileInfo &info : infos) {
+        stamp += info.absoluteFilePath().toUtf8() + ' ';
+        if (info.exists()) {
+            stamp += QByteArray::number(info.lastModified().toMSecsSinceEpoch()) + ' ' +
+                     QByteArray::number(info.size());
+        }
+        stamp += '\n';
+    }
+
+    return stamp;
 }
 
 void AptWorker::openCache(int begin, int end)
 {
     m_trans->setStatus(QApt::LoadingCacheStatus);
+
+    // Taken before opening, so that changes made meanwhile are picked up
+    // by the next transaction
+    const QByteArray stamp = cacheStamp();
+    if (m_records && stamp == m_cacheStamp) {
+        // Drops the markings of the previous transaction
+        if (m_cache->GetDepCache()->Init(nullptr)) {
+            m_trans->setProgress(end);
+            return;
+        }
+    }
+
+    m_cacheStamp.clear();
     CacheOpenProgress *progress = new CacheOpenProgress(m_trans, begin, end);
 
     // Close in case it's already open
@@ -291,6 +640,7 @@ void AptWorker::openCache(int begin, int end)
     delete progress;
     delete m_records;
     m_records = new pkgRecords(*(m_cache));
+    m_cacheStamp = stamp;
 }
 
 void AptWorker::updateCache()
@@ -303,8 +653,18 @@ void AptWorker::updateCache()
     fetcher.Setup(acquire);
 
     // Fetch the lists.
-    if (!ListUpdate(*acquire, *m_cache->GetSourceList())) {
-        if (!m_trans->isCancelled()) {
+    QElapsedTimer fetchTimer;
+    fetchTimer.start();
+
+    bool updated;
+    if (m_trans->sources().isEmpty())
+        updated = ListUpdate(*acquire, *m_cache->GetSourceList());
+    else
+        updated = updateSources(fetcher);
+    m_trans->addPhaseTime(QStringLiteral("fetch"), fetchTimer.elapsed());
+
+    if (!updated) {
+        if (!m_trans->isCancelled() && m_trans->error() == QApt::Success) {
             m_trans->setError(QApt::FetchError);
 
             string message;
@@ -317,31 +677,113 @@ void AptWorker::updateCache()
     // Clean up
     delete acquire;
 
+    QElapsedTimer reopenTimer;
+    reopenTimer.start();
     openCache(91, 95);
+    m_trans->addPhaseTime(QStringLiteral("reopen"), reopenTimer.elapsed());
+}
+
+// Sources are the same if they differ in a trailing slash only
+static std::string sourceKey(std::string uri, const std::string &dist)
+{
+    while (!uri.empty() && uri[uri.size() - 1] == '/')
+        uri.erase(uri.size() - 1);
+
+    return uri + ' ' + dist;
+}
+
+bool AptWorker::updateSources(pkgAcquire &fetcher)
+{
+    pkgSourceList *sourceList = m_cache->GetSourceList();
+
+    // Files select what they list, found by URI and distribution since
+    // parsing them again gives entries of their own
+    std::set<std::string> fileSources;
+    QStringList uris;
+    const QString sourceList = QFileInfo(QString::fromStdString(_config->FindFile("Dir::Etc::sourcelist"))).canonicalFilePath();
+    const QString sourceParts = QDir(QString::fromStdString(_config->FindDir("Dir::Etc::sourceparts"))).canonicalPath();
+    for (const QString &source : m_trans->sources()) {
+        if (!source.startsWith(QLatin1Char('/'))) {
+            uris << source;
+            continue;
+        }
+
+        // We parse as root, so only files that are sources of APT already
+        // are taken, not just any file the client names
+        const QFileInfo info(source);
+        const QString path = info.canonicalFilePath();
+        const bool isSourcesFile = (path == sourceList) ||
+                (!sourceParts.isEmpty() && info.canonicalPath() == sourceParts &&
+                 (path.endsWith(QLatin1String(".list")) || path.endsWith(QLatin1String(".sources"))));
+
+        pkgSourceList fileList;
+        if (path.isEmpty() || !isSourcesFile || !fileList.ReadAppend(path.toStdString())) {
+            _error->Discard();
+            m_trans->setError(QApt::NotFoundError);
+            m_trans->setErrorDetails(source);
+            return false;
+        }
+
+        for (auto it = fileList.begin(); it != fileList.end(); ++it)
+            fileSources.insert(sourceKey((*it)->GetURI(), (*it)->GetDist()));
+    }
+
+    bool found = false;
+    for (auto it = sourceList->begin(); it != sourceList->end(); ++it) {
+        const std::string uri = (*it)->GetURI();
+        bool selected = fileSources.count(sourceKey(uri, (*it)->GetDist()));
+
+        for (int i = 0; !selected && i < uris.size(); ++i)
+            selected = (sourceKey(uri, "") == sourceKey(uris.at(i).toStdString(), ""));
+
+        if (!selected)
+            continue;
+
+        found = true;
+        if (!(*it)->GetIndexes(&fetcher, false))
+            return false;
+    }
+
+    if (!found) {
+        m_trans->setError(QApt::NotFoundError);
+        m_trans->setErrorDetails(m_trans->sources().join(QLatin1Char('\n')));
+        return false;
+    }
+
+    // No list cleanup, the lists of the other sources are still current
+    return AcquireUpdate(fetcher, 0, true, false);
 }
 
 bool AptWorker::markChanges()
 {
     pkgDepCache::ActionGroup *actionGroup = new pkgDepCache::ActionGroup(*m_cache);
-
-    auto mapIter = m_trans->packages().constBegin();
+    // One resolver for the whole transaction, so that it knows about every
+    // package it has to protect or remove when it runs at the end
+    pkgProblemResolver resolver(*m_cache);
+
+    QVariantMap packages = m_trans->packages();
+    for (Transaction *merged : m_trans->mergedTransactions()) {
+        const QVariantMap mergedPackages = merged->packages();
+        for (auto iter = mergedPackages.constBegin(); iter != mergedPackages.constEnd(); ++iter)
+            packages.insert(iter.key(), iter.value());
+    }
+    auto mapIter = packages.constBegin();
 
     QApt::Package::State operation = QApt::Package::ToKeep;
-    while (mapIter != m_trans->packages().constEnd()) {
+    while (mapIter != packages.constEnd()) {
         operation = (QApt::Package::State)mapIter.value().toInt();
 
         // Find package in cache
-        pkgCache::PkgIterator iter;
-        QString packageString = mapIter.key();
-        QString version;
+        const QString &packageString = mapIter.key();
+        const QByteArray entry = packageString.toLatin1();
+        QByteArray version;
 
         // Check if a version is specified
-        if (packageString.contains(QLatin1Char(','))) {
-            QStringList split = packageString.split(QLatin1Char(','));
-            iter = (*m_cache)->FindPkg(split.at(0).toStdString());
-            version = split.at(1);
-        } else {
-            iter = (*m_cache)->FindPkg(packageString.toStdString());
+        int separator = entry.indexOf(',');
+        pkgCache::PkgIterator iter = (*m_cache)->FindPkg(separator == -1 ? entry.toStdString()
+                                                                          : entry.left(separator).toStdString());
+        if (separator != -1) {
+            version = entry.mid(separator + 1);
         }
 
         // Check if the package was found
@@ -354,7 +796,6 @@ bool AptWorker::markChanges()
         }
 
         pkgDepCache::StateCache &State = (*m_cache)[iter];
-        pkgProblemResolver resolver(*m_cache);
         bool toPurge = false;
 
         // Then mark according to the instruction
@@ -385,6 +826,15 @@ bool AptWorker::markChanges()
             pkgVersionMatch Match(version.toStdString(), pkgVersionMatch::Version);
             pkgCache::VerIterator Ver = Match.Find(iter);
 
+            // The cache may have changed since the client marked the package
+            if (Ver.end()) {
+                m_trans->setError(QApt::NotFoundError);
+                m_trans->setErrorDetails(packageString);
+
+                delete actionGroup;
+                return false;
+            }
+
             (*m_cache)->SetCandidateVersion(Ver);
 
             (*m_cache)->MarkInstall(iter, true);
@@ -408,6 +858,9 @@ bool AptWorker::markChanges()
         mapIter++;
     }
 
+    if ((*m_cache)->BrokenCount() > 0)
+        resolver.Resolve(true);
+
     delete actionGroup;
 
     if (_error->PendingError() && ((*m_cache)->BrokenCount() == 0))
@@ -437,8 +890,423 @@ void AptWorker::upgradeSystem()
     commitChanges();
 }
 
+bool AptWorker::commitPipelined()
+{
+    // One package to change, as it has to be marked again once the packages
+    // before it are installed
+    struct Change {
+        std::string name;
+        std::string version;
+        bool reInstall;
+        bool autoInstalled;
+    };
+
+    struct Archive {
+        std::string uri;
+        std::string md5;
+        unsigned long long size;
+        std::string description;
+        std::string shortDescription;
+        std::string path;
+    };
+
+    struct Group {
+        QList<Change> changes;
+        QList<Archive> archives;
+        unsigned long long size;
+    };
+
+    pkgDepCache *cache = m_cache->GetDepCache();
+
+    // Removals are ordered against everything else by the package manager,
+    // so only sets of installs and upgrades are split up
+    QVector<pkgCache::PkgIterator> packages;
+    QHash<unsigned long, int> indexes;
+    for (pkgCache::PkgIterator pkg = cache->PkgBegin(); !pkg.end(); ++pkg) {
+        pkgDepCache::StateCache &state = (*cache)[pkg];
+
+        if (state.Delete())
+            return false;
+
+        if (!state.Install() && !(state.iFlags & pkgDepCache::ReInstall))
+            continue;
+
+        indexes.insert(pkg->ID, packages.size());
+        packages.append(pkg);
+    }
+
+    // Packages end up in the same group as the ones they depend on, conflict
+    // with or break, if those are changed as well
+    QVector<int> roots(packages.size());
+    for (int i = 0; i < roots.size(); ++i)
+        roots[i] = i;
+
+    auto root = [&roots](int i) {
+        while (roots[i] != i)
+            i = roots[i] = roots[roots[i]];
+        return i;
+    };
+
+    for (int i = 0; i < packages.size(); ++i) {
+        pkgCache::VerIterator ver = (*cache)[packages[i]].InstVerIter(*cache);
+
+        for (pkgCache::DepIterator dep = ver.DependsList(); !dep.end(); ++dep) {
+            if (dep->Type != pkgCache::Dep::Depends &&
+                dep->Type != pkgCache::Dep::PreDepends &&
+                dep->Type != pkgCache::Dep::Conflicts &&
+                dep->Type != pkgCache::Dep::DpkgBreaks)
+                continue;
+
+            std::unique_ptr<pkgCache::Version *[]> targets(dep.AllTargets());
+            for (pkgCache::Version **target = targets.get(); *target; ++target) {
+                pkgCache::VerIterator targetVer(cache->GetCache(), *target);
+                auto index = indexes.constFind(targetVer.ParentPkg()->ID);
+
+                if (index != indexes.constEnd())
+                    roots[root(*index)] = root(i);
+            }
+        }
+    }
+
+    QHash<int, int> groupOf;
+    QList<Group> groups;
+    const string archivesDir = _config->FindDir("Dir::Cache::Archives");
+
+    for (int i = 0; i < packages.size(); ++i) {
+        const pkgCache::PkgIterator &pkg = packages[i];
+        pkgDepCache::StateCache &state = (*cache)[pkg];
+        pkgCache::VerIterator ver = state.InstVerIter(*cache);
+
+        // Find where to download the archive from. Anything else, including
+        // archives that aren't trusted, is left to the usual commit
+        pkgIndexFile *index = nullptr;
+        pkgCache::VerFileIterator vf = ver.FileList();
+        for (; !vf.end(); ++vf) {
+            if (m_cache->GetSourceList()->FindIndex(vf.File(), index))
+                break;
+        }
+
+        if (vf.end() || !index->IsTrusted())
+            return false;
+
+        pkgRecords::Parser &rec = m_records->Lookup(vf);
+        if (rec.FileName().empty())
+            return false;
+
+        if (!groupOf.contains(root(i))) {
+            groupOf.insert(root(i), groups.size());
+            groups.append(Group());
+            groups.last().size = 0;
+        }
+
+        Group &group = groups[groupOf.value(root(i))];
+
+        Change change;
+        change.name = pkg.FullName();
+        change.version = ver.VerStr();
+        change.reInstall = !state.Install();
+        change.autoInstalled = state.Flags & pkgCache::Flag::Auto;
+        group.changes.append(change);
+
+        // Named the way pkgAcqArchive names it, so that the package manager
+        // finds it later on
+        Archive archive;
+        archive.uri = index->ArchiveURI(rec.FileName());
+        archive.md5 = rec.MD5Hash();
+        archive.size = ver->Size;
+        archive.description = index->ArchiveInfo(ver);
+        archive.shortDescription = pkg.Name();
+        archive.path = archivesDir + QuoteString(pkg.Name(), "_:") + '_' +
+                       QuoteString(ver.VerStr(), "_:") + '_' +
+                       QuoteString(ver.Arch(), "_:.") + '.' +
+                       flExtension(rec.FileName());
+        group.archives.append(archive);
+
+        if (!QFile::exists(QString::fromStdString(archive.path)))
+            group.size += ver->Size;
+    }
+
+    if (groups.size() < 2)
+        return false;
+
+    // Smaller groups first, to get dpkg going sooner
+    std::stable_sort(groups.begin(), groups.end(), [](const Group &a, const Group &b) {
+        return a.size < b.size;
+    });
+
+    unsigned long long needed = 0;
+    for (const Group &group : groups)
+        needed += group.size;
+
+    struct statvfs Buf;
+    if (statvfs(archivesDir.c_str(), &Buf) != 0 ||
+        unsigned(Buf.f_bfree) < needed / Buf.f_bsize)
+        return false;
+
+    QMutex mutex;
+    QWaitCondition changed;
+    PipelineAcquire *acquire = new PipelineAcquire(this, &mutex, &changed);
+    acquire->setTransaction(m_trans);
+
+    pkgAcquire fetcher;
+    fetcher.Setup(acquire);
+
+    for (const Group &group : groups) {
+        for (const Archive &archive : group.archives) {
+            new pkgAcqFile(&fetcher, archive.uri, archive.md5, archive.size,
+                           archive.description, archive.shortDescription,
+                           "", archive.path);
+        }
+    }
+
+    // Archives that were already complete aren't reported by the fetcher
+    for (auto it = fetcher.ItemsBegin(); it != fetcher.ItemsEnd(); ++it) {
+        if ((*it)->Status == pkgAcquire::Item::StatDone && (*it)->Complete)
+            acquire->done.insert((*it)->DestFile);
+    }
+
+    Transaction *trans = m_trans;
+    std::thread fetchThread([&fetcher, &mutex, &changed, acquire, trans] {
+        QElapsedTimer fetchTimer;
+        fetchTimer.start();
+
+        fetcher.Run();
+        trans->addPhaseTime(QStringLiteral("fetch"), fetchTimer.elapsed());
+
+        // _error is per thread, so hand the messages over
+        QStringList errors;
+        string message;
+        while (_error->PopMessage(message))
+            errors << QString::fromStdString(message);
+
+        QMutexLocker locker(&mutex);
+        acquire->errors = errors;
+        acquire->finished = true;
+        changed.wakeAll();
+    });
+
+    setenv("PATH", "/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin", 1);
+
+    for (int first = 0; first < groups.size(); ++first) {
+        // Start from what's installed now, then mark the group. If doing
+        // so breaks something after all, do the rest in one go
+        QElapsedTimer reopenTimer;
+        reopenTimer.start();
+        openCache(50 + 40 * first / groups.size(), 50 + 40 * first / groups.size());
+        m_trans->addPhaseTime(QStringLiteral("reopen"), reopenTimer.elapsed());
+
+        if (m_trans->error() != QApt::Success)
+            break;
+
+        cache = m_cache->GetDepCache();
+        int last = first;
+
+        for (int i = first; i < groups.size(); last = i++) {
+            if (i > first && cache->BrokenCount() == 0)
+                break;
+
+            pkgDepCache::ActionGroup actionGroup(*cache);
+            for (const Change &change : groups.at(i).changes) {
+                pkgCache::PkgIterator pkg = cache->FindPkg(change.name);
+
+                if (change.reInstall) {
+                    cache->SetReInstall(pkg, true);
+                    continue;
+                }
+
+                for (pkgCache::VerIterator ver = pkg.VersionList(); !ver.end(); ++ver) {
+                    if (change.version == ver.VerStr())
+                        cache->SetCandidateVersion(ver);
+                }
+
+                cache->MarkInstall(pkg, false);
+                cache->MarkAuto(pkg, change.autoInstalled);
+            }
+        }
+
+        if (cache->BrokenCount() > 0) {
+            m_trans->setError(QApt::MarkingError);
+            break;
+        }
+
+        // Wait for the archives of the groups
+        mutex.lock();
+        bool arrived = false;
+        bool failed = false;
+        while (!arrived && !failed && !m_trans->isCancelled()) {
+            arrived = true;
+            for (int i = first; i <= last; ++i) {
+                for (const Archive &archive : groups.at(i).archives) {
+                    arrived &= acquire->done.count(archive.path) > 0;
+                    failed |= acquire->failed.count(archive.path) > 0;
+                }
+            }
+
+            failed |= (!arrived && acquire->finished);
+            if (!arrived && !failed)
+                changed.wait(&mutex, 250);
+        }
+        mutex.unlock();
+
+        if (!arrived) {
+            if (!m_trans->isCancelled())
+                m_trans->setError(QApt::FetchError);
+            break;
+        }
+
+        // From here on the installation is what the transaction is doing
+        if (first == 0) {
+            acquire->setReportsProgress(false);
+            m_trans->setCancellable(false);
+        }
+
+        pkgPackageManager *packageManager = _system->CreatePM(cache);
+        pkgAcquire localFetcher;
+
+        // The archives are all there, so this doesn't fetch anything
+        bool local = packageManager->GetArchives(&localFetcher, m_cache->GetSourceList(), m_records) &&
+                     !_error->PendingError();
+        for (auto it = localFetcher.ItemsBegin(); local && it != localFetcher.ItemsEnd(); ++it)
+            local = ((*it)->Status == pkgAcquire::Item::StatDone && (*it)->Complete);
+
+        if (!local) {
+            m_trans->setError(QApt::FetchError);
+            delete packageManager;
+            break;
+        }
+
+        WorkerInstallProgress installProgress(50 + 40 * first / groups.size(),
+                                              50 + 40 * (last + 1) / groups.size());
+        installProgress.setTransaction(m_trans);
+
+        QElapsedTimer dpkgTimer;
+        dpkgTimer.start();
+
+        // Nothing may run in the fetcher thread while dpkg is being forked.
+        // The methods keep on downloading in their own processes meanwhile
+        mutex.lock();
+        acquire->pause();
+        mutex.unlock();
+
+        pkgPackageManager::OrderResult res = installProgress.start(packageManager);
+        m_trans->addPhaseTime(QStringLiteral("dpkg"), dpkgTimer.elapsed());
+        delete packageManager;
+
+        mutex.lock();
+        acquire->resume();
+        mutex.unlock();
+
+        if (res != pkgPackageManager::Completed) {
+            m_trans->setError(QApt::CommitError);
+            // Error details set by WorkerInstallProgress
+            break;
+        }
+
+        first = last;
+    }
+
+    // Stop fetching what won't be installed anymore
+    mutex.lock();
+    acquire->aborted = true;
+    changed.wakeAll();
+    mutex.unlock();
+
+    fetchThread.join();
+
+    if (m_trans->error() == QApt::FetchError && m_trans->errorDetails().isEmpty())
+        m_trans->setErrorDetails(acquire->errors.join(QLatin1Char('\n')));
+    delete acquire;
+
+    QElapsedTimer reopenTimer;
+    reopenTimer.start();
+    openCache(91, 95);
+    m_trans->addPhaseTime(QStringLiteral("reopen"), reopenTimer.elapsed());
+
+    return true;
+}
+
+bool AptWorker::stageArchives(pkgAcquire &fetcher)
+{
+    QApt::TraceSpan span("worker", "stageArchives");
+    span.setTransactionId(m_trans->transactionId());
+
+    QHash<QString, HashStringList> expected;
+    QStringList archives;
+    for (auto it = fetcher.ItemsBegin(); it != fetcher.ItemsEnd(); ++it) {
+        pkgAcquire::Item *item = *it;
+        if (item->Status != pkgAcquire::Item::StatDone || !item->Complete)
+            continue;
+
+        const QString path = QString::fromStdString(item->DestFile);
+        expected.insert(path, item->GetExpectedHashes());
+        archives << path;
+    }
+
+    if (archives.isEmpty())
+        return true;
+
+    int threads = _config->FindI("QApt::Stage-Archives::Threads", 0);
+    if (threads <= 0)
+        threads = QThread::idealThreadCount();
+    threads = qBound(1, threads, archives.size());
+
+    // Like DebFile::scan(), but decompressing in the threads as well, which
+    // only share the list of bad archives
+    QStringList bad;
+    QMutex badMutex;
+    std::atomic<int> next(0);
+
+    auto work = [&]() {
+        int index;
+        while ((index = next++) < archives.size()) {
+            const QApt::DebFile debFile(archives.at(index));
+            bool good = debFile.isValid();
+
+            // Only the hash types both sides know are compared
+            const QMap<QString, QByteArray> hashes = good ? debFile.hashes() : QMap<QString, QByteArray>();
+            const HashStringList &wanted = expected.value(debFile.filePath());
+            for (auto hash = wanted.begin(); good && hash != wanted.end(); ++hash) {
+                const QByteArray actual = hashes.value(QString::fromStdString(hash->HashType()));
+                if (!actual.isEmpty())
+                    good = (actual == QByteArray::fromStdString(hash->HashValue()));
+            }
+
+            if (good)
+                good = debFile.verifyData();
+
+            if (!good) {
+                QMutexLocker locker(&badMutex);
+                bad << debFile.filePath();
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; ++i)
+        pool.emplace_back(work);
+
+    work();
+
+    for (std::thread &thread : pool)
+        thread.join();
+
+    if (bad.isEmpty())
+        return true;
+
+    for (const QString &path : bad)
+        QFile::remove(path);
+
+    m_trans->setErrorDetails(bad.join(QLatin1Char('\n')));
+    m_trans->setError(QApt::FetchError);
+
+    return false;
+}
+
 void AptWorker::commitChanges()
 {
+    if (_config->FindB("QApt::Pipelined-Commit", false) && commitPipelined())
+        return;
+
     // Initialize fetcher with our progress watcher
     WorkerAcquire *acquire = new WorkerAcquire(this, 15, 50);
     acquire->setTransaction(m_trans);
@@ -501,8 +1369,7 @@ void AptWorker::commitChanges()
             m_trans->setUntrustedPackages(untrustedPackages, allowUntrusted);
 
             // Wait until the user approves, disapproves, or cancels the transaction
-            while (m_trans->isPaused())
-                 usleep(200000);
+            m_trans->waitWhilePaused();
         }
 
         if (!m_trans->allowUntrusted()) {
@@ -514,7 +1381,13 @@ void AptWorker::commitChanges()
     }
 
     // Fetch archives from the network
-    if (fetcher.Run() != pkgAcquire::Continue) {
+    QElapsedTimer fetchTimer;
+    fetchTimer.start();
+
+    pkgAcquire::RunResult fetchResult = fetcher.Run();
+    m_trans->addPhaseTime(QStringLiteral("fetch"), fetchTimer.elapsed());
+
+    if (fetchResult != pkgAcquire::Continue) {
         // Our fetcher will report warnings for itself, but if it fails entirely
         // we have to send the error and finished signals
         if (!m_trans->isCancelled()) {
@@ -547,12 +1420,29 @@ void AptWorker::commitChanges()
         return;
     }
 
+    if (_config->FindB("QApt::Stage-Archives", false)) {
+        QElapsedTimer stageTimer;
+        stageTimer.start();
+
+        bool staged = stageArchives(fetcher);
+        m_trans->addPhaseTime(QStringLiteral("stage"), stageTimer.elapsed());
+
+        if (!staged) {
+            delete packageManager;
+            return;
+        }
+    }
+
     // Set up the install
     WorkerInstallProgress installProgress(50, 90);
     installProgress.setTransaction(m_trans);
     setenv("PATH", "/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin", 1);
 
+    QElapsedTimer dpkgTimer;
+    dpkgTimer.start();
+
     pkgPackageManager::OrderResult res = installProgress.start(packageManager);
+    m_trans->addPhaseTime(QStringLiteral("dpkg"), dpkgTimer.elapsed());
     bool success = (res == pkgPackageManager::Completed);
 
     // See how the installation went
@@ -561,7 +1451,38 @@ void AptWorker::commitChanges()
         // Error details set by WorkerInstallProgress
     }
 
+    QElapsedTimer reopenTimer;
+    reopenTimer.start();
     openCache(91, 95);
+    m_trans->addPhaseTime(QStringLiteral("reopen"), reopenTimer.elapsed());
+}
+
+// Puts the archive at @p from at @p to as a hard link, a reflink or, if
+// neither works, a copy
+static bool reuseArchive(const std::string &from, const std::string &to)
+{
+    if (link(from.c_str(), to.c_str()) == 0)
+        return true;
+
+#ifdef FICLONE
+    int in = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in >= 0) {
+        int out = open(to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        bool cloned = false;
+        if (out >= 0) {
+            cloned = (ioctl(out, FICLONE, in) == 0);
+            close(out);
+            if (!cloned)
+                unlink(to.c_str());
+        }
+        close(in);
+
+        if (cloned)
+            return true;
+    }
+#endif
+
+    return QFile::copy(QString::fromStdString(from), QString::fromStdString(to));
 }
 
 void AptWorker::downloadArchives()
@@ -575,6 +1496,14 @@ void AptWorker::downloadArchives()
 
     pkgIndexFile *index;
 
+    // Where archives may be already, checked by hash before they're reused
+    std::vector<std::string> pools;
+    pools.push_back(_config->FindDir("Dir::Cache::Archives"));
+    for (const std::string &pool : _config->FindVector("QApt::Download-Archives::Pools"))
+        pools.push_back(flCombine(pool, ""));
+
+    const std::string destination = flCombine(m_trans->filePath().toStdString(), "");
+
     for (const QString &packageString : m_trans->packages().keys()) {
         pkgCache::PkgIterator iter = (*m_cache)->FindPkg(packageString.toStdString());
 
@@ -595,7 +1524,7 @@ void AptWorker::downloadArchives()
             continue;
 
         string fileName = rec.FileName();
-        string MD5sum = rec.MD5Hash();
+        const HashStringList hashes = rec.Hashes();
 
         if (fileName.empty()) {
             m_trans->setError(QApt::NotFoundError);
@@ -604,16 +1533,59 @@ void AptWorker::downloadArchives()
             return;
         }
 
+        // Complete archives are skipped and partial ones resumed by
+        // pkgAcqFile. Those it would fetch anew may be in a pool already,
+        // under either name
+        const std::string target = destination + flNotDir(fileName);
+        struct stat targetInfo;
+        bool present = (stat(target.c_str(), &targetInfo) == 0);
+        if (present && (unsigned long long)targetInfo.st_size >= ver->Size) {
+            if ((unsigned long long)targetInfo.st_size == ver->Size && hashes.VerifyFile(target))
+                continue;
+
+            // Not a partial download of this version, nothing to resume
+            unlink(target.c_str());
+            present = false;
+        }
+
+        if (!present) {
+            const std::string archiveName = QuoteString(iter.Name(), "_:") + '_' +
+                                            QuoteString(ver.VerStr(), "_:") + '_' +
+                                            QuoteString(ver.Arch(), "_:.") + '.' +
+                                            flExtension(fileName);
+            bool reused = false;
+            for (const std::string &pool : pools) {
+                for (const std::string &name : { archiveName, flNotDir(fileName) }) {
+                    const std::string candidate = pool + name;
+                    struct stat info;
+                    if (reused || candidate == target || stat(candidate.c_str(), &info) != 0 ||
+                        (unsigned long long)info.st_size != ver->Size || !hashes.VerifyFile(candidate))
+                        continue;
+
+                    reused = reuseArchive(candidate, target);
+                }
+            }
+
+            if (reused)
+                continue;
+        }
+
         new pkgAcqFile(&fetcher,
                        index->ArchiveURI(fileName),
-                       MD5sum,
+                       hashes,
                        ver->Size,
                        index->ArchiveInfo(ver),
                        ver.ParentPkg().Name(),
                        m_trans->filePath().toStdString(), "");
     }
 
-    if (fetcher.Run() != pkgAcquire::Continue) {
+    QElapsedTimer fetchTimer;
+    fetchTimer.start();
+
+    pkgAcquire::RunResult fetchResult = fetcher.Run();
+    m_trans->addPhaseTime(QStringLiteral("fetch"), fetchTimer.elapsed());
+
+    if (fetchResult != pkgAcquire::Continue) {
         // Our fetcher will report warnings for itself, but if it fails entirely
         // we have to send the error and finished signals
         if (!m_trans->isCancelled()) {
@@ -625,6 +1597,70 @@ void AptWorker::downloadArchives()
     return;
 }
 
+void AptWorker::prefetchUpgrades()
+{
+    // The marks only decide what to fetch. They're dropped the next time the
+    // cache is opened
+    pkgDistUpgrade(*m_cache);
+
+    WorkerAcquire *acquire = new WorkerAcquire(this, 15, 100);
+    acquire->setTransaction(m_trans);
+
+    pkgAcquire fetcher;
+    fetcher.Setup(acquire);
+
+    pkgPackageManager *packageManager = _system->CreatePM(*m_cache);
+
+    if (!packageManager->GetArchives(&fetcher, m_cache->GetSourceList(), m_records) ||
+        _error->PendingError()) {
+        m_trans->setError(QApt::FetchError);
+        delete packageManager;
+        delete acquire;
+        return;
+    }
+
+    // This is optional, so rather than asking anybody, leave untrusted
+    // archives and tight disk space for the upgrade itself to deal with
+    for (auto it = fetcher.ItemsBegin(); it < fetcher.ItemsEnd(); ++it) {
+        if (!(*it)->IsTrusted()) {
+            delete packageManager;
+            delete acquire;
+            return;
+        }
+    }
+
+    struct statvfs Buf;
+    string OutputDir = _config->FindDir("Dir::Cache::Archives");
+    double needed = fetcher.FetchNeeded() - fetcher.PartialPresent();
+    if (statvfs(OutputDir.c_str(), &Buf) != 0 ||
+        unsigned(Buf.f_bavail) < needed / Buf.f_bsize) {
+        delete packageManager;
+        delete acquire;
+        return;
+    }
+
+    // Leave most of the bandwidth to whatever the user is doing, in KiB/s.
+    // runTransaction() shut out the download lane for this
+    ScopedConfig rateLimit;
+    const string limit = _config->Find("QApt::Prefetch-Dl-Limit", "256");
+    if (limit != "0") {
+        rateLimit.set("Acquire::http::Dl-Limit", limit);
+        rateLimit.set("Acquire::https::Dl-Limit", limit);
+    }
+
+    QElapsedTimer fetchTimer;
+    fetchTimer.start();
+
+    pkgAcquire::RunResult fetchResult = fetcher.Run();
+    m_trans->addPhaseTime(QStringLiteral("fetch"), fetchTimer.elapsed());
+
+    if (fetchResult != pkgAcquire::Continue && !m_trans->isCancelled())
+        m_trans->setError(QApt::FetchError);
+
+    delete packageManager;
+    delete acquire;
+}
+
 void AptWorker::installFile()
 {
     m_trans->setStatus(QApt::RunningStatus);
@@ -636,10 +1672,6 @@ void AptWorker::installFile()
     WorkerInstallProgress installProgress(50, 90);
     installProgress.setTransaction(m_trans);
 
-    QApt::DebFile deb(m_trans->filePath());
-
-    QString debArch = deb.architecture();
-
     QStringList archList;
     archList.append(QLatin1String("all"));
     std::vector<std::string> archs = APT::Configuration::getArchitectures(false);
@@ -647,19 +1679,76 @@ void AptWorker::installFile()
     for (std::string &arch : archs)
          archList.append(QString::fromStdString(arch));
 
-    if (!archList.contains(debArch)) {
-        m_trans->setError(QApt::WrongArchError);
-        m_trans->setErrorDetails(debArch);
-        return;
+    // Files that (pre-)depend on others of the set go after them, so that
+    // dpkg unpacks and configures in an order that works. Dependencies on
+    // packages outside of the set are not resolved here, dpkg checks them.
+    const QStringList filePaths = m_trans->filePaths();
+    QHash<QString, int> indexes;
+    QVector<QSet<int> > dependencies(filePaths.size());
+
+    for (int i = 0; i < filePaths.size(); ++i) {
+        QApt::DebFile deb(filePaths.at(i));
+
+        QString debArch = deb.architecture();
+        if (!archList.contains(debArch)) {
+            m_trans->setError(QApt::WrongArchError);
+            m_trans->setErrorDetails(debArch);
+            return;
+        }
+
+        indexes.insert(deb.packageName(), i);
     }
 
+    for (int i = 0; i < filePaths.size(); ++i) {
+        QApt::DebFile deb(filePaths.at(i));
+
+        for (const QApt::DependencyItem &item : deb.preDepends() + deb.depends()) {
+            for (const QApt::DependencyInfo &info : item) {
+                int index = indexes.value(info.packageName(), -1);
+                if (index != -1 && index != i)
+                    dependencies[i].insert(index);
+            }
+        }
+    }
+
+    QStringList ordered;
+    QVector<bool> placed(filePaths.size(), false);
+    while (ordered.size() < filePaths.size()) {
+        int next = -1;
+        for (int i = 0; next == -1 && i < filePaths.size(); ++i) {
+            if (placed[i])
+                continue;
+
+            bool ready = true;
+            for (int dependency : dependencies[i])
+                ready &= placed[dependency];
+
+            if (ready)
+                next = i;
+        }
+
+        // Dependency loops are left to dpkg, in the order given
+        for (int i = 0; next == -1; ++i) {
+            if (!placed[i])
+                next = i;
+        }
+
+        placed[next] = true;
+        ordered << filePaths.at(next);
+    }
+
+    m_dpkgPackages = ordered.size();
+    m_dpkgSteps = 0;
+
+    QStringList arguments;
+    arguments << QLatin1String("--status-fd") << QLatin1String("1")
+              << QLatin1String("-i") << ordered;
+
     m_dpkgProcess = new QProcess(this);
-    QString program = QLatin1String("dpkg") %
-            QLatin1String(" -i ") % '"' % m_trans->filePath() % '"';
     setenv("PATH", "/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin", 1);
     setenv("DEBIAN_FRONTEND", "passthrough", 1);
     setenv("DEBCONF_PIPE", "/tmp/qapt-sock", 1);
-    m_dpkgProcess->start(program);
+    m_dpkgProcess->start(QLatin1String("dpkg"), arguments);
     connect(m_dpkgProcess, SIGNAL(started()), this, SLOT(dpkgStarted()));
     connect(m_dpkgProcess, SIGNAL(readyRead()), this, SLOT(updateDpkgProgress()));
     connect(m_dpkgProcess, SIGNAL(finished(int,QProcess::ExitStatus)),
@@ -673,9 +1762,27 @@ void AptWorker::dpkgStarted()
 
 void AptWorker::updateDpkgProgress()
 {
-    QString str = m_dpkgProcess->readLine();
+    while (m_dpkgProcess->canReadLine()) {
+        QString str = m_dpkgProcess->readLine();
+
+        // Each package is unpacked, then set up. Everything else is output
+        // to pass on
+        if (!str.startsWith(QLatin1String("status: "))) {
+            m_trans->setStatusDetails(str);
+            continue;
+        }
 
-    m_trans->setStatusDetails(str);
+        str = str.trimmed();
+        if (!str.endsWith(QLatin1String(": unpacked")) &&
+            !str.endsWith(QLatin1String(": installed")))
+            continue;
+
+        if (m_dpkgPackages == 0)
+            continue;
+
+        m_dpkgSteps = qMin(m_dpkgSteps + 1, 2 * m_dpkgPackages);
+        m_trans->setProgress(50 + 40 * m_dpkgSteps / (2 * m_dpkgPackages));
+    }
 }
 
 void AptWorker::dpkgFinished(int exitCode, QProcess::ExitStatus exitStatus)
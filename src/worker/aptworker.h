@@ -27,6 +27,7 @@
 
 class QProcess;
 
+class pkgAcquire;
 class pkgCacheFile;
 class pkgRecords;
 
@@ -37,29 +38,47 @@ class AptWorker : public QObject
 {
     Q_OBJECT
 public:
-    explicit AptWorker(QObject *parent = 0);
+    /**
+     * A @p downloadOnly worker takes no locks on the package system and is
+     * only handed download transactions that don't need them.
+     */
+    explicit AptWorker(QObject *parent = 0, bool downloadOnly = false);
     ~AptWorker();
 
+    /**
+     * Reads the APT configuration and sets up the package system, once for
+     * all workers. Called before the workers start, so that the
+     * configuration can be read on the main thread without racing them.
+     */
+    static void initConfig();
+
     Transaction *currentTransaction();
     quint64 lastActiveTimestamp();
 
 private:
     pkgCacheFile *m_cache;
     pkgRecords *m_records;
+    // What the open cache was built from, see openCache()
+    QByteArray m_cacheStamp;
     QMutex m_transMutex;
     Transaction *m_trans;
     bool m_ready;
+    bool m_downloadOnly;
     QVector<AptLock *> m_locks;
     QMutex m_timestampMutex;
     quint64 m_lastActiveTimestamp;
     QProcess *m_dpkgProcess;
+    // Packages dpkg is installing, and how many of them it unpacked or
+    // set up so far
+    int m_dpkgPackages;
+    int m_dpkgSteps;
 
     /**
      * If the locks on the package system cannot be immediately taken, this
      * function will wait until the package system is unlocked, and proceed
-     * to lock it.
+     * to lock it. With @p archivesOnly, only the archive cache is locked.
      */
-    void waitForLocks();
+    void waitForLocks(bool archivesOnly = false);
 
     /**
      * Releases APT locks and sets the transaction as done.
@@ -67,7 +86,9 @@ private:
     void cleanupCurrentTransaction();
 
     /**
-     * Builds the package cache and package records.
+     * Builds the package cache and package records. If none of the files
+     * the open cache was built from changed, it is reused with its
+     * markings reset instead.
      */
     void openCache(int begin = 0, int end = 5);
 
@@ -76,6 +97,14 @@ private:
      */
     void updateCache();
 
+    /**
+     * Queues the lists of the sources selected by the transaction on
+     * @p fetcher and fetches them, leaving the other lists untouched.
+     *
+     * @return @c false on failure
+     */
+    bool updateSources(pkgAcquire &fetcher);
+
     /**
      * Marks changes as definied by the current transaction
      */
@@ -86,13 +115,35 @@ private:
      */
     void commitChanges();
 
+    /**
+     * Commits the marked changes as groups of packages that don't depend on
+     * each other, installing each group as soon as its archives are in while
+     * the rest are still downloading. Enabled by QApt::Pipelined-Commit.
+     *
+     * @return false, with nothing done, if the changes can't be split up or
+     * need the user's attention. commitChanges() handles them instead.
+     */
+    bool commitPipelined();
+
+    /**
+     * Checks the fetched archives of @p fetcher in parallel before dpkg gets
+     * them: their hashes against the package records, since archives that
+     * were already in the cache are only checked by size, and that their
+     * data decompresses. Bad archives are removed so they are fetched again.
+     * Enabled by QApt::Stage-Archives.
+     *
+     * @return false, with the error set, if any archive is bad
+     */
+    bool stageArchives(pkgAcquire &fetcher);
+
     /**
      * Upgrades packages
      */
     void upgradeSystem();
 
     /**
-     * Installs a Debian package file by calling dpkg
+     * Installs the Debian package files of the transaction by calling dpkg
+     * once for all of them, ordered by their dependencies on each other
      */
     void installFile();
 
@@ -100,6 +151,12 @@ private:
      * Special function to download archives for DownloadArchivesRole transactions.
      */
     void downloadArchives();
+
+    /**
+     * Downloads the archives a full upgrade would need into the archive
+     * cache, at a limited rate, for PrefetchUpgradesRole transactions.
+     */
+    void prefetchUpgrades();
     
 public slots:
     /**
@@ -108,6 +165,12 @@ public slots:
      */
     void init();
 
+    /**
+     * Opens the package cache ahead of the first transaction, unless
+     * QApt::Worker::Preload-Cache is false in the APT configuration.
+     */
+    void preloadCache();
+
     /**
      * This function will run the provided transaction in a blocking fashion
      * until the transaction is complete. As such, it is suggested that this
@@ -18,7 +18,7 @@
     <property name="isPaused" type="b" access="read"/>
     <property name="statusDetails" type="s" access="read"/>
     <property name="progress" type="i" access="read"/>
-    <property name="downloadProgress" type="(sistts)" access="read">
+    <property name="downloadProgress" type="(uitbssts)" access="read">
       <annotation name="org.qtproject.QtDBus.QtTypeName" value="QApt::DownloadProgress"/>
     </property>
     <property name="untrustedPackages" type="as" access="read"/>
@@ -27,9 +27,25 @@
     <property name="filePath" type="s" access="read"/>
     <property name="errorDetails" type="s" access="read"/>
     <property name="frontendCaps" type="i" access="read"/>
-    <signal name="propertyChanged">
-      <arg name="role" type="i" direction="out"/>
-      <arg name="newValue" type="v" direction="out"/>
+    <property name="markingTime" type="t" access="read"/>
+    <property name="lockHolderPid" type="i" access="read"/>
+    <property name="lockHolderName" type="s" access="read"/>
+    <property name="lockWaitTime" type="t" access="read"/>
+    <property name="downloadProgressInterval" type="i" access="read"/>
+    <property name="priority" type="i" access="read"/>
+    <property name="queueWaitTime" type="t" access="read"/>
+    <property name="fetchPolicy" type="a{sv}" access="read">
+      <annotation name="org.qtproject.QtDBus.QtTypeName" value="QVariantMap"/>
+    </property>
+    <property name="hostDownloadSpeeds" type="a{sv}" access="read">
+      <annotation name="org.qtproject.QtDBus.QtTypeName" value="QVariantMap"/>
+    </property>
+    <property name="phaseTimes" type="a{sv}" access="read">
+      <annotation name="org.qtproject.QtDBus.QtTypeName" value="QVariantMap"/>
+    </property>
+    <signal name="propertiesChanged">
+      <arg name="changes" type="a{iv}" direction="out"/>
+      <annotation name="org.qtproject.QtDBus.QtTypeName.Out0" value="QMap&lt;int,QDBusVariant&gt;"/>
     </signal>
     <signal name="finished">
       <arg name="exitStatus" type="i" direction="out"/>
@@ -45,6 +61,10 @@
     <signal name="promptUntrusted">
       <arg name="untrustedPackages" type="as" direction="out"/>
     </signal>
+    <signal name="downloadProgressBatch">
+      <arg name="progress" type="a(uitbssts)" direction="out"/>
+      <annotation name="org.qtproject.QtDBus.QtTypeName.Out0" value="QList&lt;QApt::DownloadProgress&gt;"/>
+    </signal>
     <method name="setProperty">
       <arg name="property" type="i" direction="in"/>
       <arg name="value" type="v" direction="in"/>
@@ -63,6 +83,10 @@
       <arg name="currentPath" type="s" direction="in"/>
       <arg name="replace" type="b" direction="in"/>
     </method>
+    <method name="openProgressChannel">
+      <arg name="channel" type="a{sv}" direction="out"/>
+      <annotation name="org.qtproject.QtDBus.QtTypeName.Out0" value="QVariantMap"/>
+    </method>
     <method name="setFrontendCaps">
         <arg name="caps" type="i" direction="in"/>
     </method>
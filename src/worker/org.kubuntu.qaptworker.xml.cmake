@@ -8,10 +8,18 @@
     <method name="updateCache">
       <arg type="s" direction="out"/>
     </method>
+    <method name="updateSources">
+      <arg type="s" direction="out"/>
+      <arg name="sources" type="as" direction="in"/>
+    </method>
     <method name="installFile">
       <arg type="s" direction="out"/>
       <arg name="file" type="s" direction="in"/>
     </method>
+    <method name="installFiles">
+      <arg type="s" direction="out"/>
+      <arg name="files" type="as" direction="in"/>
+    </method>
     <method name="commitChanges">
       <arg type="s" direction="out"/>
       <arg name="instructionsList" type="a{sv}" direction="in"/>
@@ -31,9 +39,22 @@
       <arg name="contents" type="s" direction="in"/>
       <arg name="path" type="s" direction="in"/>
     </method>
+    <method name="writeFilesToDisk">
+      <arg type="b" direction="out"/>
+      <arg name="files" type="a{sv}" direction="in"/>
+      <arg name="removedFiles" type="as" direction="in"/>
+      <annotation name="org.qtproject.QtDBus.QtTypeName.In0" value="QVariantMap"/>
+    </method>
     <method name="copyArchiveToCache">
       <arg type="b" direction="out"/>
       <arg name="archivePath" type="s" direction="in"/>
     </method>
+    <method name="copyArchivesToCache">
+      <arg type="as" direction="out"/>
+      <arg name="archives" type="a{sv}" direction="in"/>
+      <annotation name="org.qtproject.QtDBus.QtTypeName.In0" value="QVariantMap"/>
+    </method>
+    <method name="keepWarm">
+    </method>
   </interface>
 </node>
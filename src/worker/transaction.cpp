@@ -28,11 +28,14 @@
 
 // Own includes
 #include "qaptauthorization.h"
+#include "tracing.h"
 #include "transactionadaptor.h"
+#include "transactionchannel.h"
 #include "transactionqueue.h"
 #include "worker/urihelper.h"
 
 #define IDLE_TIMEOUT 30000 // 30 seconds
+#define PROPERTY_BATCH_INTERVAL 50 // milliseconds
 
 Transaction::Transaction(TransactionQueue *queue, int userId)
     : Transaction(queue, userId, QApt::EmptyRole, QVariantMap())
@@ -58,6 +61,14 @@ Transaction::Transaction(TransactionQueue *queue, int userId,
     , m_safeUpgrade(true)
     , m_replaceConfFile(false)
     , m_frontendCaps(QApt::NoCaps)
+    , m_markingTime(0)
+    , m_lockHolderPid(0)
+    , m_lockWaitTime(0)
+    , m_downloadProgressInterval(250)
+    , m_priority(QApt::InteractivePriority)
+    , m_queueWaitTime(0)
+    , m_isPreempted(false)
+    , m_channel(nullptr)
     , m_dataMutex(QMutex::Recursive)
 {
     new TransactionAdaptor(this);
@@ -77,12 +88,19 @@ Transaction::Transaction(TransactionQueue *queue, int userId,
     m_roleActionMap[QApt::CommitChangesRole] = dbusActionUri("commitchanges");
     m_roleActionMap[QApt::DownloadArchivesRole] = QString("");
     m_roleActionMap[QApt::InstallFileRole] = dbusActionUri("commitchanges");
+    m_roleActionMap[QApt::PrefetchUpgradesRole] = QString("");
 
     m_queue->addPending(this);
     m_idleTimer = new QTimer(this);
     m_idleTimer->start(IDLE_TIMEOUT);
     connect(m_idleTimer, SIGNAL(timeout()),
             this, SLOT(emitIdleTimeout()));
+
+    m_propertyTimer = new QTimer(this);
+    m_propertyTimer->setSingleShot(true);
+    m_propertyTimer->setInterval(PROPERTY_BATCH_INTERVAL);
+    connect(m_propertyTimer, SIGNAL(timeout()),
+            this, SLOT(flushProperties()));
 }
 
 Transaction::~Transaction()
@@ -119,7 +137,7 @@ void Transaction::setRole(int role)
 
     m_role = (QApt::TransactionRole)role;
 
-    emit propertyChanged(QApt::RoleProperty, QDBusVariant(role));
+    queueProperty(QApt::RoleProperty, QDBusVariant(role));
 }
 
 int Transaction::status()
@@ -133,7 +151,7 @@ void Transaction::setStatus(QApt::TransactionStatus status)
 {
     QMutexLocker lock(&m_dataMutex);
     m_status = status;
-    emit propertyChanged(QApt::StatusProperty, QDBusVariant((int)status));
+    queueProperty(QApt::StatusProperty, QDBusVariant((int)status));
 
     if (m_status != QApt::SetupStatus && m_idleTimer) {
         m_idleTimer->stop(); // We are now queued and are no longer idle
@@ -153,7 +171,7 @@ int Transaction::error()
 void Transaction::setError(QApt::ErrorCode code)
 {
     m_error = code;
-    emit propertyChanged(QApt::ErrorProperty, QDBusVariant((int)code));
+    queueProperty(QApt::ErrorProperty, QDBusVariant((int)code));
 }
 
 QString Transaction::locale()
@@ -173,7 +191,7 @@ void Transaction::setLocale(QString locale)
     }
 
     m_locale = locale;
-    emit propertyChanged(QApt::LocaleProperty, QDBusVariant(locale));
+    queueProperty(QApt::LocaleProperty, QDBusVariant(locale));
 }
 
 QString Transaction::proxy()
@@ -193,7 +211,7 @@ void Transaction::setProxy(QString proxy)
     }
 
     m_proxy = proxy;
-    emit propertyChanged(QApt::ProxyProperty, QDBusVariant(proxy));
+    queueProperty(QApt::ProxyProperty, QDBusVariant(proxy));
 }
 
 QString Transaction::debconfPipe()
@@ -220,7 +238,7 @@ void Transaction::setDebconfPipe(QString pipe)
     }
 
     m_debconfPipe = pipe;
-    emit propertyChanged(QApt::DebconfPipeProperty, QDBusVariant(pipe));
+    queueProperty(QApt::DebconfPipeProperty, QDBusVariant(pipe));
 }
 
 QVariantMap Transaction::packages()
@@ -240,7 +258,7 @@ void Transaction::setPackages(QVariantMap packageList)
     }
 
     m_packages = packageList;
-    emit propertyChanged(QApt::PackagesProperty, QDBusVariant(packageList));
+    queueProperty(QApt::PackagesProperty, QDBusVariant(packageList));
 }
 
 bool Transaction::isCancellable()
@@ -255,14 +273,23 @@ void Transaction::setCancellable(bool cancellable)
     QMutexLocker lock(&m_dataMutex);
 
     m_isCancellable = cancellable;
-    emit propertyChanged(QApt::CancellableProperty, QDBusVariant(cancellable));
+    queueProperty(QApt::CancellableProperty, QDBusVariant(cancellable));
 }
 
 bool Transaction::isCancelled()
 {
     QMutexLocker lock(&m_dataMutex);
 
-    return m_isCancelled;
+    if (m_isCancelled)
+        return true;
+
+    // Merged transactions share a single run, cancelling one cancels all
+    for (Transaction *merged : m_merged) {
+        if (merged->isCancelled())
+            return true;
+    }
+
+    return false;
 }
 
 int Transaction::exitStatus()
@@ -277,8 +304,9 @@ void Transaction::setExitStatus(QApt::ExitStatus exitStatus)
     QMutexLocker lock(&m_dataMutex);
 
     m_exitStatus = exitStatus;
-    emit propertyChanged(QApt::ExitStatusProperty, QDBusVariant(exitStatus));
+    queueProperty(QApt::ExitStatusProperty, QDBusVariant(exitStatus));
     setStatus(QApt::FinishedStatus);
+    flushProperties();
     emit finished(exitStatus);
 }
 
@@ -296,6 +324,7 @@ void Transaction::setMediumRequired(const QString &label, const QString &medium)
     m_medium = medium;
     m_isPaused = true;
 
+    flushProperties();
     emit mediumRequired(label, medium);
 }
 
@@ -306,6 +335,7 @@ void Transaction::setConfFileConflict(const QString &currentPath, const QString
     m_isPaused = true;
     m_currentConfPath = currentPath;
 
+    flushProperties();
     emit configFileConflict(currentPath, newPath);
 }
 
@@ -321,6 +351,32 @@ void Transaction::setIsPaused(bool paused)
     QMutexLocker lock(&m_dataMutex);
 
     m_isPaused = paused;
+
+    if (!paused) {
+        lock.unlock();
+        wakePauseWaiters();
+    }
+}
+
+bool Transaction::waitWhilePaused(unsigned long time)
+{
+    QMutexLocker pauseLock(&m_pauseMutex);
+
+    while (isPaused()) {
+        if (!m_resumed.wait(&m_pauseMutex, time))
+            return !isPaused();
+    }
+
+    return true;
+}
+
+void Transaction::wakePauseWaiters()
+{
+    // Must not be called with m_dataMutex held, waitWhilePaused() takes
+    // the two locks the other way around
+    QMutexLocker pauseLock(&m_pauseMutex);
+
+    m_resumed.wakeAll();
 }
 
 QString Transaction::statusDetails()
@@ -335,7 +391,7 @@ void Transaction::setStatusDetails(const QString &details)
     QMutexLocker lock(&m_dataMutex);
 
     m_statusDetails = details;
-    emit propertyChanged(QApt::StatusDetailsProperty, QDBusVariant(details));
+    queueProperty(QApt::StatusDetailsProperty, QDBusVariant(details));
 }
 
 int Transaction::progress()
@@ -350,7 +406,7 @@ void Transaction::setProgress(int progress)
     QMutexLocker lock(&m_dataMutex);
 
     m_progress = progress;
-    emit propertyChanged(QApt::ProgressProperty, QDBusVariant(progress));
+    queueProperty(QApt::ProgressProperty, QDBusVariant(progress));
 }
 
 QString Transaction::service() const
@@ -370,10 +426,27 @@ void Transaction::setDownloadProgress(const QApt::DownloadProgress &downloadProg
     QMutexLocker lock(&m_dataMutex);
 
     m_downloadProgress = downloadProgress;
-    emit propertyChanged(QApt::DownloadProgressProperty,
+    queueProperty(QApt::DownloadProgressProperty,
                          QDBusVariant(QVariant::fromValue((downloadProgress))));
 }
 
+void Transaction::setDownloadProgressBatch(const QList<QApt::DownloadProgress> &progress)
+{
+    if (progress.isEmpty())
+        return;
+
+    QMutexLocker lock(&m_dataMutex);
+
+    m_downloadProgress = progress.last();
+    // The system bus only carries the batches while nobody watches over
+    // the channel, so they aren't sent twice
+    if (!sendToPeers("downloadProgressBatch", { QVariant::fromValue(progress) }))
+        emit downloadProgressBatch(progress);
+
+    for (Transaction *merged : m_merged)
+        merged->setDownloadProgressBatch(progress);
+}
+
 void Transaction::setService(const QString &service)
 {
     m_service = service;
@@ -391,10 +464,11 @@ void Transaction::setUntrustedPackages(const QStringList &untrusted, bool prompt
     QMutexLocker lock(&m_dataMutex);
 
     m_untrusted = untrusted;
-    emit propertyChanged(QApt::UntrustedPackagesProperty, QDBusVariant(untrusted));
+    queueProperty(QApt::UntrustedPackagesProperty, QDBusVariant(untrusted));
 
     if (promptUser) {
         m_isPaused = true;
+        flushProperties();
         emit promptUntrusted(untrusted);
     }
 }
@@ -416,7 +490,7 @@ void Transaction::setDownloadSpeed(quint64 downloadSpeed)
     QMutexLocker lock(&m_dataMutex);
 
     m_downloadSpeed = downloadSpeed;
-    emit propertyChanged(QApt::DownloadSpeedProperty, QDBusVariant(downloadSpeed));
+    queueProperty(QApt::DownloadSpeedProperty, QDBusVariant(downloadSpeed));
 }
 
 quint64 Transaction::downloadETA()
@@ -431,7 +505,7 @@ void Transaction::setETA(quint64 ETA)
     QMutexLocker lock(&m_dataMutex);
 
     m_ETA = ETA;
-    emit propertyChanged(QApt::DownloadETAProperty, QDBusVariant(ETA));
+    queueProperty(QApt::DownloadETAProperty, QDBusVariant(ETA));
 }
 
 QString Transaction::filePath()
@@ -446,7 +520,23 @@ void Transaction::setFilePath(const QString &filePath)
     QMutexLocker lock(&m_dataMutex);
 
     m_filePath = filePath;
-    emit propertyChanged(QApt::FilePathProperty, QDBusVariant(filePath));
+    m_filePaths = QStringList(filePath);
+    queueProperty(QApt::FilePathProperty, QDBusVariant(filePath));
+}
+
+QStringList Transaction::filePaths()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_filePaths;
+}
+
+void Transaction::setFilePaths(const QStringList &filePaths)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    setFilePath(filePaths.value(0));
+    m_filePaths = filePaths;
 }
 
 QString Transaction::errorDetails()
@@ -461,7 +551,7 @@ void Transaction::setErrorDetails(const QString &errorDetails)
     QMutexLocker lock(&m_dataMutex);
 
     m_errorDetails = errorDetails;
-    emit propertyChanged(QApt::ErrorDetailsProperty, QDBusVariant(errorDetails));
+    queueProperty(QApt::ErrorDetailsProperty, QDBusVariant(errorDetails));
 }
 
 bool Transaction::safeUpgrade() const
@@ -474,6 +564,16 @@ void Transaction::setSafeUpgrade(bool safeUpgrade)
     m_safeUpgrade = safeUpgrade;
 }
 
+QStringList Transaction::sources() const
+{
+    return m_sources;
+}
+
+void Transaction::setSources(const QStringList &sources)
+{
+    m_sources = sources;
+}
+
 bool Transaction::replaceConfFile() const
 {
     return m_replaceConfFile;
@@ -557,6 +657,15 @@ void Transaction::setProperty(int property, QDBusVariant value)
     case QApt::FrontendCapsProperty:
         setFrontendCaps(value.variant().toInt());
         break;
+    case QApt::DownloadProgressIntervalProperty:
+        setDownloadProgressInterval(value.variant().toInt());
+        break;
+    case QApt::PriorityProperty:
+        setPriority(value.variant().toInt());
+        break;
+    case QApt::FetchPolicyProperty:
+        setFetchPolicy(value.variant().toMap());
+        break;
     default:
         sendErrorReply(QDBusError::InvalidArgs);
         break;
@@ -582,7 +691,10 @@ void Transaction::cancel()
 
     m_isCancelled = true;
     m_isPaused = false;
-    emit propertyChanged(QApt::CancelledProperty, QDBusVariant(m_isCancelled));
+    queueProperty(QApt::CancelledProperty, QDBusVariant(m_isCancelled));
+
+    lock.unlock();
+    wakePauseWaiters();
 }
 
 void Transaction::provideMedium(const QString &medium)
@@ -602,6 +714,9 @@ void Transaction::provideMedium(const QString &medium)
 
     // The medium has now been provided, and the installation should be able to continue
     m_isPaused = false;
+
+    lock.unlock();
+    wakePauseWaiters();
 }
 
 void Transaction::replyUntrustedPrompt(bool approved)
@@ -615,6 +730,9 @@ void Transaction::replyUntrustedPrompt(bool approved)
 
     m_allowUntrusted = approved;
     m_isPaused = false;
+
+    lock.unlock();
+    wakePauseWaiters();
 }
 
 void Transaction::resolveConfigFileConflict(const QString &currentPath, bool replaceFile)
@@ -626,6 +744,9 @@ void Transaction::resolveConfigFileConflict(const QString &currentPath, bool rep
 
     m_replaceConfFile = replaceFile;
     m_isPaused = false;
+
+    lock.unlock();
+    wakePauseWaiters();
 }
 
 void Transaction::setFrontendCaps(int frontendCaps)
@@ -635,6 +756,300 @@ void Transaction::setFrontendCaps(int frontendCaps)
     m_frontendCaps = (QApt::FrontendCaps)frontendCaps;
 }
 
+int Transaction::downloadProgressInterval()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_downloadProgressInterval;
+}
+
+void Transaction::setDownloadProgressInterval(int interval)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    m_downloadProgressInterval = qMax(interval, 0);
+}
+
+int Transaction::priority()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_priority;
+}
+
+void Transaction::setPriority(int priority)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    // The queue orders transactions when they get queued
+    if (m_status != QApt::SetupStatus ||
+        priority < QApt::InteractivePriority || priority > QApt::BackgroundPriority) {
+        sendErrorReply(QDBusError::Failed);
+        return;
+    }
+
+    m_priority = (QApt::TransactionPriority)priority;
+    queueProperty(QApt::PriorityProperty, QDBusVariant(priority));
+}
+
+quint64 Transaction::queueWaitTime()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_queueWaitTime;
+}
+
+void Transaction::setQueueWaitTime(quint64 queueWaitTime)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    m_queueWaitTime = queueWaitTime;
+    queueProperty(QApt::QueueWaitTimeProperty, QDBusVariant(queueWaitTime));
+
+    // Merged transactions each waited for themselves
+    m_phaseTimes[QStringLiteral("queue")] = queueWaitTime;
+    queueProperty(QApt::PhaseTimesProperty, QDBusVariant(m_phaseTimes));
+
+    if (QApt::Tracing::isEnabled()) {
+        const qint64 now = QApt::Tracing::now();
+        QApt::Tracing::complete("worker", QStringLiteral("queue"),
+                                now - qint64(queueWaitTime) * 1000, now, m_tid);
+    }
+}
+
+QVariantMap Transaction::fetchPolicy()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_fetchPolicy;
+}
+
+void Transaction::setFetchPolicy(const QVariantMap &policy)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    // The worker applies the policy when the transaction starts running
+    if (m_status != QApt::SetupStatus) {
+        sendErrorReply(QDBusError::Failed);
+        return;
+    }
+
+    m_fetchPolicy = policy;
+    queueProperty(QApt::FetchPolicyProperty, QDBusVariant(policy));
+}
+
+QVariantMap Transaction::hostDownloadSpeeds()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_hostDownloadSpeeds;
+}
+
+void Transaction::setHostDownloadSpeeds(const QVariantMap &speeds)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    m_hostDownloadSpeeds = speeds;
+    queueProperty(QApt::HostDownloadSpeedsProperty, QDBusVariant(speeds));
+}
+
+QVariantMap Transaction::phaseTimes()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_phaseTimes;
+}
+
+void Transaction::addPhaseTime(const QString &phase, quint64 msecs)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    m_phaseTimes[phase] = m_phaseTimes.value(phase).toULongLong() + msecs;
+    queueProperty(QApt::PhaseTimesProperty, QDBusVariant(m_phaseTimes));
+
+    // Phases are timed as they end, so the span ends now
+    if (QApt::Tracing::isEnabled()) {
+        const qint64 now = QApt::Tracing::now();
+        QApt::Tracing::complete("worker", phase, now - qint64(msecs) * 1000, now, m_tid);
+    }
+
+    for (Transaction *merged : m_merged)
+        merged->addPhaseTime(phase, msecs);
+}
+
+bool Transaction::isPreempted()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_isPreempted;
+}
+
+void Transaction::preempt()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    if (!m_isCancellable || m_isCancelled)
+        return;
+
+    m_isPreempted = true;
+    m_isCancelled = true;
+    m_isPaused = false;
+    queueProperty(QApt::CancelledProperty, QDBusVariant(m_isCancelled));
+
+    lock.unlock();
+    wakePauseWaiters();
+}
+
+quint64 Transaction::markingTime()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_markingTime;
+}
+
+void Transaction::setMarkingTime(quint64 markingTime)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    m_markingTime = markingTime;
+    queueProperty(QApt::MarkingTimeProperty, QDBusVariant(markingTime));
+    addPhaseTime(QStringLiteral("marking"), markingTime);
+}
+
+int Transaction::lockHolderPid()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_lockHolderPid;
+}
+
+QString Transaction::lockHolderName()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_lockHolderName;
+}
+
+void Transaction::setLockHolder(int pid, const QString &name)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    m_lockHolderPid = pid;
+    m_lockHolderName = name;
+    queueProperty(QApt::LockHolderPidProperty, QDBusVariant(pid));
+    queueProperty(QApt::LockHolderNameProperty, QDBusVariant(name));
+}
+
+quint64 Transaction::lockWaitTime()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_lockWaitTime;
+}
+
+void Transaction::setLockWaitTime(quint64 lockWaitTime)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    m_lockWaitTime = lockWaitTime;
+    queueProperty(QApt::LockWaitTimeProperty, QDBusVariant(lockWaitTime));
+    addPhaseTime(QStringLiteral("lock"), lockWaitTime);
+}
+
+QList<Transaction *> Transaction::mergedTransactions()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_merged;
+}
+
+void Transaction::setMergedTransactions(const QList<Transaction *> &merged)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    m_merged = merged;
+}
+
+void Transaction::queueProperty(QApt::TransactionProperty property, const QDBusVariant &value)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    bool wasEmpty = m_pendingProperties.isEmpty();
+    m_pendingProperties.insert(property, value);
+
+    // The timer lives in the thread of the transaction, not the worker's
+    if (wasEmpty)
+        QMetaObject::invokeMethod(m_propertyTimer, "start", Qt::QueuedConnection);
+
+    // Everything describing the progress of the run applies to the merged
+    // transactions too. What they were set up with and their exit status
+    // stay their own
+    switch (property) {
+    case QApt::TransactionIdProperty:
+    case QApt::UserIdProperty:
+    case QApt::RoleProperty:
+    case QApt::LocaleProperty:
+    case QApt::ProxyProperty:
+    case QApt::DebconfPipeProperty:
+    case QApt::PackagesProperty:
+    case QApt::CancelledProperty:
+    case QApt::ExitStatusProperty:
+    case QApt::FilePathProperty:
+    case QApt::FrontendCapsProperty:
+    case QApt::DownloadProgressIntervalProperty:
+    case QApt::PhaseTimesProperty:
+    case QApt::FetchPolicyProperty:
+        break;
+    default:
+        for (Transaction *merged : m_merged)
+            merged->queueProperty(property, value);
+        break;
+    }
+}
+
+void Transaction::flushProperties()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    if (m_pendingProperties.isEmpty())
+        return;
+
+    QMap<int, QDBusVariant> changes;
+    changes.swap(m_pendingProperties);
+    lock.unlock();
+
+    emit propertiesChanged(changes);
+}
+
+bool Transaction::sendToPeers(const char *signal, const QVariantList &arguments)
+{
+    return m_channel && m_channel->send(signal, arguments);
+}
+
+QVariantMap Transaction::openProgressChannel()
+{
+    // Anyone may watch a transaction on the system bus, so anyone may watch
+    // it over the channel. Once a peer has authenticated, the download
+    // progress batches only go over the channel. The property changes and
+    // all other signals stay on the system bus
+    if (!m_channel) {
+        m_channel = new TransactionChannel(m_tid, QLatin1String(s_workerReverseDomainName) +
+                                           QLatin1String(".transaction"), this);
+    }
+
+    const QString address = m_channel->address();
+    if (address.isEmpty()) {
+        sendErrorReply(QDBusError::Failed);
+        return QVariantMap();
+    }
+
+    QVariantMap channel;
+    channel[QLatin1String("address")] = address;
+    channel[QLatin1String("token")] = m_channel->issueToken();
+
+    return channel;
+}
+
 void Transaction::emitIdleTimeout()
 {
     emit idleTimeout(this);
@@ -23,15 +23,20 @@
 #define TRANSACTION_H
 
 // Qt includes
+#include <QMap>
 #include <QMutex>
 #include <QObject>
 #include <QDBusContext>
 #include <QDBusVariant>
+#include <QWaitCondition>
+
+#include <climits>
 
 // Own includes
 #include "downloadprogress.h"
 
 class QTimer;
+class TransactionChannel;
 class TransactionQueue;
 
 class Transaction : public QObject, protected QDBusContext
@@ -61,6 +66,16 @@ class Transaction : public QObject, protected QDBusContext
     Q_PROPERTY(QString filePath READ filePath)
     Q_PROPERTY(QString errorDetails READ errorDetails)
     Q_PROPERTY(int frontendCaps READ frontendCaps)
+    Q_PROPERTY(quint64 markingTime READ markingTime)
+    Q_PROPERTY(int lockHolderPid READ lockHolderPid)
+    Q_PROPERTY(QString lockHolderName READ lockHolderName)
+    Q_PROPERTY(quint64 lockWaitTime READ lockWaitTime)
+    Q_PROPERTY(int downloadProgressInterval READ downloadProgressInterval)
+    Q_PROPERTY(int priority READ priority)
+    Q_PROPERTY(quint64 queueWaitTime READ queueWaitTime)
+    Q_PROPERTY(QVariantMap phaseTimes READ phaseTimes)
+    Q_PROPERTY(QVariantMap fetchPolicy READ fetchPolicy)
+    Q_PROPERTY(QVariantMap hostDownloadSpeeds READ hostDownloadSpeeds)
 public:
     Transaction(TransactionQueue *queue, int userId);
     Transaction(TransactionQueue *queue, int userId,
@@ -90,10 +105,31 @@ public:
     quint64 downloadSpeed();
     quint64 downloadETA();
     QString filePath();
+    // All files an InstallFileRole transaction installs, filePath() is the first
+    QStringList filePaths();
     QString errorDetails();
     bool safeUpgrade() const;
+    // The URIs and sources files an UpdateCacheRole transaction refreshes,
+    // everything if empty
+    QStringList sources() const;
     bool replaceConfFile() const;
     int frontendCaps() const;
+    quint64 markingTime();
+    int lockHolderPid();
+    QString lockHolderName();
+    quint64 lockWaitTime();
+    int downloadProgressInterval();
+    int priority();
+    quint64 queueWaitTime();
+    QVariantMap phaseTimes();
+    // See QApt::FetchPolicy::toMap()
+    QVariantMap fetchPolicy();
+    QVariantMap hostDownloadSpeeds();
+    bool isPreempted();
+    // Compatible transactions run together with this one, which report the
+    // progress and outcome of this one. See TransactionQueue::runNextTransaction()
+    QList<Transaction *> mergedTransactions();
+    void setMergedTransactions(const QList<Transaction *> &merged);
 
     void setStatus(QApt::TransactionStatus status);
     void setError(QApt::ErrorCode code);
@@ -101,18 +137,36 @@ public:
     void setExitStatus(QApt::ExitStatus exitStatus);
     void setMediumRequired(const QString &label, const QString &medium);
     void setIsPaused(bool paused);
+    // Blocks until the transaction is no longer paused or @p time ms
+    // passed. Returns whether the transaction was resumed
+    bool waitWhilePaused(unsigned long time = ULONG_MAX);
     void setStatusDetails(const QString &details);
     void setProgress(int progress);
     void setService(const QString &service);
     void setDownloadProgress(const QApt::DownloadProgress &downloadProgress);
+    // Publishes the progress of all items that changed since the last batch
+    void setDownloadProgressBatch(const QList<QApt::DownloadProgress> &progress);
     void setUntrustedPackages(const QStringList &untrusted, bool promptUser);
     void setDownloadSpeed(quint64 downloadSpeed);
     void setETA(quint64 ETA);
     void setFilePath(const QString &filePath);
+    void setFilePaths(const QStringList &filePaths);
     void setErrorDetails(const QString &errorDetails);
     void setSafeUpgrade(bool safeUpgrade);
+    void setSources(const QStringList &sources);
     void setConfFileConflict(const QString &currentPath, const QString &newPath);
     void setFrontendCaps(int frontendCaps);
+    void setDownloadProgressInterval(int interval);
+    void setPriority(int priority);
+    void setMarkingTime(quint64 markingTime);
+    void setLockHolder(int pid, const QString &name);
+    void setLockWaitTime(quint64 lockWaitTime);
+    void setQueueWaitTime(quint64 queueWaitTime);
+    // Adds @p msecs to the time spent in @p phase, see QApt::PhaseTimesProperty
+    void addPhaseTime(const QString &phase, quint64 msecs);
+    void setHostDownloadSpeeds(const QVariantMap &speeds);
+    // Cancels the transaction on behalf of a more important one
+    void preempt();
 
 private:
     // Pointers to external containers
@@ -141,16 +195,36 @@ private:
     quint64 m_downloadSpeed;
     quint64 m_ETA;
     QString m_filePath;
+    QStringList m_filePaths;
     QString m_errorDetails;
     bool m_safeUpgrade;
+    QStringList m_sources;
     QString m_currentConfPath;
     bool m_replaceConfFile;
     QApt::FrontendCaps m_frontendCaps;
+    quint64 m_markingTime;
+    int m_lockHolderPid;
+    QString m_lockHolderName;
+    quint64 m_lockWaitTime;
+    int m_downloadProgressInterval;
+    QList<Transaction *> m_merged;
+    QApt::TransactionPriority m_priority;
+    quint64 m_queueWaitTime;
+    QVariantMap m_phaseTimes;
+    QVariantMap m_fetchPolicy;
+    QVariantMap m_hostDownloadSpeeds;
+    bool m_isPreempted;
 
     // Other data
     QMap<int, QString> m_roleActionMap;
     QTimer *m_idleTimer;
+    QTimer *m_propertyTimer;
+    TransactionChannel *m_channel;
+    QMap<int, QDBusVariant> m_pendingProperties;
     QMutex m_dataMutex;
+    // m_dataMutex is recursive, which QWaitCondition can't work with
+    QMutex m_pauseMutex;
+    QWaitCondition m_resumed;
     QString m_service;
 
     // Private functions
@@ -161,14 +235,23 @@ private:
     void setProxy(QString proxy);
     void setDebconfPipe(QString pipe);
     void setPackages(QVariantMap packageList);
+    void setFetchPolicy(const QVariantMap &policy);
     bool authorizeRun();
+    void wakePauseWaiters();
+    // Property changes are sent in batches of PROPERTY_BATCH_INTERVAL ms
+    void queueProperty(QApt::TransactionProperty property, const QDBusVariant &value);
+    // Sends a signal to the peers of the transaction channel instead of the
+    // system bus, for the ones that are too frequent for the bus daemon.
+    // Returns false if there are none
+    bool sendToPeers(const char *signal, const QVariantList &arguments);
 
 Q_SIGNALS:
-    Q_SCRIPTABLE void propertyChanged(int role, QDBusVariant newValue);
+    Q_SCRIPTABLE void propertiesChanged(QMap<int,QDBusVariant> changes);
     Q_SCRIPTABLE void finished(int exitStatus);
     Q_SCRIPTABLE void mediumRequired(QString label, QString mountPoint);
     Q_SCRIPTABLE void promptUntrusted(QStringList untrustedPackages);
     Q_SCRIPTABLE void configFileConflict(QString currentPath, QString newPath);
+    Q_SCRIPTABLE void downloadProgressBatch(QList<QApt::DownloadProgress> progress);
     void idleTimeout(Transaction *trans);
     
 public Q_SLOTS:
@@ -178,9 +261,13 @@ public Q_SLOTS:
     void provideMedium(const QString &medium);
     void replyUntrustedPrompt(bool approved);
     void resolveConfigFileConflict(const QString &currentPath, bool replaceFile);
+    // The address of the private channel for the download progress of the
+    // transaction and a token for connecting to it, see TransactionChannel
+    QVariantMap openProgressChannel();
 
 private Q_SLOTS:
     void emitIdleTimeout();
+    void flushProperties();
 };
 
 #endif // TRANSACTION_H
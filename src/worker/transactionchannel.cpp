@@ -0,0 +1,160 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "transactionchannel.h"
+
+// Qt includes
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusServer>
+#include <QDebug>
+#include <QStringBuilder>
+#include <QTimer>
+#include <QUuid>
+
+#define AUTHENTICATION_TIMEOUT 5000 // 5 seconds
+
+TransactionChannel::TransactionChannel(const QString &path, const QString &interface,
+                                       QObject *parent)
+    : QDBusVirtualObject(parent)
+    , m_path(path)
+    , m_interface(interface)
+    , m_server(nullptr)
+{
+}
+
+TransactionChannel::~TransactionChannel()
+{
+    QMutexLocker lock(&m_mutex);
+
+    for (const QString &name : m_pending + m_peers)
+        QDBusConnection::disconnectFromPeer(name);
+}
+
+QString TransactionChannel::address()
+{
+    if (!m_server) {
+        // Abstract sockets on Linux. Anyone can connect to those, which is
+        // why peers have to authenticate with a token instead of their uid
+        m_server = new QDBusServer(QLatin1String("unix:tmpdir=/tmp"), this);
+        m_server->setAnonymousAuthenticationAllowed(true);
+        connect(m_server, SIGNAL(newConnection(QDBusConnection)),
+                this, SLOT(newConnection(QDBusConnection)));
+    }
+
+    if (!m_server->isConnected()) {
+        qWarning() << "Unable to open a transaction channel" << m_server->lastError().message();
+        return QString();
+    }
+
+    return m_server->address();
+}
+
+QString TransactionChannel::issueToken()
+{
+    QMutexLocker lock(&m_mutex);
+
+    const QString token = QUuid::createUuid().toString();
+    m_tokens.insert(token);
+
+    return token;
+}
+
+bool TransactionChannel::send(const char *name, const QVariantList &arguments)
+{
+    QMutexLocker lock(&m_mutex);
+
+    QDBusMessage signal = QDBusMessage::createSignal(m_path, m_interface, QLatin1String(name));
+    signal.setArguments(arguments);
+
+    for (auto it = m_peers.begin(); it != m_peers.end();) {
+        QDBusConnection connection(*it);
+        if (!connection.isConnected()) {
+            QDBusConnection::disconnectFromPeer(*it);
+            it = m_peers.erase(it);
+            continue;
+        }
+
+        connection.send(signal);
+        ++it;
+    }
+
+    return !m_peers.isEmpty();
+}
+
+QString TransactionChannel::introspect(const QString &path) const
+{
+    Q_UNUSED(path)
+
+    return QLatin1String("<interface name=\"") % m_interface % QLatin1String("channel\">"
+                         "<method name=\"authenticate\">"
+                         "<arg name=\"token\" type=\"s\" direction=\"in\"/>"
+                         "<arg name=\"authenticated\" type=\"b\" direction=\"out\"/>"
+                         "</method></interface>");
+}
+
+bool TransactionChannel::handleMessage(const QDBusMessage &message, const QDBusConnection &connection)
+{
+    if (message.type() != QDBusMessage::MethodCallMessage ||
+        message.interface() != m_interface + QLatin1String("channel") ||
+        message.member() != QLatin1String("authenticate") ||
+        message.arguments().size() != 1) {
+        return false;
+    }
+
+    QMutexLocker lock(&m_mutex);
+
+    // Tokens are only good for one peer
+    const bool authenticated = m_pending.contains(connection.name()) &&
+                               m_tokens.remove(message.arguments().first().toString());
+    if (authenticated) {
+        m_pending.removeOne(connection.name());
+        m_peers.append(connection.name());
+    }
+
+    connection.send(message.createReply(authenticated));
+
+    return true;
+}
+
+void TransactionChannel::newConnection(const QDBusConnection &connection)
+{
+    QDBusConnection peer(connection);
+    if (!peer.registerVirtualObject(m_path, this)) {
+        QDBusConnection::disconnectFromPeer(peer.name());
+        return;
+    }
+
+    QMutexLocker lock(&m_mutex);
+    m_pending.append(peer.name());
+
+    const QString name = peer.name();
+    QTimer::singleShot(AUTHENTICATION_TIMEOUT, this, [this, name]() {
+        dropUnauthenticated(name);
+    });
+}
+
+void TransactionChannel::dropUnauthenticated(const QString &name)
+{
+    QMutexLocker lock(&m_mutex);
+
+    if (m_pending.removeOne(name))
+        QDBusConnection::disconnectFromPeer(name);
+}
@@ -0,0 +1,77 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef TRANSACTIONCHANNEL_H
+#define TRANSACTIONCHANNEL_H
+
+// Qt includes
+#include <QDBusVirtualObject>
+#include <QMutex>
+#include <QSet>
+#include <QStringList>
+#include <QVariantList>
+
+class QDBusServer;
+
+/**
+ * A private D-Bus server for one transaction, so that its frequent signals
+ * reach the client without a trip through the system bus daemon. While
+ * any peer is authenticated, those signals are not emitted on the system
+ * bus. Everything else still goes out there.
+ *
+ * Clients get an address and a one-time token over the system bus and
+ * present the token with an authenticate() call on the peer connection.
+ * Only then does the connection get the download progress. Peers
+ * that don't authenticate within a few seconds are dropped.
+ */
+class TransactionChannel : public QDBusVirtualObject
+{
+    Q_OBJECT
+public:
+    TransactionChannel(const QString &path, const QString &interface, QObject *parent);
+    ~TransactionChannel();
+
+    // Starts listening if needed, returns the address or an empty string
+    QString address();
+    // A token for one peer to authenticate with
+    QString issueToken();
+
+    // Sends the signal @p name to all authenticated peers. Returns false if
+    // there are none, in which case the caller emits it on the system bus
+    bool send(const char *name, const QVariantList &arguments);
+
+    QString introspect(const QString &path) const override;
+    bool handleMessage(const QDBusMessage &message, const QDBusConnection &connection) override;
+
+private:
+    QString m_path;
+    QString m_interface;
+    QDBusServer *m_server;
+    QMutex m_mutex;
+    QSet<QString> m_tokens;
+    QStringList m_pending;
+    QStringList m_peers;
+
+private Q_SLOTS:
+    void newConnection(const QDBusConnection &connection);
+    void dropUnauthenticated(const QString &name);
+};
+
+#endif
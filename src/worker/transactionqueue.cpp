@@ -22,33 +22,45 @@
 #include "transactionqueue.h"
 
 // Qt includes
+#include <QDir>
+#include <QHash>
 #include <QStringList>
 #include <QTimer>
 
+// Apt-pkg includes
+#include <apt-pkg/configuration.h>
+
 // Own includes
 #include "aptworker.h"
 #include "transaction.h"
 
-TransactionQueue::TransactionQueue(QObject *parent, AptWorker *worker)
+TransactionQueue::TransactionQueue(QObject *parent, AptWorker *worker,
+                                   AptWorker *downloadWorker)
     : QObject(parent)
-    , m_worker(worker)
-    , m_activeTransaction(nullptr)
 {
+    m_mainLane.worker = worker;
+    m_mainLane.active = nullptr;
+    m_downloadLane.worker = downloadWorker;
+    m_downloadLane.active = nullptr;
+
+    // The workers own the configuration once they run
+    m_archivesDir = QDir::cleanPath(QString::fromStdString(_config->FindDir("Dir::Cache::Archives")));
 }
 
 QList<Transaction *> TransactionQueue::transactions() const
 {
-    return m_queue;
+    return m_mainLane.queue + m_downloadLane.queue;
 }
 
 Transaction *TransactionQueue::activeTransaction() const
 {
-    return m_activeTransaction;
+    return m_mainLane.active ? m_mainLane.active : m_downloadLane.active;
 }
 
 bool TransactionQueue::isEmpty() const
 {
-    return (m_queue.isEmpty() && m_pending.isEmpty());
+    return (m_mainLane.queue.isEmpty() && m_downloadLane.queue.isEmpty() &&
+            m_pending.isEmpty());
 }
 
 Transaction *TransactionQueue::pendingTransactionById(const QString &id) const
@@ -69,7 +81,7 @@ Transaction *TransactionQueue::transactionById(const QString &id) const
 {
     Transaction *transaction = nullptr;
 
-    for (Transaction *trans : m_queue) {
+    for (Transaction *trans : transactions()) {
         if (trans->transactionId() == id) {
             transaction = trans;
             break;
@@ -79,6 +91,21 @@ Transaction *TransactionQueue::transactionById(const QString &id) const
     return transaction;
 }
 
+TransactionQueue::Lane &TransactionQueue::laneFor(Transaction *trans)
+{
+    if (!m_downloadLane.worker || trans->role() != QApt::DownloadArchivesRole)
+        return m_mainLane;
+
+    // Downloads to a directory of their own don't need any of the locks the
+    // main lane takes, so they can run alongside it. Downloads into the
+    // archive cache have to wait for commits that fetch into it
+    const QString destination = QDir::cleanPath(trans->filePath());
+    if (destination.isEmpty() || destination == m_archivesDir)
+        return m_mainLane;
+
+    return m_downloadLane;
+}
+
 void TransactionQueue::addPending(Transaction *trans)
 {
     m_pending.append(trans);
@@ -102,12 +129,34 @@ void TransactionQueue::enqueue(QString tid)
 
     connect(trans, SIGNAL(finished(int)), this, SLOT(onTransactionFinished()));
     m_pending.removeAll(trans);
-    m_queue.enqueue(trans);
+    m_queuedSince[trans].start();
+
+    Lane &lane = laneFor(trans);
+
+    // Behind everything at least as important. The active transaction and
+    // the ones merged into it stay in front
+    int first = 0;
+    if (lane.active)
+        first = 1 + lane.active->mergedTransactions().size();
 
-    if (!m_worker->currentTransaction())
-        runNextTransaction();
+    int index = lane.queue.size();
+    while (index > first && lane.queue.at(index - 1)->priority() > trans->priority())
+        --index;
+    lane.queue.insert(index, trans);
+
+    if (!lane.active)
+        runNextTransaction(lane);
     else {
         trans->setStatus(QApt::WaitingStatus);
+
+        // Optional downloads make way for more important work
+        Transaction *active = lane.active;
+        if (active->priority() == QApt::BackgroundPriority &&
+            trans->priority() < QApt::BackgroundPriority &&
+            (active->role() == QApt::UpdateCacheRole ||
+             active->role() == QApt::DownloadArchivesRole ||
+             active->role() == QApt::PrefetchUpgradesRole))
+            active->preempt();
     }
 
     emitQueueChanged();
@@ -120,10 +169,13 @@ void TransactionQueue::remove(QString tid)
     if (!trans)
         return;
 
-    m_queue.removeAll(trans);
+    for (Lane *lane : { &m_mainLane, &m_downloadLane }) {
+        lane->queue.removeAll(trans);
 
-    if (trans == m_activeTransaction)
-        m_activeTransaction = nullptr;
+        if (trans == lane->active)
+            lane->active = nullptr;
+    }
+    m_queuedSince.remove(trans);
 
     emitQueueChanged();
 
@@ -138,20 +190,82 @@ void TransactionQueue::onTransactionFinished()
     if (!trans) // Don't want no trouble...
         return;
 
-    // TODO: Transaction chaining
+    // Transactions merged into the active one finish before it
+    Lane *lane = nullptr;
+    if (trans == m_mainLane.active)
+        lane = &m_mainLane;
+    else if (trans == m_downloadLane.active)
+        lane = &m_downloadLane;
 
     remove(trans->transactionId());
-    if (m_queue.count())
-        runNextTransaction();
+    if (lane && lane->queue.count())
+        runNextTransaction(*lane);
     emitQueueChanged();
 }
 
-void TransactionQueue::runNextTransaction()
+bool TransactionQueue::canMerge(Transaction *trans, Transaction *other,
+                                const QVariantMap &packages) const
+{
+    if (other->role() != QApt::CommitChangesRole ||
+        other->userId() != trans->userId() ||
+        other->isCancelled() ||
+        other->locale() != trans->locale() ||
+        other->proxy() != trans->proxy() ||
+        other->debconfPipe() != trans->debconfPipe() ||
+        other->frontendCaps() != trans->frontendCaps())
+        return false;
+
+    // The instructions must not contradict each other. Downgrades carry
+    // their version after a comma, so compare by package name
+    QHash<QString, int> actions;
+    for (auto iter = packages.constBegin(); iter != packages.constEnd(); ++iter)
+        actions.insert(iter.key().section(QLatin1Char(','), 0, 0), iter.value().toInt());
+
+    const QVariantMap otherPackages = other->packages();
+    for (auto iter = otherPackages.constBegin(); iter != otherPackages.constEnd(); ++iter) {
+        const QString name = iter.key().section(QLatin1Char(','), 0, 0);
+        auto action = actions.constFind(name);
+        if (action != actions.constEnd() &&
+            (*action != iter.value().toInt() || !packages.contains(iter.key())))
+            return false;
+    }
+
+    return true;
+}
+
+void TransactionQueue::runNextTransaction(Lane &lane)
 {
-    m_activeTransaction = m_queue.head();
+    Transaction *active = lane.queue.head();
+    lane.active = active;
+
+    // Chain compatible commits waiting right behind into a single marking,
+    // download and dpkg run
+    QList<Transaction *> merged;
+    if (active->role() == QApt::CommitChangesRole) {
+        QVariantMap packages = active->packages();
+
+        for (int i = 1; i < lane.queue.size(); ++i) {
+            Transaction *next = lane.queue.at(i);
+            if (!canMerge(active, next, packages))
+                break;
+
+            const QVariantMap nextPackages = next->packages();
+            for (auto iter = nextPackages.constBegin(); iter != nextPackages.constEnd(); ++iter)
+                packages.insert(iter.key(), iter.value());
+            merged << next;
+        }
+    }
+
+    active->setMergedTransactions(merged);
+    for (Transaction *trans : merged)
+        trans->setStatus(QApt::RunningStatus);
+
+    active->setQueueWaitTime(m_queuedSince.value(active).elapsed());
+    for (Transaction *trans : merged)
+        trans->setQueueWaitTime(m_queuedSince.value(trans).elapsed());
 
-    QMetaObject::invokeMethod(m_worker, "runTransaction", Qt::QueuedConnection,
-                              Q_ARG(Transaction *, m_activeTransaction));
+    QMetaObject::invokeMethod(lane.worker, "runTransaction", Qt::QueuedConnection,
+                              Q_ARG(Transaction *, active));
 }
 
 void TransactionQueue::emitQueueChanged()
@@ -159,10 +273,10 @@ void TransactionQueue::emitQueueChanged()
     QString tid;
     QStringList queued;
 
-    if (m_activeTransaction)
-        tid = m_activeTransaction->transactionId();
+    if (activeTransaction())
+        tid = activeTransaction()->transactionId();
 
-    for (Transaction *trans : m_queue)
+    for (Transaction *trans : transactions())
         queued << trans->transactionId();
 
     emit queueChanged(tid, queued);
@@ -22,8 +22,11 @@
 #ifndef TRANSACTIONQUEUE_H
 #define TRANSACTIONQUEUE_H
 
+#include <QElapsedTimer>
+#include <QHash>
 #include <QObject>
 #include <QQueue>
+#include <QVariantMap>
 
 class AptWorker;
 class Transaction;
@@ -32,20 +35,35 @@ class TransactionQueue : public QObject
 {
     Q_OBJECT
 public:
-    TransactionQueue(QObject *parent, AptWorker *worker);
+    // Download-only transactions run on @p downloadWorker if given,
+    // alongside everything else
+    TransactionQueue(QObject *parent, AptWorker *worker,
+                     AptWorker *downloadWorker = nullptr);
 
     QList<Transaction *> transactions() const;
     Transaction *activeTransaction() const;
     bool isEmpty() const;
 
 private:
-    AptWorker *m_worker;
-    QQueue<Transaction *> m_queue;
+    // A worker and the transactions waiting for it, the head is running
+    struct Lane {
+        AptWorker *worker;
+        QQueue<Transaction *> queue;
+        Transaction *active;
+    };
+
+    Lane m_mainLane;
+    Lane m_downloadLane;
     QList<Transaction *> m_pending;
-    Transaction *m_activeTransaction;
+    QHash<Transaction *, QElapsedTimer> m_queuedSince;
+    QString m_archivesDir;
 
     Transaction *pendingTransactionById(const QString &id) const;
     Transaction *transactionById(const QString &id) const;
+    Lane &laneFor(Transaction *trans);
+    void runNextTransaction(Lane &lane);
+    bool canMerge(Transaction *trans, Transaction *other,
+                  const QVariantMap &packages) const;
     
 signals:
     void queueChanged(const QString &active,
@@ -59,7 +77,6 @@ public slots:
 
 private slots:
     void onTransactionFinished();
-    void runNextTransaction();
     void emitQueueChanged();
 };
 
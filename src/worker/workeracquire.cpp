@@ -25,6 +25,7 @@
 #include <QDebug>
 #include <QEventLoop>
 #include <QStringBuilder>
+#include <QUrl>
 
 // Apt-pkg includes
 #include <apt-pkg/error.h>
@@ -33,6 +34,7 @@
 
 // Own includes
 #include "aptworker.h"
+#include "tracing.h"
 #include "transaction.h"
 
 using namespace std;
@@ -43,6 +45,8 @@ WorkerAcquire::WorkerAcquire(QObject *parent, int begin, int end)
         , m_progressBegin(begin)
         , m_progressEnd(end)
         , m_lastProgress(0)
+        , m_reportsProgress(1)
+        , m_lastItemId(0)
 {
     MorePulses = true;
 }
@@ -54,13 +58,30 @@ void WorkerAcquire::setTransaction(Transaction *trans)
         setenv("http_proxy", m_trans->proxy().toLatin1(), 1);
 }
 
+void WorkerAcquire::setReportsProgress(bool reports)
+{
+    m_reportsProgress.store(reports);
+}
+
 void WorkerAcquire::Start()
 {
     // Cleanup from old fetches
     m_calculatingSpeed = true;
-
-    m_trans->setCancellable(true);
-    m_trans->setStatus(QApt::DownloadingStatus);
+    m_itemStates.clear();
+    m_itemIds.clear();
+    m_sentMessages.clear();
+    m_pendingIndex.clear();
+    m_pendingProgress.clear();
+    m_traceStarts.clear();
+    m_hostBytes.clear();
+    m_itemBytes.clear();
+    m_flushTimer.start();
+    m_hostSpeedTimer.start();
+
+    if (m_reportsProgress.load()) {
+        m_trans->setCancellable(true);
+        m_trans->setStatus(QApt::DownloadingStatus);
+    }
 
     pkgAcquireStatus::Start();
 }
@@ -79,6 +100,9 @@ void WorkerAcquire::Fetch(pkgAcquire::ItemDesc &item)
         return;
     }
 
+    if (QApt::Tracing::isEnabled())
+        m_traceStarts.insert(item.Owner, QApt::Tracing::now());
+
     updateStatus(item);
 }
 
@@ -86,6 +110,7 @@ void WorkerAcquire::Done(pkgAcquire::ItemDesc &item)
 {
    Update = true;
 
+   traceItem(item);
    updateStatus(item);
 }
 
@@ -96,6 +121,8 @@ void WorkerAcquire::Fail(pkgAcquire::ItemDesc &item)
         return;
     }
 
+    traceItem(item);
+
     if (item.Owner->Status == pkgAcquire::Item::StatDone) {
         updateStatus(item);
     } else {
@@ -111,10 +138,24 @@ void WorkerAcquire::Fail(pkgAcquire::ItemDesc &item)
     Update = true;
 }
 
+void WorkerAcquire::traceItem(const pkgAcquire::ItemDesc &item)
+{
+    const qint64 start = m_traceStarts.take(item.Owner);
+    if (start) {
+        QApt::Tracing::complete("fetch", QString::fromStdString(item.ShortDesc),
+                                start, QApt::Tracing::now(), m_trans->transactionId());
+    }
+}
+
 void WorkerAcquire::Stop()
 {
-    m_trans->setProgress(m_progressEnd);
-    m_trans->setCancellable(false);
+    flushProgress(true);
+    if (!m_hostBytes.isEmpty() || !m_itemBytes.isEmpty())
+        m_trans->setHostDownloadSpeeds(QVariantMap());
+    if (m_reportsProgress.load()) {
+        m_trans->setProgress(m_progressEnd);
+        m_trans->setCancellable(false);
+    }
     pkgAcquireStatus::Stop();
 }
 
@@ -130,8 +171,7 @@ bool WorkerAcquire::MediaChange(string Media, string Drive)
     m_trans->setStatus(QApt::WaitingMediumStatus);
 
     // Wait until the media is provided or the user cancels
-    while (m_trans->isPaused())
-        usleep(200000);
+    m_trans->waitWhilePaused();
 
     m_trans->setStatus(QApt::DownloadingStatus);
 
@@ -156,6 +196,9 @@ bool WorkerAcquire::Pulse(pkgAcquire *Owner)
         updateStatus(*iter->CurrentItem);
     }
 
+    flushProgress(false);
+    updateHostSpeeds(Owner);
+
     int percentage = qRound(double((CurrentBytes + CurrentItems) * 100.0)/double (TotalBytes + TotalItems));
     int progress = 0;
     // work-around a stupid problem with libapt-pkg
@@ -166,11 +209,13 @@ bool WorkerAcquire::Pulse(pkgAcquire *Owner)
     // Calculate global progress, adjusted for given beginning and ending points
     progress = qRound(m_progressBegin + qreal(percentage / 100.0) * (m_progressEnd - m_progressBegin));
 
-    if (m_lastProgress > progress)
-        m_trans->setProgress(101);
-    else {
-        m_trans->setProgress(progress);
-        m_lastProgress = progress;
+    if (m_reportsProgress.load()) {
+        if (m_lastProgress > progress)
+            m_trans->setProgress(101);
+        else {
+            m_trans->setProgress(progress);
+            m_lastProgress = progress;
+        }
     }
 
     quint64 ETA = 0;
@@ -189,12 +234,78 @@ bool WorkerAcquire::Pulse(pkgAcquire *Owner)
     return true;
 }
 
+void WorkerAcquire::updateHostSpeeds(pkgAcquire *owner)
+{
+    for (pkgAcquire::Worker *iter = owner->WorkersBegin(); iter != 0; iter = owner->WorkerStep(iter)) {
+        if (!iter->CurrentItem)
+            continue;
+
+        // Resumed items start out with what was there already
+        const pkgAcquire::Item *item = iter->CurrentItem->Owner;
+        auto last = m_itemBytes.find(item);
+        if (last == m_itemBytes.end())
+            last = m_itemBytes.insert(item, iter->CurrentSize);
+
+        const QString host = QUrl(QString::fromStdString(iter->CurrentItem->URI)).host();
+        m_hostBytes[host] += iter->CurrentSize - qMin(*last, (quint64)iter->CurrentSize);
+        *last = iter->CurrentSize;
+    }
+
+    const qint64 elapsed = m_hostSpeedTimer.elapsed();
+    if (elapsed < 1000)
+        return;
+
+    QVariantMap speeds;
+    for (auto it = m_hostBytes.constBegin(); it != m_hostBytes.constEnd(); ++it)
+        speeds.insert(it.key(), *it * 1000 / elapsed);
+
+    m_trans->setHostDownloadSpeeds(speeds);
+    m_hostBytes.clear();
+    m_hostSpeedTimer.start();
+}
+
+void WorkerAcquire::flushProgress(bool force)
+{
+    if (m_pendingProgress.isEmpty())
+        return;
+
+    if (!force && m_flushTimer.isValid() &&
+        m_flushTimer.elapsed() < m_trans->downloadProgressInterval())
+        return;
+
+    m_trans->setDownloadProgressBatch(m_pendingProgress);
+    m_pendingProgress.clear();
+    m_pendingIndex.clear();
+    m_flushTimer.start();
+}
+
 void WorkerAcquire::updateStatus(const pkgAcquire::ItemDesc &Itm)
 {
-    QString URI = QString::fromStdString(Itm.Description);
+    const pkgAcquire::Item *owner = Itm.Owner;
+    const ItemState state = { (int)owner->Status, owner->FileSize,
+                              owner->PartialSize, owner->Mode,
+                              owner->ErrorText.size() };
+
+    bool sameFile = false;
+    auto known = m_itemStates.find(owner);
+    if (known != m_itemStates.end()) {
+        const ItemState &last = *known;
+        if (last.status == state.status && last.fileSize == state.fileSize &&
+            last.fetchedSize == state.fetchedSize && last.mode == state.mode &&
+            last.errorSize == state.errorSize)
+            return;
+        sameFile = (last.fileSize == state.fileSize);
+        *known = state;
+    } else {
+        m_itemStates.insert(owner, state);
+    }
+
+    quint32 &id = m_itemIds[owner];
+    if (!id)
+        id = ++m_lastItemId;
+
     int status = (int)Itm.Owner->Status;
     QApt::DownloadStatus downloadStatus = QApt::IdleState;
-    QString shortDesc = QString::fromStdString(Itm.ShortDesc);
     quint64 fileSize = Itm.Owner->FileSize;
     quint64 fetchedSize = Itm.Owner->PartialSize;
     QString errorMsg = QString::fromStdString(Itm.Owner->ErrorText);
@@ -230,8 +341,30 @@ void WorkerAcquire::updateStatus(const pkgAcquire::ItemDesc &Itm)
     else if (Itm.Owner->Mode)
         message = QString::fromUtf8(Itm.Owner->Mode);
 
-    QApt::DownloadProgress dp(URI, downloadStatus, shortDesc,
-                              fileSize, fetchedSize, message);
+    // Once the client has the URI and description of an item, only what
+    // changed while fetching it is sent. A full progress that is still
+    // pending must not be replaced by an update
+    auto pending = m_pendingIndex.constFind(owner);
+    const bool pendingFull = (pending != m_pendingIndex.constEnd() &&
+                              !m_pendingProgress.at(*pending).isUpdate());
+
+    QApt::DownloadProgress dp;
+    auto sentMessage = m_sentMessages.find(owner);
+    if (sameFile && !pendingFull && sentMessage != m_sentMessages.end() &&
+        *sentMessage == message) {
+        dp = QApt::DownloadProgress(id, downloadStatus, fetchedSize);
+    } else {
+        dp = QApt::DownloadProgress(id, QString::fromStdString(Itm.Description),
+                                    downloadStatus, QString::fromStdString(Itm.ShortDesc),
+                                    fileSize, fetchedSize, message);
+        m_sentMessages.insert(owner, message);
+    }
 
-    m_trans->setDownloadProgress(dp);
+    // Only the latest state of an item is sent with the next batch
+    if (pending != m_pendingIndex.constEnd()) {
+        m_pendingProgress[*pending] = dp;
+    } else {
+        m_pendingIndex.insert(owner, m_pendingProgress.size());
+        m_pendingProgress.append(dp);
+    }
 }
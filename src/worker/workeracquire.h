@@ -22,8 +22,14 @@
 #define WORKERACQUIRE_H
 
 // Qt includes
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QObject>
 
+// Own includes
+#include "downloadprogress.h"
+
 // Apt-pkg includes
 #include <apt-pkg/acquire.h>
 
@@ -47,13 +53,51 @@ public:
 
     void setTransaction(Transaction *trans);
 
+    /**
+     * Whether the fetch sets the status, progress and cancellability of the
+     * transaction, true by default. Can be changed while the fetch runs for
+     * when something else takes over the transaction.
+     */
+    void setReportsProgress(bool reports);
+
 private:
     Transaction *m_trans;
+    QAtomicInt m_reportsProgress;
     bool m_calculatingSpeed;
     int m_progressBegin;
     int m_progressEnd;
     int m_lastProgress;
 
+    // What was last reported for an item, to skip unchanged ones cheaply
+    struct ItemState {
+        int status;
+        quint64 fileSize;
+        quint64 fetchedSize;
+        const char *mode;
+        size_t errorSize;
+    };
+    QHash<const pkgAcquire::Item *, ItemState> m_itemStates;
+    // The numeric ID of each item and the status message last sent in full
+    // for it. IDs are not reused within a transaction
+    QHash<const pkgAcquire::Item *, quint32> m_itemIds;
+    QHash<const pkgAcquire::Item *, QString> m_sentMessages;
+    quint32 m_lastItemId;
+    QHash<const pkgAcquire::Item *, int> m_pendingIndex;
+    // When each item started downloading, only filled while tracing
+    QHash<const pkgAcquire::Item *, qint64> m_traceStarts;
+    QList<QApt::DownloadProgress> m_pendingProgress;
+    QElapsedTimer m_flushTimer;
+    // Bytes fetched from each host since the last speed report, and how far
+    // each item had got at the last pulse
+    QHash<QString, quint64> m_hostBytes;
+    QHash<const pkgAcquire::Item *, quint64> m_itemBytes;
+    QElapsedTimer m_hostSpeedTimer;
+
+    void updateHostSpeeds(pkgAcquire *owner);
+
+    void flushProgress(bool force);
+    void traceItem(const pkgAcquire::ItemDesc &item);
+
 private Q_SLOTS:
     void updateStatus(const pkgAcquire::ItemDesc &Itm);
 };
@@ -21,12 +21,25 @@
 #include "workerdaemon.h"
 
 // Qt includes
+#include <QCryptographicHash>
+#include <QDBusMetaType>
+#include <QDBusServiceWatcher>
+#include <QFile>
+#include <QSaveFile>
+#include <QStringBuilder>
 #include <QThread>
 #include <QTimer>
 
 // Apt-pkg includes
 #include <apt-pkg/configuration.h>
 
+// System includes
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 // Own includes
 #include "aptworker.h"
 #include "qaptauthorization.h"
@@ -42,22 +55,42 @@ WorkerDaemon::WorkerDaemon(int &argc, char **argv)
     , m_queue(nullptr)
     , m_worker(nullptr)
     , m_workerThread(nullptr)
+    , m_downloadWorker(nullptr)
+    , m_downloadThread(nullptr)
+    , m_clientWatcher(nullptr)
 {
+    // Read before the workers start, which own the configuration from then on
+    AptWorker::initConfig();
+    m_archivesDir = QString::fromStdString(_config->FindDir("Dir::Cache::Archives"));
+    m_keepWarm = _config->FindB("QApt::Worker::Keep-Warm", false);
+    m_idleTimeout = _config->FindI("QApt::Worker::Idle-Timeout", IDLE_TIMEOUT / 1000) * 1000;
+    m_prefetchUpgrades = _config->FindB("QApt::Prefetch-Upgrades", false);
+
     m_worker = new AptWorker(nullptr);
-    m_queue = new TransactionQueue(this, m_worker);
+    m_downloadWorker = new AptWorker(nullptr, true);
+    m_queue = new TransactionQueue(this, m_worker, m_downloadWorker);
 
     m_workerThread = new QThread(this);
     m_worker->moveToThread(m_workerThread);
     m_workerThread->start();
     connect(m_workerThread, SIGNAL(finished()), this, SLOT(quit()));
 
+    m_downloadThread = new QThread(this);
+    m_downloadWorker->moveToThread(m_downloadThread);
+    m_downloadThread->start();
+
     // Invoke with Qt::QueuedConnection since the Qt event loop isn't up yet
     QMetaObject::invokeMethod(m_worker, "init", Qt::QueuedConnection);
+    QMetaObject::invokeMethod(m_downloadWorker, "init", Qt::QueuedConnection);
+
+    // We were most likely activated for a transaction that's on its way
+    QMetaObject::invokeMethod(m_worker, "preloadCache", Qt::QueuedConnection);
     connect(m_queue, SIGNAL(queueChanged(QString,QStringList)),
             this, SIGNAL(transactionQueueChanged(QString,QStringList)),
             Qt::QueuedConnection);
     qRegisterMetaType<Transaction *>("Transaction *");
     QApt::DownloadProgress::registerMetaTypes();
+    qDBusRegisterMetaType<QMap<int, QDBusVariant> >();
 
     // Start up D-Bus service
     new WorkerAdaptor(this);
@@ -75,6 +108,12 @@ WorkerDaemon::WorkerDaemon(int &argc, char **argv)
         return;
     }
 
+    m_clientWatcher = new QDBusServiceWatcher(this);
+    m_clientWatcher->setConnection(QDBusConnection::systemBus());
+    m_clientWatcher->setWatchMode(QDBusServiceWatcher::WatchForUnregistration);
+    connect(m_clientWatcher, SIGNAL(serviceUnregistered(QString)),
+            this, SLOT(removeClient(QString)));
+
     // Quit if we've not run a job for a while
     m_idleTimer = new QTimer(this);
     m_idleTimer->start(IDLE_TIMEOUT);
@@ -83,14 +122,58 @@ WorkerDaemon::WorkerDaemon(int &argc, char **argv)
 
 void WorkerDaemon::checkIdle()
 {
+    // Connected frontends keep the open cache around
+    if (!m_clients.isEmpty() && m_keepWarm)
+        return;
+
+    // Only checked every IDLE_TIMEOUT
+    quint64 timeout = m_idleTimeout;
     quint64 currentTime = QDateTime::currentMSecsSinceEpoch();
     if (!m_worker->currentTransaction() &&
-        currentTime - m_worker->lastActiveTimestamp() > IDLE_TIMEOUT &&
+        !m_downloadWorker->currentTransaction() &&
+        currentTime - m_worker->lastActiveTimestamp() > timeout &&
+        currentTime - m_downloadWorker->lastActiveTimestamp() > timeout &&
         m_queue->isEmpty()) {
+        m_downloadWorker->quit();
+        m_downloadThread->wait();
         m_worker->quit();
     }
 }
 
+void WorkerDaemon::onCacheUpdated(int exitStatus)
+{
+    if (exitStatus != QApt::ExitSuccess || !m_prefetchUpgrades)
+        return;
+
+    // One prefetch fetches everything, don't pile them up
+    for (Transaction *trans : m_queue->transactions()) {
+        if (trans->role() == QApt::PrefetchUpgradesRole)
+            return;
+    }
+
+    // Started on behalf of root, so only the worker itself can cancel it.
+    // Being of BackgroundPriority, it makes way for anything else queued
+    Transaction *trans = new Transaction(m_queue, 0, QApt::PrefetchUpgradesRole,
+                                         QVariantMap());
+    trans->setPriority(QApt::BackgroundPriority);
+    m_queue->enqueue(trans->transactionId());
+}
+
+void WorkerDaemon::addClient(const QString &service)
+{
+    if (m_clients.contains(service))
+        return;
+
+    m_clients.insert(service);
+    m_clientWatcher->addWatchedService(service);
+}
+
+void WorkerDaemon::removeClient(const QString &service)
+{
+    m_clients.remove(service);
+    m_clientWatcher->removeWatchedService(service);
+}
+
 int WorkerDaemon::dbusSenderUid() const
 {
     return connection().interface()->serviceUid(message().service()).value();
@@ -103,6 +186,7 @@ Transaction *WorkerDaemon::createTransaction(QApt::TransactionRole role, QVarian
     // Create a transaction. It will add itself to the queue
     Transaction *trans = new Transaction(m_queue, uid, role, instructionsList);
     trans->setService(message().service());
+    addClient(message().service());
 
     return trans;
 }
@@ -110,6 +194,16 @@ Transaction *WorkerDaemon::createTransaction(QApt::TransactionRole role, QVarian
 QString WorkerDaemon::updateCache()
 {
     Transaction *trans = createTransaction(QApt::UpdateCacheRole);
+    connect(trans, SIGNAL(finished(int)), this, SLOT(onCacheUpdated(int)));
+
+    return trans->transactionId();
+}
+
+QString WorkerDaemon::updateSources(const QStringList &sources)
+{
+    Transaction *trans = createTransaction(QApt::UpdateCacheRole);
+    trans->setSources(sources);
+    connect(trans, SIGNAL(finished(int)), this, SLOT(onCacheUpdated(int)));
 
     return trans->transactionId();
 }
@@ -122,6 +216,19 @@ QString WorkerDaemon::installFile(const QString &file)
     return trans->transactionId();
 }
 
+QString WorkerDaemon::installFiles(const QStringList &files)
+{
+    if (files.isEmpty()) {
+        sendErrorReply(QDBusError::InvalidArgs, QLatin1String("No files to install"));
+        return QString();
+    }
+
+    Transaction *trans = createTransaction(QApt::InstallFileRole);
+    trans->setFilePaths(files);
+
+    return trans->transactionId();
+}
+
 QString WorkerDaemon::commitChanges(QVariantMap instructionsList)
 {
     Transaction *trans = createTransaction(QApt::CommitChangesRole,
@@ -170,20 +277,164 @@ bool WorkerDaemon::writeFileToDisk(const QString &contents, const QString &path)
     return false;
 }
 
-bool WorkerDaemon::copyArchiveToCache(const QString &archivePath)
+bool WorkerDaemon::writeFilesToDisk(QVariantMap files, const QStringList &removedFiles)
 {
     if (!QApt::Auth::authorize(dbusActionUri("writefiletodisk"), message().service())) {
+        qDebug() << "Failed to authorize!!";
         return false;
     }
 
-    QString cachePath = QString::fromStdString(_config->FindDir("Dir::Cache::Archives"));
-    // Filename
-    cachePath += archivePath.right(archivePath.size() - archivePath.lastIndexOf('/'));
+    bool success = true;
+    for (auto iter = files.constBegin(); iter != files.constEnd(); ++iter) {
+        // Replace each file atomically, so readers never see half of it
+        QSaveFile file(iter.key());
+
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            qDebug() << "Failed to write file to disk: " << file.errorString();
+            success = false;
+            continue;
+        }
+
+        file.write(iter.value().toString().toLatin1());
+
+        if (!file.commit()) {
+            qDebug() << "Failed to write file to disk: " << file.errorString();
+            success = false;
+        }
+    }
+
+    for (const QString &path : removedFiles) {
+        QFile file(path);
+        if (file.exists() && !file.remove()) {
+            qDebug() << "Failed to remove file from disk: " << file.errorString();
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+void WorkerDaemon::keepWarm()
+{
+    // Holding the worker up is only for active local sessions, which need
+    // no password for it, the same as for updating the cache
+    if (!QApt::Auth::authorize(dbusActionUri("updatecache"), message().service())) {
+        qDebug() << "Failed to authorize!!";
+        return;
+    }
+
+    // Activating us already got the cache preloading
+    addClient(message().service());
+}
+
+// Copies the data of @p in to @p out, sharing the blocks if the file system
+// can, and within the kernel otherwise
+static bool copyFileData(int in, int out, off_t size)
+{
+#ifdef FICLONE
+    if (ioctl(out, FICLONE, in) == 0)
+        return true;
+#endif
+
+    while (size > 0) {
+        ssize_t copied = copy_file_range(in, nullptr, out, nullptr, size, 0);
+        if (copied <= 0)
+            break;
+
+        size -= copied;
+    }
+
+    if (size == 0)
+        return true;
+
+    // Not supported between these file systems, copy what's left by hand
+    char buffer[64 * 1024];
+    ssize_t length;
+    while ((length = read(in, buffer, sizeof(buffer))) > 0) {
+        if (write(out, buffer, length) != length)
+            return false;
+    }
+
+    return (length == 0);
+}
+
+// Puts @p archivePath into the archive cache at @p cacheDir. Archives only root can change
+// are hard linked, others copied. The result is checked against @p md5 if
+// given, as read back from the cache, so the archive can't be changed
+// between checking and storing it
+static bool injectArchive(const QString &cacheDir, const QString &archivePath,
+                          const QByteArray &md5)
+{
+    const QString fileName = archivePath.mid(archivePath.lastIndexOf('/') + 1);
+    const QString cachePath = cacheDir + fileName;
 
     if (QFile::exists(cachePath)) {
         // Already copied
         return true;
     }
 
-    return QFile::copy(archivePath, cachePath);
+    int in = open(QFile::encodeName(archivePath).constData(), O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(in, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(in);
+        return false;
+    }
+
+    const QByteArray partialPath = QFile::encodeName(cacheDir % QLatin1String("partial/") % fileName);
+    unlink(partialPath.constData());
+
+    bool stored = false;
+    if (info.st_uid == 0 && !(info.st_mode & (S_IWGRP | S_IWOTH)))
+        stored = (linkat(in, "", AT_FDCWD, partialPath.constData(), AT_EMPTY_PATH) == 0);
+
+    if (!stored) {
+        int out = open(partialPath.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (out >= 0) {
+            stored = copyFileData(in, out, info.st_size);
+            stored &= (close(out) == 0);
+        }
+    }
+    close(in);
+
+    if (stored && !md5.isEmpty()) {
+        QFile partial(QFile::decodeName(partialPath));
+        QCryptographicHash hash(QCryptographicHash::Md5);
+
+        stored = partial.open(QIODevice::ReadOnly) && hash.addData(&partial) &&
+                 hash.result().toHex() == md5.toLower();
+    }
+
+    if (!stored || rename(partialPath.constData(), QFile::encodeName(cachePath).constData()) != 0) {
+        unlink(partialPath.constData());
+        return false;
+    }
+
+    return true;
+}
+
+bool WorkerDaemon::copyArchiveToCache(const QString &archivePath)
+{
+    if (!QApt::Auth::authorize(dbusActionUri("writefiletodisk"), message().service())) {
+        return false;
+    }
+
+    return injectArchive(m_archivesDir, archivePath, QByteArray());
+}
+
+QStringList WorkerDaemon::copyArchivesToCache(QVariantMap archives)
+{
+    if (!QApt::Auth::authorize(dbusActionUri("writefiletodisk"), message().service())) {
+        return QStringList();
+    }
+
+    QStringList added;
+    for (auto iter = archives.constBegin(); iter != archives.constEnd(); ++iter) {
+        if (injectArchive(m_archivesDir, iter.key(), iter.value().toString().toLatin1()))
+            added << iter.key();
+    }
+
+    return added;
 }
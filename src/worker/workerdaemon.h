@@ -23,9 +23,11 @@
 
 #include <QCoreApplication>
 #include <QDBusContext>
+#include <QSet>
 
 #include "globals.h"
 
+class QDBusServiceWatcher;
 class QThread;
 class QTimer;
 
@@ -45,9 +47,21 @@ private:
     TransactionQueue *m_queue;
     AptWorker *m_worker;
     QThread *m_workerThread;
+    // Runs downloads that don't touch the package system alongside m_worker
+    AptWorker *m_downloadWorker;
+    QThread *m_downloadThread;
     QTimer *m_idleTimer;
+    // Frontends keeping the worker up, see keepWarm()
+    QSet<QString> m_clients;
+    QDBusServiceWatcher *m_clientWatcher;
+    // Read from the APT configuration at startup, see AptWorker::initConfig()
+    QString m_archivesDir;
+    bool m_keepWarm;
+    quint64 m_idleTimeout;
+    bool m_prefetchUpgrades;
 
     int dbusSenderUid() const;
+    void addClient(const QString &service);
     Transaction *createTransaction(QApt::TransactionRole role,
                                    QVariantMap instructionsList = QVariantMap());
 
@@ -58,17 +72,28 @@ signals:
 public slots:
     // Transaction-based methods. Return transaction ids.
     QString updateCache();
+    QString updateSources(const QStringList &sources);
     QString installFile(const QString &file);
+    QString installFiles(const QStringList &files);
     QString commitChanges(QVariantMap instructionsList);
     QString upgradeSystem(bool safeUpgrade);
     QString downloadArchives(const QStringList &packageNames, const QString &dest);
 
     // Synchronous methods
     bool writeFileToDisk(const QString &contents, const QString &path);
+    // Takes the contents of the files to write keyed by path, and the paths
+    // of the files to remove
+    bool writeFilesToDisk(QVariantMap files, const QStringList &removedFiles);
     bool copyArchiveToCache(const QString &archivePath);
+    // Takes the md5 sums the archives have to match, keyed by path, and
+    // returns the paths of the archives that were added
+    QStringList copyArchivesToCache(QVariantMap archives);
+    void keepWarm();
 
 private slots:
     void checkIdle();
+    void removeClient(const QString &service);
+    void onCacheUpdated(int exitStatus);
 };
 
 #endif // WORKERDAEMON_H
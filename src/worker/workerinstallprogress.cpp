@@ -29,11 +29,14 @@
 #include <apt-pkg/error.h>
 
 #include <errno.h>
+#include <poll.h>
 #include <sys/statvfs.h>
 #include <sys/statfs.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <sys/fcntl.h>
 #include <pty.h>
+#include <unistd.h>
 
 #include <iostream>
 #include <stdlib.h>
@@ -117,112 +120,161 @@ pkgPackageManager::OrderResult WorkerInstallProgress::start(pkgPackageManager *p
         _exit(res);
     }
 
+    // The child has its own copy of the write end. Closing ours lets us
+    // see the end of the status stream
+    close(readFromChildFD[1]);
+
     // make it nonblocking
     fcntl(readFromChildFD[0], F_SETFL, O_NONBLOCK);
     fcntl(pty_master, F_SETFL, O_NONBLOCK);
 
+    // Wake up when the child exits, if the kernel can tell us. Otherwise
+    // we have to check on it every now and then
+    int pidFd = -1;
+#ifdef SYS_pidfd_open
+    pidFd = syscall(SYS_pidfd_open, m_child_id, 0);
+#endif
+
     // Update the interface until the child dies
-    int ret;
-    char masterbuf[1024];
-    while (waitpid(m_child_id, &ret, WNOHANG) == 0) {
-        // Read dpkg's raw output
-        while(read(pty_master, masterbuf, sizeof(masterbuf)) > 0);
+    int ret = 0;
+    int statusFd = readFromChildFD[0];
+    int ptyFd = pty_master;
+    char buf[4096];
+    QByteArray statusBuffer;
+
+    while (true) {
+        struct pollfd fds[3];
+        nfds_t count = 0;
+        if (statusFd != -1) {
+            fds[count++] = { statusFd, POLLIN, 0 };
+        }
+        if (ptyFd != -1) {
+            fds[count++] = { ptyFd, POLLIN, 0 };
+        }
+        if (pidFd != -1) {
+            fds[count++] = { pidFd, POLLIN, 0 };
+        }
+
+        if (poll(fds, count, pidFd != -1 ? -1 : 100) < 0 && errno != EINTR) {
+            break;
+        }
 
         // Update high-level status info
-        updateInterface(readFromChildFD[0], pty_master);
+        if (statusFd != -1) {
+            ssize_t len;
+            while ((len = read(statusFd, buf, sizeof(buf))) > 0) {
+                statusBuffer.append(buf, len);
+            }
+            if (len == 0) {
+                statusFd = -1;
+            }
+
+            int start = 0;
+            int end;
+            while ((end = statusBuffer.indexOf('\n', start)) != -1) {
+                processStatusLine(statusBuffer.mid(start, end - start), pty_master);
+                start = end + 1;
+            }
+            statusBuffer.remove(0, start);
+        }
+
+        // Read dpkg's raw output
+        if (ptyFd != -1) {
+            ssize_t len;
+            while ((len = read(ptyFd, buf, sizeof(buf))) > 0);
+            // The terminal is gone once all of the child's processes closed it
+            if (len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR)) {
+                ptyFd = -1;
+            }
+        }
+
+        if (waitpid(m_child_id, &ret, WNOHANG) != 0) {
+            // Pick up whatever was written after our last read
+            if (statusFd != -1) {
+                pollfd last = { statusFd, POLLIN, 0 };
+                if (poll(&last, 1, 0) > 0) {
+                    continue;
+                }
+            }
+            break;
+        }
     }
 
     res = (pkgPackageManager::OrderResult)WEXITSTATUS(ret);
 
+    if (pidFd != -1) {
+        close(pidFd);
+    }
     close(readFromChildFD[0]);
-    close(readFromChildFD[1]);
     close(pty_master);
 
     return res;
 }
 
-void WorkerInstallProgress::updateInterface(int fd, int writeFd)
+void WorkerInstallProgress::processStatusLine(const QByteArray &line, int writeFd)
 {
-    char buf[2];
-    static char line[1024] = "";
-
-    while (1) {
-        int len = read(fd, buf, 1);
-
-        // Status message didn't change
-        if (len < 1) {
-            break;
-        }
-
-        if (buf[0] == '\n') {
-            const QStringList list = QString::fromUtf8(line).split(QLatin1Char(':'));
-            const QString status = list.at(0);
-            const QString package = list.at(1);
-            QString percent = list.at(2);
-            QString str = list.at(3);
-            // If str legitimately had a ':' in it (such as a package version)
-            // we need to retrieve the next string in the list.
-            if (list.count() == 5) {
-                str += QString(':' % list.at(4));
-            }
-
-            if (package.isEmpty() || status.isEmpty()) {
-                continue;
-            }
-
-            if (status.contains(QLatin1String("pmerror"))) {
-                // Append error string to existing error details
-                m_trans->setErrorDetails(m_trans->errorDetails() % package % '\n' % str % "\n\n");
-            } else if (status.contains(QLatin1String("pmconffile"))) {
-                // From what I understand, the original file starts after the ' character ('\'') and
-                // goes to a second ' character. The new conf file starts at the next ' and goes to
-                // the next '.
-                QStringList strList = str.split('\'');
-                QString oldFile = strList.at(1);
-                QString newFile = strList.at(2);
-
-                // Prompt for which file to use if the frontend supports that
-                if (m_trans->frontendCaps() & QApt::ConfigPromptCap) {
-                    m_trans->setConfFileConflict(oldFile, newFile);
-                    m_trans->setStatus(QApt::WaitingConfigFilePromptStatus);
-
-                    while (m_trans->isPaused())
-                        usleep(200000);
-                }
+    const QStringList list = QString::fromUtf8(line).split(QLatin1Char(':'));
+    if (list.count() < 4) {
+        return;
+    }
 
-                m_trans->setStatus(QApt::CommittingStatus);
+    const QString status = list.at(0);
+    const QString package = list.at(1);
+    QString percent = list.at(2);
+    QString str = list.at(3);
+    // If str legitimately had a ':' in it (such as a package version)
+    // we need to retrieve the next string in the list.
+    if (list.count() == 5) {
+        str += QString(':' % list.at(4));
+    }
 
-                if (m_trans->replaceConfFile()) {
-                    ssize_t reply = write(writeFd, "Y\n", 2);
-                    Q_UNUSED(reply);
-                } else {
-                    ssize_t reply = write(writeFd, "N\n", 2);
-                    Q_UNUSED(reply);
-                }
-            } else {
-                m_startCounting = true;
-            }
+    if (package.isEmpty() || status.isEmpty()) {
+        return;
+    }
 
-            int percentage;
-            int progress;
-            if (percent.contains(QLatin1Char('.'))) {
-                QStringList percentList = percent.split(QLatin1Char('.'));
-                percentage = percentList.at(0).toInt();
-            } else {
-                percentage = percent.toInt();
-            }
+    if (status.contains(QLatin1String("pmerror"))) {
+        // Append error string to existing error details
+        m_trans->setErrorDetails(m_trans->errorDetails() % package % '\n' % str % "\n\n");
+    } else if (status.contains(QLatin1String("pmconffile"))) {
+        // From what I understand, the original file starts after the ' character ('\'') and
+        // goes to a second ' character. The new conf file starts at the next ' and goes to
+        // the next '.
+        QStringList strList = str.split('\'');
+        QString oldFile = strList.at(1);
+        QString newFile = strList.at(2);
+
+        // Prompt for which file to use if the frontend supports that
+        if (m_trans->frontendCaps() & QApt::ConfigPromptCap) {
+            m_trans->setConfFileConflict(oldFile, newFile);
+            m_trans->setStatus(QApt::WaitingConfigFilePromptStatus);
+
+            m_trans->waitWhilePaused();
+        }
 
-            progress = qRound(qreal(m_progressBegin + qreal(percentage / 100.0) * (m_progressEnd - m_progressBegin)));
+        m_trans->setStatus(QApt::CommittingStatus);
 
-            m_trans->setProgress(progress);
-            m_trans->setStatusDetails(str);
-            // clean-up
-            line[0] = 0;
+        if (m_trans->replaceConfFile()) {
+            ssize_t reply = write(writeFd, "Y\n", 2);
+            Q_UNUSED(reply);
         } else {
-            buf[1] = 0;
-            strcat(line, buf);
+            ssize_t reply = write(writeFd, "N\n", 2);
+            Q_UNUSED(reply);
         }
+    } else {
+        m_startCounting = true;
+    }
+
+    int percentage;
+    int progress;
+    if (percent.contains(QLatin1Char('.'))) {
+        QStringList percentList = percent.split(QLatin1Char('.'));
+        percentage = percentList.at(0).toInt();
+    } else {
+        percentage = percent.toInt();
     }
-    // 30 frames per second
-    usleep(1000000/30);
+
+    progress = qRound(qreal(m_progressBegin + qreal(percentage / 100.0) * (m_progressEnd - m_progressBegin)));
+
+    m_trans->setProgress(progress);
+    m_trans->setStatusDetails(str);
 }
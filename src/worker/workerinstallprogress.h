@@ -24,6 +24,7 @@
 
 #include <apt-pkg/packagemanager.h>
 
+class QByteArray;
 class Transaction;
 
 class WorkerInstallProgress
@@ -42,7 +43,7 @@ private:
     int m_progressBegin;
     int m_progressEnd;
 
-    void updateInterface(int fd, int writeFd);
+    void processStatusLine(const QByteArray &line, int writeFd);
 };
 
 #endif
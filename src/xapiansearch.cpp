@@ -0,0 +1,300 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "xapiansearch.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+
+using namespace std;
+
+namespace QApt {
+
+// Matches below this percentage of the top match are dropped
+static const int qualityCutoff = 15;
+
+// How often a search starts over on a newer revision of the index, as
+// recommended by Xapian
+static const int maxReopens = 2;
+
+// The number of matches delivered at once by background searches
+static const int searchPageSize = 50;
+
+XapianSearch::XapianSearch()
+    : m_database(nullptr)
+    , m_enquire(nullptr)
+    , m_topPercent(-1)
+{
+}
+
+XapianSearch::~XapianSearch()
+{
+    delete m_enquire;
+}
+
+void XapianSearch::setDatabase(Xapian::Database *database)
+{
+    delete m_enquire;
+    m_enquire = nullptr;
+    m_database = database;
+    m_searchString.clear();
+    m_topPercent = -1;
+
+    if (!m_database) {
+        return;
+    }
+
+    m_enquire = new Xapian::Enquire(*m_database);
+    m_parser = Xapian::QueryParser();
+    m_parser.set_database(*m_database);
+    m_parser.add_prefix("name","XP");
+    m_parser.add_prefix("section","XS");
+    // default op is AND to narrow down the resultset
+    m_parser.set_default_op(Xapian::Query::OP_AND);
+}
+
+void XapianSearch::reopen()
+{
+    if (!m_database) {
+        return;
+    }
+
+    m_database->reopen();
+    // The parsed query and its cutoff belong to the old revision
+    setDatabase(m_database);
+}
+
+void XapianSearch::prepare(const QString &searchString)
+{
+    if (searchString == m_searchString && m_topPercent != -1) {
+        return;
+    }
+
+    string unsplitSearchString = searchString.toStdString();
+
+    /* Workaround to allow searching an hyphenated package name using a prefix (name:)
+    * LP: #282995
+    * Xapian currently doesn't support wildcard for boolean prefix and
+    * doesn't handle implicit wildcards at the end of hypenated phrases.
+    *
+    * e.g searching for name:ubuntu-res will be equivalent to 'name:ubuntu res*'
+    * however 'name:(ubuntu* res*) won't return any result because the
+    * index is built with the full package name
+    */
+    // Always search for the package name
+    string xpString = "name:";
+    string::size_type pos = unsplitSearchString.find_first_of(" ,;");
+    if (pos > 0) {
+        xpString += unsplitSearchString.substr(0,pos);
+    } else {
+        xpString += unsplitSearchString;
+    }
+    Xapian::Query xpQuery = m_parser.parse_query(xpString);
+
+    pos = 0;
+    while ( (pos = unsplitSearchString.find("-", pos)) != string::npos ) {
+        unsplitSearchString.replace(pos, 1, " ");
+        pos+=1;
+    }
+
+    // Build the query
+    // apply a weight factor to XP term to increase relevancy on package name
+    Xapian::Query query = m_parser.parse_query(unsplitSearchString,
+       Xapian::QueryParser::FLAG_WILDCARD |
+       Xapian::QueryParser::FLAG_BOOLEAN |
+       Xapian::QueryParser::FLAG_PARTIAL);
+    query = Xapian::Query(Xapian::Query::OP_OR, query,
+            Xapian::Query(Xapian::Query::OP_SCALE_WEIGHT, xpQuery, 3));
+
+    m_enquire->set_query(query);
+    m_enquire->set_cutoff(0);
+
+    // The confidence of the top match is the reference for the adaptive
+    // quality cutoff, which Xapian can then apply while ranking
+    Xapian::MSet top = m_enquire->get_mset(0, 1);
+    m_topPercent = top.empty() ? 0 : top.begin().get_percent();
+    m_enquire->set_cutoff(qualityCutoff * m_topPercent / 100);
+
+    m_searchString = searchString;
+}
+
+QStringList XapianSearch::matches(const QString &searchString, int offset, int limit,
+                                  bool *exhausted)
+{
+    QStringList names;
+
+    if (exhausted) {
+        *exhausted = true;
+    }
+
+    if (!m_database) {
+        return names;
+    }
+
+    for (int reopens = 0; ; ++reopens) {
+        names.clear();
+
+        try {
+            prepare(searchString);
+            if (!m_topPercent) {
+                return names;
+            }
+
+            // Ask for one extra match to find out whether there are more
+            Xapian::doccount count = (limit < 0) ? m_database->get_doccount() : Xapian::doccount(limit) + 1;
+            Xapian::MSet matches = m_enquire->get_mset(qMax(0, offset), count);
+
+            for (Xapian::MSetIterator i = matches.begin(); i != matches.end(); ++i) {
+                if (limit >= 0 && names.size() == limit) {
+                    if (exhausted) {
+                        *exhausted = false;
+                    }
+                    break;
+                }
+
+                names.append(QString::fromStdString(i.get_document().get_data()));
+            }
+
+            return names;
+        } catch (const Xapian::DatabaseModifiedError &) {
+            // The index was updated while we were reading the previous
+            // revision. Carry on with the latest one, unless it keeps
+            // changing under us
+            if (reopens == maxReopens) {
+                return names;
+            }
+
+            reopen();
+        }
+    }
+}
+
+XapianSearchThread::XapianSearchThread(const QString &databasePath, QObject *receiver)
+    : QThread(receiver)
+    , m_databasePath(databasePath)
+    , m_receiver(receiver)
+    , m_hasPending(false)
+    , m_reopen(false)
+    , m_stopping(false)
+{
+}
+
+XapianSearchThread::~XapianSearchThread()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_condition.wakeAll();
+    }
+
+    wait();
+}
+
+void XapianSearchThread::reopen()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_reopen = true;
+}
+
+void XapianSearchThread::search(const QString &searchString)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_pending = searchString;
+    m_hasPending = true;
+    m_condition.wakeAll();
+}
+
+void XapianSearchThread::run()
+{
+    Xapian::Database *database = nullptr;
+    XapianSearch search;
+
+    forever {
+        // Also retried for each search if the index was missing or broken
+        if (!database) {
+            try {
+                database = new Xapian::Database(m_databasePath.toStdString());
+                search.setDatabase(database);
+            } catch (const Xapian::Error &error) {
+                qDebug() << "Search error" << QString::fromStdString(error.get_msg());
+            }
+        }
+
+        QString searchString;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (!m_hasPending && !m_stopping) {
+                m_condition.wait(&m_mutex);
+            }
+
+            if (m_stopping) {
+                break;
+            }
+
+            searchString = m_pending;
+            m_hasPending = false;
+
+            if (m_reopen) {
+                m_reopen = false;
+                try {
+                    search.reopen();
+                } catch (const Xapian::Error &error) {
+                    qDebug() << "Search error" << QString::fromStdString(error.get_msg());
+                }
+            }
+        }
+
+        int offset = 0;
+        bool exhausted = false;
+        while (!exhausted) {
+            QStringList names;
+            try {
+                names = search.matches(searchString, offset, searchPageSize, &exhausted);
+            } catch (const Xapian::Error &error) {
+                qDebug() << "Search error" << QString::fromStdString(error.get_msg());
+                exhausted = true;
+
+                // Start over with a fresh database for the next search
+                search.setDatabase(nullptr);
+                delete database;
+                database = nullptr;
+            }
+            offset += names.size();
+
+            QMetaObject::invokeMethod(m_receiver, "deliverSearchPage", Qt::QueuedConnection,
+                                      Q_ARG(QString, searchString),
+                                      Q_ARG(QStringList, names),
+                                      Q_ARG(bool, exhausted));
+
+            // Typing on makes the rest of this search outdated
+            QMutexLocker locker(&m_mutex);
+            if (m_hasPending || m_stopping) {
+                break;
+            }
+        }
+    }
+
+    search.setDatabase(nullptr);
+    delete database;
+}
+
+}
@@ -0,0 +1,119 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef QAPT_XAPIANSEARCH_H
+#define QAPT_XAPIANSEARCH_H
+
+#include <QMutex>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+// Xapian includes
+#undef slots
+#include <xapian.h>
+
+namespace QApt {
+
+/**
+ * The XapianSearch class runs searches against the APT Xapian index. It is
+ * used internally by QApt::Backend.
+ *
+ * The query parser is set up once per database, and the parsed query of the
+ * last search string is kept around, so that fetching further pages of the
+ * same search does not parse or rank it again from scratch. Matches below
+ * the adaptive quality cutoff are never fetched.
+ */
+class XapianSearch
+{
+public:
+    XapianSearch();
+    ~XapianSearch();
+
+    /// Sets the database to search, or @c nullptr to disable searching
+    void setDatabase(Xapian::Database *database);
+
+    /**
+     * Moves the database on to its latest revision in place, e.g. after an
+     * incremental update of the index. Searches going past the revision
+     * they started on do this by themselves.
+     */
+    void reopen();
+
+    /**
+     * Returns the names of up to @p limit packages matching
+     * @p searchString, skipping the first @p offset matches. If the index
+     * keeps changing while it is read, returns what was found before giving
+     * up.
+     *
+     * @param limit The maximum number of names to return, or -1 for all
+     * @param exhausted Set to whether there are no further matches
+     */
+    QStringList matches(const QString &searchString, int offset, int limit,
+                        bool *exhausted = nullptr);
+
+private:
+    Q_DISABLE_COPY(XapianSearch)
+
+    void prepare(const QString &searchString);
+
+    Xapian::Database *m_database;
+    Xapian::Enquire *m_enquire;
+    Xapian::QueryParser m_parser;
+    QString m_searchString;
+    int m_topPercent;
+};
+
+/**
+ * The XapianSearchThread class runs searches in the background, using its
+ * own connection to the Xapian index. Results are delivered page by page by
+ * invoking the deliverSearchPage(QString, QStringList, bool) slot of the
+ * receiver. Starting a new search abandons the one that is running.
+ */
+class XapianSearchThread : public QThread
+{
+public:
+    XapianSearchThread(const QString &databasePath, QObject *receiver);
+    ~XapianSearchThread();
+
+    /// Queues @p searchString, replacing any search that was not done yet
+    void search(const QString &searchString);
+
+    /// Has the next search run on the latest revision of the database
+    void reopen();
+
+protected:
+    void run();
+
+private:
+    QString m_databasePath;
+    QObject *m_receiver;
+
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+    QString m_pending;
+    bool m_hasPending;
+    bool m_reopen;
+    bool m_stopping;
+};
+
+}
+
+#endif
@@ -0,0 +1,102 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "CommandIndex.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+// APT includes
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/error.h>
+#include <apt-pkg/fileutl.h>
+#include <apt-pkg/init.h>
+
+CommandIndex::CommandIndex()
+    : m_stamp(-1)
+    , m_available(false)
+{
+    if (_config->FindB("APT::Config::Loaded", false) == false)
+        pkgInitConfig(*_config);
+
+    m_listsDir = QString::fromStdString(_config->FindDir("Dir::State::lists"));
+}
+
+bool CommandIndex::isAvailable()
+{
+    QMutexLocker locker(&m_mutex);
+
+    refresh();
+    return m_available;
+}
+
+QStringList CommandIndex::packagesForCommand(const QString &command)
+{
+    QMutexLocker locker(&m_mutex);
+
+    refresh();
+    return m_commands.value(command);
+}
+
+void CommandIndex::refresh()
+{
+    // Updating the cache touches the lists directory
+    const qint64 stamp = QFileInfo(m_listsDir).lastModified().toMSecsSinceEpoch();
+    if (stamp == m_stamp)
+        return;
+
+    m_stamp = stamp;
+    m_commands.clear();
+
+    const QStringList lists = QDir(m_listsDir).entryList(QStringList(QLatin1String("*_Commands-*")),
+                                                         QDir::Files);
+    m_available = !lists.isEmpty();
+
+    for (const QString &list : lists) {
+        // FileFd takes care of compressed lists
+        FileFd fd;
+        if (!fd.Open(QFile::encodeName(m_listsDir + list).toStdString(), FileFd::ReadOnly, FileFd::Extension)) {
+            _error->Discard();
+            continue;
+        }
+
+        // Stanzas of "name: <package>" followed by "commands: <a>,<b>,..."
+        QString package;
+        QByteArray buffer(64 * 1024, '\0');
+        while (fd.ReadLine(buffer.data(), buffer.size())) {
+            const QByteArray line = QByteArray(buffer.constData()).trimmed();
+
+            if (line.startsWith("name: ")) {
+                package = QString::fromUtf8(line.mid(6));
+            } else if (line.startsWith("commands: ") && !package.isEmpty()) {
+                for (const QByteArray &command : line.mid(10).split(',')) {
+                    QStringList &packages = m_commands[QString::fromUtf8(command.trimmed())];
+                    if (!packages.contains(package))
+                        packages << package;
+                }
+            } else if (line.isEmpty()) {
+                package.clear();
+            }
+        }
+        _error->Discard();
+    }
+}
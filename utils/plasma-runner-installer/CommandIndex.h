@@ -0,0 +1,57 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef COMMANDINDEX_H
+#define COMMANDINDEX_H
+
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+
+/**
+ * An in-memory index from command names to the packages providing them,
+ * read from the command-not-found (Commands-*) lists APT downloads. The
+ * index is rebuilt whenever the lists directory changes, i.e. after a
+ * cache update. It may be used from several threads at once.
+ */
+class CommandIndex
+{
+public:
+    CommandIndex();
+
+    /// Whether any Commands lists are available to build the index from
+    bool isAvailable();
+
+    /// Returns the packages providing @p command
+    QStringList packagesForCommand(const QString &command);
+
+private:
+    Q_DISABLE_COPY(CommandIndex)
+
+    void refresh();
+
+    QMutex m_mutex;
+    QString m_listsDir;
+    qint64 m_stamp;
+    bool m_available;
+    QHash<QString, QStringList> m_commands;
+};
+
+#endif
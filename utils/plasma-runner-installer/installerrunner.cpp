@@ -23,6 +23,7 @@
 // Qt includes
 #include <QDir>
 #include <QIcon>
+#include <QThread>
 
 // KDE includes
 #include <KLocalizedString>
@@ -62,30 +63,12 @@ void InstallerRunner::match(Plasma::RunnerContext &context)
     QList<Plasma::QueryMatch> matches;
 
     if (services.isEmpty()) {
-        KProcess process;
-        if (QFile::exists("/usr/lib/command-not-found")) {
-            process << "/usr/lib/command-not-found" << term;
-        } else if (QFile::exists("/usr/bin/command-not-found")) {
-            process << "/usr/bin/command-not-found" << term;
-        } else {
-            process << "/bin/ls" << term; // Play it safe even if it won't work at all
-        }
-        process.setTextModeEnabled(true);
-        process.setOutputChannelMode(KProcess::OnlyStderrChannel);
-        process.start();
-        process.waitForFinished();
-
-        QString output = QString(process.readAllStandardError());
-        QStringList resultLines = output.split('\n');
-        foreach(const QString &line, resultLines) {
-            if (line.startsWith(QLatin1String("sudo"))) {
-                QString package = line.split(' ').last();
-                Plasma::QueryMatch match(this);
-                match.setType(Plasma::QueryMatch::ExactMatch);
-                setupMatch(package, term, match);
-                match.setRelevance(1);
-                matches << match;
-            }
+        for (const QString &package : packagesForCommand(context, term)) {
+            Plasma::QueryMatch match(this);
+            match.setType(Plasma::QueryMatch::ExactMatch);
+            setupMatch(package, term, match);
+            match.setRelevance(1);
+            matches << match;
         }
     }
 
@@ -97,6 +80,66 @@ void InstallerRunner::match(Plasma::RunnerContext &context)
     context.addMatches(matches);
 }
 
+QStringList InstallerRunner::packagesForCommand(Plasma::RunnerContext &context, const QString &term)
+{
+    if (m_commandIndex.isAvailable()) {
+        return m_commandIndex.packagesForCommand(term);
+    }
+
+    // Without the Commands lists, fall back to asking command-not-found, which
+    // is too slow to ask twice for the same term
+    {
+        QMutexLocker locker(&m_cacheMutex);
+        auto it = m_cache.constFind(term);
+        if (it != m_cache.constEnd()) {
+            return *it;
+        }
+    }
+
+    // Wait for the user to stop typing before starting a process
+    QThread::msleep(300);
+    if (!context.isValid()) {
+        return QStringList();
+    }
+
+    const QStringList packages = commandNotFound(term);
+
+    QMutexLocker locker(&m_cacheMutex);
+    if (m_cache.size() >= 256) {
+        m_cache.clear();
+    }
+    m_cache.insert(term, packages);
+
+    return packages;
+}
+
+QStringList InstallerRunner::commandNotFound(const QString &term)
+{
+    KProcess process;
+    if (QFile::exists("/usr/lib/command-not-found")) {
+        process << "/usr/lib/command-not-found" << term;
+    } else if (QFile::exists("/usr/bin/command-not-found")) {
+        process << "/usr/bin/command-not-found" << term;
+    } else {
+        process << "/bin/ls" << term; // Play it safe even if it won't work at all
+    }
+    process.setTextModeEnabled(true);
+    process.setOutputChannelMode(KProcess::OnlyStderrChannel);
+    process.start();
+    process.waitForFinished();
+
+    QStringList packages;
+    QString output = QString(process.readAllStandardError());
+    QStringList resultLines = output.split('\n');
+    foreach(const QString &line, resultLines) {
+        if (line.startsWith(QLatin1String("sudo"))) {
+            packages << line.split(' ').last();
+        }
+    }
+
+    return packages;
+}
+
 void InstallerRunner::run(const Plasma::RunnerContext &context, const Plasma::QueryMatch &match)
 {
     Q_UNUSED(context);
@@ -23,6 +23,11 @@
 
 #include <KRunner/AbstractRunner>
 
+#include <QHash>
+#include <QMutex>
+
+#include "CommandIndex.h"
+
 /**
  * This runner checks if the query exists as an executable in the normal paths
  * and suggests the installation of the package that would normally contain
@@ -41,6 +46,15 @@ public:
 
 protected:
     void setupMatch(const QString &package, const QString &term, Plasma::QueryMatch &action);
+
+private:
+    QStringList packagesForCommand(Plasma::RunnerContext &context, const QString &term);
+    QStringList commandNotFound(const QString &term);
+
+    CommandIndex m_commandIndex;
+    // Packages found for recent terms
+    QMutex m_cacheMutex;
+    QHash<QString, QStringList> m_cache;
 };
 
 #endif
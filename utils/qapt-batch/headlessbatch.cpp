@@ -0,0 +1,235 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "headlessbatch.h"
+
+#include <QCoreApplication>
+#include <QIODevice>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+#include <QApt/Backend>
+#include <QApt/Transaction>
+
+#include <clocale>
+#include <cstdio>
+
+HeadlessBatch::HeadlessBatch(const QString &mode, const QStringList &packages, QObject *parent)
+    : QObject(parent)
+    , m_backend(new QApt::Backend(this))
+    , m_trans(nullptr)
+    , m_mode(mode)
+    , m_failed(false)
+{
+    if (!m_backend->init()) {
+        QJsonObject record;
+        record[QLatin1String("details")] = m_backend->initErrorMessage();
+        emitRecord(QLatin1String("init-error"), record);
+        m_failed = true;
+        return;
+    }
+
+    m_backend->setFrontendCaps(QApt::NoCaps);
+
+    const QString action = (m_mode == QLatin1String("uninstall")) ? QLatin1String("remove") : m_mode;
+    for (const QString &package : packages)
+        addAction(action, package);
+}
+
+bool HeadlessBatch::addAction(const QString &action, const QString &packageName)
+{
+    if (!m_backend->package(packageName)) {
+        QJsonObject record;
+        record[QLatin1String("package")] = packageName;
+        emitRecord(QLatin1String("not-found"), record);
+        m_failed = true;
+        return false;
+    }
+
+    if (action == QLatin1String("install")) {
+        m_toInstall << packageName;
+    } else if (action == QLatin1String("remove")) {
+        m_toRemove << packageName;
+    } else if (action == QLatin1String("purge")) {
+        m_toPurge << packageName;
+    } else {
+        QJsonObject record;
+        record[QLatin1String("action")] = action;
+        record[QLatin1String("package")] = packageName;
+        emitRecord(QLatin1String("invalid-action"), record);
+        m_failed = true;
+        return false;
+    }
+
+    return true;
+}
+
+bool HeadlessBatch::readActions(QIODevice *input)
+{
+    if (m_failed)
+        return false;
+
+    const QString defaultAction = (m_mode == QLatin1String("uninstall")) ? QLatin1String("remove") : m_mode;
+
+    QTextStream stream(input);
+    QString line;
+    while (stream.readLineInto(&line)) {
+        const int comment = line.indexOf(QLatin1Char('#'));
+        if (comment != -1)
+            line.truncate(comment);
+
+        QStringList words = line.split(QLatin1Char(' '), QString::SkipEmptyParts);
+        if (words.isEmpty())
+            continue;
+
+        QString action = defaultAction;
+        const QString &first = words.first();
+        if (first == QLatin1String("install") || first == QLatin1String("remove") ||
+            first == QLatin1String("purge")) {
+            action = words.takeFirst();
+        }
+
+        for (const QString &package : words)
+            addAction(action, package);
+    }
+
+    return !m_failed;
+}
+
+bool HeadlessBatch::start()
+{
+    if (m_failed)
+        return false;
+
+    if (m_mode == QLatin1String("update")) {
+        m_trans = m_backend->updateCache();
+    } else {
+        // Everything goes into one transaction
+        m_backend->setCompressEvents(true);
+        for (QApt::Package *package : m_backend->packages(m_toInstall).packages)
+            package->setInstall();
+        for (QApt::Package *package : m_backend->packages(m_toRemove).packages)
+            package->setRemove();
+        for (QApt::Package *package : m_backend->packages(m_toPurge).packages)
+            package->setPurge();
+        m_backend->setCompressEvents(false);
+
+        // e.g. everything asked for is installed already. An empty commit
+        // would only make the worker start a transaction that does nothing
+        if (!m_backend->areChangesMarked()) {
+            emitRecord(QLatin1String("nothing-to-do"), QJsonObject());
+            QMetaObject::invokeMethod(QCoreApplication::instance(), "quit", Qt::QueuedConnection);
+            return true;
+        }
+
+        m_trans = m_backend->commitChanges();
+    }
+
+    m_trans->setLocale(QLatin1String(setlocale(LC_ALL, 0)));
+
+    connect(m_trans, SIGNAL(statusChanged(QApt::TransactionStatus)),
+            this, SLOT(statusChanged(QApt::TransactionStatus)));
+    connect(m_trans, SIGNAL(progressChanged(int)),
+            this, SLOT(progressChanged(int)));
+    connect(m_trans, SIGNAL(statusDetailsChanged(QString)),
+            this, SLOT(statusDetailsChanged(QString)));
+    connect(m_trans, SIGNAL(errorOccurred(QApt::ErrorCode)),
+            this, SLOT(errorOccurred(QApt::ErrorCode)));
+    connect(m_trans, SIGNAL(mediumRequired(QString,QString)),
+            this, SLOT(mediumRequired(QString,QString)));
+    connect(m_trans, SIGNAL(promptUntrusted(QStringList)),
+            this, SLOT(promptUntrusted(QStringList)));
+    connect(m_trans, SIGNAL(finished(QApt::ExitStatus)),
+            this, SLOT(finished(QApt::ExitStatus)));
+
+    m_trans->run();
+
+    return true;
+}
+
+void HeadlessBatch::emitRecord(const QString &type, QJsonObject record)
+{
+    record[QLatin1String("type")] = type;
+
+    const QByteArray line = QJsonDocument(record).toJson(QJsonDocument::Compact) + '\n';
+    fwrite(line.constData(), 1, line.size(), stdout);
+    fflush(stdout);
+}
+
+void HeadlessBatch::statusChanged(QApt::TransactionStatus status)
+{
+    QJsonObject record;
+    record[QLatin1String("status")] = int(status);
+    emitRecord(QLatin1String("status"), record);
+}
+
+void HeadlessBatch::progressChanged(int progress)
+{
+    QJsonObject record;
+    record[QLatin1String("progress")] = progress;
+    emitRecord(QLatin1String("progress"), record);
+}
+
+void HeadlessBatch::statusDetailsChanged(const QString &details)
+{
+    QJsonObject record;
+    record[QLatin1String("details")] = details;
+    emitRecord(QLatin1String("details"), record);
+}
+
+void HeadlessBatch::errorOccurred(QApt::ErrorCode code)
+{
+    QJsonObject record;
+    record[QLatin1String("code")] = int(code);
+    record[QLatin1String("details")] = m_trans->errorDetails();
+    emitRecord(QLatin1String("error"), record);
+}
+
+void HeadlessBatch::mediumRequired(const QString &label, const QString &mountPoint)
+{
+    // Nobody is there to insert it
+    QJsonObject record;
+    record[QLatin1String("label")] = label;
+    record[QLatin1String("mountPoint")] = mountPoint;
+    emitRecord(QLatin1String("medium-required"), record);
+    m_trans->cancel();
+}
+
+void HeadlessBatch::promptUntrusted(const QStringList &untrustedPackages)
+{
+    QJsonObject record;
+    record[QLatin1String("packages")] = QJsonValue::fromVariant(untrustedPackages);
+    emitRecord(QLatin1String("untrusted"), record);
+    m_trans->replyUntrustedPrompt(false);
+}
+
+void HeadlessBatch::finished(QApt::ExitStatus exitStatus)
+{
+    QJsonObject record;
+    record[QLatin1String("exitStatus")] = int(exitStatus);
+    emitRecord(QLatin1String("finished"), record);
+
+    const bool success = exitStatus == QApt::ExitSuccess && m_trans->error() == QApt::Success;
+    m_trans->deleteLater();
+    m_trans = nullptr;
+
+    QCoreApplication::exit(success ? 0 : 1);
+}
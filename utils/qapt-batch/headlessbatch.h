@@ -0,0 +1,81 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef HEADLESSBATCH_H
+#define HEADLESSBATCH_H
+
+#include <QObject>
+#include <QStringList>
+
+// LibQApt includes
+#include <QApt/Globals>
+
+class QIODevice;
+class QJsonObject;
+
+namespace QApt {
+    class Backend;
+    class Transaction;
+}
+
+/**
+ * Runs qapt-batch without any widgets. Package actions are read line by
+ * line from an input device, all of them are committed as one transaction
+ * and progress is written to stdout as one JSON object per line.
+ *
+ * Each input line holds an action ("install", "remove" or "purge")
+ * followed by one or more package names. Lines with just package names use
+ * the action given on the command line, '#' starts a comment.
+ */
+class HeadlessBatch : public QObject
+{
+    Q_OBJECT
+public:
+    HeadlessBatch(const QString &mode, const QStringList &packages, QObject *parent = 0);
+
+    /// Reads further package actions from @p input until it ends
+    bool readActions(QIODevice *input);
+
+    /// Starts the transaction, the application quits once it has finished
+    bool start();
+
+private Q_SLOTS:
+    void statusChanged(QApt::TransactionStatus status);
+    void progressChanged(int progress);
+    void statusDetailsChanged(const QString &details);
+    void errorOccurred(QApt::ErrorCode code);
+    void mediumRequired(const QString &label, const QString &mountPoint);
+    void promptUntrusted(const QStringList &untrustedPackages);
+    void finished(QApt::ExitStatus exitStatus);
+
+private:
+    bool addAction(const QString &action, const QString &packageName);
+    void emitRecord(const QString &type, QJsonObject record);
+
+    QApt::Backend *m_backend;
+    QApt::Transaction *m_trans;
+    QString m_mode;
+    QStringList m_toInstall;
+    QStringList m_toRemove;
+    QStringList m_toPurge;
+    bool m_failed;
+};
+
+#endif
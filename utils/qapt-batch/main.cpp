@@ -18,13 +18,18 @@
  *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
  ***************************************************************************/
 
+#include "headlessbatch.h"
 #include "qaptbatch.h"
 
 #include <QApplication>
 #include <QCommandLineParser>
 #include <QDebug>
+#include <QFile>
 #include <QIcon>
 #include <QPointer>
+#include <QScopedPointer>
+
+#include <cstring>
 
 #include <KAboutData>
 #include <KLocalizedString>
@@ -36,8 +41,19 @@ static const char version[] = CMAKE_PROJECT_VERSION;
 
 int main(int argc, char **argv)
 {
-    QApplication app(argc, argv);
-    app.setWindowIcon(QIcon::fromTheme("applications-other"));
+    // The headless mode must not need a display, so decide before any
+    // QApplication gets created
+    bool headless = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--headless") == 0)
+            headless = true;
+    }
+
+    QScopedPointer<QCoreApplication> appPointer(headless ? new QCoreApplication(argc, argv)
+                                                         : new QApplication(argc, argv));
+    QCoreApplication &app = *appPointer;
+    if (!headless)
+        QApplication::setWindowIcon(QIcon::fromTheme("applications-other"));
 
     KLocalizedString::setApplicationDomain("qapt-batch");
 
@@ -73,6 +89,13 @@ int main(int argc, char **argv)
     QCommandLineOption updateOption(QStringLiteral("update"),
                                     i18nc("@info:shell", "Update the package cache"));
     parser.addOption(updateOption);
+    QCommandLineOption headlessOption(QStringLiteral("headless"),
+                                    i18nc("@info:shell", "Run without a user interface, printing progress as JSON lines"));
+    parser.addOption(headlessOption);
+    QCommandLineOption fileOption(QStringLiteral("from-file"),
+                                    i18nc("@info:shell", "Read actions and packages from a file, or - for standard input (headless only)"),
+                                    i18nc("@info:shell value name", "file"));
+    parser.addOption(fileOption);
     parser.addPositionalArgument("packages",
                                  i18nc("@info:shell", "Packages to be operated upon"));
     aboutData.setupCommandLine(&parser);
@@ -83,7 +106,11 @@ int main(int argc, char **argv)
 
     int winId = parser.value(attachOption).toInt();
 
-    if (!(parser.isSet(installOption) ^ parser.isSet(uninstallOption) ^ parser.isSet(updateOption))) {
+    const bool anyMode = parser.isSet(installOption) || parser.isSet(uninstallOption) || parser.isSet(updateOption);
+
+    // Headless runs may take all their actions from the input file
+    if ((anyMode || !headless) &&
+        !(parser.isSet(installOption) ^ parser.isSet(uninstallOption) ^ parser.isSet(updateOption))) {
         qCritical() << i18nc("@info:shell error", "Only one operation mode may be defined.");
         return 1;
     }
@@ -94,6 +121,8 @@ int main(int argc, char **argv)
         mode = QStringLiteral("uninstall");
     } else if (parser.isSet(updateOption)) {
         mode = QStringLiteral("update");
+    } else if (headless) {
+        mode = QStringLiteral("install");
     } else {
         qCritical() << i18nc("@info:shell error", "No operation mode defined.");
         return 1;
@@ -101,6 +130,29 @@ int main(int argc, char **argv)
 
     QStringList packages = parser.positionalArguments();
 
+    if (headless) {
+        HeadlessBatch batch(mode, packages);
+
+        if (parser.isSet(fileOption)) {
+            QFile input;
+            const QString fileName = parser.value(fileOption);
+            const bool opened = (fileName == QLatin1String("-"))
+                                ? input.open(stdin, QIODevice::ReadOnly | QIODevice::Text)
+                                : (input.setFileName(fileName), input.open(QIODevice::ReadOnly | QIODevice::Text));
+            if (!opened) {
+                qCritical() << i18nc("@info:shell error", "Could not open %1.", fileName);
+                return 1;
+            }
+            if (!batch.readActions(&input))
+                return 1;
+        }
+
+        if (!batch.start())
+            return 1;
+
+        return app.exec();
+    }
+
     Q_UNUSED(app);
     QPointer<QAptBatch> batchInstaller = new QAptBatch(mode, packages, winId);
     switch (batchInstaller->exec()) {
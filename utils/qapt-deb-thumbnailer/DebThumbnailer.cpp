@@ -21,7 +21,12 @@
 
 #include "DebThumbnailer.h"
 
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include <QStringBuilder>
 #include <QImage>
 #include <QPainter>
@@ -48,17 +53,17 @@ DebThumbnailer::~DebThumbnailer()
 {
 }
 
-bool DebThumbnailer::create(const QString &path, int width, int height, QImage &img)
+// Returns the app icon of the archive at @p path scaled to @p width, or a
+// null image if it has none
+static QImage debIcon(const QString &path, int width)
 {
     const QApt::DebFile debFile(path);
 
     if (!debFile.isValid()) {
         qDebug() << Q_FUNC_INFO << "debfile not valid";
-        return false;
+        return QImage();
     }
 
-    QStringList iconsList = debFile.iconList();
-
     // Drop everything but pngs and xpms.
     // ::iconList is based on ::fileList which contrary to what the name suggests
     // does a full content list including parent directories.
@@ -66,36 +71,76 @@ bool DebThumbnailer::create(const QString &path, int width, int height, QImage &
     // identify as supported.
     // TODO: should debfile ever get more sensible this should be changed to
     //       exclude unsupported formats (svg) rather than include supported ones.
-    for (auto it = iconsList.begin(); it != iconsList.end(); ++it) {
-        if (!(*it).endsWith(QStringLiteral(".png")) && !(*it).endsWith(QStringLiteral(".xpm"))) {
-            iconsList.erase(it);
+    QStringList iconsList;
+    for (const QString &icon : debFile.iconList()) {
+        if (icon.endsWith(QStringLiteral(".png")) || icon.endsWith(QStringLiteral(".xpm"))) {
+            iconsList << icon;
         }
     }
 
     qSort(iconsList);
 
     if (iconsList.isEmpty()) {
-        return false;
+        return QImage();
     }
 
-    QString iconPath = iconsList.last();
-
-    // FIXME: two users at the same time cannot use the thumbnailer or bad things happen
-    QDir tempDir = QDir::temp();
-    tempDir.mkdir(QStringLiteral("kde-deb-thumbnailer"));
+    const QImage icon = QImage::fromData(debFile.readFile(iconsList.last()));
+    if (icon.isNull()) {
+        return QImage();
+    }
 
-    QString destPath = QDir::tempPath() % QLatin1Literal("/kde-deb-thumbnailer/");
+    return icon.scaledToWidth(width, Qt::SmoothTransformation);
+}
 
-    if (!debFile.extractFileFromArchive(iconPath, destPath)) {
+bool DebThumbnailer::create(const QString &path, int width, int height, QImage &img)
+{
+    // Archives on shares get thumbnailed over and over, so the scaled icons
+    // are kept per user, keyed by what identifies an archive cheaply. An
+    // empty file stands for an archive without icon
+    const QFileInfo info(path);
+    const QByteArray key = info.canonicalFilePath().toUtf8() % '\n' %
+                           QByteArray::number(info.size()) % '\n' %
+                           QByteArray::number(info.lastModified().toMSecsSinceEpoch()) % '\n' %
+                           QByteArray::number(width / 2);
+
+    const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) %
+                             QLatin1String("/qapt-deb-thumbnailer/");
+    const QString cachePath = cacheDir %
+                              QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex()) %
+                              QLatin1String(".png");
+
+    QImage appOverlay;
+    const QFileInfo cacheInfo(cachePath);
+
+    if (cacheInfo.exists() && cacheInfo.size() == 0) {
         return false;
+    } else if (cacheInfo.exists()) {
+        appOverlay.load(cachePath);
+    }
+
+    if (appOverlay.isNull()) {
+        appOverlay = debIcon(path, width / 2);
+
+        // Written in one go, in case others thumbnail the same archive
+        QDir().mkpath(cacheDir);
+        QSaveFile cacheFile(cachePath);
+        if (cacheFile.open(QIODevice::WriteOnly)) {
+            if (!appOverlay.isNull()) {
+                appOverlay.save(&cacheFile, "PNG");
+            }
+            cacheFile.commit();
+        }
+
+        if (appOverlay.isNull()) {
+            return false;
+        }
     }
 
     QPixmap mimeIcon = QIcon::fromTheme("application-x-deb").pixmap(width, height);
-    QPixmap appOverlay = QPixmap(destPath % iconPath).scaledToWidth(width/2);
 
     QPainter painter(&mimeIcon);
     for (int y = 0; y < appOverlay.height(); y += appOverlay.height()) {
-        painter.drawPixmap( 0, y, appOverlay );
+        painter.drawImage( 0, y, appOverlay );
     }
 
     img = mimeIcon.toImage();
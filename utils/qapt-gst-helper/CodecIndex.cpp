@@ -0,0 +1,92 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "CodecIndex.h"
+
+#include <QStringList>
+
+#include <QApt/Backend>
+
+#include "PluginInfo.h"
+
+CodecIndex::CodecIndex(QApt::Backend *backend)
+{
+    const QString nativeArch = backend->nativeArchitecture();
+
+    QApt::PackageList candidates;
+    for (QApt::Package *package : backend->availablePackages()) {
+        if (!package->isInstalled() && package->architecture() == nativeArch)
+            candidates << package;
+    }
+
+    const QStringList fieldNames = {
+        QLatin1String("Gstreamer-Version"),
+        QLatin1String("Gstreamer-Encoders"),
+        QLatin1String("Gstreamer-Decoders"),
+        QLatin1String("Gstreamer-Uri-Sources"),
+        QLatin1String("Gstreamer-Uri-Sinks"),
+        QLatin1String("Gstreamer-Elements")
+    };
+
+    const QList<QStringList> fields = backend->recordFields(candidates, fieldNames);
+
+    for (int i = 0; i < candidates.size(); ++i) {
+        const QStringList &values = fields.at(i);
+
+        // Must be x.y or we don't consider it a valid API version number.
+        const QStringList versionFields = values.at(0).split(QChar('.'));
+        if (versionFields.size() != 2)
+            continue;
+
+        Entry entry;
+        entry.package = candidates.at(i);
+        entry.version = values.at(0);
+        entry.minorVersion = versionFields.at(1).toInt();
+        entry.caps[PluginInfo::Encoder] = values.at(1);
+        entry.caps[PluginInfo::Decoder] = values.at(2);
+        entry.caps[PluginInfo::UriSource] = values.at(3);
+        entry.caps[PluginInfo::UriSink] = values.at(4);
+        entry.caps[PluginInfo::Element] = values.at(5);
+
+        m_entries[versionFields.at(0).toInt()].append(entry);
+    }
+}
+
+CodecIndex::~CodecIndex()
+{
+    for (GstCaps *caps : m_parsedCaps) {
+        if (caps)
+            gst_caps_unref(caps);
+    }
+}
+
+QVector<CodecIndex::Entry> CodecIndex::entries(int majorVersion) const
+{
+    return m_entries.value(majorVersion);
+}
+
+GstCaps *CodecIndex::parsedCaps(const QString &caps) const
+{
+    auto it = m_parsedCaps.constFind(caps);
+    if (it == m_parsedCaps.constEnd())
+        it = m_parsedCaps.insert(caps, gst_caps_from_string(caps.toUtf8().constData()));
+
+    return *it;
+}
@@ -0,0 +1,70 @@
+/***************************************************************************
+ *   Copyright © 2026 agent <agent@local>                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef CODECINDEX_H
+#define CODECINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+namespace QApt {
+    class Backend;
+    class Package;
+}
+
+typedef struct _GstCaps GstCaps;
+
+/**
+ * An index of the Gstreamer-* fields of all installable native packages,
+ * read in a single pass over the package records and grouped by the major
+ * part of their Gstreamer-Version.
+ */
+class CodecIndex
+{
+public:
+    struct Entry {
+        QApt::Package *package;
+        QString version;
+        int minorVersion;
+        // The caps of each PluginInfo::PluginType
+        QString caps[6];
+    };
+
+    explicit CodecIndex(QApt::Backend *backend);
+    ~CodecIndex();
+
+    /// Returns the entries with a Gstreamer-Version of @p majorVersion.x
+    QVector<Entry> entries(int majorVersion) const;
+
+    /**
+     * Returns @p caps parsed, or 0 if it can't be parsed. Each distinct caps
+     * string is only parsed once, and owned by the index.
+     */
+    GstCaps *parsedCaps(const QString &caps) const;
+
+private:
+    Q_DISABLE_COPY(CodecIndex)
+
+    QHash<int, QVector<Entry> > m_entries;
+    mutable QHash<QString, GstCaps *> m_parsedCaps;
+};
+
+#endif
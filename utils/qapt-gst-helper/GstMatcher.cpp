@@ -23,55 +23,53 @@
 
 #include <QDebug>
 
-#include <QApt/Package>
-
 #include "PluginInfo.h"
 
 GstMatcher::GstMatcher(const PluginInfo *info)
+    : m_info(info)
+    , m_caps(0)
 {
-    m_aptTypes = QVector<QString>(6);
-    m_aptTypes[PluginInfo::InvalidType] = QLatin1String("");
-    m_aptTypes[PluginInfo::Encoder] = QLatin1String("Gstreamer-Encoders");
-    m_aptTypes[PluginInfo::Decoder] = QLatin1String("Gstreamer-Decoders");
-    m_aptTypes[PluginInfo::UriSource] = QLatin1String("Gstreamer-Uri-Sources");
-    m_aptTypes[PluginInfo::UriSink] = QLatin1String("Gstreamer-Uri-Sinks");
-    m_aptTypes[PluginInfo::Element] = QLatin1String("Gstreamer-Elements");
-
-    m_info = info;
+    // There is a bug in Ubuntu (and supposedly Debian) where it lists an incorrect
+    // version, see below. To work around the problem a more fuzzy match is used,
+    // to force strict matching, use export QAPT_GST_STRICT_VERSION_MATCH=1.
+    m_strictVersion = !qgetenv("QAPT_GST_STRICT_VERSION_MATCH").isEmpty();
+
+    QStringList infoVersionFields = m_info->version().split(QChar('.'));
+    m_majorVersion = infoVersionFields.value(0).toInt();
+    m_minorVersion = infoVersionFields.value(1).toInt();
+
+    if (m_info->pluginType() == PluginInfo::Encoder || m_info->pluginType() == PluginInfo::Decoder) {
+        m_caps = gst_caps_from_string(m_info->capsInfo().toUtf8().constData());
+
+        if (m_caps && !gst_caps_is_any(m_caps)) {
+            for (guint i = 0; i < gst_caps_get_size(m_caps); ++i)
+                m_mediaTypes << QString::fromUtf8(gst_structure_get_name(gst_caps_get_structure(m_caps, i)));
+        }
+    }
 }
 
 GstMatcher::~GstMatcher()
 {
+    if (m_caps)
+        gst_caps_unref(m_caps);
 }
 
-bool GstMatcher::matches(QApt::Package *package)
+int GstMatcher::majorVersion() const
 {
-    // Reject already-installed packages
-    if (package->isInstalled())
-        return false;
+    return m_majorVersion;
+}
 
-    // There is a bug in Ubuntu (and supposedly Debian) where it lists an incorrect
-    // version, see below. To work around the problem a more fuzzy match is used,
-    // to force strict matching, use export QAPT_GST_STRICT_VERSION_MATCH=1.
-    if (!qgetenv("QAPT_GST_STRICT_VERSION_MATCH").isEmpty()) {
-        if (package->controlField(QLatin1String("Gstreamer-Version")) != m_info->version())
+bool GstMatcher::matches(const CodecIndex::Entry &entry, const CodecIndex &index) const
+{
+    // Installed packages, foreign packages and ones without an x.y version
+    // never make it into the index.
+    if (m_strictVersion) {
+        if (entry.version != m_info->version())
             return false;
     } else {
-        // Excitingly silly code following...
-
-        QString packageVersion = package->controlField(QLatin1String("Gstreamer-Version"));
-
-        if (packageVersion.isEmpty()) // No version, discard.
-            return false;
-
-        QStringList packageVersionFields = packageVersion.split(QChar('.'));
-        if (packageVersionFields.size() != 2) // must be x.y or we don't consider it a valid API version number.
-            return false;
-
-        QStringList infoVersionFields = m_info->version().split(QChar('.'));
-
-        // x and y in x.y: both of the package need to be greater or equal to the ones
-        // in the request.
+        // x and y in x.y: the x of the package needs to be the same as the
+        // one of the request (the index is grouped by it), its y greater or
+        // equal.
         // WARNING: This is a bloody workaround for Ubuntu having broken versions.
         //          In particular Ubuntu thinks that gst_version(...) is the same
         //          as the GST_API_VERSION, which worked out fine for 0.1x but fails
@@ -79,45 +77,42 @@ bool GstMatcher::matches(QApt::Package *package)
         //          but gst_version is at 1.2. libgstreamer will however continue to
         //          ask for api version, so we get a request for 1.0 but the packages
         //          say they are 1.2 .... -.-
-        for (int i = 0; i < 2; ++i) {
-            int packageVersion = packageVersionFields.at(i).toInt();
-            int infoVersion = infoVersionFields.at(i).toInt();
-            if (i == 0) {
-                if (packageVersion != infoVersion)
-                    return false;
-            } else {
-                if (packageVersion < infoVersion)
-                    return false;
-            }
-        }
-
-        // At this point we have assured that the package has a version, that it is
-        // of the form x.y and that the package's x.y is >= the request's x.y.
-        // We now consider the version an acceptable match.
-
-        // End of excitingly silly code.
+        if (entry.minorVersion < m_minorVersion)
+            return false;
     }
 
-    QString typeName = m_aptTypes[m_info->pluginType()];
-    QString typeData = package->controlField(typeName);
+    const QString &typeData = entry.caps[m_info->pluginType()];
 
     if (typeData.isEmpty())
         return false;
 
-    // We are handling gobjects that need cleanup, so we'll do a delayed return.
     bool ret = false;
 
-    GstCaps *packageCaps = gst_caps_from_string(typeData.toUtf8().constData());
-    GstCaps *pluginCaps = gst_caps_from_string(m_info->capsInfo().toUtf8().constData());
-
     switch (m_info->pluginType()) {
     case PluginInfo::Encoder:
-    case PluginInfo::Decoder:
-        if (!packageCaps || !pluginCaps || gst_caps_is_empty(packageCaps) || gst_caps_is_empty(pluginCaps))
-            ret = false;
+    case PluginInfo::Decoder: {
+        if (!m_caps || gst_caps_is_empty(m_caps))
+            break;
+
+        // Caps can only intersect if the package names one of the requested
+        // media types, which is much cheaper to check than parsing its caps
+        if (!m_mediaTypes.isEmpty()) {
+            bool plausible = false;
+            for (const QString &mediaType : m_mediaTypes) {
+                if (typeData.contains(mediaType)) {
+                    plausible = true;
+                    break;
+                }
+            }
+            if (!plausible)
+                break;
+        }
 
-        ret = gst_caps_can_intersect(pluginCaps, packageCaps);
+        GstCaps *packageCaps = index.parsedCaps(typeData);
+        if (packageCaps && !gst_caps_is_empty(packageCaps))
+            ret = gst_caps_can_intersect(m_caps, packageCaps);
         break;
+    }
     case PluginInfo::Element:
     case PluginInfo::UriSink:
     case PluginInfo::UriSource:
@@ -125,8 +120,6 @@ bool GstMatcher::matches(QApt::Package *package)
         break;
     }
 
-    gst_caps_unref(pluginCaps);
-    gst_caps_unref(packageCaps);
     return ret;
 }
 
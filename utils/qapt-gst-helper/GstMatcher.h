@@ -22,14 +22,11 @@
 #ifndef GSTMATCHER_H
 #define GSTMATCHER_H
 
-#include <QVector>
 #include <QStringList>
 
-class PluginInfo;
+#include "CodecIndex.h"
 
-namespace QApt {
-    class Package;
-}
+class PluginInfo;
 
 class GstMatcher
 {
@@ -37,12 +34,22 @@ public:
     explicit GstMatcher(const PluginInfo *info);
     ~GstMatcher();
 
-    bool matches(QApt::Package *package);
+    bool matches(const CodecIndex::Entry &entry, const CodecIndex &index) const;
     bool hasMatches() const;
 
+    /// The major part of the requested API version, to look up in a CodecIndex
+    int majorVersion() const;
+
 private:
     const PluginInfo *m_info;
-    QVector<QString> m_aptTypes;
+    bool m_strictVersion;
+    int m_majorVersion;
+    int m_minorVersion;
+    // The requested caps and the media types they name, for encoders and decoders
+    GstCaps *m_caps;
+    QStringList m_mediaTypes;
+
+    Q_DISABLE_COPY(GstMatcher)
 };
 
 #endif
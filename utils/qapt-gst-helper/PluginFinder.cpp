@@ -24,6 +24,7 @@
 
 #include <QApt/Backend>
 
+#include "CodecIndex.h"
 #include "GstMatcher.h"
 #include "PluginInfo.h"
 
@@ -38,7 +39,7 @@ PluginFinder::~PluginFinder()
 {
 }
 
-void PluginFinder::find(const PluginInfo *pluginInfo)
+void PluginFinder::find(const PluginInfo *pluginInfo, const CodecIndex &index)
 {
     if (m_stop) {
         return;
@@ -52,9 +53,9 @@ void PluginFinder::find(const PluginInfo *pluginInfo)
         return;
     }
 
-    foreach (QApt::Package *package, m_backend->availablePackages()) {
-        if (matcher.matches(package) && package->architecture() == m_backend->nativeArchitecture()) {
-            emit foundCodec(package);
+    for (const CodecIndex::Entry &entry : index.entries(matcher.majorVersion())) {
+        if (matcher.matches(entry, index)) {
+            emit foundCodec(entry.package);
             return;
         }
     }
@@ -69,8 +70,11 @@ void PluginFinder::setSearchList(const QList<PluginInfo *> &list)
 
 void PluginFinder::startSearch()
 {
+    // Read the codec fields of all packages once for all requests
+    const CodecIndex index(m_backend);
+
     foreach(PluginInfo *info, m_searchList) {
-        find(info);
+        find(info, index);
     }
 
     thread()->quit();
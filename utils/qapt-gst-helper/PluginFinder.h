@@ -29,6 +29,7 @@ namespace QApt {
     class Package;
 }
 
+class CodecIndex;
 class PluginInfo;
 
 class PluginFinder : public QObject
@@ -48,8 +49,8 @@ public Q_SLOTS:
     void setSearchList(const QList<PluginInfo *> &list);
     void stop();
 
-private Q_SLOTS:
-    void find(const PluginInfo *pluginInfo);
+private:
+    void find(const PluginInfo *pluginInfo, const CodecIndex &index);
 
 Q_SIGNALS:
     void foundCodec(QApt::Package *package);